@@ -0,0 +1,86 @@
+/**
+ * BackgroundThread.cpp
+ * \brief Shared background thread for work that the audio thread hands off.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "BackgroundThread.h"
+
+BackgroundThread::BackgroundThread()
+    : m_tasks(),
+      m_mutex(),
+      m_wake(),
+      m_signals (0),
+      m_sleeping (false),
+      m_running (true),
+      m_thread()
+{
+    m_thread = std::thread (&BackgroundThread::run, this);
+}
+
+BackgroundThread::~BackgroundThread()
+{
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+std::shared_ptr<BackgroundThread> BackgroundThread::getShared()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<BackgroundThread> shared;
+
+    std::lock_guard<std::mutex> lock (mutex);
+    std::shared_ptr<BackgroundThread> thread = shared.lock();
+    if (thread == nullptr)
+    {
+        thread = std::make_shared<BackgroundThread>();
+        shared = thread;
+    }
+    return thread;
+}
+
+void BackgroundThread::add (const TaskFunction function, void* context)
+{
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_tasks.push_back ({ function, context });
+    }
+    signal();
+}
+
+void BackgroundThread::remove (void* context)
+{
+    // The tasks run with the mutex held, so none of them is running once it's taken.
+    std::lock_guard<std::mutex> lock (m_mutex);
+    m_tasks.erase (std::remove_if (m_tasks.begin(), m_tasks.end(), [context] (const Task& task) { return task.context == context; }),
+                   m_tasks.end());
+}
+
+void BackgroundThread::signal()
+{
+    // Notifying doesn't need the mutex. A wake-up that's missed is made up for by the timeout.
+    ++m_signals;
+    if (m_sleeping.load()) { m_wake.notify_one(); }
+}
+
+void BackgroundThread::run()
+{
+    std::unique_lock<std::mutex> lock (m_mutex);
+    while (m_running.load())
+    {
+        // Signals from here on wake the thread again, even if they're about work done in this pass.
+        const uint32_t seen = m_signals.load();
+        for (const auto& task : m_tasks) { task.function (task.context); }
+
+        m_sleeping = true;
+        m_wake.wait_for (lock, std::chrono::milliseconds (s_sleepTime), [this, seen] { return m_signals.load() != seen || ! m_running.load(); });
+        m_sleeping = false;
+    }
+}
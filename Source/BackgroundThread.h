@@ -0,0 +1,109 @@
+/**
+ * BackgroundThread.h
+ * \brief Shared background thread for work that the audio thread hands off.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Shared background thread for work that the audio thread hands off.
+ *
+ * Objects that need housekeeping done off the audio thread (spilling audio to disk, computing
+ * late convolution blocks and so on) register a task with add(). Each time the thread wakes, it
+ * runs every registered task once. The audio thread wakes it with signal(), which never blocks,
+ * allocates memory or takes a lock, so a task only runs when there is something for it to do.
+ *
+ * Notifying without the mutex means that a signal can arrive just before the thread sleeps and
+ * be missed, so the thread also wakes every s_sleepTime to run the tasks anyway. Tasks should
+ * therefore check for work themselves rather than count on one run per signal.
+ *
+ * One thread is shared by every plugin instance (see getShared()), so tasks must be short enough
+ * not to hold up the others for long.
+ */
+class BackgroundThread
+{
+public:
+
+    /**
+     * Pointer to a task function.
+     *
+     * \param[in]  void*  Context passed to add()
+     */
+    typedef void (*TaskFunction) (void* context);
+
+    /**
+     * Class constructor, which starts the thread.
+     */
+    BackgroundThread();
+
+    /**
+     * Class destructor, which stops the thread.
+     */
+    ~BackgroundThread();
+
+    /**
+     * Gets the thread shared by the whole process. The thread is started by the first call and
+     * stopped once the last pointer to it is released, so never call this or release the thread
+     * on the audio thread.
+     *
+     * \return  std::shared_ptr<BackgroundThread>  Shared thread
+     */
+    static std::shared_ptr<BackgroundThread> getShared();
+
+    /**
+     * Registers a task, which then runs every time the thread wakes. This waits for the tasks
+     * that are running to finish, so it's never called from the audio thread.
+     *
+     * \param[in]  TaskFunction  Task function
+     * \param[in]  void*  Context passed to the function, which identifies the task for remove()
+     */
+    void add (const TaskFunction function, void* context);
+
+    /**
+     * Unregisters the tasks with the given context. Once this returns, they aren't running and
+     * won't run again, so the context can be destroyed. It's never called from the audio thread.
+     *
+     * \param[in]  void*  Context passed to add()
+     */
+    void remove (void* context);
+
+    /**
+     * Wakes the thread to run the tasks. This is safe to call from the audio thread.
+     */
+    void signal();
+
+    static const int s_sleepTime = 20; ///< Longest time the thread sleeps without running the tasks (msecs).
+
+private:
+
+    /**
+     * Registered task.
+     */
+    struct Task
+    {
+        TaskFunction function; ///< Task function.
+        void* context; ///< Context passed to the function.
+    };
+
+    void run(); ///< Thread loop.
+
+    std::vector<Task> m_tasks; ///< Registered tasks.
+    std::mutex m_mutex; ///< Mutex for the tasks and the wake condition (never taken by signal()).
+    std::condition_variable m_wake; ///< Wakes the thread for a signal.
+    std::atomic<uint32_t> m_signals; ///< Number of signals so far, for the thread to notice new ones.
+    std::atomic<bool> m_sleeping; ///< True while the thread is sleeping.
+    std::atomic<bool> m_running; ///< Cleared to stop the thread.
+    std::thread m_thread; ///< The thread.
+
+    BackgroundThread (const BackgroundThread&) = delete;
+    BackgroundThread& operator= (const BackgroundThread&) = delete;
+};
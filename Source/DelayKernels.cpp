@@ -0,0 +1,651 @@
+/**
+ * DelayKernels.cpp
+ * \brief Vectorized processing kernels for the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "DelayKernels.h"
+
+#if defined (__x86_64__) || defined (__i386__) || defined (_M_X64) || defined (_M_IX86)
+ #define DELAYKERNELS_X86 1
+ #include <immintrin.h>
+ #if defined (_MSC_VER) && ! defined (__clang__)
+  #include <intrin.h>
+  #define DELAYKERNELS_TARGET(isa)
+ #else
+  #define DELAYKERNELS_TARGET(isa) __attribute__ ((target (isa)))
+ #endif
+#elif defined (__ARM_NEON) || defined (__ARM_NEON__)
+ #define DELAYKERNELS_NEON 1
+ #include <arm_neon.h>
+#endif
+
+// The kernels must not fuse multiplies and adds, or they won't be bit-exact with each other. GCC
+// ignores the standard pragma, so the makefiles pass -ffp-contract=off, and MSVC builds must keep
+// the default /fp:precise.
+#if defined (__clang__)
+ #pragma STDC FP_CONTRACT OFF
+#elif defined (_MSC_VER)
+ #pragma fp_contract (off)
+#endif
+
+static void processRunScalar (const float* input, float* output, float* write, const float* read, const float* readPrev,
+                              const int numSamples, const float fraction, const float feedback, const float mix)
+{
+    const float fractionInv = 1.0f - fraction;
+    const float mixInv = 1.0f - mix;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float in = input[i];
+        const float out = (fraction * readPrev[i]) + (fractionInv * read[i]);
+        write[i] = in + (feedback * out);
+        output[i] = (mix * out) + (mixInv * in);
+    }
+}
+
+static void processStereoRunScalar (const float* input, float* output, float* write,
+                                    const float* readLeft, const float* readPrevLeft, const float* readRight, const float* readPrevRight,
+                                    const int numFrames, const float fractionLeft, const float fractionRight,
+                                    const float feedback, const float mix, const DelayKernels::StereoMatrix& matrix)
+{
+    const float fractionInvLeft = 1.0f - fractionLeft;
+    const float fractionInvRight = 1.0f - fractionRight;
+    const float mixInv = 1.0f - mix;
+
+    for (int i = 0; i < 2*numFrames; i += 2)
+    {
+        const float inLeft = input[i];
+        const float inRight = input[i + 1];
+        const float outLeft = (fractionLeft * readPrevLeft[i]) + (fractionInvLeft * readLeft[i]);
+        const float outRight = (fractionRight * readPrevRight[i + 1]) + (fractionInvRight * readRight[i + 1]);
+
+        // Each channel is its own gain times itself plus the cross gain times the other channel.
+        write[i] = ((matrix.input[0] * inLeft) + (matrix.input[1] * inRight))
+                 + (feedback * ((matrix.feedback[0] * outLeft) + (matrix.feedback[1] * outRight)));
+        write[i + 1] = ((matrix.input[3] * inRight) + (matrix.input[2] * inLeft))
+                     + (feedback * ((matrix.feedback[3] * outRight) + (matrix.feedback[2] * outLeft)));
+
+        const float wetLeft = (matrix.wet[0] * outLeft) + (matrix.wet[1] * outRight);
+        const float wetRight = (matrix.wet[0] * outRight) + (matrix.wet[1] * outLeft);
+        output[i] = (mix * wetLeft) + (mixInv * inLeft);
+        output[i + 1] = (mix * wetRight) + (mixInv * inRight);
+    }
+}
+
+#if DELAYKERNELS_X86
+
+DELAYKERNELS_TARGET ("sse2")
+static void processRunSSE2 (const float* input, float* output, float* write, const float* read, const float* readPrev,
+                            const int numSamples, const float fraction, const float feedback, const float mix)
+{
+    const __m128 frac = _mm_set1_ps (fraction);
+    const __m128 fracInv = _mm_set1_ps (1.0f - fraction);
+    const __m128 fb = _mm_set1_ps (feedback);
+    const __m128 wet = _mm_set1_ps (mix);
+    const __m128 dry = _mm_set1_ps (1.0f - mix);
+
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const __m128 in = _mm_loadu_ps (input + i);
+        const __m128 out = _mm_add_ps (_mm_mul_ps (frac, _mm_loadu_ps (readPrev + i)), _mm_mul_ps (fracInv, _mm_loadu_ps (read + i)));
+        _mm_storeu_ps (write + i, _mm_add_ps (in, _mm_mul_ps (fb, out)));
+        _mm_storeu_ps (output + i, _mm_add_ps (_mm_mul_ps (wet, out), _mm_mul_ps (dry, in)));
+    }
+
+    processRunScalar (input + i, output + i, write + i, read + i, readPrev + i, numSamples - i, fraction, feedback, mix);
+}
+
+DELAYKERNELS_TARGET ("avx2")
+static void processRunAVX2 (const float* input, float* output, float* write, const float* read, const float* readPrev,
+                            const int numSamples, const float fraction, const float feedback, const float mix)
+{
+    const __m256 frac = _mm256_set1_ps (fraction);
+    const __m256 fracInv = _mm256_set1_ps (1.0f - fraction);
+    const __m256 fb = _mm256_set1_ps (feedback);
+    const __m256 wet = _mm256_set1_ps (mix);
+    const __m256 dry = _mm256_set1_ps (1.0f - mix);
+
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m256 in = _mm256_loadu_ps (input + i);
+        const __m256 out = _mm256_add_ps (_mm256_mul_ps (frac, _mm256_loadu_ps (readPrev + i)), _mm256_mul_ps (fracInv, _mm256_loadu_ps (read + i)));
+        _mm256_storeu_ps (write + i, _mm256_add_ps (in, _mm256_mul_ps (fb, out)));
+        _mm256_storeu_ps (output + i, _mm256_add_ps (_mm256_mul_ps (wet, out), _mm256_mul_ps (dry, in)));
+    }
+
+    processRunScalar (input + i, output + i, write + i, read + i, readPrev + i, numSamples - i, fraction, feedback, mix);
+}
+
+DELAYKERNELS_TARGET ("sse2")
+static void processStereoRunSSE2 (const float* input, float* output, float* write,
+                                  const float* readLeft, const float* readPrevLeft, const float* readRight, const float* readPrevRight,
+                                  const int numFrames, const float fractionLeft, const float fractionRight,
+                                  const float feedback, const float mix, const DelayKernels::StereoMatrix& matrix)
+{
+    // The lanes alternate between the left and right channels, two frames at a time.
+    const __m128 leftLanes = _mm_castsi128_ps (_mm_set_epi32 (0, -1, 0, -1));
+    const __m128 frac = _mm_set_ps (fractionRight, fractionLeft, fractionRight, fractionLeft);
+    const __m128 fracInv = _mm_set_ps (1.0f - fractionRight, 1.0f - fractionLeft, 1.0f - fractionRight, 1.0f - fractionLeft);
+    const __m128 inSame = _mm_set_ps (matrix.input[3], matrix.input[0], matrix.input[3], matrix.input[0]);
+    const __m128 inCross = _mm_set_ps (matrix.input[2], matrix.input[1], matrix.input[2], matrix.input[1]);
+    const __m128 fbSame = _mm_set_ps (matrix.feedback[3], matrix.feedback[0], matrix.feedback[3], matrix.feedback[0]);
+    const __m128 fbCross = _mm_set_ps (matrix.feedback[2], matrix.feedback[1], matrix.feedback[2], matrix.feedback[1]);
+    const __m128 wetSame = _mm_set1_ps (matrix.wet[0]);
+    const __m128 wetCross = _mm_set1_ps (matrix.wet[1]);
+    const __m128 fb = _mm_set1_ps (feedback);
+    const __m128 wet = _mm_set1_ps (mix);
+    const __m128 dry = _mm_set1_ps (1.0f - mix);
+
+    int i = 0;
+    for (; i + 4 <= 2*numFrames; i += 4)
+    {
+        // Take the left lanes from the left read position and the right lanes from the right one.
+        const __m128 read = _mm_or_ps (_mm_and_ps (leftLanes, _mm_loadu_ps (readLeft + i)), _mm_andnot_ps (leftLanes, _mm_loadu_ps (readRight + i)));
+        const __m128 readPrev = _mm_or_ps (_mm_and_ps (leftLanes, _mm_loadu_ps (readPrevLeft + i)), _mm_andnot_ps (leftLanes, _mm_loadu_ps (readPrevRight + i)));
+        const __m128 out = _mm_add_ps (_mm_mul_ps (frac, readPrev), _mm_mul_ps (fracInv, read));
+        const __m128 outSwap = _mm_shuffle_ps (out, out, _MM_SHUFFLE (2, 3, 0, 1));
+
+        const __m128 in = _mm_loadu_ps (input + i);
+        const __m128 inSwap = _mm_shuffle_ps (in, in, _MM_SHUFFLE (2, 3, 0, 1));
+
+        const __m128 inMix = _mm_add_ps (_mm_mul_ps (inSame, in), _mm_mul_ps (inCross, inSwap));
+        const __m128 fbMix = _mm_add_ps (_mm_mul_ps (fbSame, out), _mm_mul_ps (fbCross, outSwap));
+        _mm_storeu_ps (write + i, _mm_add_ps (inMix, _mm_mul_ps (fb, fbMix)));
+
+        const __m128 wetMix = _mm_add_ps (_mm_mul_ps (wetSame, out), _mm_mul_ps (wetCross, outSwap));
+        _mm_storeu_ps (output + i, _mm_add_ps (_mm_mul_ps (wet, wetMix), _mm_mul_ps (dry, in)));
+    }
+
+    processStereoRunScalar (input + i, output + i, write + i, readLeft + i, readPrevLeft + i, readRight + i, readPrevRight + i,
+                            numFrames - i/2, fractionLeft, fractionRight, feedback, mix, matrix);
+}
+
+DELAYKERNELS_TARGET ("avx2")
+static void processStereoRunAVX2 (const float* input, float* output, float* write,
+                                  const float* readLeft, const float* readPrevLeft, const float* readRight, const float* readPrevRight,
+                                  const int numFrames, const float fractionLeft, const float fractionRight,
+                                  const float feedback, const float mix, const DelayKernels::StereoMatrix& matrix)
+{
+    // The lanes alternate between the left and right channels, four frames at a time.
+    const __m256 frac = _mm256_setr_ps (fractionLeft, fractionRight, fractionLeft, fractionRight, fractionLeft, fractionRight, fractionLeft, fractionRight);
+    const __m256 fracInv = _mm256_sub_ps (_mm256_set1_ps (1.0f), frac);
+    const __m256 inSame = _mm256_setr_ps (matrix.input[0], matrix.input[3], matrix.input[0], matrix.input[3], matrix.input[0], matrix.input[3], matrix.input[0], matrix.input[3]);
+    const __m256 inCross = _mm256_setr_ps (matrix.input[1], matrix.input[2], matrix.input[1], matrix.input[2], matrix.input[1], matrix.input[2], matrix.input[1], matrix.input[2]);
+    const __m256 fbSame = _mm256_setr_ps (matrix.feedback[0], matrix.feedback[3], matrix.feedback[0], matrix.feedback[3], matrix.feedback[0], matrix.feedback[3], matrix.feedback[0], matrix.feedback[3]);
+    const __m256 fbCross = _mm256_setr_ps (matrix.feedback[1], matrix.feedback[2], matrix.feedback[1], matrix.feedback[2], matrix.feedback[1], matrix.feedback[2], matrix.feedback[1], matrix.feedback[2]);
+    const __m256 wetSame = _mm256_set1_ps (matrix.wet[0]);
+    const __m256 wetCross = _mm256_set1_ps (matrix.wet[1]);
+    const __m256 fb = _mm256_set1_ps (feedback);
+    const __m256 wet = _mm256_set1_ps (mix);
+    const __m256 dry = _mm256_set1_ps (1.0f - mix);
+
+    int i = 0;
+    for (; i + 8 <= 2*numFrames; i += 8)
+    {
+        const __m256 read = _mm256_blend_ps (_mm256_loadu_ps (readLeft + i), _mm256_loadu_ps (readRight + i), 0xaa);
+        const __m256 readPrev = _mm256_blend_ps (_mm256_loadu_ps (readPrevLeft + i), _mm256_loadu_ps (readPrevRight + i), 0xaa);
+        const __m256 out = _mm256_add_ps (_mm256_mul_ps (frac, readPrev), _mm256_mul_ps (fracInv, read));
+        const __m256 outSwap = _mm256_permute_ps (out, _MM_SHUFFLE (2, 3, 0, 1));
+
+        const __m256 in = _mm256_loadu_ps (input + i);
+        const __m256 inSwap = _mm256_permute_ps (in, _MM_SHUFFLE (2, 3, 0, 1));
+
+        const __m256 inMix = _mm256_add_ps (_mm256_mul_ps (inSame, in), _mm256_mul_ps (inCross, inSwap));
+        const __m256 fbMix = _mm256_add_ps (_mm256_mul_ps (fbSame, out), _mm256_mul_ps (fbCross, outSwap));
+        _mm256_storeu_ps (write + i, _mm256_add_ps (inMix, _mm256_mul_ps (fb, fbMix)));
+
+        const __m256 wetMix = _mm256_add_ps (_mm256_mul_ps (wetSame, out), _mm256_mul_ps (wetCross, outSwap));
+        _mm256_storeu_ps (output + i, _mm256_add_ps (_mm256_mul_ps (wet, wetMix), _mm256_mul_ps (dry, in)));
+    }
+
+    processStereoRunScalar (input + i, output + i, write + i, readLeft + i, readPrevLeft + i, readRight + i, readPrevRight + i,
+                            numFrames - i/2, fractionLeft, fractionRight, feedback, mix, matrix);
+}
+
+/**
+ * Checks whether the CPU and OS support AVX2.
+ */
+static bool cpuHasAVX2()
+{
+   #if defined (_MSC_VER) && ! defined (__clang__)
+    int info[4];
+    __cpuid (info, 0);
+    if (info[0] < 7) { return false; }
+
+    // The OS must save the AVX registers on context switches.
+    __cpuid (info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (! osxsave || ! avx || (_xgetbv (0) & 0x6) != 0x6) { return false; }
+
+    __cpuidex (info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+   #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports ("avx2");
+   #endif
+}
+
+/**
+ * Checks whether the CPU and OS support F16C, which the half precision conversions use with
+ * 256-bit AVX registers. F16C is reported separately from AVX2 (CPUID.1:ECX bit 29), and some
+ * CPUs have it without AVX2.
+ */
+static bool cpuHasF16C()
+{
+   #if defined (_MSC_VER) && ! defined (__clang__)
+    int info[4];
+    __cpuid (info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    return osxsave && avx && f16c && (_xgetbv (0) & 0x6) == 0x6;
+   #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports ("avx") && __builtin_cpu_supports ("f16c");
+   #endif
+}
+
+/**
+ * Gets whether the half precision conversions can use F16C, checking the CPU only once.
+ */
+static bool hasF16C()
+{
+    static const bool has = cpuHasF16C();
+    return has;
+}
+
+#endif
+
+#if DELAYKERNELS_NEON
+
+static void processRunNeon (const float* input, float* output, float* write, const float* read, const float* readPrev,
+                            const int numSamples, const float fraction, const float feedback, const float mix)
+{
+    const float32x4_t frac = vdupq_n_f32 (fraction);
+    const float32x4_t fracInv = vdupq_n_f32 (1.0f - fraction);
+    const float32x4_t fb = vdupq_n_f32 (feedback);
+    const float32x4_t wet = vdupq_n_f32 (mix);
+    const float32x4_t dry = vdupq_n_f32 (1.0f - mix);
+
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        const float32x4_t in = vld1q_f32 (input + i);
+        const float32x4_t out = vaddq_f32 (vmulq_f32 (frac, vld1q_f32 (readPrev + i)), vmulq_f32 (fracInv, vld1q_f32 (read + i)));
+        vst1q_f32 (write + i, vaddq_f32 (in, vmulq_f32 (fb, out)));
+        vst1q_f32 (output + i, vaddq_f32 (vmulq_f32 (wet, out), vmulq_f32 (dry, in)));
+    }
+
+    processRunScalar (input + i, output + i, write + i, read + i, readPrev + i, numSamples - i, fraction, feedback, mix);
+}
+
+static void processStereoRunNeon (const float* input, float* output, float* write,
+                                  const float* readLeft, const float* readPrevLeft, const float* readRight, const float* readPrevRight,
+                                  const int numFrames, const float fractionLeft, const float fractionRight,
+                                  const float feedback, const float mix, const DelayKernels::StereoMatrix& matrix)
+{
+    // The lanes alternate between the left and right channels, two frames at a time.
+    const uint32_t leftMask[4] = { 0xffffffff, 0, 0xffffffff, 0 };
+    const uint32x4_t leftLanes = vld1q_u32 (leftMask);
+    const float fracs[4] = { fractionLeft, fractionRight, fractionLeft, fractionRight };
+    const float fracInvs[4] = { 1.0f - fractionLeft, 1.0f - fractionRight, 1.0f - fractionLeft, 1.0f - fractionRight };
+    const float inSames[4] = { matrix.input[0], matrix.input[3], matrix.input[0], matrix.input[3] };
+    const float inCrosses[4] = { matrix.input[1], matrix.input[2], matrix.input[1], matrix.input[2] };
+    const float fbSames[4] = { matrix.feedback[0], matrix.feedback[3], matrix.feedback[0], matrix.feedback[3] };
+    const float fbCrosses[4] = { matrix.feedback[1], matrix.feedback[2], matrix.feedback[1], matrix.feedback[2] };
+    const float32x4_t frac = vld1q_f32 (fracs);
+    const float32x4_t fracInv = vld1q_f32 (fracInvs);
+    const float32x4_t inSame = vld1q_f32 (inSames);
+    const float32x4_t inCross = vld1q_f32 (inCrosses);
+    const float32x4_t fbSame = vld1q_f32 (fbSames);
+    const float32x4_t fbCross = vld1q_f32 (fbCrosses);
+    const float32x4_t wetSame = vdupq_n_f32 (matrix.wet[0]);
+    const float32x4_t wetCross = vdupq_n_f32 (matrix.wet[1]);
+    const float32x4_t fb = vdupq_n_f32 (feedback);
+    const float32x4_t wet = vdupq_n_f32 (mix);
+    const float32x4_t dry = vdupq_n_f32 (1.0f - mix);
+
+    int i = 0;
+    for (; i + 4 <= 2*numFrames; i += 4)
+    {
+        const float32x4_t read = vbslq_f32 (leftLanes, vld1q_f32 (readLeft + i), vld1q_f32 (readRight + i));
+        const float32x4_t readPrev = vbslq_f32 (leftLanes, vld1q_f32 (readPrevLeft + i), vld1q_f32 (readPrevRight + i));
+        const float32x4_t out = vaddq_f32 (vmulq_f32 (frac, readPrev), vmulq_f32 (fracInv, read));
+        const float32x4_t outSwap = vrev64q_f32 (out);
+
+        const float32x4_t in = vld1q_f32 (input + i);
+        const float32x4_t inSwap = vrev64q_f32 (in);
+
+        const float32x4_t inMix = vaddq_f32 (vmulq_f32 (inSame, in), vmulq_f32 (inCross, inSwap));
+        const float32x4_t fbMix = vaddq_f32 (vmulq_f32 (fbSame, out), vmulq_f32 (fbCross, outSwap));
+        vst1q_f32 (write + i, vaddq_f32 (inMix, vmulq_f32 (fb, fbMix)));
+
+        const float32x4_t wetMix = vaddq_f32 (vmulq_f32 (wetSame, out), vmulq_f32 (wetCross, outSwap));
+        vst1q_f32 (output + i, vaddq_f32 (vmulq_f32 (wet, wetMix), vmulq_f32 (dry, in)));
+    }
+
+    processStereoRunScalar (input + i, output + i, write + i, readLeft + i, readPrevLeft + i, readRight + i, readPrevRight + i,
+                            numFrames - i/2, fractionLeft, fractionRight, feedback, mix, matrix);
+}
+
+#endif
+
+/**
+ * Converts a sample to half precision, rounding to the nearest value (ties to even) like F16C.
+ */
+static uint16_t floatToHalfScalar (const float value)
+{
+    uint32_t bits;
+    std::memcpy (&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t magnitude = bits & 0x7fffffff;
+
+    // Infinity and NaN keep their mantissa (quietened), and anything too big becomes infinity.
+    if (magnitude >= 0x7f800000) { return static_cast<uint16_t> (sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x200 | ((magnitude >> 13) & 0x3ff) : 0)); }
+    if (magnitude >= 0x47800000) { return static_cast<uint16_t> (sign | 0x7c00); }
+
+    // Below the smallest normal half, the result is a whole number of 2^-24 steps.
+    if (magnitude < 0x38800000)
+    {
+        float absolute;
+        std::memcpy (&absolute, &magnitude, sizeof(absolute));
+        return static_cast<uint16_t> (sign | static_cast<uint32_t> (std::nearbyint (absolute * 16777216.0f)));
+    }
+
+    // Round the mantissa to 10 bits and rebias the exponent. A carry rolls over into the exponent.
+    const uint32_t rounded = magnitude + 0xfff + ((magnitude >> 13) & 1);
+    return static_cast<uint16_t> (sign | ((rounded - 0x38000000) >> 13));
+}
+
+/**
+ * Converts a half precision sample to single precision.
+ */
+static float halfToFloatScalar (const uint16_t half)
+{
+    const uint32_t sign = static_cast<uint32_t> (half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        // Zero and subnormals are a whole number of 2^-24 steps.
+        const float magnitude = static_cast<float> (mantissa) * 5.9604644775390625e-8f;
+        std::memcpy (&bits, &magnitude, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    std::memcpy (&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * Scales a sample and rounds it to a 16-bit integer in the current rounding mode, like the vector conversions.
+ */
+static int16_t floatToInt16Scalar (const float value, const float scale)
+{
+    const float scaled = std::max (-32768.0f, std::min (value * scale, 32767.0f));
+    return static_cast<int16_t> (std::lrint (scaled));
+}
+
+#if DELAYKERNELS_X86
+
+DELAYKERNELS_TARGET ("avx,f16c")
+static void floatToHalfF16C (const float* input, uint16_t* output, const int numSamples)
+{
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        _mm_storeu_si128 (reinterpret_cast<__m128i*> (output + i), _mm256_cvtps_ph (_mm256_loadu_ps (input + i), _MM_FROUND_TO_NEAREST_INT));
+    }
+    for (; i < numSamples; ++i) { output[i] = floatToHalfScalar (input[i]); }
+}
+
+DELAYKERNELS_TARGET ("avx,f16c")
+static void halfToFloatF16C (const uint16_t* input, float* output, const int numSamples)
+{
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        _mm256_storeu_ps (output + i, _mm256_cvtph_ps (_mm_loadu_si128 (reinterpret_cast<const __m128i*> (input + i))));
+    }
+    for (; i < numSamples; ++i) { output[i] = halfToFloatScalar (input[i]); }
+}
+
+#endif
+
+DelayKernels::Type DelayKernels::getBestType()
+{
+    static const Type best = isSupported (AVX2) ? AVX2
+                           : isSupported (SSE2) ? SSE2
+                           : isSupported (NEON) ? NEON
+                           : SCALAR;
+    return best;
+}
+
+bool DelayKernels::isSupported (const Type type)
+{
+    switch (type)
+    {
+        case SCALAR:
+            return true;
+       #if DELAYKERNELS_X86
+        case SSE2:
+            return true;
+        case AVX2:
+        {
+            static const bool hasAVX2 = cpuHasAVX2();
+            return hasAVX2;
+        }
+       #endif
+       #if DELAYKERNELS_NEON
+        case NEON:
+            return true;
+       #endif
+        default:
+            return false;
+    }
+}
+
+DelayKernels::RunFunction DelayKernels::getRunFunction (const Type type)
+{
+    if (! isSupported (type)) { return processRunScalar; }
+
+    switch (type)
+    {
+       #if DELAYKERNELS_X86
+        case SSE2:
+            return processRunSSE2;
+        case AVX2:
+            return processRunAVX2;
+       #endif
+       #if DELAYKERNELS_NEON
+        case NEON:
+            return processRunNeon;
+       #endif
+        default:
+            return processRunScalar;
+    }
+}
+
+float DelayKernels::getPeak (const float* data, const int numSamples)
+{
+    float peak = 0;
+    int i = 0;
+
+   #if DELAYKERNELS_X86
+    const __m128 signMask = _mm_set1_ps (-0.0f);
+    __m128 peaks = _mm_setzero_ps();
+    for (; i + 4 <= numSamples; i += 4) { peaks = _mm_max_ps (peaks, _mm_andnot_ps (signMask, _mm_loadu_ps (data + i))); }
+    peaks = _mm_max_ps (peaks, _mm_movehl_ps (peaks, peaks));
+    peaks = _mm_max_ss (peaks, _mm_shuffle_ps (peaks, peaks, 1));
+    peak = _mm_cvtss_f32 (peaks);
+   #elif DELAYKERNELS_NEON
+    float32x4_t peaks = vdupq_n_f32 (0.0f);
+    for (; i + 4 <= numSamples; i += 4) { peaks = vmaxq_f32 (peaks, vabsq_f32 (vld1q_f32 (data + i))); }
+    float32x2_t pairs = vpmax_f32 (vget_low_f32 (peaks), vget_high_f32 (peaks));
+    pairs = vpmax_f32 (pairs, pairs);
+    peak = vget_lane_f32 (pairs, 0);
+   #endif
+
+    for (; i < numSamples; ++i) { peak = std::max (peak, std::abs (data[i])); }
+    return peak;
+}
+
+void DelayKernels::floatToHalf (const float* input, uint16_t* output, const int numSamples)
+{
+    int i = 0;
+
+   #if DELAYKERNELS_X86
+    if (hasF16C())
+    {
+        floatToHalfF16C (input, output, numSamples);
+        return;
+    }
+   #elif DELAYKERNELS_NEON && defined (__aarch64__)
+    for (; i + 4 <= numSamples; i += 4) { vst1_u16 (output + i, vreinterpret_u16_f16 (vcvt_f16_f32 (vld1q_f32 (input + i)))); }
+   #endif
+
+    for (; i < numSamples; ++i) { output[i] = floatToHalfScalar (input[i]); }
+}
+
+void DelayKernels::halfToFloat (const uint16_t* input, float* output, const int numSamples)
+{
+    int i = 0;
+
+   #if DELAYKERNELS_X86
+    if (hasF16C())
+    {
+        halfToFloatF16C (input, output, numSamples);
+        return;
+    }
+   #elif DELAYKERNELS_NEON && defined (__aarch64__)
+    for (; i + 4 <= numSamples; i += 4) { vst1q_f32 (output + i, vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (input + i)))); }
+   #endif
+
+    for (; i < numSamples; ++i) { output[i] = halfToFloatScalar (input[i]); }
+}
+
+void DelayKernels::floatToInt16 (const float* input, int16_t* output, const int numSamples, const float scale)
+{
+    int i = 0;
+
+   #if DELAYKERNELS_X86
+    const __m128 gain = _mm_set1_ps (scale);
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m128i low = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (input + i), gain));
+        const __m128i high = _mm_cvtps_epi32 (_mm_mul_ps (_mm_loadu_ps (input + i + 4), gain));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*> (output + i), _mm_packs_epi32 (low, high));
+    }
+   #elif DELAYKERNELS_NEON && defined (__aarch64__)
+    const float32x4_t gain = vdupq_n_f32 (scale);
+    for (; i + 4 <= numSamples; i += 4) { vst1_s16 (output + i, vqmovn_s32 (vcvtnq_s32_f32 (vmulq_f32 (vld1q_f32 (input + i), gain)))); }
+   #endif
+
+    for (; i < numSamples; ++i) { output[i] = floatToInt16Scalar (input[i], scale); }
+}
+
+void DelayKernels::int16ToFloat (const int16_t* input, float* output, const int numSamples, const float scale)
+{
+    int i = 0;
+
+   #if DELAYKERNELS_X86
+    const __m128 gain = _mm_set1_ps (scale);
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        // Sign extend by unpacking each sample into the top half of a 32-bit lane and shifting it down.
+        const __m128i samples = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (input + i));
+        const __m128i low = _mm_srai_epi32 (_mm_unpacklo_epi16 (samples, samples), 16);
+        const __m128i high = _mm_srai_epi32 (_mm_unpackhi_epi16 (samples, samples), 16);
+        _mm_storeu_ps (output + i, _mm_mul_ps (_mm_cvtepi32_ps (low), gain));
+        _mm_storeu_ps (output + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (high), gain));
+    }
+   #elif DELAYKERNELS_NEON
+    const float32x4_t gain = vdupq_n_f32 (scale);
+    for (; i + 4 <= numSamples; i += 4) { vst1q_f32 (output + i, vmulq_f32 (vcvtq_f32_s32 (vmovl_s16 (vld1_s16 (input + i))), gain)); }
+   #endif
+
+    for (; i < numSamples; ++i) { output[i] = static_cast<float> (input[i]) * scale; }
+}
+
+DelayKernels::ScopedNoDenormals::ScopedNoDenormals()
+    : m_mode()
+{
+   #if DELAYKERNELS_X86
+    m_mode = _mm_getcsr();
+    _mm_setcsr (static_cast<unsigned int> (m_mode) | 0x8040); // Flush to zero and denormals are zero.
+   #elif DELAYKERNELS_NEON && defined (__aarch64__)
+    asm volatile ("mrs %0, fpcr" : "=r" (m_mode));
+    asm volatile ("msr fpcr, %0" : : "r" (m_mode | (1ull << 24))); // Flush to zero.
+   #elif DELAYKERNELS_NEON
+    unsigned int mode;
+    asm volatile ("vmrs %0, fpscr" : "=r" (mode));
+    asm volatile ("vmsr fpscr, %0" : : "r" (mode | (1u << 24))); // Flush to zero.
+    m_mode = mode;
+   #endif
+}
+
+DelayKernels::ScopedNoDenormals::~ScopedNoDenormals()
+{
+   #if DELAYKERNELS_X86
+    _mm_setcsr (static_cast<unsigned int> (m_mode));
+   #elif DELAYKERNELS_NEON && defined (__aarch64__)
+    asm volatile ("msr fpcr, %0" : : "r" (m_mode));
+   #elif DELAYKERNELS_NEON
+    asm volatile ("vmsr fpscr, %0" : : "r" (static_cast<unsigned int> (m_mode)));
+   #endif
+}
+
+DelayKernels::StereoRunFunction DelayKernels::getStereoRunFunction (const Type type)
+{
+    if (! isSupported (type)) { return processStereoRunScalar; }
+
+    switch (type)
+    {
+       #if DELAYKERNELS_X86
+        case SSE2:
+            return processStereoRunSSE2;
+        case AVX2:
+            return processStereoRunAVX2;
+       #endif
+       #if DELAYKERNELS_NEON
+        case NEON:
+            return processStereoRunNeon;
+       #endif
+        default:
+            return processStereoRunScalar;
+    }
+}
+
+const char* DelayKernels::getName (const Type type)
+{
+    switch (type)
+    {
+        case SSE2:
+            return "SSE2";
+        case AVX2:
+            return "AVX2";
+        case NEON:
+            return "NEON";
+        default:
+            return "Scalar";
+    }
+}
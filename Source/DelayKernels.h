@@ -0,0 +1,182 @@
+/**
+ * DelayKernels.h
+ * \brief Vectorized processing kernels for the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * \brief Vectorized processing kernels for the delay line.
+ *
+ * Each kernel processes a run of samples for which none of the delay buffer positions wrap around.
+ * It interpolates the delayed signal, writes the input plus feedback back into the buffer and blends
+ * the delayed signal with the input. The kernel is picked at runtime from the features of the CPU, so
+ * the plugin doesn't depend on the instruction set of the build machine. All kernels give bit-exact
+ * results compared to the scalar kernel.
+ */
+class DelayKernels
+{
+public:
+
+    /**
+     * Enum for the available kernel types.
+     */
+    enum Type { SCALAR, SSE2, AVX2, NEON };
+
+    /**
+     * Pointer to a kernel function.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples (may be the same as the input)
+     * \param[out]  float*  Buffer write position
+     * \param[in]  float*  Buffer read position
+     * \param[in]  float*  Buffer position of the previous delayed sample
+     * \param[in]  int  Number of samples
+     * \param[in]  float  Fractional delay (0-1)
+     * \param[in]  float  Feedback (0-1)
+     * \param[in]  float  Mix (0-1)
+     */
+    typedef void (*RunFunction) (const float* input, float* output, float* write, const float* read, const float* readPrev,
+                                 const int numSamples, const float fraction, const float feedback, const float mix);
+
+    /**
+     * Stereo routing gains. Each pair is the gain from the same channel followed by the gain from
+     * the opposite channel, first for the left output and then for the right output.
+     */
+    struct StereoMatrix
+    {
+        float input[4]; ///< Input gains into the buffer (L<-L, L<-R, R<-L, R<-R).
+        float feedback[4]; ///< Feedback gains from the delayed signal into the buffer (L<-L, L<-R, R<-L, R<-R).
+        float wet[2]; ///< Gains of the delayed signal in the output (same channel, opposite channel).
+    };
+
+    /**
+     * Pointer to a stereo kernel function, which processes a run of interleaved stereo frames with
+     * a separate delay for each channel. The delayed signals of both channels are mixed through a
+     * StereoMatrix into the buffer and the output, so the cross-coupling stays in the vectorized loop.
+     *
+     * \param[in]  float*  Input data frames
+     * \param[out]  float*  Output data frames (may be the same as the input)
+     * \param[out]  float*  Buffer write position
+     * \param[in]  float*  Buffer read position of the left channel
+     * \param[in]  float*  Buffer position of the previous delayed sample of the left channel
+     * \param[in]  float*  Buffer read position of the right channel
+     * \param[in]  float*  Buffer position of the previous delayed sample of the right channel
+     * \param[in]  int  Number of frames
+     * \param[in]  float  Fractional delay of the left channel (0-1)
+     * \param[in]  float  Fractional delay of the right channel (0-1)
+     * \param[in]  float  Feedback (0-1)
+     * \param[in]  float  Mix (0-1)
+     * \param[in]  StereoMatrix&  Routing gains
+     */
+    typedef void (*StereoRunFunction) (const float* input, float* output, float* write,
+                                       const float* readLeft, const float* readPrevLeft, const float* readRight, const float* readPrevRight,
+                                       const int numFrames, const float fractionLeft, const float fractionRight,
+                                       const float feedback, const float mix, const StereoMatrix& matrix);
+
+    /**
+     * Gets the fastest kernel type supported by this CPU. The CPU is only checked on the first call.
+     *
+     * \return  Type  Kernel type
+     */
+    static Type getBestType();
+
+    /**
+     * Checks whether a kernel type is supported by this build and CPU.
+     *
+     * \param[in]  Type  Kernel type
+     *
+     * \return  bool  True if the kernel can be used
+     */
+    static bool isSupported (const Type type);
+
+    /**
+     * Gets the kernel function for a kernel type. Unsupported types fall back to the scalar kernel.
+     *
+     * \param[in]  Type  Kernel type
+     *
+     * \return  RunFunction  Kernel function
+     */
+    static RunFunction getRunFunction (const Type type = getBestType());
+
+    /**
+     * Gets the stereo kernel function for a kernel type. Unsupported types fall back to the scalar kernel.
+     *
+     * \param[in]  Type  Kernel type
+     *
+     * \return  StereoRunFunction  Stereo kernel function
+     */
+    static StereoRunFunction getStereoRunFunction (const Type type = getBestType());
+
+    static const char* getName (const Type type); ///< Gets the name of a kernel type.
+
+    /**
+     * Gets the peak absolute value of a block of samples, using the vector instructions of the CPU.
+     *
+     * \param[in]  float*  Data samples
+     * \param[in]  int  Number of samples
+     *
+     * \return  float  Peak absolute value
+     */
+    static float getPeak (const float* data, const int numSamples);
+
+    /**
+     * Converts samples to half precision (IEEE 754 binary16), rounding to the nearest value. This
+     * uses F16C on x86 CPUs that have it, whatever kernel type is in use, and NEON on 64-bit ARM,
+     * and gives bit-exact results on every CPU.
+     *
+     * \param[in]  float*  Data samples
+     * \param[out]  uint16_t*  Half precision samples
+     * \param[in]  int  Number of samples
+     */
+    static void floatToHalf (const float* input, uint16_t* output, const int numSamples);
+
+    /**
+     * Converts half precision samples back to single precision, which is exact.
+     *
+     * \param[in]  uint16_t*  Half precision samples
+     * \param[out]  float*  Data samples
+     * \param[in]  int  Number of samples
+     */
+    static void halfToFloat (const uint16_t* input, float* output, const int numSamples);
+
+    /**
+     * Scales samples and rounds them to 16-bit integers, saturating at the limits.
+     *
+     * \param[in]  float*  Data samples
+     * \param[out]  int16_t*  Integer samples
+     * \param[in]  int  Number of samples
+     * \param[in]  float  Scale
+     */
+    static void floatToInt16 (const float* input, int16_t* output, const int numSamples, const float scale);
+
+    /**
+     * Converts 16-bit integer samples back to floating point and scales them.
+     *
+     * \param[in]  int16_t*  Integer samples
+     * \param[out]  float*  Data samples
+     * \param[in]  int  Number of samples
+     * \param[in]  float  Scale
+     */
+    static void int16ToFloat (const int16_t* input, float* output, const int numSamples, const float scale);
+
+    /**
+     * \brief Flushes denormal numbers to zero while it's in scope.
+     *
+     * Sets the flush-to-zero (and on x86, denormals-are-zero) mode of the floating point unit on
+     * construction and restores the previous mode on destruction. Feedback that decays towards
+     * silence otherwise ends up as denormal numbers, which are many times slower to process.
+     */
+    class ScopedNoDenormals
+    {
+    public:
+        ScopedNoDenormals();
+        ~ScopedNoDenormals();
+
+    private:
+        unsigned long long m_mode; ///< Floating point control register value to restore.
+    };
+};
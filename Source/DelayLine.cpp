@@ -5,41 +5,363 @@
  */
 
 #include <cstring>
+#include <limits>
 
 #include "DelayLine.h"
 
-DelayLine::DelayLine(const int fs, const float delay, const float feedback, const float mix)
-    : m_sampleFreq (fs),
-      m_delay (delay), m_feedback (feedback), m_mix (mix), m_bypass(),
-      m_readPos(), m_writePos(),
+DelayLine::DelayLine(const int fs, const float delay, const float feedback, const float mix, const int numChannels)
+    : m_numChannels (numChannels),
+      m_sampleFreq (fs),
+      m_delay (delay), m_feedback (feedback), m_mix (mix), m_bypass(), m_freeze(),
+      m_readPos(), m_writePos(), m_quietFrames(),
       m_delaySamples (floor(fs*1e-3*delay)),
-      m_maxDelaySamples (ceil(fs*1e-3*2000)),
-      m_maxDelay ((m_maxDelaySamples * 1000.0f) / fs),
+      m_maxDelaySamples(),
+      m_maxDelay(),
       m_delayFraction ((fs*1e-3*delay) - m_delaySamples),
-      m_buffer(nullptr)
+      m_powerOfTwo(), m_mask(),
+      m_buffer(nullptr),
+      m_bufferSize(),
+      m_format (TieredDelayBuffer::FLOAT32),
+      m_compact(), m_scales(), m_head(), m_scratch(),
+      m_processRun (DelayKernels::getRunFunction()),
+      m_processStereoRun (DelayKernels::getStereoRunFunction()),
+      m_delaySmoother (static_cast<float> (fs*1e-3*delay)),
+      m_feedbackSmoother (feedback),
+      m_mixSmoother (mix),
+      m_modRate(), m_modDepth(), m_lfoPhase(),
+      m_modDepthSmoother(),
+      m_interpolation (Interpolators::LINEAR),
+      m_allpassState (new float [numChannels]),
+      m_feedbackFilter (numChannels),
+      m_saturator (numChannels),
+      m_delayRight (-1),
+      m_rightDelaySmoother (static_cast<float> (fs*1e-3*delay)),
+      m_stereoMatrix(),
+      m_routed(),
+      m_longBuffer(),
+      m_longDelay(), m_longDelaySamples(), m_long(),
+      m_numTaps(),
+      m_tapGains (new float [s_maxTaps*s_tapFrames*numChannels]()),
+      m_tapSums (new float [2*s_tapFrames*numChannels])
 {
-    reset();
+    Interpolators::initialise();
+    setStereoRouting (false, 0, 1);
+    prepare (fs);
 }
 
 DelayLine::~DelayLine()
 {
     delete [] m_buffer;
+    delete [] m_allpassState;
+    delete [] m_tapGains;
+    delete [] m_tapSums;
 }
 
-void DelayLine::reset()
+void DelayLine::prepare (const double fs, const float maxDelay, const bool powerOfTwo, const TieredDelayBuffer::Format format)
+{
+    m_sampleFreq = fs;
+    m_maxDelaySamples = std::max (static_cast<int> (ceil (fs*1e-3*maxDelay)), 1);
+
+    // The compact formats are converted in whole blocks.
+    if (format != TieredDelayBuffer::FLOAT32) { m_maxDelaySamples = ((m_maxDelaySamples + s_storageBlock - 1) / s_storageBlock) * s_storageBlock; }
+
+    // Round the buffer length up to a power of two so positions can wrap with a bit mask.
+    m_powerOfTwo = powerOfTwo;
+    if (m_powerOfTwo)
+    {
+        int length = 1;
+        while (length < m_maxDelaySamples) { length <<= 1; }
+        m_maxDelaySamples = length;
+    }
+    m_mask = m_maxDelaySamples - 1;
+
+    m_delaySmoother.prepare (fs);
+    m_feedbackSmoother.prepare (fs);
+    m_mixSmoother.prepare (fs);
+    m_modDepthSmoother.prepare (fs);
+    for (auto& tap : m_taps) { tap.delaySmoother.prepare (fs); tap.feedbackSmoother.prepare (fs); }
+    m_rightDelaySmoother.prepare (fs);
+    m_feedbackFilter.prepare (fs);
+    m_maxDelay = static_cast<float> ((m_maxDelaySamples * 1000.0) / fs);
+
+    // Only reallocate the buffer if it's too small for the new sample rate or is in another format.
+    // The buffer in the other format is freed, since saving memory is the point of the compact ones.
+    const int size = m_maxDelaySamples*m_numChannels;
+    if (size > m_bufferSize || format != m_format)
+    {
+        delete [] m_buffer;
+        m_buffer = nullptr;
+        std::vector<uint16_t>().swap (m_compact);
+        std::vector<float>().swap (m_scales);
+        std::vector<float>().swap (m_head);
+        std::vector<float>().swap (m_scratch);
+
+        if (format == TieredDelayBuffer::FLOAT32)
+        {
+            m_buffer = new float [size];
+        }
+        else
+        {
+            m_compact.resize (size);
+            m_scales.resize (size / (s_storageBlock*m_numChannels));
+            m_head.resize (s_storageBlock*m_numChannels);
+            m_scratch.resize (s_maxTaps*s_scratchFrames*m_numChannels);
+        }
+        m_bufferSize = size;
+        m_format = format;
+    }
+
+    // Keep the long delay at the same time for the new sample rate.
+    if (m_long) { setLongDelay (m_longDelay); }
+
+    reset();
+}
+
+bool DelayLine::prepareLongDelay (const float maxDelay, const std::string& spillDirectory, const TieredDelayBuffer::Format format)
+{
+    const int64_t maxDelayFrames = static_cast<int64_t> (std::ceil (m_sampleFreq*1e-3*maxDelay));
+    const bool ready = m_longBuffer.prepare (m_numChannels, std::max<int64_t> (maxDelayFrames, 1), spillDirectory, format);
+    setLongDelay (m_longDelay);
+    return ready;
+}
+
+void DelayLine::releaseLongDelay()
+{
+    m_long = false;
+    m_longBuffer.release();
+}
+
+void DelayLine::setLongDelay (const float delay)
 {
-    if (m_buffer != nullptr) { delete [] m_buffer; }
+    const bool wasLong = m_long;
+    m_long = delay > 0 && m_longBuffer.isReady();
+    m_longDelay = delay;
+    if (! m_long) { return; }
+
+    const int64_t samples = static_cast<int64_t> (std::round (m_sampleFreq*1e-3*delay));
+    m_longDelaySamples = static_cast<int> (std::max<int64_t> (1, std::min (samples, m_longBuffer.getMaxDelayFrames())));
 
-    m_buffer = new float [m_maxDelaySamples];
-    memset (m_buffer, 0, m_maxDelaySamples*sizeof(float));
+    // Start recording from now, so nothing is left over from the last time the mode was on.
+    if (! wasLong) { m_longBuffer.startRecording(); }
+}
+
+void DelayLine::reset()
+{
+    if (isCompact())
+    {
+        // Zero is zero in both compact formats.
+        std::fill (m_compact.begin(), m_compact.end(), 0);
+        std::fill (m_scales.begin(), m_scales.end(), 0.0f);
+        std::fill (m_head.begin(), m_head.end(), 0.0f);
+    }
+    else
+    {
+        memset (m_buffer, 0, m_maxDelaySamples*m_numChannels*sizeof(float));
+    }
     m_readPos = m_writePos = 0;
+    m_quietFrames = getSilentLength();
+    setReadPos();
+
+    jumpToTargets();
+    m_lfoPhase = 0;
+    std::fill (m_allpassState, m_allpassState + m_numChannels, 0.0f);
+    m_feedbackFilter.reset();
+    m_saturator.reset();
+    if (m_longBuffer.isReady()) { m_longBuffer.startRecording(); }
+}
+
+void DelayLine::jumpToTargets()
+{
+    m_delaySmoother.setValue (getDelaySamples());
+    m_feedbackSmoother.setValue (m_feedback);
+    m_mixSmoother.setValue (m_mix);
+    m_modDepthSmoother.setValue (static_cast<float> (m_sampleFreq*1e-3*m_modDepth));
+    for (auto& tap : m_taps)
+    {
+        tap.delaySmoother.setValue (getTapDelaySamples (tap.delay));
+        tap.feedbackSmoother.setValue (tap.feedbackSmoother.getTarget());
+    }
+    m_rightDelaySmoother.setValue (getRightDelaySamples());
+}
+
+double DelayLine::getTailTime (const float delay, const float feedback)
+{
+    if (feedback >= 1) { return std::numeric_limits<double>::infinity(); }
+    if (feedback <= 0) { return delay; }
+
+    // Each trip around the feedback loop scales the signal by the feedback.
+    const double repeats = std::ceil (std::log (s_silenceLevel) / std::log (feedback));
+    return delay * (1 + repeats);
+}
+
+void DelayLine::setInterpolation (const Interpolators::Type type)
+{
+    if (type == m_interpolation) { return; }
+
+    m_interpolation = type;
+    std::fill (m_allpassState, m_allpassState + m_numChannels, 0.0f);
+
+    // Only the linear kernels use the read position, so bring it up to date for them.
+    setReadPos();
+}
+
+void DelayLine::setSmoothing (const ParameterSmoother::Type delayType, const float delayTime,
+                              const ParameterSmoother::Type levelType, const float levelTime)
+{
+    m_delaySmoother.setRamp (delayType, delayTime);
+    m_feedbackSmoother.setRamp (levelType, levelTime);
+    m_mixSmoother.setRamp (levelType, levelTime);
+    m_modDepthSmoother.setRamp (levelType, levelTime);
+    for (auto& tap : m_taps) { tap.delaySmoother.setRamp (delayType, delayTime); tap.feedbackSmoother.setRamp (levelType, levelTime); }
+    m_rightDelaySmoother.setRamp (delayType, delayTime);
+
+    m_delaySmoother.prepare (m_sampleFreq);
+    m_feedbackSmoother.prepare (m_sampleFreq);
+    m_mixSmoother.prepare (m_sampleFreq);
+    m_modDepthSmoother.prepare (m_sampleFreq);
+    for (auto& tap : m_taps) { tap.delaySmoother.prepare (m_sampleFreq); tap.feedbackSmoother.prepare (m_sampleFreq); }
+    m_rightDelaySmoother.prepare (m_sampleFreq);
+    setReadPos();
+}
+
+void DelayLine::setKernelType (DelayKernels::Type type)
+{
+    m_processRun = DelayKernels::getRunFunction (type);
+    m_processStereoRun = DelayKernels::getStereoRunFunction (type);
+}
+
+void DelayLine::setDelayRight (const float delay)
+{
+    m_delayRight = delay;
+    m_rightDelaySmoother.setTarget (getRightDelaySamples());
+    updateRouting();
+}
+
+void DelayLine::setStereoRouting (const bool pingPong, const float crossfeed, const float width)
+{
+    DelayKernels::StereoMatrix& matrix = m_stereoMatrix;
+
+    if (pingPong)
+    {
+        // Feed both inputs into the left channel and swap the channels on every repeat.
+        const float input[4] = { 0.5f, 0.5f, 0.0f, 0.0f };
+        const float feedback[4] = { 0.0f, 1.0f, 1.0f, 0.0f };
+        std::copy (input, input + 4, matrix.input);
+        std::copy (feedback, feedback + 4, matrix.feedback);
+    }
+    else
+    {
+        const float cross = std::max (0.0f, std::min (crossfeed, 1.0f));
+        const float input[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+        const float feedback[4] = { 1.0f - cross, cross, cross, 1.0f - cross };
+        std::copy (input, input + 4, matrix.input);
+        std::copy (feedback, feedback + 4, matrix.feedback);
+    }
+
+    // Scale the side signal (L - R) by the width and leave the mid signal (L + R) alone.
+    const float w = std::max (0.0f, std::min (width, 2.0f));
+    matrix.wet[0] = 0.5f * (1.0f + w);
+    matrix.wet[1] = 0.5f * (1.0f - w);
+
+    updateRouting();
+}
+
+void DelayLine::updateRouting()
+{
+    const DelayKernels::StereoMatrix& matrix = m_stereoMatrix;
+    const bool routed = m_numChannels == 2
+                     && (m_delayRight >= 0 || matrix.input[0] != 1.0f || matrix.feedback[0] != 1.0f || matrix.wet[0] != 1.0f);
+
+    if (routed == m_routed) { return; }
+
+    // The right channel delay is frozen outside of the stereo routing, so pick up from its target.
+    m_rightDelaySmoother.setValue (getRightDelaySamples());
+    std::fill (m_allpassState, m_allpassState + m_numChannels, 0.0f);
     setReadPos();
+    m_routed = routed;
+}
+
+float DelayLine::getRightDelaySamples() const
+{
+    if (m_delayRight < 0) { return getDelaySamples(); }
+    return std::max (0.0f, std::min (static_cast<float> (m_sampleFreq*1e-3*m_delayRight), m_maxDelaySamples - 1.0f));
+}
+
+void DelayLine::setNumTaps (const int numTaps)
+{
+    const int num = std::max (0, std::min (numTaps, s_maxTaps));
+
+    // Taps that are switched on jump straight to their delay and feedback instead of gliding from old ones.
+    for (int k = m_numTaps; k < num; ++k)
+    {
+        m_taps[k].delaySmoother.setValue (m_taps[k].delaySmoother.getTarget());
+        m_taps[k].feedbackSmoother.setValue (m_taps[k].feedbackSmoother.getTarget());
+    }
+
+    if (num == 0 && m_numTaps > 0)
+    {
+        // The single delay ramps are frozen in multi-tap mode, so pick up from their targets.
+        m_delaySmoother.setValue (getDelaySamples());
+        m_feedbackSmoother.setValue (m_feedback);
+        m_modDepthSmoother.setValue (m_modDepthSmoother.getTarget());
+        setReadPos();
+    }
+
+    m_numTaps = num;
+}
+
+void DelayLine::setTap (const int index, const float delay, const float gain, const float pan, const float feedback)
+{
+    if (index < 0 || index >= s_maxTaps) { return; }
+
+    Tap& tap = m_taps[index];
+    tap.delay = delay;
+    tap.delaySmoother.setTarget (getTapDelaySamples (delay));
+    tap.feedbackSmoother.setTarget (feedback);
+
+    // Spread the gain over a tile of interleaved samples, panned with a balance law for stereo.
+    const int tile = s_tapFrames*m_numChannels;
+    float* gains = m_tapGains + index*tile;
+    for (int j = 0; j < tile; ++j)
+    {
+        const int channel = j % m_numChannels;
+        float balance = 1.0f;
+        if (m_numChannels == 2) { balance = channel == 0 ? std::min (1.0f, 1.0f - pan) : std::min (1.0f, 1.0f + pan); }
+        gains[j] = gain * balance;
+    }
 }
 
 float DelayLine::processSample (const float input)
 {
+    assert (m_numChannels == 1);
+
     if (m_bypass) { return input; }
 
+    if (std::abs (input) >= s_silenceLevel) { m_quietFrames = 0; }
+
+    if (m_long || m_freeze)
+    {
+        float output = 0;
+        if (m_long) { processLong (&input, &output, 1); }
+        else { processFrozen (&input, &output, 1); }
+        return output;
+    }
+
+    if (m_numTaps > 0)
+    {
+        float output = 0;
+        processTaps (&input, &output, 1);
+        return output;
+    }
+
+    if (isVarying() || m_interpolation != Interpolators::LINEAR)
+    {
+        float output = 0;
+        processVarying (&input, &output, 1);
+        if (! isVarying()) { setReadPos(); }
+        return output;
+    }
+
     float out = 0;
     if (m_delaySamples == 0)
     {
@@ -47,37 +369,861 @@ float DelayLine::processSample (const float input)
     }
     else
     {
+        const float* read = nullptr;
+        const float* readPrev = nullptr;
+        getReadPointers (m_readPos, 1, 0, read, readPrev);
+
         // Get the delayed sample value.
-        out = m_buffer[m_readPos];
+        out = read[0];
         if (m_readPos == m_writePos && m_delaySamples < 1) { out = input; } // Fractional delay case.
         
         // Get the previous delayed sample value.
-        float outPrev = 0;
-        if (m_readPos-1 > 0) { outPrev = m_buffer[m_readPos-1]; }
-        else { outPrev = m_buffer[m_maxDelaySamples-1]; }
+        float outPrev = readPrev[0];
         
         // Calculate the fractional delay value.
         out = (m_delayFraction * outPrev) + ((1 - m_delayFraction) * out);
     }
 
     // Write the input to the delay buffer.
-    m_buffer[m_writePos] = input + (m_feedback * out);
+    float* write = getWritePointer();
+    write[0] = input + (m_feedback * out);
+    processFeedback (write, 1);
     
     // Set the new read/write positions.
-    if (++m_writePos >= m_maxDelaySamples) { m_writePos = 0; }
-    if (++m_readPos >= m_maxDelaySamples) { m_readPos = 0; }
+    advanceWritePos (1);
+    m_readPos = wrapPos (m_readPos + 1);
 
     return (m_mix * out) + ((1.0 - m_mix) * input); 
 }
 
+void DelayLine::processBlock (const float* input, float* output, const int numFrames)
+{
+    const float inputPeak = DelayKernels::getPeak (input, numFrames*m_numChannels);
+
+    if (trySleep (inputPeak))
+    {
+        if (output != input) { std::copy (input, input + numFrames*m_numChannels, output); }
+        return;
+    }
+
+    processActive (input, output, numFrames, inputPeak);
+}
+
+bool DelayLine::trySleep (const float inputPeak)
+{
+    if (inputPeak >= s_silenceLevel || ! isSilent()) { return false; }
+
+    // Nothing can come out of the buffer, so skip to the end of any ramps and leave it alone.
+    jumpToTargets();
+    setReadPos();
+    return true;
+}
+
+void DelayLine::processActive (const float* input, float* output, const int numFrames, const float inputPeak)
+{
+    const int channels = m_numChannels;
+    const int writePos = m_writePos;
+
+    if (m_bypass)
+    {
+        if (output != input) { std::copy (input, input + numFrames*channels, output); }
+        return;
+    }
+
+    if (m_long)
+    {
+        processLong (input, output, numFrames);
+    }
+    else if (m_freeze)
+    {
+        processFrozen (input, output, numFrames);
+    }
+    else if (m_numTaps > 0)
+    {
+        processTaps (input, output, numFrames);
+    }
+    else if (m_routed)
+    {
+        processRouted (input, output, numFrames);
+    }
+    else
+    {
+        // Process any parameter ramps in short steps, then the rest of the block with static values.
+        int done = 0;
+        while (done < numFrames && isVarying())
+        {
+            const int num = std::min (numFrames - done, s_rampFrames);
+            processVarying (input + done*channels, output + done*channels, num);
+            done += num;
+
+            if (! isVarying()) { setReadPos(); }
+        }
+
+        processStatic (input + done*channels, output + done*channels, numFrames - done);
+    }
+
+    updateSilence (inputPeak, writePos, numFrames);
+}
+
+void DelayLine::write (const float* input, const int numFrames, const float inputPeak)
+{
+    const int channels = m_numChannels;
+    const int writePos = m_writePos;
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        const int run = std::min (numFrames - done, getWriteSpace());
+        std::copy (input + done*channels, input + (done + run)*channels, getWritePointer());
+        advanceWritePos (run);
+        m_readPos = wrapPos (m_readPos + run);
+        done += run;
+    }
+
+    updateSilence (inputPeak, writePos, numFrames);
+}
+
+void DelayLine::getMixRamp (float* mix, const int numFrames)
+{
+    if (m_mixSmoother.isSmoothing()) { m_mixSmoother.process (mix, numFrames); }
+    else { std::fill (mix, mix + numFrames, m_mix); }
+}
+
+void DelayLine::updateSilence (const float inputPeak, const int writePos, const int numFrames)
+{
+    if (inputPeak >= s_silenceLevel)
+    {
+        m_quietFrames = 0;
+        return;
+    }
+
+    // With a silent input, only the feedback was written, so check whether it has decayed.
+    const int channels = m_numChannels;
+    float peak = 0;
+    int pos = writePos;
+    for (int remaining = std::min (numFrames, m_maxDelaySamples); remaining > 0 && peak < s_silenceLevel;)
+    {
+        const int run = std::min (std::min (remaining, m_maxDelaySamples - pos), isCompact() ? s_scratchFrames : remaining);
+        peak = std::max (peak, DelayKernels::getPeak (getReadPointer (pos, run, 0), run*channels));
+        pos = wrapPos (pos + run);
+        remaining -= run;
+    }
+
+    m_quietFrames = peak < s_silenceLevel ? std::min (m_quietFrames + numFrames, getSilentLength()) : 0;
+}
+
+void DelayLine::decodeFrames (int pos, int numFrames, float* output) const
+{
+    const int channels = m_numChannels;
+    const int headBlock = m_writePos / s_storageBlock;
+    const int headFrames = m_writePos & (s_storageBlock - 1);
+
+    while (numFrames > 0)
+    {
+        // Blocks never straddle the end of the buffer, so each run stays inside one block.
+        const int block = pos / s_storageBlock;
+        const int offset = pos & (s_storageBlock - 1);
+        int run = std::min (numFrames, s_storageBlock - offset);
+
+        if (block == headBlock && offset < headFrames)
+        {
+            // The newest frames haven't been converted yet. The rest of this block is still the
+            // oldest audio in the buffer, converted the last time round.
+            run = std::min (run, headFrames - offset);
+            std::copy (m_head.data() + offset*channels, m_head.data() + (offset + run)*channels, output);
+        }
+        else if (m_format == TieredDelayBuffer::INT16)
+        {
+            DelayKernels::int16ToFloat (reinterpret_cast<const int16_t*> (m_compact.data()) + pos*channels, output, run*channels, m_scales[block]);
+        }
+        else
+        {
+            DelayKernels::halfToFloat (m_compact.data() + pos*channels, output, run*channels);
+        }
+
+        output += run*channels;
+        pos = wrapPos (pos + run);
+        numFrames -= run;
+    }
+}
+
+void DelayLine::encodeBlock (const int block)
+{
+    const int size = s_storageBlock*m_numChannels;
+    if (m_format == TieredDelayBuffer::INT16)
+    {
+        // Like the spill store, each block is scaled so that its peak uses the full range.
+        const float peak = DelayKernels::getPeak (m_head.data(), size);
+        DelayKernels::floatToInt16 (m_head.data(), reinterpret_cast<int16_t*> (m_compact.data()) + block*size, size, (peak > 0.0f) ? 32767.0f/peak : 0.0f);
+        m_scales[block] = (peak > 0.0f) ? peak/32767.0f : 0.0f;
+    }
+    else
+    {
+        DelayKernels::floatToHalf (m_head.data(), m_compact.data() + block*size, size);
+    }
+}
+
+void DelayLine::processStatic (const float* input, float* output, const int numFrames)
+{
+    switch (m_interpolation)
+    {
+        case Interpolators::CUBIC:
+            processStaticTaps<CubicInterpolator> (input, output, numFrames);
+            return;
+        case Interpolators::LAGRANGE:
+            processStaticTaps<LagrangeInterpolator> (input, output, numFrames);
+            return;
+        case Interpolators::SINC:
+            processStaticTaps<SincInterpolator> (input, output, numFrames);
+            return;
+        default:
+            break;
+    }
+
+    const int channels = m_numChannels;
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the next wrap point of the write position.
+        int run = std::min (numFrames - done, getWriteSpace());
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        float* write = getWritePointer();
+
+        if (m_delaySamples == 0)
+        {
+            // No delay, so the output is just the input.
+            for (int i = 0; i < run*channels; ++i)
+            {
+                write[i] = in[i] + (m_feedback * in[i]);
+                out[i] = in[i];
+            }
+        }
+        else
+        {
+            // Limit the run to the next wrap points of the read positions. The run must also be no longer
+            // than the delay so that it never reads a sample that it has written itself.
+            const int readPrevPos = wrapPos (m_readPos - 1);
+            run = std::min (run, m_maxDelaySamples - m_readPos);
+            run = std::min (run, m_maxDelaySamples - readPrevPos);
+            run = std::min (run, m_delaySamples);
+
+            const float* read = nullptr;
+            const float* readPrev = nullptr;
+            getReadPointers (m_readPos, run, 0, read, readPrev);
+            m_processRun (in, out, write, read, readPrev, run*channels, m_delayFraction, m_feedback, m_mix);
+        }
+
+        // Nothing in the run reads what it wrote, so the feedback can be processed afterwards.
+        processFeedback (write, run);
+
+        // Set the new read/write positions.
+        advanceWritePos (run);
+        m_readPos = wrapPos (m_readPos + run);
+        done += run;
+    }
+}
+
+void DelayLine::processVarying (const float* input, float* output, const int numFrames)
+{
+    float delay[s_rampFrames];
+    float feedback[s_rampFrames];
+    float mix[s_rampFrames];
+    m_delaySmoother.process (delay, numFrames);
+    m_feedbackSmoother.process (feedback, numFrames);
+    m_mixSmoother.process (mix, numFrames);
+    addModulation (delay, numFrames);
+
+    // Pick the interpolation once per block so the frame loop is compiled for each policy.
+    switch (m_interpolation)
+    {
+        case Interpolators::CUBIC:
+            processFrames<CubicInterpolator> (input, output, delay, feedback, mix, numFrames);
+            break;
+        case Interpolators::LAGRANGE:
+            processFrames<LagrangeInterpolator> (input, output, delay, feedback, mix, numFrames);
+            break;
+        case Interpolators::ALLPASS:
+            processFrames<AllpassInterpolator> (input, output, delay, feedback, mix, numFrames);
+            break;
+        case Interpolators::SINC:
+            processFrames<SincInterpolator> (input, output, delay, feedback, mix, numFrames);
+            break;
+        default:
+            processFrames<LinearInterpolator> (input, output, delay, feedback, mix, numFrames);
+            break;
+    }
+}
+
+template <typename Interpolator>
+void DelayLine::processFrames (const float* input, float* output, const float* delay, const float* feedback, const float* mix, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const int numTaps = Interpolator::s_numTaps;
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        // Split the delay into whole samples and a fraction for the interpolation.
+        int delaySamples = 0;
+        float fraction = 0;
+        Interpolator::split (limitDelay<Interpolator> (delay[i]), delaySamples, fraction);
+
+        float coeffs[numTaps];
+        Interpolator::getCoefficients (fraction, coeffs);
+
+        const float* in = input + i*channels;
+        float* out = output + i*channels;
+        float* write = getWritePointer();
+
+        const float* taps[numTaps];
+        for (int k = 0; k < numTaps; ++k)
+        {
+            // Under one sample of delay, the newest tap is the input itself.
+            const int age = delaySamples + Interpolator::s_firstTap + k;
+            taps[k] = age == 0 ? in : getReadPointer (wrapPos (m_writePos - age), 1, k);
+        }
+
+        for (int c = 0; c < channels; ++c)
+        {
+            const float x = in[c];
+            float y = coeffs[0] * taps[0][c];
+            for (int k = 1; k < numTaps; ++k) { y += coeffs[k] * taps[k][c]; }
+
+            if (Interpolator::s_recursive)
+            {
+                y -= coeffs[0] * m_allpassState[c];
+                m_allpassState[c] = y;
+            }
+
+            write[c] = x + (feedback[i] * y);
+            out[c] = (mix[i] * y) + ((1.0f - mix[i]) * x);
+        }
+
+        processFeedback (write, 1);
+        advanceWritePos (1);
+    }
+}
+
+template <typename Interpolator>
+void DelayLine::processStaticTaps (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const float feedback = m_feedback;
+    const float mix = m_mix;
+    const float mixInv = 1.0f - mix;
+    const int numTaps = Interpolator::s_numTaps;
+
+    int delaySamples = 0;
+    float fraction = 0;
+    Interpolator::split (limitDelay<Interpolator> (m_delaySamples + m_delayFraction), delaySamples, fraction);
+
+    float coeffs[numTaps];
+    Interpolator::getCoefficients (fraction, coeffs);
+
+    // The minimum delay keeps the newest tap at least one frame behind the write position.
+    const int newest = delaySamples + Interpolator::s_firstTap;
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the next wrap points of the write position and every tap, and to the
+        // age of the newest tap so that it never reads a sample that it has written itself.
+        int run = std::min (numFrames - done, getWriteSpace());
+        run = std::min (run, newest);
+        for (int k = 0; k < numTaps; ++k) { run = std::min (run, m_maxDelaySamples - wrapPos (m_writePos - newest - k)); }
+
+        // In a compact format, one run of frames covers every tap, starting from the oldest.
+        const float* taps[numTaps];
+        const float* oldest = isCompact() ? getReadPointer (wrapPos (m_writePos - newest - numTaps + 1), run + numTaps - 1, 0) : nullptr;
+        for (int k = 0; k < numTaps; ++k)
+        {
+            taps[k] = isCompact() ? oldest + (numTaps - 1 - k)*channels : getReadPointer (wrapPos (m_writePos - newest - k), run, 0);
+        }
+
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        float* write = getWritePointer();
+
+        for (int j = 0; j < run*channels; ++j)
+        {
+            const float x = in[j];
+            float y = coeffs[0] * taps[0][j];
+            for (int k = 1; k < numTaps; ++k) { y += coeffs[k] * taps[k][j]; }
+
+            write[j] = x + (feedback * y);
+            out[j] = (mix * y) + (mixInv * x);
+        }
+
+        processFeedback (write, run);
+        advanceWritePos (run);
+        done += run;
+    }
+}
+
+void DelayLine::processLong (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    float feedback[s_rampFrames];
+    float mix[s_rampFrames];
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the segments of the tiered buffer, to the wrap point of the buffer and to
+        // the delay, so it never reads what it has written. Level ramps go in short steps.
+        const bool varying = m_feedbackSmoother.isSmoothing() || m_mixSmoother.isSmoothing();
+        const int64_t readFrame = m_longBuffer.getWriteFrame() - m_longDelaySamples;
+        int run = std::min (numFrames - done, m_longDelaySamples);
+        run = std::min (run, getWriteSpace());
+        if (varying) { run = std::min (run, s_rampFrames); }
+        run = m_longBuffer.getRunLength (readFrame, run);
+
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        float* write = m_longBuffer.getWritePointer();
+        const float* read = m_longBuffer.read (readFrame, run);
+
+        if (m_freeze)
+        {
+            // Write the delayed signal straight back so the loop repeats forever.
+            const float wet = m_mix;
+            for (int j = 0; j < run*channels; ++j)
+            {
+                write[j] = read[j];
+                out[j] = (wet * read[j]) + ((1.0f - wet) * in[j]);
+            }
+        }
+        else if (varying)
+        {
+            m_feedbackSmoother.process (feedback, run);
+            m_mixSmoother.process (mix, run);
+            for (int i = 0; i < run; ++i)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    const int j = i*channels + c;
+                    write[j] = in[j] + (feedback[i] * read[j]);
+                    out[j] = (mix[i] * read[j]) + ((1.0f - mix[i]) * in[j]);
+                }
+            }
+            processFeedback (write, run);
+        }
+        else
+        {
+            // A whole-sample delay is the run kernel with no fraction.
+            m_processRun (in, out, write, read, read, run*channels, 0.0f, m_feedback, m_mix);
+            processFeedback (write, run);
+        }
+
+        std::copy (write, write + run*channels, getWritePointer());
+        m_longBuffer.advance (run);
+        advanceWritePos (run);
+        m_readPos = wrapPos (m_readPos + run);
+        done += run;
+    }
+}
+
+void DelayLine::processFrozen (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const int delaySamples = std::max (m_delaySamples, 1);
+    const float mix = m_mix;
+    const float mixInv = 1.0f - mix;
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the next wrap points and to the loop length, so it never reads what it has written.
+        const int readPos = wrapPos (m_writePos - delaySamples);
+        int run = std::min (numFrames - done, getWriteSpace());
+        run = std::min (run, m_maxDelaySamples - readPos);
+        run = std::min (run, delaySamples);
+
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        float* write = getWritePointer();
+        const float* read = getReadPointer (readPos, run, 0);
+
+        // Write the delayed signal straight back so it repeats forever.
+        for (int j = 0; j < run*channels; ++j)
+        {
+            const float y = read[j];
+            write[j] = y;
+            out[j] = (mix * y) + (mixInv * in[j]);
+        }
+
+        advanceWritePos (run);
+        m_readPos = wrapPos (m_readPos + run);
+        done += run;
+    }
+}
+
+void DelayLine::processRouted (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+
+    // Process any parameter ramps in short steps, then the rest of the block with static values.
+    int done = 0;
+    while (done < numFrames && isRoutedVarying())
+    {
+        const int num = std::min (numFrames - done, s_rampFrames);
+
+        float delayLeft[s_rampFrames];
+        float delayRight[s_rampFrames];
+        float feedback[s_rampFrames];
+        float mix[s_rampFrames];
+        m_delaySmoother.process (delayLeft, num);
+        m_rightDelaySmoother.process (delayRight, num);
+        m_feedbackSmoother.process (feedback, num);
+        m_mixSmoother.process (mix, num);
+        addModulation (delayLeft, num, delayRight);
+
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        switch (m_interpolation)
+        {
+            case Interpolators::CUBIC:
+                processRoutedFrames<CubicInterpolator> (in, out, delayLeft, delayRight, feedback, mix, num);
+                break;
+            case Interpolators::LAGRANGE:
+                processRoutedFrames<LagrangeInterpolator> (in, out, delayLeft, delayRight, feedback, mix, num);
+                break;
+            case Interpolators::ALLPASS:
+                processRoutedFrames<AllpassInterpolator> (in, out, delayLeft, delayRight, feedback, mix, num);
+                break;
+            case Interpolators::SINC:
+                processRoutedFrames<SincInterpolator> (in, out, delayLeft, delayRight, feedback, mix, num);
+                break;
+            default:
+                processRoutedFrames<LinearInterpolator> (in, out, delayLeft, delayRight, feedback, mix, num);
+                break;
+        }
+        done += num;
+
+        if (! isRoutedVarying()) { setReadPos(); }
+    }
+
+    processRoutedRuns (input + done*channels, output + done*channels, numFrames - done);
+}
+
+void DelayLine::processRoutedRuns (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+
+    // Both channels read at least one frame back, like processRoutedFrames().
+    int delaySamples[2];
+    float fraction[2];
+    LinearInterpolator::split (std::max (1.0f, limitDelay<LinearInterpolator> (getDelaySamples())), delaySamples[0], fraction[0]);
+    LinearInterpolator::split (std::max (1.0f, limitDelay<LinearInterpolator> (getRightDelaySamples())), delaySamples[1], fraction[1]);
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the next wrap points of the write position and both read positions, and
+        // to the shorter delay so that neither channel reads a frame that the run has written itself.
+        int run = std::min (numFrames - done, getWriteSpace());
+        run = std::min (run, std::min (delaySamples[0], delaySamples[1]));
+
+        int readPos[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            readPos[c] = wrapPos (m_writePos - delaySamples[c]);
+            run = std::min (run, m_maxDelaySamples - readPos[c]);
+            run = std::min (run, m_maxDelaySamples - wrapPos (readPos[c] - 1));
+        }
+
+        const float* read[2];
+        const float* readPrev[2];
+        for (int c = 0; c < 2; ++c) { getReadPointers (readPos[c], run, c, read[c], readPrev[c]); }
+
+        float* write = getWritePointer();
+        m_processStereoRun (input + done*channels, output + done*channels, write, read[0], readPrev[0], read[1], readPrev[1],
+                            run, fraction[0], fraction[1], m_feedback, m_mix, m_stereoMatrix);
+        processFeedback (write, run);
+
+        advanceWritePos (run);
+        done += run;
+    }
+
+    // Keep the read position of the single delay in step with the write position.
+    m_readPos = wrapPos (m_writePos - m_delaySamples);
+}
+
+template <typename Interpolator>
+void DelayLine::processRoutedFrames (const float* input, float* output, const float* delayLeft, const float* delayRight,
+                                     const float* feedback, const float* mix, const int numFrames)
+{
+    const int numTaps = Interpolator::s_numTaps;
+    const DelayKernels::StereoMatrix& matrix = m_stereoMatrix;
+    const float* delay[2] = { delayLeft, delayRight };
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        const float* in = input + 2*i;
+        float* out = output + 2*i;
+        float* write = getWritePointer();
+
+        float y[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            // Read at least one frame back, since the other channel's write depends on this one.
+            int delaySamples = 0;
+            float fraction = 0;
+            Interpolator::split (std::max (1.0f, limitDelay<Interpolator> (delay[c][i])), delaySamples, fraction);
+
+            float coeffs[numTaps];
+            Interpolator::getCoefficients (fraction, coeffs);
+
+            const int newest = delaySamples + Interpolator::s_firstTap;
+            float sum = coeffs[0] * getReadPointer (wrapPos (m_writePos - newest), 1, c*numTaps)[c];
+            for (int k = 1; k < numTaps; ++k) { sum += coeffs[k] * getReadPointer (wrapPos (m_writePos - newest - k), 1, c*numTaps + k)[c]; }
+
+            if (Interpolator::s_recursive)
+            {
+                sum -= coeffs[0] * m_allpassState[c];
+                m_allpassState[c] = sum;
+            }
+            y[c] = sum;
+        }
+
+        // The same routing as the stereo kernel.
+        write[0] = ((matrix.input[0] * in[0]) + (matrix.input[1] * in[1]))
+                 + (feedback[i] * ((matrix.feedback[0] * y[0]) + (matrix.feedback[1] * y[1])));
+        write[1] = ((matrix.input[3] * in[1]) + (matrix.input[2] * in[0]))
+                 + (feedback[i] * ((matrix.feedback[3] * y[1]) + (matrix.feedback[2] * y[0])));
+
+        const float wetLeft = (matrix.wet[0] * y[0]) + (matrix.wet[1] * y[1]);
+        const float wetRight = (matrix.wet[0] * y[1]) + (matrix.wet[1] * y[0]);
+        out[0] = (mix[i] * wetLeft) + ((1.0f - mix[i]) * in[0]);
+        out[1] = (mix[i] * wetRight) + ((1.0f - mix[i]) * in[1]);
+
+        processFeedback (write, 1);
+        advanceWritePos (1);
+    }
+}
+
+void DelayLine::processTaps (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+
+    int done = 0;
+    while (done < numFrames && isTapVarying())
+    {
+        const int num = std::min (numFrames - done, s_rampFrames);
+        processTapFrames (input + done*channels, output + done*channels, num);
+        done += num;
+    }
+
+    processTapRuns (input + done*channels, output + done*channels, numFrames - done);
+}
+
+void DelayLine::processTapRuns (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const int numTaps = m_numTaps;
+    const int tile = s_tapFrames*channels;
+    const float mix = m_mix;
+    const float mixInv = 1.0f - mix;
+    float* wet = m_tapSums;
+    float* feedback = m_tapSums + tile;
+
+    // Split each tap delay into whole samples and a fraction for the interpolation.
+    int delaySamples[s_maxTaps];
+    float fraction[s_maxTaps];
+    int minDelay = m_maxDelaySamples;
+    for (int k = 0; k < numTaps; ++k)
+    {
+        const float delay = m_taps[k].delaySmoother.getValue();
+        delaySamples[k] = static_cast<int> (delay);
+        fraction[k] = delay - delaySamples[k];
+        minDelay = std::min (minDelay, delaySamples[k]);
+    }
+
+    int done = 0;
+    while (done < numFrames)
+    {
+        // Limit the run to the next wrap points of the write position and every tap. The run must also be
+        // no longer than the shortest delay so that no tap reads a sample that the run has written itself.
+        int run = std::min (numFrames - done, getWriteSpace());
+        run = std::min (run, minDelay);
+
+        int readPos[s_maxTaps];
+        for (int k = 0; k < numTaps; ++k)
+        {
+            readPos[k] = wrapPos (m_writePos - delaySamples[k]);
+            run = std::min (run, m_maxDelaySamples - readPos[k]);
+            run = std::min (run, m_maxDelaySamples - wrapPos (readPos[k] - 1));
+        }
+
+        const float* read[s_maxTaps];
+        const float* readPrev[s_maxTaps];
+        for (int k = 0; k < numTaps; ++k) { getReadPointers (readPos[k], run, k, read[k], readPrev[k]); }
+
+        const float* in = input + done*channels;
+        float* out = output + done*channels;
+        float* write = getWritePointer();
+
+        // Sum the taps for a tile of frames at a time so the sums stay in cache.
+        for (int start = 0; start < run*channels; start += tile)
+        {
+            const int num = std::min (tile, run*channels - start);
+            std::fill (wet, wet + num, 0.0f);
+            std::fill (feedback, feedback + num, 0.0f);
+
+            for (int k = 0; k < numTaps; ++k)
+            {
+                const float* gains = m_tapGains + k*tile;
+                const float* r = read[k] + start;
+                const float* p = readPrev[k] + start;
+                const float frac = fraction[k];
+                const float fracInv = 1.0f - frac;
+                const float fb = m_taps[k].feedbackSmoother.getValue();
+
+                for (int j = 0; j < num; ++j)
+                {
+                    const float y = (frac * p[j]) + (fracInv * r[j]);
+                    wet[j] += gains[j] * y;
+                    feedback[j] += fb * y;
+                }
+            }
+
+            for (int j = 0; j < num; ++j)
+            {
+                const float x = in[start + j];
+                write[start + j] = x + feedback[j];
+                out[start + j] = (mix * wet[j]) + (mixInv * x);
+            }
+        }
+
+        processFeedback (write, run);
+        advanceWritePos (run);
+        done += run;
+    }
+}
+
+void DelayLine::processTapFrames (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const int numTaps = m_numTaps;
+    const int tile = s_tapFrames*channels;
+    float* wet = m_tapSums;
+    float* feedback = m_tapSums + tile;
+
+    float mix[s_rampFrames];
+    float delay[s_maxTaps][s_rampFrames];
+    float fb[s_maxTaps][s_rampFrames];
+    m_mixSmoother.process (mix, numFrames);
+    for (int k = 0; k < numTaps; ++k)
+    {
+        m_taps[k].delaySmoother.process (delay[k], numFrames);
+        m_taps[k].feedbackSmoother.process (fb[k], numFrames);
+    }
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        const float* in = input + i*channels;
+        float* out = output + i*channels;
+        float* write = getWritePointer();
+
+        std::fill (wet, wet + channels, 0.0f);
+        std::fill (feedback, feedback + channels, 0.0f);
+
+        for (int k = 0; k < numTaps; ++k)
+        {
+            const int delaySamples = static_cast<int> (delay[k][i]);
+            const float fraction = delay[k][i] - delaySamples;
+            const float* read = nullptr;
+            const float* readPrev = nullptr;
+            getReadPointers (wrapPos (m_writePos - delaySamples), 1, k, read, readPrev);
+            const float* gains = m_tapGains + k*tile;
+
+            for (int c = 0; c < channels; ++c)
+            {
+                const float y = (fraction * readPrev[c]) + ((1.0f - fraction) * read[c]);
+                wet[c] += gains[c] * y;
+                feedback[c] += fb[k][i] * y;
+            }
+        }
+
+        for (int c = 0; c < channels; ++c)
+        {
+            const float x = in[c];
+            write[c] = x + feedback[c];
+            out[c] = (mix[i] * wet[c]) + ((1.0f - mix[i]) * x);
+        }
+
+        processFeedback (write, 1);
+        advanceWritePos (1);
+    }
+}
+
+void DelayLine::addModulation (float* delay, const int numFrames, float* delay2)
+{
+    float depth[s_rampFrames];
+    m_modDepthSmoother.process (depth, numFrames);
+    if (! m_modDepthSmoother.isSmoothing() && m_modDepthSmoother.getValue() <= 0) { return; }
+
+    const float maxDelay = m_maxDelaySamples - 1.0f;
+    const double phaseInc = m_modRate / m_sampleFreq;
+    const float phase = static_cast<float> (m_lfoPhase);
+    const float inc = static_cast<float> (phaseInc);
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        // Fold the phase into a triangle wave (-1 to 1) and shape it into a sine with a polynomial.
+        float p = phase + (inc * (i + 1)) + 0.25f;
+        p -= static_cast<int> (p);
+        const float x = 1.0f - 4.0f * std::abs (p - 0.5f);
+        const float x2 = x * x;
+        const float lfo = x * (1.5703368f - x2 * (0.6421070f - x2 * 0.0717703f));
+
+        delay[i] = std::max (0.0f, std::min (delay[i] + (depth[i] * lfo), maxDelay));
+        if (delay2 != nullptr) { delay2[i] = std::max (0.0f, std::min (delay2[i] + (depth[i] * lfo), maxDelay)); }
+    }
+
+    // Keep the running phase in double precision so it doesn't drift.
+    m_lfoPhase += phaseInc * numFrames;
+    m_lfoPhase -= static_cast<int> (m_lfoPhase);
+}
+
+void DelayLine::setModulation (const float rate, const float depth)
+{
+    m_modRate = std::max (rate, 0.0f);
+    m_modDepth = std::max (depth, 0.0f);
+    m_modDepthSmoother.setTarget (static_cast<float> (m_sampleFreq*1e-3*m_modDepth));
+}
+
+void DelayLine::setFreeze (bool freeze)
+{
+    // Loop the whole-sample delay at the current delay time, which the read position may not be tracking.
+    if (freeze && ! m_freeze) { setReadPos(); }
+    m_freeze = freeze;
+}
+
+void DelayLine::setDelay (float delay)
+{
+    m_delay = delay;
+    m_delaySmoother.setTarget (getDelaySamples());
+    if (m_delayRight < 0) { m_rightDelaySmoother.setTarget (getDelaySamples()); }
+
+    // Without smoothing, the read position jumps straight to the new delay.
+    if (! m_delaySmoother.isSmoothing()) { setReadPos(); }
+}
+
+float DelayLine::getDelaySamples() const
+{
+    // The delay is kept under the buffer length so the read position never catches up with the write position.
+    return std::max (0.0f, std::min (static_cast<float> (m_sampleFreq*1e-3*m_delay), m_maxDelaySamples - 1.0f));
+}
+
 void DelayLine::setReadPos()
 {
     // Calculate the number of delay samples and the fractional delay.
-    float samples = m_sampleFreq*1e-3*m_delay;
+    float samples = getDelaySamples();
     m_delaySamples = floor(samples);
     m_delayFraction = samples - m_delaySamples;
     
     // Calculate the read position.
-    m_readPos = m_writePos - m_delaySamples;
-    if (m_readPos < 0) { m_readPos += m_maxDelaySamples; }
+    m_readPos = wrapPos (m_writePos - m_delaySamples);
 }
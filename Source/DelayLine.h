@@ -10,6 +10,15 @@
 #include <cmath>
 #include <cassert>
 #include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "DelayKernels.h"
+#include "FeedbackFilter.h"
+#include "Saturator.h"
+#include "TieredDelayBuffer.h"
+#include "Interpolators.h"
+#include "ParameterSmoother.h"
 
 /**
  * \class 
@@ -25,21 +34,52 @@ public:
      * \param[in]  float  Delay time (msecs)
      * \param[in]  float  Feedback (%)
      * \param[in]  float  Mix (%)
+     * \param[in]  int  Number of channels stored interleaved in each frame of the buffer
      */
-    DelayLine (const int fs = 44100, const float delay = 0, const float feedback = 0, const float mix = 0.5);
+    DelayLine (const int fs = 44100, const float delay = 0, const float feedback = 0, const float mix = 0.5, const int numChannels = 1);
 
     /**
      * Class destructor.
      */
     ~DelayLine();
 
+    /**
+     * Sizes the buffer for a sample rate and maximum delay time, then resets the delay line.
+     *
+     * The buffer is only reallocated when it has to grow, so this should be called from
+     * AudioProcessor::prepareToPlay() and never from the audio thread.
+     *
+     * With powerOfTwo set, the buffer length is rounded up to a power of two so that every buffer
+     * position wraps with a bit mask instead of a compare-and-reset branch. This costs some extra
+     * memory per delay line.
+     *
+     * The buffer can also be stored as half precision or as 16-bit integers with a scale for each
+     * block of s_storageBlock frames, which halves its memory and cache footprint. The newest block
+     * is kept in single precision and converted once it's complete, and every read converts the
+     * frames it needs into a scratch buffer. Each pass through the feedback loop adds rounding noise
+     * about 70 dB below the signal (half precision) or 90 dB below the block peak (16-bit), and the
+     * buffer length is rounded up to whole blocks.
+     *
+     * \param[in]  double  Sample frequency
+     * \param[in]  float  Maximum delay time (msecs)
+     * \param[in]  bool  Use a power-of-two buffer length
+     * \param[in]  TieredDelayBuffer::Format  Storage format for the buffer
+     */
+    void prepare (const double fs, const float maxDelay = 2000, const bool powerOfTwo = false,
+                  const TieredDelayBuffer::Format format = TieredDelayBuffer::FLOAT32);
+
+    TieredDelayBuffer::Format getStorageFormat() const { return m_format; }; ///< Gets the storage format of the buffer.
+
+    static const int s_storageBlock = 64; ///< Number of frames converted at a time in the compact storage formats.
+
     /**
      * Resets the delay line by flushing the buffer and initializing the delay parameters.
+     * This never allocates memory.
      */
     void reset();
 
     /**
-     * Calculates the delayed value of the input signal.
+     * Calculates the delayed value of the input signal (single channel only).
      *
      * \param[in]  float  Input data sample
      *
@@ -47,27 +87,655 @@ public:
      */
     float processSample (const float input);
 
+    /**
+     * Calculates the delayed values of a block of input samples.
+     *
+     * The circular buffer is split into contiguous runs between its wrap points so that the
+     * inner loop is free of branches and can be vectorized by the compiler. With more than one
+     * channel, the input and output samples are interleaved frames. While a parameter is being
+     * smoothed or the delay is modulated, the block is processed with per-sample values instead.
+     * Interpolation types other than linear read their taps with the same run splitting.
+     *
+     * Once everything in the buffer has decayed below the silence level and the input is silent
+     * too, the delay line sleeps: the input is passed straight through and the buffer is left alone
+     * until the input is audible again.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output amplitudes of the delayed signal (may be the same as the input)
+     * \param[in]  int  Number of sample frames
+     */
+    void processBlock (const float* input, float* output, const int numFrames);
+
+    int getNumChannels() const { return m_numChannels; }; ///< Gets the number of interleaved channels.
+    bool isSilent() const { return m_quietFrames >= getSilentLength(); }; ///< Indicates whether the whole buffer is below the silence level.
+
+    /**
+     * Calculates how long a full scale signal takes to decay below the silence level once the
+     * input stops, for the host to know when the output has finished.
+     *
+     * \param[in]  float  Delay time (msecs)
+     * \param[in]  float  Feedback (0-1)
+     *
+     * \return  double  Tail time (msecs), or infinity if the feedback doesn't decay
+     */
+    static double getTailTime (const float delay, const float feedback);
+
+    static constexpr float s_silenceLevel = 1e-6f; ///< Level below which the buffer and input count as silent (-120 dB).
+
+    /**
+     * Sets how changes to the delay, feedback and mix parameters are smoothed. A ramp time of
+     * zero applies changes immediately.
+     *
+     * \param[in]  ParameterSmoother::Type  Delay ramp type
+     * \param[in]  float  Delay ramp time (msecs)
+     * \param[in]  ParameterSmoother::Type  Feedback and mix ramp type
+     * \param[in]  float  Feedback and mix ramp time (msecs)
+     */
+    void setSmoothing (const ParameterSmoother::Type delayType, const float delayTime,
+                       const ParameterSmoother::Type levelType, const float levelTime);
+
+    /**
+     * Sets the delay time modulation. The delay swings by up to the depth either side of the delay
+     * parameter with a sine LFO, and the read position is then calculated for every sample.
+     *
+     * \param[in]  float  LFO rate (Hz)
+     * \param[in]  float  Modulation depth (msecs)
+     */
+    void setModulation (const float rate, const float depth);
+
     void setReadPos(); ///< Sets the buffer read position based on the delay and size of the buffer.
-    void setDelay (float delay) { m_delay = delay; setReadPos(); }; ///< Sets the delay parameter and updates the buffer read position.
-    void setFeedback (float feedback) { m_feedback = feedback/100; }; ///< Sets the feedback parameter (0-1).
-    void setMix (float mix) { m_mix = mix/100; }; ///< Sets the mix parameter (0-1).
+    void setDelay (float delay); ///< Sets the delay parameter and starts moving the buffer read position.
+    void setFeedback (float feedback) { m_feedback = feedback/100; m_feedbackSmoother.setTarget (m_feedback); }; ///< Sets the feedback parameter (0-1).
+    void setMix (float mix) { m_mix = mix/100; m_mixSmoother.setTarget (m_mix); }; ///< Sets the mix parameter (0-1).
     void setBypass (bool bypass) { m_bypass = bypass; }; ///< Sets the bypass parameter (true = bypass).
+    bool isBypassed() const { return m_bypass; }; ///< Indicates whether the delay line is bypassed.
+    void setFreeze (bool freeze); ///< Holds the delayed signal in the buffer and repeats it without decay (true = freeze).
+    void setKernelType (DelayKernels::Type type); ///< Overrides the CPU-selected processing kernels.
+
+    /**
+     * Sets a separate delay time for the right channel (stereo only). The delay parameter then only
+     * sets the left channel. Changes are smoothed like the delay parameter.
+     *
+     * \param[in]  float  Right channel delay time (msecs), or a negative value to follow the delay parameter
+     */
+    void setDelayRight (const float delay);
+
+    /**
+     * Sets how the channels are routed through the feedback loop (stereo only).
+     *
+     * In ping-pong mode, both inputs feed the left channel and every repeat crosses over to the
+     * other channel. Otherwise the cross-feed sends part of each channel's feedback to the other
+     * channel. The width scales the difference between the delayed channels in the output, from
+     * mono (0) to double width (2).
+     *
+     * With a separate right delay or any routing, the block is processed by the fused stereo kernel
+     * (DelayKernels::StereoRunFunction) instead of the per-channel kernel.
+     *
+     * \param[in]  bool  Ping-pong mode
+     * \param[in]  float  Cross-feed (0-1)
+     * \param[in]  float  Width (0-2)
+     */
+    void setStereoRouting (const bool pingPong, const float crossfeed, const float width);
+
+    /**
+     * Sets the interpolation used for fractional delays. Linear interpolation is the cheapest and
+     * uses the vectorized run kernels. The others trade CPU for less high frequency loss, and need
+     * a minimum delay of a few samples for their taps.
+     *
+     * \param[in]  Interpolators::Type  Interpolation type
+     */
+    void setInterpolation (const Interpolators::Type type);
+
+    Interpolators::Type getInterpolation() const { return m_interpolation; }; ///< Gets the interpolation type.
+
+    /**
+     * Sets the filter inside the feedback loop. Everything written into the buffer goes through
+     * the filter, so every repeat is filtered once more than the one before. The buffer isn't
+     * filtered while it's frozen.
+     *
+     * \param[in]  FeedbackFilter::Type  Filter type
+     * \param[in]  float  Cutoff or pivot frequency (Hz)
+     * \param[in]  float  Tilt (dB, TILT only)
+     */
+    void setFeedbackFilter (const FeedbackFilter::Type type, const float frequency, const float tilt) { m_feedbackFilter.setFilter (type, frequency, tilt); };
+
+    /**
+     * Sets the drive stage inside the feedback loop, which saturates everything written into the
+     * buffer before the feedback filter. The buffer isn't saturated while it's frozen.
+     *
+     * \param[in]  Saturator::Shape  Waveshaper curve
+     * \param[in]  float  Drive (dB)
+     * \param[in]  int  Oversampling factor for the drive stage (1, 2 or 4)
+     */
+    void setSaturation (const Saturator::Shape shape, const float drive, const int oversampling) { m_saturator.setSaturation (shape, drive, oversampling); };
+
+    /**
+     * Prepares the long delay mode for delays of up to maxDelay, which can be much longer than the
+     * buffer. This allocates memory and creates a spill file, so it should be called from
+     * AudioProcessor::prepareToPlay() after prepare() or with processing suspended, and never from
+     * the audio thread.
+     *
+     * \param[in]  float  Longest delay time (msecs)
+     * \param[in]  std::string  Directory for the spill file (empty for the system temporary directory)
+     * \param[in]  TieredDelayBuffer::Format  Storage format for the spilled audio
+     *
+     * \return  bool  True if the long delay mode is available
+     */
+    bool prepareLongDelay (const float maxDelay, const std::string& spillDirectory = std::string(),
+                           const TieredDelayBuffer::Format format = TieredDelayBuffer::FLOAT32);
+
+    /**
+     * Sets the delay time for the long delay mode. A positive delay switches the delay line to the
+     * long delay mode if prepareLongDelay() succeeded, and zero switches it back.
+     *
+     * In the long delay mode, recent audio stays in RAM and older audio is spilled to a tiered
+     * buffer (see TieredDelayBuffer). A new recording starts when the mode is switched on, so the
+     * first repeat comes one full delay later. The delay is a whole number of samples, and changes
+     * to it jump instead of gliding. The modulation, interpolation, taps and stereo routing don't
+     * apply, and freezing loops the long delay.
+     *
+     * \param[in]  float  Delay time (msecs), or zero to switch the long delay mode off
+     */
+    void setLongDelay (const float delay);
+
+    bool isLongDelay() const { return m_long; }; ///< Indicates whether the delay line is in the long delay mode.
+    bool isLongDelayReady() const { return m_longBuffer.isReady(); }; ///< Indicates whether prepareLongDelay() has succeeded since the last releaseLongDelay().
+    int getNumDropouts() const { return m_longBuffer.getNumDropouts(); }; ///< Gets the number of times long delay audio was lost or read late.
+
+    /**
+     * Switches the long delay mode off and frees its memory, spill file and background task. It
+     * stays off until prepareLongDelay() is called again, so this is never called from the audio thread.
+     */
+    void releaseLongDelay();
+
+    static const int s_maxTaps = 8; ///< Maximum number of read taps in multi-tap mode.
+
+    /**
+     * Sets the number of read taps. With one or more taps, the delay line runs in multi-tap mode:
+     * the write head feeds every tap from the same buffer, and each tap has its own delay, gain,
+     * pan and feedback from setTap(). The delay, feedback, modulation and interpolation settings
+     * only apply with no taps. Taps that are switched on jump straight to their delay, so set them
+     * up with setTap() first.
+     *
+     * \param[in]  int  Number of taps (0 to s_maxTaps)
+     */
+    void setNumTaps (const int numTaps);
+
+    /**
+     * Sets the parameters of a read tap. Delay changes are smoothed like the delay parameter,
+     * feedback changes like the feedback parameter, and gain and pan changes apply from the next block.
+     *
+     * \param[in]  int  Tap index
+     * \param[in]  float  Delay time (msecs)
+     * \param[in]  float  Gain (0-1)
+     * \param[in]  float  Pan (-1 for left to 1 for right, stereo only)
+     * \param[in]  float  Feedback into the write head (0-1)
+     */
+    void setTap (const int index, const float delay, const float gain, const float pan, const float feedback);
+
+    int getNumTaps() const { return m_numTaps; }; ///< Gets the number of read taps (0 without multi-tap mode).
+
+protected:
+
+    /**
+     * Skips a block if the buffer and the input are both silent. The parameter ramps jump to
+     * their targets, and the caller passes the input straight through instead of processing it.
+     *
+     * \param[in]  float  Peak absolute value of the input block
+     *
+     * \return  bool  True if the block was skipped
+     */
+    bool trySleep (const float inputPeak);
+
+    /**
+     * Processes a block that wasn't skipped by trySleep(), and keeps track of how much of the
+     * buffer is below the silence level.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples (may be the same as the input)
+     * \param[in]  int  Number of sample frames
+     * \param[in]  float  Peak absolute value of the input block
+     */
+    void processActive (const float* input, float* output, const int numFrames, const float inputPeak);
+
+    /**
+     * Writes frames into the buffer without processing them, for a derived class that makes its
+     * own output, so that switching back to the delay picks up the recent audio. The feedback,
+     * freeze and long delay don't apply.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[in]  int  Number of sample frames
+     * \param[in]  float  Peak absolute value of the input frames
+     */
+    void write (const float* input, const int numFrames, const float inputPeak);
+
+    /**
+     * Gets the mix for each frame of a run that a derived class processes itself, and moves the
+     * mix ramp on past them.
+     *
+     * \param[out]  float*  Mix for each frame (0-1)
+     * \param[in]  int  Number of frames
+     */
+    void getMixRamp (float* mix, const int numFrames);
+
+    double getSampleRate() const { return m_sampleFreq; }; ///< Gets the audio sample rate.
 
 private:
 
+    /**
+     * Updates the count of quiet frames in the buffer after processing a block.
+     *
+     * \param[in]  float  Peak absolute value of the input block
+     * \param[in]  int  Buffer write position at the start of the block (frames)
+     * \param[in]  int  Number of sample frames
+     */
+    void updateSilence (const float inputPeak, const int writePos, const int numFrames);
+
+    void jumpToTargets(); ///< Ends all of the parameter ramps at their target values.
+
+    /**
+     * Gets the number of quiet frames after which nothing audible is left in the buffer, which
+     * is the long delay in the long delay mode.
+     */
+    int getSilentLength() const { return m_long ? std::max (m_maxDelaySamples, m_longDelaySamples + 1) : m_maxDelaySamples; };
+
+    /**
+     * Runs frames that were just written into the buffer through the drive stage and feedback filter.
+     *
+     * \param[in,out]  float*  Buffer write position
+     * \param[in]  int  Number of sample frames
+     */
+    void processFeedback (float* write, const int numFrames)
+    {
+        if (m_saturator.isActive()) { m_saturator.process (write, numFrames); }
+        if (m_feedbackFilter.isActive()) { m_feedbackFilter.process (write, numFrames); }
+    };
+
+    /**
+     * Processes a block with the current (static) parameter values.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processStatic (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes a block with static parameter values and a non-recursive interpolation policy.
+     * The coefficients are calculated once, and each tap reads a contiguous run of the buffer.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    template <typename Interpolator>
+    void processStaticTaps (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes a block while parameters are being smoothed or the delay is modulated.
+     *
+     * The per-sample delay and parameter values are calculated for the whole block first, which
+     * vectorizes, and then the read position is calculated for each frame from the delay.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames (at most s_rampFrames)
+     */
+    void processVarying (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes frames with per-sample parameter values and an interpolation policy.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  float*  Delay values (samples)
+     * \param[in]  float*  Feedback values (0-1)
+     * \param[in]  float*  Mix values (0-1)
+     * \param[in]  int  Number of sample frames
+     */
+    template <typename Interpolator>
+    void processFrames (const float* input, float* output, const float* delay, const float* feedback, const float* mix, const int numFrames);
+
+    /**
+     * Limits a delay to the range that an interpolation policy can read from the buffer.
+     *
+     * \param[in]  float  Delay (samples)
+     *
+     * \return  float  Limited delay (samples)
+     */
+    template <typename Interpolator>
+    float limitDelay (const float delay) const
+    {
+        const float maxDelay = static_cast<float> (m_maxDelaySamples - (Interpolator::s_firstTap + Interpolator::s_numTaps - 1));
+        return std::max (Interpolator::getMinDelay(), std::min (delay, maxDelay));
+    };
+
+    /**
+     * Processes a block while the buffer is frozen. The buffer repeats the last whole-sample delay
+     * time of audio without decay or interpolation, and the input is only mixed into the output.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processFrozen (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes a block in the long delay mode. The frames written into the tiered buffer are
+     * also copied into the buffer, so that switching back or freezing picks up the recent audio.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processLong (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes a block of stereo frames with a separate delay for each channel and the routing
+     * matrix, with per-sample values while parameters are smoothed or the delay is modulated.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processRouted (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes stereo frames with static parameter values and linear interpolation, split into
+     * runs that none of the read positions wrap around in, through the stereo kernel.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processRoutedRuns (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes stereo frames with per-sample parameter values, a separate delay for each channel
+     * and an interpolation policy.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  float*  Left channel delay values (samples)
+     * \param[in]  float*  Right channel delay values (samples)
+     * \param[in]  float*  Feedback values (0-1)
+     * \param[in]  float*  Mix values (0-1)
+     * \param[in]  int  Number of sample frames
+     */
+    template <typename Interpolator>
+    void processRoutedFrames (const float* input, float* output, const float* delayLeft, const float* delayRight,
+                              const float* feedback, const float* mix, const int numFrames);
+
+    /**
+     * Indicates whether the stereo routing has to be processed frame by frame.
+     */
+    bool isRoutedVarying() const
+    {
+        return isVarying() || m_rightDelaySmoother.isSmoothing() || m_interpolation != Interpolators::LINEAR;
+    };
+
+    float getRightDelaySamples() const; ///< Gets the right channel delay in samples, limited to the buffer length.
+    void updateRouting(); ///< Checks whether the stereo routing is needed after a routing or delay change.
+
+    /**
+     * Processes a block in multi-tap mode, with per-sample values while any tap delay or feedback or the mix
+     * is being smoothed and static values for the rest of the block.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processTaps (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes a block in multi-tap mode with static tap delays. The buffer is split into runs
+     * that none of the taps wrap around in, and all of the taps are summed in one pass over each
+     * run, a tile of s_tapFrames frames at a time.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void processTapRuns (const float* input, float* output, const int numFrames);
+
+    /**
+     * Processes frames in multi-tap mode while a tap delay or feedback or the mix is being smoothed.
+     *
+     * \param[in]  float*  Input data samples
+     * \param[out]  float*  Output data samples
+     * \param[in]  int  Number of sample frames (at most s_rampFrames)
+     */
+    void processTapFrames (const float* input, float* output, const int numFrames);
+
+    /**
+     * Indicates whether any of the tap delays or feedbacks or the mix are being smoothed in multi-tap mode.
+     */
+    bool isTapVarying() const
+    {
+        if (m_mixSmoother.isSmoothing()) { return true; }
+        for (int k = 0; k < m_numTaps; ++k)
+        {
+            if (m_taps[k].delaySmoother.isSmoothing() || m_taps[k].feedbackSmoother.isSmoothing()) { return true; }
+        }
+        return false;
+    };
+
+    /**
+     * Gets a tap delay in samples, limited so that the tap and its interpolation neighbour are
+     * never the sample being written.
+     */
+    float getTapDelaySamples (const float delay) const
+    {
+        return std::max (1.0f, std::min (static_cast<float> (m_sampleFreq*1e-3*delay), m_maxDelaySamples - 2.0f));
+    };
+
+    /**
+     * Adds the LFO modulation to a block of delay values.
+     *
+     * \param[in,out]  float*  Delay values (samples)
+     * \param[in]  int  Number of sample frames (at most s_rampFrames)
+     * \param[in,out]  float*  Optional second channel of delay values that gets the same modulation
+     */
+    void addModulation (float* delay, const int numFrames, float* delay2 = nullptr);
+
+    float getDelaySamples() const; ///< Gets the delay parameter in samples, limited to the buffer length.
+
+    /**
+     * Indicates whether any of the parameters are being smoothed, the delay is modulated or the
+     * interpolation is recursive, so the block has to be processed frame by frame.
+     */
+    bool isVarying() const
+    {
+        return m_delaySmoother.isSmoothing() || m_feedbackSmoother.isSmoothing() || m_mixSmoother.isSmoothing()
+            || m_modDepthSmoother.isSmoothing() || m_modDepthSmoother.getTarget() > 0
+            || m_interpolation == Interpolators::ALLPASS;
+    };
+
+    /**
+     * Wraps a buffer position that is less than one buffer length outside of the buffer.
+     *
+     * \param[in]  int  Buffer position (frames)
+     *
+     * \return  int  Wrapped buffer position (frames)
+     */
+    int wrapPos (const int pos) const
+    {
+        if (m_powerOfTwo) { return pos & m_mask; }
+        return pos < 0 ? pos + m_maxDelaySamples : (pos >= m_maxDelaySamples ? pos - m_maxDelaySamples : pos);
+    };
+
+    bool isCompact() const { return m_format != TieredDelayBuffer::FLOAT32; }; ///< Indicates whether the buffer is stored in a compact format.
+
+    /**
+     * Gets where the frame at the write position is written. In a compact format this is in the
+     * newest block, which is converted once advanceWritePos() completes it.
+     *
+     * \return  float*  Frame at the write position
+     */
+    float* getWritePointer()
+    {
+        if (! isCompact()) { return m_buffer + m_writePos*m_numChannels; }
+        return m_head.data() + (m_writePos & (s_storageBlock - 1))*m_numChannels;
+    };
+
+    /**
+     * Gets the number of frames that can be written from getWritePointer() before the next wrap
+     * point, which is the end of the newest block in a compact format.
+     *
+     * \return  int  Number of frames
+     */
+    int getWriteSpace() const
+    {
+        if (! isCompact()) { return m_maxDelaySamples - m_writePos; }
+        return s_storageBlock - (m_writePos & (s_storageBlock - 1));
+    };
+
+    /**
+     * Moves the write position on past frames written at getWritePointer(), converting the newest
+     * block once it's complete.
+     *
+     * \param[in]  int  Number of frames (at most getWriteSpace())
+     */
+    void advanceWritePos (const int numFrames)
+    {
+        if (isCompact() && (m_writePos & (s_storageBlock - 1)) + numFrames == s_storageBlock) { encodeBlock (m_writePos / s_storageBlock); }
+        m_writePos = wrapPos (m_writePos + numFrames);
+    };
+
+    /**
+     * Gets consecutive frames of the buffer for reading. In single precision this points into the
+     * buffer, so the frames must not cross its end. In a compact format they are converted into the
+     * scratch buffer, wrapping around the end of the buffer, so there must be no more than
+     * s_scratchFrames of them in a slot.
+     *
+     * \param[in]  int  Buffer position of the first frame (frames)
+     * \param[in]  int  Number of frames
+     * \param[in]  int  Position in the scratch buffer to convert to (frames)
+     *
+     * \return  float*  Frames
+     */
+    const float* getReadPointer (const int pos, const int numFrames, const int scratchFrame)
+    {
+        if (! isCompact()) { return m_buffer + pos*m_numChannels; }
+
+        float* scratch = m_scratch.data() + scratchFrame*m_numChannels;
+        decodeFrames (pos, numFrames, scratch);
+        return scratch;
+    };
+
+    /**
+     * Gets the frames at a read position and the frames one before it, for interpolating between them.
+     *
+     * \param[in]  int  Read position (frames)
+     * \param[in]  int  Number of frames
+     * \param[in]  int  Scratch slot to convert to in a compact format (less than s_maxTaps)
+     * \param[out]  float*  Frames at the read position
+     * \param[out]  float*  Frames one before the read position
+     */
+    void getReadPointers (const int readPos, const int numFrames, const int slot, const float*& read, const float*& readPrev)
+    {
+        if (! isCompact())
+        {
+            read = m_buffer + readPos*m_numChannels;
+            readPrev = m_buffer + wrapPos (readPos - 1)*m_numChannels;
+            return;
+        }
+
+        readPrev = getReadPointer (wrapPos (readPos - 1), numFrames + 1, slot*s_scratchFrames);
+        read = readPrev + m_numChannels;
+    };
+
+    /**
+     * Converts consecutive frames of a compact buffer to single precision. Frames of the newest
+     * block that have been written since it was started are copied as they are.
+     *
+     * \param[in]  int  Buffer position of the first frame (frames)
+     * \param[in]  int  Number of frames
+     * \param[out]  float*  Frames
+     */
+    void decodeFrames (int pos, int numFrames, float* output) const;
+
+    /**
+     * Converts the newest block into the compact buffer.
+     *
+     * \param[in]  int  Block index
+     */
+    void encodeBlock (const int block);
+
+    int m_numChannels; ///< Number of interleaved channels per buffer frame.
     double m_sampleFreq; ///< Audio sample rate.
     float m_delay; ///< Delay time parameter (msecs).
     float m_feedback; ///< Feedback parameter (%).
     float m_mix; ///< Mix parameter (%).
     bool m_bypass; ///< Bypass parameter (true = bypass).
+    bool m_freeze; ///< Freeze state (true = repeat the buffer without writing the input).
 
-    int m_readPos; ///< Input buffer read position.
-    int m_writePos; ///< Output buffer write position.
+    int m_readPos; ///< Input buffer read position (frames).
+    int m_writePos; ///< Output buffer write position (frames).
+    int m_quietFrames; ///< Number of frames most recently written to the buffer below the silence level.
 
     int m_delaySamples; ///< Number of samples corresponding to m_delay.
-    int m_maxDelaySamples; ///< Maximum number of delayed samples.
-    float m_maxDelay; ///< Maximum delay time (currently set to 2 secs).
+    int m_maxDelaySamples; ///< Maximum number of delayed samples (buffer length in frames).
+    float m_maxDelay; ///< Maximum delay time (msecs).
     float m_delayFraction; ///< Fractional delay time (msecs).
+    bool m_powerOfTwo; ///< True if the buffer length is a power of two.
+    int m_mask; ///< Bit mask for wrapping positions in a power-of-two buffer.
+
+    float* m_buffer; ///< Delayed signal buffer (single precision format only).
+    int m_bufferSize; ///< Allocated size of the buffer in its format (samples).
+
+    static const int s_scratchFrames = s_storageBlock + 8; ///< Frames per scratch slot: a run plus the extra taps of the longest interpolator.
+
+    TieredDelayBuffer::Format m_format; ///< Storage format for the buffer.
+    std::vector<uint16_t> m_compact; ///< Delayed signal buffer in a compact format (half precision or 16-bit integers).
+    std::vector<float> m_scales; ///< Scale of each block of m_compact in the 16-bit format.
+    std::vector<float> m_head; ///< Newest block of a compact buffer, before it's converted.
+    std::vector<float> m_scratch; ///< Frames converted from a compact buffer for reading (s_maxTaps slots of s_scratchFrames).
+
+    DelayKernels::RunFunction m_processRun; ///< Kernel used by processBlock().
+    DelayKernels::StereoRunFunction m_processStereoRun; ///< Kernel used for stereo routing.
+
+    ParameterSmoother m_delaySmoother; ///< Delay ramp (samples).
+    ParameterSmoother m_feedbackSmoother; ///< Feedback ramp (0-1).
+    ParameterSmoother m_mixSmoother; ///< Mix ramp (0-1).
+
+    float m_modRate; ///< Modulation LFO rate (Hz).
+    float m_modDepth; ///< Modulation depth (msecs).
+    double m_lfoPhase; ///< Modulation LFO phase (0-1).
+    ParameterSmoother m_modDepthSmoother; ///< Modulation depth ramp (samples).
+
+    Interpolators::Type m_interpolation; ///< Fractional delay interpolation type.
+    float* m_allpassState; ///< Previous allpass interpolator output for each channel.
+
+    FeedbackFilter m_feedbackFilter; ///< Filter for the signal written into the buffer.
+    Saturator m_saturator; ///< Drive stage for the signal written into the buffer.
+
+    float m_delayRight; ///< Right channel delay time (msecs, negative to follow m_delay).
+    ParameterSmoother m_rightDelaySmoother; ///< Right channel delay ramp (samples).
+    DelayKernels::StereoMatrix m_stereoMatrix; ///< Stereo routing gains.
+    bool m_routed; ///< True if the stereo routing is processed.
+
+    TieredDelayBuffer m_longBuffer; ///< Tiered buffer for the long delay mode.
+    float m_longDelay; ///< Long delay time parameter (msecs, 0 = off).
+    int m_longDelaySamples; ///< Number of samples corresponding to m_longDelay.
+    bool m_long; ///< True in the long delay mode.
+
+    /**
+     * Read tap for multi-tap mode.
+     */
+    struct Tap
+    {
+        float delay = 0; ///< Delay time (msecs).
+        ParameterSmoother delaySmoother; ///< Delay ramp (samples).
+        ParameterSmoother feedbackSmoother; ///< Ramp of the feedback into the write head (0-1).
+    };
+
+    static const int s_tapFrames = 16; ///< Number of frames summed at a time in multi-tap mode.
+
+    int m_numTaps; ///< Number of read taps (0 without multi-tap mode).
+    Tap m_taps[s_maxTaps]; ///< Read taps.
+    float* m_tapGains; ///< Panned gain of each tap, repeated for every sample of a tile (s_maxTaps x s_tapFrames x channels).
+    float* m_tapSums; ///< Wet and feedback sums of the taps for a tile of frames.
 
-    float* m_buffer; ///< Delayed signal buffer.
+    static const int s_rampFrames = 64; ///< Number of frames processed per parameter ramp step.
 };
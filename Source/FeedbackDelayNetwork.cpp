@@ -0,0 +1,229 @@
+/**
+ * FeedbackDelayNetwork.cpp
+ * \brief Feedback delay network for diffuse repeats.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "FeedbackDelayNetwork.h"
+
+FeedbackDelayNetwork::FeedbackDelayNetwork (const int numChannels)
+    : m_numChannels (numChannels),
+      m_sampleFreq (44100),
+      m_numLines (s_minLines),
+      m_matrix (HADAMARD),
+      m_delay(), m_feedback(),
+      m_lines (nullptr),
+      m_length(), m_mask(), m_writePos(),
+      m_delays(), m_gains(), m_minDelay (1), m_outputGains(),
+      m_input (new float [numChannels*s_blockSize]),
+      m_block (new float [s_maxLines*s_blockSize]),
+      m_sum (new float [s_blockSize]),
+      m_output (new float [numChannels*s_blockSize])
+{
+    assert (numChannels >= 1 && numChannels <= s_maxLines);
+    setNetwork (s_minLines, HADAMARD);
+}
+
+FeedbackDelayNetwork::~FeedbackDelayNetwork()
+{
+    delete [] m_lines;
+    delete [] m_input;
+    delete [] m_block;
+    delete [] m_sum;
+    delete [] m_output;
+}
+
+void FeedbackDelayNetwork::prepare (const double fs, const float maxDelay)
+{
+    m_sampleFreq = fs;
+
+    // A power-of-two length lets every line position wrap with a bit mask.
+    const int maxDelaySamples = std::max (static_cast<int> (std::ceil (fs*1e-3*maxDelay)), 1);
+    int length = 1;
+    while (length <= maxDelaySamples) { length <<= 1; }
+    if (length != m_length)
+    {
+        delete [] m_lines;
+        m_lines = new float [s_maxLines*length];
+        m_length = length;
+        m_mask = length - 1;
+    }
+
+    std::fill (m_lines, m_lines + s_maxLines*m_length, 0.0f);
+    m_writePos = 0;
+    updateLines();
+}
+
+void FeedbackDelayNetwork::release()
+{
+    delete [] m_lines;
+    m_lines = nullptr;
+    m_length = m_mask = m_writePos = 0;
+}
+
+void FeedbackDelayNetwork::reset()
+{
+    if (m_lines == nullptr) { return; }
+    std::fill (m_lines, m_lines + m_numLines*m_length, 0.0f);
+    m_writePos = 0;
+}
+
+void FeedbackDelayNetwork::setNetwork (const int numLines, const Matrix matrix)
+{
+    int lines = s_minLines;
+    while (lines < s_maxLines && (lines < numLines || lines < m_numChannels)) { lines *= 2; }
+
+    // Lines that weren't in use may still hold audio from the last time they were.
+    if (lines > m_numLines && m_lines != nullptr) { std::fill (m_lines + m_numLines*m_length, m_lines + lines*m_length, 0.0f); }
+
+    m_numLines = lines;
+    m_matrix = matrix;
+    updateLines();
+}
+
+void FeedbackDelayNetwork::updateLines()
+{
+    const int numLines = m_numLines;
+    // Very short delays would make runs of a frame or two, and the repeats would merge into a buzz anyway.
+    const double longest = std::max (1.0, std::min (std::max (m_sampleFreq*1e-3*m_delay, static_cast<double> (s_minDelay)), m_length - 1.0));
+
+    // The Hadamard matrix is orthogonal once it's scaled by 1/sqrt(N), and the Householder matrix already is.
+    const float scale = (m_matrix == HADAMARD) ? 1.0f/std::sqrt (static_cast<float> (numLines)) : 1.0f;
+
+    // Space the lines exponentially between half and all of the delay time. Odd lengths keep
+    // them from sharing a factor of two, so the repeats don't pile up on the same samples.
+    m_minDelay = static_cast<int> (longest);
+    for (int l = 0; l < numLines; ++l)
+    {
+        const double length = longest * std::pow (0.5, static_cast<double> (l)/numLines);
+        const int delay = std::max (1, std::min (static_cast<int> (std::round (length)) | 1, static_cast<int> (longest)));
+        m_delays[l] = delay;
+        m_minDelay = std::min (m_minDelay, delay);
+
+        // Every line loses the same level per second, which is the feedback per longest delay.
+        m_gains[l] = scale * static_cast<float> (std::pow (static_cast<double> (m_feedback), delay/longest));
+    }
+
+    // Each channel hears its own lines at a level that keeps the first repeats at unity power.
+    const int channels = std::min (m_numChannels, numLines);
+    for (int l = 0; l < numLines; ++l)
+    {
+        const int c = l % channels;
+        const int linesPerChannel = (numLines - c + channels - 1) / channels;
+        m_outputGains[l] = 1.0f/std::sqrt (static_cast<float> (linesPerChannel));
+    }
+}
+
+const float* FeedbackDelayNetwork::process (const float* input, const int numFrames)
+{
+    assert (numFrames <= s_blockSize && m_lines != nullptr);
+
+    const int channels = m_numChannels;
+    int done = 0;
+    while (done < numFrames)
+    {
+        // A run can't read back anything it writes, or cross the end of the lines.
+        int run = std::min (numFrames - done, m_minDelay);
+        run = std::min (run, m_length - m_writePos);
+        processRun (input + done*channels, m_output + done*channels, run);
+        done += run;
+    }
+
+    return m_output;
+}
+
+void FeedbackDelayNetwork::processRun (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    const int numLines = m_numLines;
+
+    // Read the output of every line. Each one is contiguous apart from where it wraps.
+    for (int l = 0; l < numLines; ++l)
+    {
+        const float* line = m_lines + l*m_length;
+        float* out = m_block + l*s_blockSize;
+        const int pos = (m_writePos - m_delays[l]) & m_mask;
+        const int first = std::min (numFrames, m_length - pos);
+        std::copy (line + pos, line + pos + first, out);
+        std::copy (line, line + numFrames - first, out + first);
+    }
+
+    // Each channel hears its own share of the lines.
+    std::fill (output, output + numFrames*channels, 0.0f);
+    for (int l = 0; l < numLines; ++l)
+    {
+        const float* out = m_block + l*s_blockSize;
+        const float gain = m_outputGains[l];
+        float* frame = output + (l % channels);
+        for (int i = 0; i < numFrames; ++i) { frame[i*channels] += gain * out[i]; }
+    }
+
+    // Split the input into channels, so that writing each line is a contiguous loop.
+    for (int c = 0; c < channels; ++c)
+    {
+        float* in = m_input + c*s_blockSize;
+        for (int i = 0; i < numFrames; ++i) { in[i] = input[i*channels + c]; }
+    }
+
+    // Mix the lines into each other and write them back with the input of their channel.
+    mix (numFrames);
+    for (int l = 0; l < numLines; ++l)
+    {
+        const float* mixed = m_block + l*s_blockSize;
+        const float* in = m_input + (l % channels)*s_blockSize;
+        float* write = m_lines + l*m_length + m_writePos;
+        const float gain = m_gains[l];
+        for (int i = 0; i < numFrames; ++i) { write[i] = (gain * mixed[i]) + in[i]; }
+    }
+
+    m_writePos = (m_writePos + numFrames) & m_mask;
+}
+
+void FeedbackDelayNetwork::mix (const int numFrames)
+{
+    const int numLines = m_numLines;
+
+    if (m_matrix == HADAMARD)
+    {
+        // Fast Walsh-Hadamard transform across the lines. Every butterfly is a loop over the run.
+        for (int half = 1; half < numLines; half *= 2)
+        {
+            for (int start = 0; start < numLines; start += 2*half)
+            {
+                for (int l = start; l < start + half; ++l)
+                {
+                    float* a = m_block + l*s_blockSize;
+                    float* b = a + half*s_blockSize;
+                    for (int i = 0; i < numFrames; ++i)
+                    {
+                        const float x = a[i];
+                        const float y = b[i];
+                        a[i] = x + y;
+                        b[i] = x - y;
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        // Householder reflection: subtract 2/N of the sum of all of the lines from each one.
+        std::fill (m_sum, m_sum + numFrames, 0.0f);
+        for (int l = 0; l < numLines; ++l)
+        {
+            const float* line = m_block + l*s_blockSize;
+            for (int i = 0; i < numFrames; ++i) { m_sum[i] += line[i]; }
+        }
+
+        const float scale = -2.0f/numLines;
+        for (int l = 0; l < numLines; ++l)
+        {
+            float* line = m_block + l*s_blockSize;
+            for (int i = 0; i < numFrames; ++i) { line[i] += scale * m_sum[i]; }
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * FeedbackDelayNetwork.h
+ * \brief Feedback delay network for diffuse repeats.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+/**
+ * \brief Feedback delay network for diffuse repeats.
+ *
+ * A bank of delay lines feed back into each other through an orthogonal mixing matrix, so every
+ * repeat is spread over all of the lines and the echoes thicken into a diffuse, reverb-like tail.
+ * The line lengths are spaced between half and all of the delay time, and each line's gain is
+ * set from its length so that they all decay at the same rate.
+ *
+ * The lines are stored as a structure of arrays, with each line contiguous, and frames are
+ * processed in runs no longer than the shortest line. A run never reads anything written during
+ * the same run, so reading the lines, applying the matrix and writing the lines back are each
+ * loops over the whole run that vectorize.
+ *
+ * Input and output samples are interleaved frames. The lines are shared out between the channels,
+ * and each line is fed by and heard in its own channel.
+ */
+class FeedbackDelayNetwork
+{
+public:
+
+    /**
+     * Enum for the mixing matrix.
+     */
+    enum Matrix { HADAMARD, HOUSEHOLDER };
+
+    static const int s_numMatrices = 2; ///< Number of mixing matrices.
+    static const int s_minLines = 4; ///< Fewest delay lines.
+    static const int s_maxLines = 16; ///< Most delay lines.
+    static const int s_blockSize = 64; ///< Most frames per call to process().
+    static const int s_minDelay = 2*s_blockSize; ///< Shortest length of the longest line (samples), which keeps every line at least a block long.
+
+    /**
+     * Class constructor. The network isn't usable until prepare() is called.
+     *
+     * \param[in]  int  Number of interleaved channels (at most s_maxLines)
+     */
+    explicit FeedbackDelayNetwork (const int numChannels);
+
+    /**
+     * Class destructor.
+     */
+    ~FeedbackDelayNetwork();
+
+    /**
+     * Sizes the lines for a sample rate and longest delay time, then clears them. This allocates
+     * memory, so it's never called from the audio thread.
+     *
+     * \param[in]  double  Sample frequency
+     * \param[in]  float  Longest delay time (msecs)
+     */
+    void prepare (const double fs, const float maxDelay);
+
+    void release(); ///< Frees the lines until prepare() is called again.
+    void reset(); ///< Clears the lines in use. This never allocates memory.
+
+    bool isReady() const { return m_lines != nullptr; }; ///< Indicates whether prepare() has been called since the last release().
+
+    /**
+     * Sets the number of lines and the mixing matrix. The number of lines is rounded up to a power
+     * of two (for the Hadamard matrix) with at least one line per channel, and lines that are added
+     * start out silent.
+     *
+     * \param[in]  int  Number of lines (s_minLines to s_maxLines)
+     * \param[in]  Matrix  Mixing matrix
+     */
+    void setNetwork (const int numLines, const Matrix matrix);
+
+    void setDelay (const float delay) { m_delay = delay; updateLines(); }; ///< Sets the length of the longest line (msecs, at least s_minDelay samples).
+    void setFeedback (const float feedback) { m_feedback = feedback; updateLines(); }; ///< Sets the level of each pass relative to the one before (0-1).
+
+    int getNumLines() const { return m_numLines; }; ///< Gets the number of lines in use.
+    Matrix getMatrix() const { return m_matrix; }; ///< Gets the mixing matrix.
+    float getFeedback() const { return m_feedback; }; ///< Gets the feedback parameter (0-1).
+    int getLongestDelay() const { return m_delays[0]; }; ///< Gets the length of the longest line (samples).
+
+    /**
+     * Runs frames through the network.
+     *
+     * \param[in]  float*  Input frames
+     * \param[in]  int  Number of frames (at most s_blockSize)
+     *
+     * \return  const float*  Output frames of the lines, without the input, valid until the next call
+     */
+    const float* process (const float* input, const int numFrames);
+
+private:
+
+    void updateLines(); ///< Sets the length and gain of each line from the delay and feedback.
+
+    /**
+     * Runs frames through the network, without reading anything written in the same run or
+     * crossing the end of the lines.
+     *
+     * \param[in]  float*  Input frames
+     * \param[out]  float*  Output frames
+     * \param[in]  int  Number of frames
+     */
+    void processRun (const float* input, float* output, const int numFrames);
+
+    /**
+     * Applies the mixing matrix to the line outputs in m_block.
+     *
+     * \param[in]  int  Number of frames
+     */
+    void mix (const int numFrames);
+
+    int m_numChannels; ///< Number of interleaved channels.
+    double m_sampleFreq; ///< Sample frequency.
+    int m_numLines; ///< Number of lines in use.
+    Matrix m_matrix; ///< Mixing matrix.
+    float m_delay; ///< Delay time parameter (msecs).
+    float m_feedback; ///< Feedback parameter (0-1).
+
+    float* m_lines; ///< Delay lines, one after the other (s_maxLines x m_length).
+    int m_length; ///< Length of each line (a power of two).
+    int m_mask; ///< Bit mask for wrapping positions in a line.
+    int m_writePos; ///< Write position, shared by all of the lines.
+
+    int m_delays[s_maxLines]; ///< Length of each line in use (samples, longest first).
+    float m_gains[s_maxLines]; ///< Gain of each line's feedback, including the matrix scaling.
+    int m_minDelay; ///< Length of the shortest line in use (samples).
+    float m_outputGains[s_maxLines]; ///< Gain of each line in the output of its channel.
+
+    float* m_input; ///< Input of the current run for each channel (channels x s_blockSize).
+    float* m_block; ///< Output of each line for the current run (s_maxLines x s_blockSize).
+    float* m_sum; ///< Sum of the line outputs for the Householder matrix (s_blockSize).
+    float* m_output; ///< Output frames returned by process().
+
+    FeedbackDelayNetwork (const FeedbackDelayNetwork&) = delete;
+    FeedbackDelayNetwork& operator= (const FeedbackDelayNetwork&) = delete;
+};
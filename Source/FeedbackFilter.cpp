@@ -0,0 +1,186 @@
+/**
+ * FeedbackFilter.cpp
+ * \brief Filter for the feedback loop of the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "FeedbackFilter.h"
+
+FeedbackFilter::FeedbackFilter (const int numChannels)
+    : m_numChannels (numChannels),
+      m_sampleFreq (44100),
+      m_type (OFF), m_frequency (4000), m_tilt (-6),
+      m_b0 (1), m_b1(), m_b2(), m_a1(), m_a2(),
+      m_state (new float [2*numChannels]())
+{}
+
+FeedbackFilter::~FeedbackFilter()
+{
+    delete [] m_state;
+}
+
+void FeedbackFilter::prepare (const double fs)
+{
+    m_sampleFreq = fs;
+    updateCoefficients();
+    reset();
+}
+
+void FeedbackFilter::reset()
+{
+    std::fill (m_state, m_state + 2*m_numChannels, 0.0f);
+}
+
+void FeedbackFilter::setFilter (const Type type, const float frequency, const float tilt)
+{
+    if (type == m_type && frequency == m_frequency && tilt == m_tilt) { return; }
+
+    // Start from silence when the filter is switched on, rather than from a stale state.
+    if (m_type == OFF) { reset(); }
+
+    m_type = type;
+    m_frequency = frequency;
+    m_tilt = tilt;
+    updateCoefficients();
+}
+
+void FeedbackFilter::updateCoefficients()
+{
+    const double pi = 3.14159265358979323846;
+    const double frequency = std::max (10.0, std::min (static_cast<double> (m_frequency), 0.45*m_sampleFreq));
+    const double w0 = 2*pi*frequency / m_sampleFreq;
+
+    double b0 = 1, b1 = 0, b2 = 0, a0 = 1, a1 = 0, a2 = 0;
+
+    switch (m_type)
+    {
+        case LOW_PASS:
+        case HIGH_PASS:
+        {
+            // Butterworth (Q = 0.707) sections from the Audio EQ Cookbook, which have no resonant peak.
+            const double cosw0 = std::cos (w0);
+            const double alpha = std::sin (w0) / (2*0.70710678118654752);
+            const double sign = m_type == LOW_PASS ? 1 : -1;
+            b0 = b2 = (1 - sign*cosw0) / 2;
+            b1 = sign*(1 - sign*cosw0);
+            a0 = 1 + alpha;
+            a1 = -2*cosw0;
+            a2 = 1 - alpha;
+            break;
+        }
+        case TILT:
+        {
+            // First-order shelf from the bilinear transform, with 0 dB on the side that isn't cut.
+            const double k = std::tan (w0 / 2);
+            const double g = std::pow (10.0, -std::abs (m_tilt) / 20);
+            if (m_tilt < 0)
+            {
+                b0 = g + k;
+                b1 = k - g;
+            }
+            else
+            {
+                b0 = 1 + g*k;
+                b1 = g*k - 1;
+            }
+            a0 = 1 + k;
+            a1 = k - 1;
+            break;
+        }
+        default:
+            break;
+    }
+
+    m_b0 = static_cast<float> (b0 / a0);
+    m_b1 = static_cast<float> (b1 / a0);
+    m_b2 = static_cast<float> (b2 / a0);
+    m_a1 = static_cast<float> (a1 / a0);
+    m_a2 = static_cast<float> (a2 / a0);
+}
+
+void FeedbackFilter::process (float* data, const int numFrames)
+{
+    switch (m_numChannels)
+    {
+        case 1:
+            processChannels<1> (data, numFrames);
+            break;
+        case 2:
+            processChannels<2> (data, numFrames);
+            break;
+        case 4:
+            processChannels<4> (data, numFrames);
+            break;
+        case 8:
+            processChannels<8> (data, numFrames);
+            break;
+        default:
+        {
+            for (int i = 0; i < numFrames; ++i)
+            {
+                float* frame = data + i*m_numChannels;
+                for (int c = 0; c < m_numChannels; ++c)
+                {
+                    const float x = frame[c];
+                    const float y = (m_b0 * x) + m_state[2*c];
+                    m_state[2*c] = (m_b1 * x) - (m_a1 * y) + m_state[2*c + 1];
+                    m_state[2*c + 1] = (m_b2 * x) - (m_a2 * y);
+                    frame[c] = y;
+                }
+            }
+            break;
+        }
+    }
+}
+
+template <int numChannels>
+void FeedbackFilter::processChannels (float* data, const int numFrames)
+{
+    const float b0 = m_b0, b1 = m_b1, b2 = m_b2, a1 = m_a1, a2 = m_a2;
+
+    float s1[numChannels];
+    float s2[numChannels];
+    for (int c = 0; c < numChannels; ++c)
+    {
+        s1[c] = m_state[2*c];
+        s2[c] = m_state[2*c + 1];
+    }
+
+    // The channels are independent, so the compiler can run them side by side.
+    for (int i = 0; i < numFrames; ++i)
+    {
+        float* frame = data + i*numChannels;
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const float x = frame[c];
+            const float y = (b0 * x) + s1[c];
+            s1[c] = (b1 * x) - (a1 * y) + s2[c];
+            s2[c] = (b2 * x) - (a2 * y);
+            frame[c] = y;
+        }
+    }
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        m_state[2*c] = s1[c];
+        m_state[2*c + 1] = s2[c];
+    }
+}
+
+const char* FeedbackFilter::getName (const Type type)
+{
+    switch (type)
+    {
+        case LOW_PASS:
+            return "Low Pass";
+        case HIGH_PASS:
+            return "High Pass";
+        case TILT:
+            return "Tilt";
+        default:
+            return "Off";
+    }
+}
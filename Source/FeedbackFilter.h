@@ -0,0 +1,96 @@
+/**
+ * FeedbackFilter.h
+ * \brief Filter for the feedback loop of the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+/**
+ * \brief Filter for the feedback loop of the delay line.
+ *
+ * A biquad that filters the signal written into the delay buffer, so each repeat is darker or
+ * thinner than the one before it, like the filtering in an analog delay. The filter runs over
+ * whole blocks of interleaved frames with the state of each channel kept in registers. The gain
+ * never goes above 0 dB at any frequency, so the filter can't make the feedback loop unstable.
+ */
+class FeedbackFilter
+{
+public:
+
+    /**
+     * Enum for the filter types. TILT cuts either the highs or the lows with a first-order shelf.
+     */
+    enum Type { OFF, LOW_PASS, HIGH_PASS, TILT };
+
+    static const int s_numTypes = 4; ///< Number of filter types.
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  int  Number of interleaved channels
+     */
+    FeedbackFilter (const int numChannels = 1);
+
+    /**
+     * Class destructor.
+     */
+    ~FeedbackFilter();
+
+    /**
+     * Sets the sample rate, recalculates the coefficients and resets the filter.
+     *
+     * \param[in]  double  Sample frequency
+     */
+    void prepare (const double fs);
+
+    /**
+     * Clears the filter state.
+     */
+    void reset();
+
+    /**
+     * Sets the filter parameters. The state is kept, so the filter can be changed while it runs.
+     *
+     * \param[in]  Type  Filter type
+     * \param[in]  float  Cutoff frequency, or the pivot frequency for TILT (Hz)
+     * \param[in]  float  Tilt (dB), negative to cut the highs and positive to cut the lows (TILT only)
+     */
+    void setFilter (const Type type, const float frequency, const float tilt);
+
+    /**
+     * Filters a block of interleaved frames in place.
+     *
+     * \param[in,out]  float*  Data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void process (float* data, const int numFrames);
+
+    bool isActive() const { return m_type != OFF; }; ///< Indicates whether the filter does anything.
+    Type getType() const { return m_type; }; ///< Gets the filter type.
+
+    static const char* getName (const Type type); ///< Gets the name of a filter type.
+
+private:
+
+    /**
+     * Filters a block with a fixed number of channels so the state stays in registers.
+     *
+     * \param[in,out]  float*  Data samples
+     * \param[in]  int  Number of sample frames
+     */
+    template <int numChannels>
+    void processChannels (float* data, const int numFrames);
+
+    void updateCoefficients(); ///< Calculates the coefficients from the filter parameters.
+
+    int m_numChannels; ///< Number of interleaved channels.
+    double m_sampleFreq; ///< Audio sample rate.
+    Type m_type; ///< Filter type.
+    float m_frequency; ///< Cutoff or pivot frequency (Hz).
+    float m_tilt; ///< Tilt (dB).
+
+    float m_b0, m_b1, m_b2; ///< Feedforward coefficients.
+    float m_a1, m_a2; ///< Feedback coefficients (normalised so a0 = 1).
+    float* m_state; ///< Transposed direct form II state, two values per channel.
+};
@@ -0,0 +1,115 @@
+/**
+ * Interpolators.cpp
+ * \brief Fractional delay interpolation policies for the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <cmath>
+
+#include "Interpolators.h"
+
+/**
+ * Coefficient table for one interpolation type, calculated on construction.
+ */
+template <int numTaps>
+struct CoefficientTable
+{
+    /**
+     * Fills the table from a function that calculates the coefficients for a fractional delay.
+     */
+    template <typename Function>
+    CoefficientTable (Function calculate)
+    {
+        for (int row = 0; row <= Interpolators::s_tableSize; ++row)
+        {
+            double coeffs[numTaps];
+            calculate (static_cast<double> (row) / Interpolators::s_tableSize, coeffs);
+            for (int k = 0; k < numTaps; ++k) { data[row*numTaps + k] = static_cast<float> (coeffs[k]); }
+        }
+    }
+
+    float data[(Interpolators::s_tableSize + 1)*numTaps]; ///< Coefficients, one row per fractional delay step.
+};
+
+static const double s_pi = 3.14159265358979323846;
+
+void Interpolators::initialise()
+{
+    getCubicTable();
+    getLagrangeTable();
+    getAllpassTable();
+    getSincTable();
+}
+
+const char* Interpolators::getName (const Type type)
+{
+    switch (type)
+    {
+        case CUBIC:
+            return "Cubic";
+        case LAGRANGE:
+            return "Lagrange";
+        case ALLPASS:
+            return "Allpass";
+        case SINC:
+            return "Sinc";
+        default:
+            return "Linear";
+    }
+}
+
+const float* Interpolators::getCubicTable()
+{
+    static const CoefficientTable<4> table ([] (const double f, double* c)
+    {
+        c[0] = (-0.5 * f) + (f * f) - (0.5 * f * f * f);
+        c[1] = 1.0 - (2.5 * f * f) + (1.5 * f * f * f);
+        c[2] = (0.5 * f) + (2.0 * f * f) - (1.5 * f * f * f);
+        c[3] = (-0.5 * f * f) + (0.5 * f * f * f);
+    });
+    return table.data;
+}
+
+const float* Interpolators::getLagrangeTable()
+{
+    static const CoefficientTable<4> table ([] (const double f, double* c)
+    {
+        c[0] = -f * (f - 1) * (f - 2) / 6;
+        c[1] = (f + 1) * (f - 1) * (f - 2) / 2;
+        c[2] = -(f + 1) * f * (f - 2) / 2;
+        c[3] = (f + 1) * f * (f - 1) / 6;
+    });
+    return table.data;
+}
+
+const float* Interpolators::getAllpassTable()
+{
+    // The table covers fractional delays from 0.5 to 1.5 samples.
+    static const CoefficientTable<1> table ([] (const double f, double* c)
+    {
+        const double delay = f + 0.5;
+        c[0] = (1 - delay) / (1 + delay);
+    });
+    return table.data;
+}
+
+const float* Interpolators::getSincTable()
+{
+    static const CoefficientTable<8> table ([] (const double f, double* c)
+    {
+        double sum = 0;
+        for (int k = 0; k < 8; ++k)
+        {
+            // Distance of the tap from the interpolated position, windowed over +/-4 samples.
+            const double t = (k - 3) - f;
+            const double sinc = std::abs (t) < 1e-9 ? 1.0 : std::sin (s_pi * t) / (s_pi * t);
+            const double window = 0.42 + (0.5 * std::cos (s_pi * t / 4)) + (0.08 * std::cos (2 * s_pi * t / 4));
+            c[k] = sinc * window;
+            sum += c[k];
+        }
+
+        // Normalise for unity gain at DC.
+        for (int k = 0; k < 8; ++k) { c[k] /= sum; }
+    });
+    return table.data;
+}
@@ -0,0 +1,142 @@
+/**
+ * Interpolators.h
+ * \brief Fractional delay interpolation policies for the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+/**
+ * \brief Fractional delay interpolation policies for the delay line.
+ *
+ * Each policy reads s_numTaps consecutive delayed samples, starting s_firstTap samples from the
+ * whole part of the delay (negative values are newer samples), and weights them with coefficients
+ * for the fractional part of the delay. Apart from linear interpolation, the coefficients are read
+ * from tables that are calculated once, with linear interpolation between table rows. The allpass
+ * policy is recursive and feeds its previous output back with the first coefficient.
+ *
+ * The delay line is instantiated with one of these policies at a time, so the cheaper policies
+ * don't pay for the features of the more expensive ones.
+ */
+class Interpolators
+{
+public:
+
+    /**
+     * Enum for the available interpolation types, from cheapest to highest quality.
+     */
+    enum Type { LINEAR, CUBIC, LAGRANGE, ALLPASS, SINC };
+
+    static const int s_numTypes = 5; ///< Number of interpolation types.
+    static const int s_tableSize = 1024; ///< Number of fractional delay steps in the coefficient tables.
+
+    /**
+     * Calculates all of the coefficient tables. This is done from the DelayLine constructor so the
+     * audio thread never has to.
+     */
+    static void initialise();
+
+    static const char* getName (const Type type); ///< Gets the name of an interpolation type.
+
+    /**
+     * Interpolates the coefficients for a fractional position in a table.
+     *
+     * \param[in]  float*  Coefficient table with s_tableSize + 1 rows
+     * \param[in]  int  Number of coefficients per row
+     * \param[in]  float  Position in the table (0-1)
+     * \param[out]  float*  Coefficients
+     */
+    static void lookup (const float* table, const int numTaps, const float position, float* coeffs)
+    {
+        const float row = position * s_tableSize;
+        const int index = static_cast<int> (row);
+        const float t = row - index;
+        const float* row0 = table + index*numTaps;
+        const float* row1 = row0 + numTaps;
+        for (int k = 0; k < numTaps; ++k) { coeffs[k] = row0[k] + (t * (row1[k] - row0[k])); }
+    };
+
+    static const float* getCubicTable(); ///< Gets the 4-point cubic Hermite coefficient table.
+    static const float* getLagrangeTable(); ///< Gets the 3rd-order Lagrange coefficient table.
+    static const float* getAllpassTable(); ///< Gets the first-order allpass coefficient table.
+    static const float* getSincTable(); ///< Gets the 8-point windowed sinc coefficient table.
+};
+
+/**
+ * Linear interpolation between two samples, as used by the run kernels.
+ */
+struct LinearInterpolator
+{
+    static const int s_numTaps = 2;
+    static const int s_firstTap = 0;
+    static const bool s_recursive = false;
+    static float getMinDelay() { return 0.0f; };
+
+    static void split (const float delay, int& whole, float& fraction) { whole = static_cast<int> (delay); fraction = delay - whole; };
+    static void getCoefficients (const float fraction, float* coeffs) { coeffs[0] = 1.0f - fraction; coeffs[1] = fraction; };
+};
+
+/**
+ * 4-point cubic Hermite (Catmull-Rom) interpolation.
+ */
+struct CubicInterpolator
+{
+    static const int s_numTaps = 4;
+    static const int s_firstTap = -1;
+    static const bool s_recursive = false;
+    static float getMinDelay() { return 2.0f; };
+
+    static void split (const float delay, int& whole, float& fraction) { whole = static_cast<int> (delay); fraction = delay - whole; };
+    static void getCoefficients (const float fraction, float* coeffs) { Interpolators::lookup (Interpolators::getCubicTable(), s_numTaps, fraction, coeffs); };
+};
+
+/**
+ * 3rd-order Lagrange interpolation.
+ */
+struct LagrangeInterpolator
+{
+    static const int s_numTaps = 4;
+    static const int s_firstTap = -1;
+    static const bool s_recursive = false;
+    static float getMinDelay() { return 2.0f; };
+
+    static void split (const float delay, int& whole, float& fraction) { whole = static_cast<int> (delay); fraction = delay - whole; };
+    static void getCoefficients (const float fraction, float* coeffs) { Interpolators::lookup (Interpolators::getLagrangeTable(), s_numTaps, fraction, coeffs); };
+};
+
+/**
+ * First-order allpass interpolation. The fractional part is kept between 0.5 and 1.5 samples,
+ * where the allpass has a flat group delay and no pole near the Nyquist frequency.
+ */
+struct AllpassInterpolator
+{
+    static const int s_numTaps = 2;
+    static const int s_firstTap = 0;
+    static const bool s_recursive = true;
+    static float getMinDelay() { return 1.5f; };
+
+    static void split (const float delay, int& whole, float& fraction)
+    {
+        whole = static_cast<int> (delay - 0.5f);
+        fraction = delay - whole;
+    };
+    static void getCoefficients (const float fraction, float* coeffs)
+    {
+        Interpolators::lookup (Interpolators::getAllpassTable(), 1, fraction - 0.5f, coeffs);
+        coeffs[1] = 1.0f;
+    };
+};
+
+/**
+ * 8-point Blackman-windowed sinc interpolation.
+ */
+struct SincInterpolator
+{
+    static const int s_numTaps = 8;
+    static const int s_firstTap = -3;
+    static const bool s_recursive = false;
+    static float getMinDelay() { return 4.0f; };
+
+    static void split (const float delay, int& whole, float& fraction) { whole = static_cast<int> (delay); fraction = delay - whole; };
+    static void getCoefficients (const float fraction, float* coeffs) { Interpolators::lookup (Interpolators::getSincTable(), s_numTaps, fraction, coeffs); };
+};
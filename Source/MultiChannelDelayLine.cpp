@@ -0,0 +1,144 @@
+/**
+ * MultiChannelDelayLine.cpp
+ * \brief Multichannel delay line processor class.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <limits>
+
+#include "MultiChannelDelayLine.h"
+
+MultiChannelDelayLine::MultiChannelDelayLine (const int numChannels, const int fs, const float delay, const float feedback, const float mix)
+    : DelayLine (fs, delay, feedback, mix, std::max (1, std::min (numChannels, s_maxChannels))),
+      m_convolver (getNumChannels()),
+      m_convolution(),
+      m_network (getNumChannels()),
+      m_diffusion(),
+      m_quietFrames()
+{
+    m_network.setDelay (delay);
+    m_network.setFeedback (feedback/100);
+}
+
+void MultiChannelDelayLine::setConvolution (const bool convolution)
+{
+    // Start from a clean history, so nothing is left over from the last time the mode was on.
+    if (convolution && ! m_convolution)
+    {
+        m_convolver.reset();
+        m_quietFrames = 0;
+    }
+    m_convolution = convolution;
+}
+
+void MultiChannelDelayLine::setDiffusion (const int numLines, const FeedbackDelayNetwork::Matrix matrix)
+{
+    const bool diffusion = numLines > 0;
+    if (diffusion) { m_network.setNetwork (numLines, matrix); }
+
+    // Start from silent lines, so nothing is left over from the last time the mode was on.
+    if (diffusion && ! m_diffusion)
+    {
+        m_network.reset();
+        m_quietFrames = 0;
+    }
+    m_diffusion = diffusion;
+}
+
+void MultiChannelDelayLine::processBlock (float* const* channels, const int startSample, const int numSamples)
+{
+    // The input is already in place, so bypassing takes no work at all.
+    if (isBypassed()) { return; }
+
+    const int numChannels = getNumChannels();
+
+    float inputPeak = 0;
+    for (int c = 0; c < numChannels; ++c) { inputPeak = std::max (inputPeak, DelayKernels::getPeak (channels[c] + startSample, numSamples)); }
+
+    if (isConvolution() || isDiffusion())
+    {
+        processWet (channels, startSample, numSamples, inputPeak);
+        return;
+    }
+    if (trySleep (inputPeak)) { return; }
+
+    // A single channel is already a run of frames.
+    if (numChannels == 1)
+    {
+        processActive (channels[0] + startSample, channels[0] + startSample, numSamples, inputPeak);
+        return;
+    }
+
+    float frames[s_maxChannels*s_chunkFrames];
+
+    for (int start = startSample; start < startSample + numSamples; start += s_chunkFrames)
+    {
+        const int num = std::min (startSample + numSamples - start, s_chunkFrames);
+
+        // Interleave the channels, process all of them in one pass and split them up again.
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const float* channel = channels[c] + start;
+            for (int i = 0; i < num; ++i) { frames[i*numChannels + c] = channel[i]; }
+        }
+
+        processActive (frames, frames, num, inputPeak);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            float* channel = channels[c] + start;
+            for (int i = 0; i < num; ++i) { channel[i] = frames[i*numChannels + c]; }
+        }
+    }
+}
+
+void MultiChannelDelayLine::processWet (float* const* channels, const int startSample, const int numSamples, const float inputPeak)
+{
+    const int numChannels = getNumChannels();
+    const bool convolution = isConvolution();
+    const int length = getWetLength();
+
+    // Waking up starts from a clean history, as the frames skipped while asleep weren't recorded.
+    const bool asleep = m_quietFrames >= length;
+    m_quietFrames = (inputPeak >= s_silenceLevel) ? 0 : std::min (m_quietFrames + numSamples, length);
+    if (m_quietFrames >= length) { return; }
+    if (asleep)
+    {
+        if (convolution) { m_convolver.reset(); }
+        else { m_network.reset(); }
+    }
+
+    float frames[s_maxChannels*s_chunkFrames];
+    float mix[s_chunkFrames];
+
+    for (int start = startSample; start < startSample + numSamples; start += s_chunkFrames)
+    {
+        const int num = std::min (startSample + numSamples - start, s_chunkFrames);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const float* channel = channels[c] + start;
+            for (int i = 0; i < num; ++i) { frames[i*numChannels + c] = channel[i]; }
+        }
+
+        const float* wet = convolution ? m_convolver.process (frames, num) : m_network.process (frames, num);
+        write (frames, num, inputPeak);
+        getMixRamp (mix, num);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            float* channel = channels[c] + start;
+            for (int i = 0; i < num; ++i) { channel[i] = (mix[i] * wet[i*numChannels + c]) + ((1.0f - mix[i]) * channel[i]); }
+        }
+    }
+}
+
+int MultiChannelDelayLine::getWetLength() const
+{
+    if (isConvolution()) { return m_convolver.getLength(); }
+
+    // The tail time is proportional to the delay, so it can be worked out in samples. An endless
+    // tail is capped well short of overflowing the count of quiet frames.
+    const double tail = getTailTime (static_cast<float> (m_network.getLongestDelay()), m_network.getFeedback());
+    return static_cast<int> (std::min<double> (tail, std::numeric_limits<int>::max()/2));
+}
@@ -0,0 +1,164 @@
+/**
+ * MultiChannelDelayLine.h
+ * \brief Multichannel delay line processor class.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include "DelayLine.h"
+#include "FeedbackDelayNetwork.h"
+#include "PartitionedConvolver.h"
+
+/**
+ * \brief Multichannel delay line processor class.
+ *
+ * This class runs a bank of delays for any channel layout from mono up to s_maxChannels channels,
+ * such as 5.1, 7.1.4 or third-order ambisonics. The channels are stored as interleaved frames in a
+ * single buffer with one set of read/write positions, so each frame of 4 or 8 channels is one
+ * group of SIMD lanes and every channel is processed in the same pass.
+ *
+ * It also has a convolution mode, which replaces the delay with a PartitionedConvolver for echoes
+ * from an impulse response, and a diffusion mode, which replaces it with a FeedbackDelayNetwork.
+ * These run alongside the delay line in the processBlock() that takes channel arrays, rather than
+ * inside it, and only the input is written into the delay buffer meanwhile.
+ */
+class MultiChannelDelayLine : public DelayLine
+{
+public:
+
+    static const int s_maxChannels = 16; ///< Maximum number of channels (third-order ambisonics).
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  int  Number of channels (1 to s_maxChannels)
+     * \param[in]  int  Sample frequency
+     * \param[in]  float  Delay time (msecs)
+     * \param[in]  float  Feedback (%)
+     * \param[in]  float  Mix (%)
+     */
+    MultiChannelDelayLine (const int numChannels, const int fs = 44100, const float delay = 0, const float feedback = 0, const float mix = 0.5);
+
+    using DelayLine::processBlock;
+
+    void setDelay (const float delay) { DelayLine::setDelay (delay); m_network.setDelay (delay); }; ///< Sets the delay parameter of the delay line and the diffusion network.
+    void setFeedback (const float feedback) { DelayLine::setFeedback (feedback); m_network.setFeedback (feedback/100); }; ///< Sets the feedback parameter of the delay line and the diffusion network (%).
+
+    /**
+     * Calculates the delayed values of a block of samples in place, with one array per channel.
+     * While the delay line is bypassed or asleep, the channels are left as they are without
+     * interleaving them, and a single channel is processed where it is.
+     *
+     * \param[in,out]  float**  Channel samples (getNumChannels() arrays)
+     * \param[in]  int  Index of the first sample to process in each array
+     * \param[in]  int  Number of samples
+     */
+    void processBlock (float* const* channels, const int startSample, const int numSamples);
+
+    /**
+     * Sets the impulse response for the convolution mode. This allocates memory and registers the
+     * convolver's background task, so it should be called from AudioProcessor::prepareToPlay() or
+     * with processing suspended, and never from the audio thread.
+     *
+     * \param[in]  float**  Impulse response channels
+     * \param[in]  int  Number of impulse response channels (repeated over the channels if fewer)
+     * \param[in]  int  Impulse response length (samples)
+     *
+     * \return  bool  True if the convolution mode is available
+     */
+    bool setImpulseResponse (const float* const* response, const int numResponseChannels, const int length)
+    {
+        return m_convolver.setResponse (response, numResponseChannels, length);
+    };
+
+    /**
+     * Switches the convolution mode on or off. It only takes effect once setImpulseResponse() has succeeded.
+     *
+     * In the convolution mode, the input is convolved with the impulse response without any
+     * latency, and the mix parameter blends it with the input. The delay, feedback, modulation,
+     * taps, stereo routing, feedback filter, drive, long delay and freeze don't apply. The input is
+     * still written into the delay buffer, so switching back picks up the recent audio.
+     *
+     * \param[in]  bool  Convolution mode
+     */
+    void setConvolution (const bool convolution);
+
+    bool isConvolution() const { return m_convolution && m_convolver.isReady(); }; ///< Indicates whether the convolution mode is on.
+    bool isConvolutionReady() const { return m_convolver.isReady(); }; ///< Indicates whether an impulse response is set for the convolution mode.
+
+    /**
+     * Frees the impulse response and unregisters the convolver's background task. The convolution
+     * mode is unavailable until setImpulseResponse() is called again, so this is never called from
+     * the audio thread.
+     */
+    void releaseConvolution() { m_convolver.release(); };
+
+    /**
+     * Prepares the diffusion mode for delays of up to maxDelay. This allocates memory, so it should
+     * be called from AudioProcessor::prepareToPlay() after prepare() or with processing suspended,
+     * and never from the audio thread.
+     *
+     * \param[in]  float  Longest delay time (msecs)
+     */
+    void prepareDiffusion (const float maxDelay) { m_network.prepare (getSampleRate(), maxDelay); };
+
+    /**
+     * Sets the number of lines for the diffusion mode. A number of lines switches to the diffusion
+     * mode if prepareDiffusion() has been called, and zero switches it back.
+     *
+     * In the diffusion mode, the input feeds a feedback delay network whose longest line is the
+     * delay time, and the feedback sets how much each pass through the network loses. The mix
+     * parameter blends the network with the input. The modulation, taps, stereo routing, feedback
+     * filter, drive, long delay and freeze don't apply, and changes to the delay time jump instead
+     * of gliding. The convolution mode takes precedence when both are on.
+     *
+     * \param[in]  int  Number of lines (0 to switch the diffusion mode off, or
+     *                   FeedbackDelayNetwork::s_minLines to FeedbackDelayNetwork::s_maxLines)
+     * \param[in]  FeedbackDelayNetwork::Matrix  Mixing matrix
+     */
+    void setDiffusion (const int numLines, const FeedbackDelayNetwork::Matrix matrix);
+
+    bool isDiffusion() const { return m_diffusion && m_network.isReady(); }; ///< Indicates whether the diffusion mode is on.
+    bool isDiffusionReady() const { return m_network.isReady(); }; ///< Indicates whether prepareDiffusion() has been called since the last releaseDiffusion().
+
+    /**
+     * Frees the lines of the diffusion mode. The mode is unavailable until prepareDiffusion() is
+     * called again, so this is never called from the audio thread.
+     */
+    void releaseDiffusion() { m_network.release(); };
+
+    /**
+     * Gets the number of times long delay audio was lost or read late, or a block of the
+     * convolution tail was left out.
+     */
+    int getNumDropouts() const { return DelayLine::getNumDropouts() + m_convolver.getNumDropouts(); };
+
+private:
+
+    /**
+     * Processes a block in the convolution or diffusion mode. Once the input has been quiet for
+     * longer than the tail (see getWetLength()), nothing is left to come out, so the channels are
+     * left as they are.
+     *
+     * \param[in,out]  float**  Channel samples (getNumChannels() arrays)
+     * \param[in]  int  Index of the first sample to process in each array
+     * \param[in]  int  Number of samples
+     * \param[in]  float  Peak absolute value of the input block
+     */
+    void processWet (float* const* channels, const int startSample, const int numSamples, const float inputPeak);
+
+    /**
+     * Gets the number of quiet frames after which nothing audible is left to come out of the
+     * convolution or diffusion mode: the impulse response, or the decay of the network.
+     */
+    int getWetLength() const;
+
+    static const int s_chunkFrames = 64; ///< Number of frames interleaved at a time.
+
+    PartitionedConvolver m_convolver; ///< Convolver for the convolution mode.
+    bool m_convolution; ///< Convolution mode parameter (true = convolve once an impulse response is set).
+    FeedbackDelayNetwork m_network; ///< Feedback delay network for the diffusion mode.
+    bool m_diffusion; ///< Diffusion mode parameter (true = diffuse once the network is prepared).
+    int m_quietFrames; ///< Number of frames since the input was last above the silence level in the convolution or diffusion mode.
+};
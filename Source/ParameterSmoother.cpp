@@ -0,0 +1,87 @@
+/**
+ * ParameterSmoother.cpp
+ * \brief Parameter ramp class for smoothing parameter changes.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "ParameterSmoother.h"
+
+ParameterSmoother::ParameterSmoother (const float value)
+    : m_type (LINEAR), m_rampTime(), m_rampSamples(),
+      m_value (value), m_target (value),
+      m_start(), m_step(), m_remaining(), m_coeff (1.0f),
+      m_smoothing (false)
+{}
+
+void ParameterSmoother::setRamp (const Type type, const float rampTime)
+{
+    m_type = type;
+    m_rampTime = rampTime;
+}
+
+void ParameterSmoother::prepare (const double fs)
+{
+    m_rampSamples = static_cast<int> (fs*1e-3*m_rampTime);
+
+    // The one-pole ramp decays by a factor of 1000 (ln(1000) = 6.9) over the ramp time.
+    m_coeff = m_rampSamples > 0 ? static_cast<float> (1.0 - std::exp (-6.9 / m_rampSamples)) : 1.0f;
+
+    setValue (m_target);
+}
+
+void ParameterSmoother::setTarget (const float target)
+{
+    m_target = target;
+
+    if (m_rampSamples == 0 || target == m_value)
+    {
+        setValue (target);
+        return;
+    }
+
+    m_start = m_value;
+    m_step = (m_target - m_value) / m_rampSamples;
+    m_remaining = m_rampSamples;
+    m_smoothing = true;
+}
+
+void ParameterSmoother::setValue (const float value)
+{
+    m_value = m_target = value;
+    m_remaining = 0;
+    m_smoothing = false;
+}
+
+void ParameterSmoother::process (float* values, const int numSamples)
+{
+    int i = 0;
+
+    if (m_smoothing && numSamples > 0)
+    {
+        if (m_type == LINEAR)
+        {
+            // Calculate each value from the start of the ramp so the result doesn't depend on the block size.
+            const int num = std::min (numSamples, m_remaining);
+            const int offset = m_rampSamples - m_remaining + 1;
+            for (; i < num; ++i) { values[i] = m_start + (m_step * (offset + i)); }
+
+            m_value = values[num - 1];
+            if ((m_remaining -= num) == 0) { setValue (m_target); }
+        }
+        else
+        {
+            float value = m_value;
+            for (; i < numSamples; ++i) { values[i] = (value += m_coeff * (m_target - value)); }
+
+            // End the ramp once the value is within the smallest step that still matters.
+            m_value = value;
+            if (std::abs (m_target - m_value) <= 1e-5f * (1.0f + std::abs (m_target))) { setValue (m_target); }
+        }
+    }
+
+    // Fill the rest of the block with the target value.
+    for (; i < numSamples; ++i) { values[i] = m_value; }
+}
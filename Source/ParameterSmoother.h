@@ -0,0 +1,91 @@
+/**
+ * ParameterSmoother.h
+ * \brief Parameter ramp class for smoothing parameter changes.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+/**
+ * \brief Parameter ramp class for smoothing parameter changes.
+ *
+ * This class ramps a parameter from its current value to a new target value over a set time,
+ * either linearly or with a one-pole low-pass filter, to avoid zipper noise and clicks. When the
+ * value has reached its target, isSmoothing() returns false so callers can skip the ramp entirely.
+ */
+class ParameterSmoother
+{
+public:
+
+    /**
+     * Enum for the ramp types.
+     */
+    enum Type { LINEAR, ONE_POLE };
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  float  Initial value
+     */
+    ParameterSmoother (const float value = 0);
+
+    /**
+     * Class destructor.
+     */
+    ~ParameterSmoother() = default;
+
+    /**
+     * Sets the ramp type and length. A ramp time of zero makes new targets take effect immediately.
+     * For the one-pole ramp, the value is within 0.1% of the target after the ramp time.
+     *
+     * \param[in]  Type  Ramp type
+     * \param[in]  float  Ramp time (msecs)
+     */
+    void setRamp (const Type type, const float rampTime);
+
+    /**
+     * Sets the sample rate used to convert the ramp time to samples.
+     *
+     * \param[in]  double  Sample frequency
+     */
+    void prepare (const double fs);
+
+    /**
+     * Starts a ramp from the current value to a new target value.
+     *
+     * \param[in]  float  Target value
+     */
+    void setTarget (const float target);
+
+    /**
+     * Sets the value immediately, ending any ramp.
+     *
+     * \param[in]  float  New value
+     */
+    void setValue (const float value);
+
+    /**
+     * Calculates the ramp values for the next block of samples. The ramp ends at the target value.
+     *
+     * \param[out]  float*  Ramp values
+     * \param[in]  int  Number of samples
+     */
+    void process (float* values, const int numSamples);
+
+    bool isSmoothing() const { return m_smoothing; }; ///< Indicates whether a ramp is in progress.
+    float getValue() const { return m_value; }; ///< Gets the current value.
+    float getTarget() const { return m_target; }; ///< Gets the target value.
+
+private:
+
+    Type m_type; ///< Ramp type.
+    float m_rampTime; ///< Ramp time (msecs).
+    int m_rampSamples; ///< Ramp time (samples).
+    float m_value; ///< Current value.
+    float m_target; ///< Target value.
+    float m_start; ///< Value at the start of the linear ramp.
+    float m_step; ///< Linear ramp increment per sample.
+    int m_remaining; ///< Number of samples left in the linear ramp.
+    float m_coeff; ///< One-pole ramp coefficient.
+    bool m_smoothing; ///< True while a ramp is in progress.
+};
@@ -0,0 +1,407 @@
+/**
+ * PartitionedConvolver.cpp
+ * \brief Zero latency convolution with long impulse responses.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "PartitionedConvolver.h"
+
+PartitionedConvolver::PartitionedConvolver (const int numChannels)
+    : m_numChannels (numChannels), m_numResponseChannels(), m_length(),
+      m_fft (2*s_blockSize), m_tailFFT (2*s_tailSize),
+      m_headLength(), m_head (nullptr), m_history (nullptr), m_blockOutput (nullptr), m_output (nullptr), m_blockPos(),
+      m_numPartitions(), m_partitions (nullptr), m_spectra (nullptr), m_spectrumIndex(), m_sum (nullptr), m_block (nullptr),
+      m_numTailPartitions(), m_tailPartitions (nullptr), m_tailSpectra (nullptr), m_tailSpectrumIndex(),
+      m_tailPrevious (nullptr), m_tailSum (nullptr), m_tailBlock (nullptr),
+      m_tailInput (nullptr), m_tailSlots (nullptr), m_tailResults (nullptr),
+      m_tailPos(), m_tailBlockIndex(), m_firstTailBlock(), m_tailOutput (nullptr),
+      m_submitted(), m_claimed(), m_completed(), m_clearBlock(), m_dropouts(), m_lateBlocks(),
+      m_thread()
+{
+}
+
+PartitionedConvolver::~PartitionedConvolver()
+{
+    release();
+}
+
+bool PartitionedConvolver::setResponse (const float* const* response, const int numResponseChannels, const int length)
+{
+    release();
+    if (numResponseChannels <= 0 || length <= 0) { return false; }
+
+    const int channels = m_numChannels;
+    const int spectrumSize = m_fft.getSize() + 2;
+    const int tailSpectrumSize = m_tailFFT.getSize() + 2;
+
+    // The tail starts two tail blocks in, so that each tail block has a whole block of time to be
+    // convolved before its output is needed. The audio thread partitions cover the gap after the head.
+    const int tailStart = 2*s_tailSize;
+    const int directEnd = std::min (length, tailStart);
+    m_numResponseChannels = numResponseChannels;
+    m_headLength = std::min (length, s_blockSize);
+    m_numPartitions = (directEnd > s_blockSize) ? (directEnd - s_blockSize + s_blockSize - 1) / s_blockSize : 0;
+    m_numTailPartitions = (length > tailStart) ? (length - tailStart + s_tailSize - 1) / s_tailSize : 0;
+
+    // The head is reversed so the FIR filter reads the history forwards.
+    m_head = new float [numResponseChannels*s_blockSize]();
+    for (int r = 0; r < numResponseChannels; ++r)
+    {
+        for (int k = 0; k < m_headLength; ++k) { m_head[r*s_blockSize + s_blockSize - 1 - k] = response[r][k]; }
+    }
+
+    m_history = new float [channels*2*s_blockSize];
+    m_blockOutput = new float [channels*s_blockSize];
+    m_output = new float [channels*s_blockSize];
+    m_sum = new float [spectrumSize];
+    m_block = new float [2*s_blockSize];
+
+    // Each partition is zero padded to the transform size, and scaled to undo the transforms.
+    m_partitions = new float [numResponseChannels*m_numPartitions*spectrumSize];
+    m_spectra = new float [channels*m_numPartitions*spectrumSize];
+    for (int r = 0; r < numResponseChannels; ++r)
+    {
+        for (int j = 0; j < m_numPartitions; ++j)
+        {
+            const int start = s_blockSize*(j + 1);
+            const int end = std::min (start + s_blockSize, directEnd);
+            std::fill (m_block, m_block + 2*s_blockSize, 0.0f);
+            for (int k = start; k < end; ++k) { m_block[k - start] = response[r][k] / m_fft.getSize(); }
+            m_fft.forward (m_block, m_partitions + (r*m_numPartitions + j)*spectrumSize);
+        }
+    }
+
+    if (m_numTailPartitions > 0)
+    {
+        const int tailBlockSize = channels*s_tailSize;
+        m_tailPartitions = new float [numResponseChannels*m_numTailPartitions*tailSpectrumSize];
+        m_tailSpectra = new float [channels*m_numTailPartitions*tailSpectrumSize];
+        m_tailPrevious = new float [tailBlockSize];
+        m_tailSum = new float [tailSpectrumSize];
+        m_tailBlock = new float [2*s_tailSize];
+        m_tailInput = new float [tailBlockSize];
+        m_tailSlots = new float [s_tailSlots*tailBlockSize];
+        m_tailResults = new float [s_tailSlots*tailBlockSize];
+
+        for (int r = 0; r < numResponseChannels; ++r)
+        {
+            for (int j = 0; j < m_numTailPartitions; ++j)
+            {
+                const int start = tailStart + s_tailSize*j;
+                const int end = std::min (start + s_tailSize, length);
+                std::fill (m_tailBlock, m_tailBlock + 2*s_tailSize, 0.0f);
+                for (int k = start; k < end; ++k) { m_tailBlock[k - start] = response[r][k] / m_tailFFT.getSize(); }
+                m_tailFFT.forward (m_tailBlock, m_tailPartitions + (r*m_numTailPartitions + j)*tailSpectrumSize);
+            }
+        }
+    }
+
+    m_length = length;
+    m_tailBlockIndex = 0;
+    m_submitted = 0;
+    m_claimed = 0;
+    m_completed = 0;
+    m_dropouts = 0;
+    m_lateBlocks = 0;
+    reset();
+
+    if (m_numTailPartitions > 0)
+    {
+        m_thread = BackgroundThread::getShared();
+        m_thread->add (&PartitionedConvolver::runTask, this);
+    }
+    return true;
+}
+
+void PartitionedConvolver::release()
+{
+    if (m_thread != nullptr)
+    {
+        m_thread->remove (this);
+        m_thread = nullptr;
+    }
+
+    delete [] m_head;
+    delete [] m_history;
+    delete [] m_blockOutput;
+    delete [] m_output;
+    delete [] m_partitions;
+    delete [] m_spectra;
+    delete [] m_sum;
+    delete [] m_block;
+    delete [] m_tailPartitions;
+    delete [] m_tailSpectra;
+    delete [] m_tailPrevious;
+    delete [] m_tailSum;
+    delete [] m_tailBlock;
+    delete [] m_tailInput;
+    delete [] m_tailSlots;
+    delete [] m_tailResults;
+    m_head = m_history = m_blockOutput = m_output = m_partitions = m_spectra = m_sum = m_block = nullptr;
+    m_tailPartitions = m_tailSpectra = m_tailPrevious = m_tailSum = m_tailBlock = nullptr;
+    m_tailInput = m_tailSlots = m_tailResults = nullptr;
+    m_tailOutput = nullptr;
+    m_length = m_numPartitions = m_numTailPartitions = 0;
+}
+
+void PartitionedConvolver::reset()
+{
+    if (! isReady()) { return; }
+
+    const int channels = m_numChannels;
+    std::fill (m_history, m_history + channels*2*s_blockSize, 0.0f);
+    std::fill (m_blockOutput, m_blockOutput + channels*s_blockSize, 0.0f);
+    std::fill (m_spectra, m_spectra + channels*m_numPartitions*(m_fft.getSize() + 2), 0.0f);
+    m_blockPos = 0;
+    m_spectrumIndex = 0;
+
+    // The tail history is cleared when the next tail block is convolved, and the tail is silent
+    // until that block's output is due.
+    if (m_numTailPartitions > 0)
+    {
+        std::fill (m_tailInput, m_tailInput + channels*s_tailSize, 0.0f);
+        m_tailPos = 0;
+        m_firstTailBlock = m_tailBlockIndex;
+        m_clearBlock.store (m_tailBlockIndex, std::memory_order_release);
+        m_tailOutput = nullptr;
+    }
+}
+
+const float* PartitionedConvolver::process (const float* input, const int numFrames)
+{
+    int done = 0;
+    while (done < numFrames)
+    {
+        const int run = std::min (numFrames - done, s_blockSize - m_blockPos);
+        processRun (input + done*m_numChannels, m_output + done*m_numChannels, run);
+        done += run;
+
+        if (m_blockPos == s_blockSize) { finishBlock(); }
+    }
+
+    return m_output;
+}
+
+void PartitionedConvolver::processRun (const float* input, float* output, const int numFrames)
+{
+    const int channels = m_numChannels;
+    float sum[s_blockSize];
+
+    for (int c = 0; c < channels; ++c)
+    {
+        float* history = m_history + c*2*s_blockSize;
+        const float* head = m_head + (c % m_numResponseChannels)*s_blockSize;
+        const float* block = m_blockOutput + c*s_blockSize + m_blockPos;
+
+        // Start from the partitions that were convolved at the end of the last block.
+        for (int i = 0; i < numFrames; ++i)
+        {
+            history[s_blockSize + m_blockPos + i] = input[i*channels + c];
+            sum[i] = block[i];
+        }
+
+        if (m_numTailPartitions > 0)
+        {
+            float* record = m_tailInput + c*s_tailSize + m_tailPos;
+            for (int i = 0; i < numFrames; ++i) { record[i] = input[i*channels + c]; }
+
+            if (m_tailOutput != nullptr)
+            {
+                const float* tail = m_tailOutput + c*s_tailSize + m_tailPos;
+                for (int i = 0; i < numFrames; ++i) { sum[i] += tail[i]; }
+            }
+        }
+
+        // Filter with the head one coefficient at a time over the whole run, which vectorizes.
+        const float* x = history + m_blockPos + 1;
+        for (int k = s_blockSize - m_headLength; k < s_blockSize; ++k)
+        {
+            const float h = head[k];
+            for (int i = 0; i < numFrames; ++i) { sum[i] += h * x[i + k]; }
+        }
+
+        for (int i = 0; i < numFrames; ++i) { output[i*channels + c] = sum[i]; }
+    }
+
+    m_blockPos += numFrames;
+    if (m_numTailPartitions > 0) { m_tailPos += numFrames; }
+}
+
+void PartitionedConvolver::finishBlock()
+{
+    const int spectrumSize = m_fft.getSize() + 2;
+    const int numBins = m_fft.getNumBins();
+
+    for (int c = 0; c < m_numChannels; ++c)
+    {
+        float* history = m_history + c*2*s_blockSize;
+
+        // Overlap-save: transform the last two blocks, multiply each recent block by its partition
+        // and keep the second half of the result, which is the output for the next block.
+        if (m_numPartitions > 0)
+        {
+            const int r = c % m_numResponseChannels;
+            float* spectra = m_spectra + c*m_numPartitions*spectrumSize;
+            m_fft.forward (history, spectra + m_spectrumIndex*spectrumSize);
+
+            std::fill (m_sum, m_sum + spectrumSize, 0.0f);
+            for (int j = 0; j < m_numPartitions; ++j)
+            {
+                const int slot = (m_spectrumIndex - j + m_numPartitions) % m_numPartitions;
+                RealFFT::multiplyAdd (spectra + slot*spectrumSize, m_partitions + (r*m_numPartitions + j)*spectrumSize, m_sum, numBins);
+            }
+
+            m_fft.inverse (m_sum, m_block);
+            std::copy (m_block + s_blockSize, m_block + 2*s_blockSize, m_blockOutput + c*s_blockSize);
+        }
+
+        std::copy (history + s_blockSize, history + 2*s_blockSize, history);
+    }
+
+    if (m_numPartitions > 0) { m_spectrumIndex = (m_spectrumIndex + 1) % m_numPartitions; }
+    m_blockPos = 0;
+
+    if (m_numTailPartitions > 0 && m_tailPos == s_tailSize) { submitTailBlock(); }
+}
+
+void PartitionedConvolver::submitTailBlock()
+{
+    const int size = m_numChannels*s_tailSize;
+    const int64_t block = m_tailBlockIndex;
+
+    // The slot was last used by the block s_tailSlots before this one. If that block isn't
+    // finished, it's still being read, so this block is dropped instead. It still takes its turn
+    // (with the old contents of the slot), but the history is cleared at the next block and
+    // nothing up to there is heard.
+    if (m_completed.load (std::memory_order_acquire) + s_tailSlots > block)
+    {
+        std::copy (m_tailInput, m_tailInput + size, m_tailSlots + (block % s_tailSlots)*size);
+    }
+    else
+    {
+        ++m_dropouts;
+        m_firstTailBlock = block + 1;
+        m_clearBlock.store (block + 1, std::memory_order_release);
+    }
+    m_submitted.store (block + 1, std::memory_order_release);
+    m_thread->signal();
+    m_tailBlockIndex = block + 1;
+    m_tailPos = 0;
+
+    // The next tail block plays the output of the block before this one, which has had a whole
+    // block of time. If the background thread hasn't got to it, it's convolved here instead.
+    const int64_t source = block - 1;
+    m_tailOutput = nullptr;
+    if (source >= m_firstTailBlock)
+    {
+        const bool late = m_completed.load (std::memory_order_acquire) <= source;
+        if (late) { processTailBlocks (source + 1); }
+
+        if (m_completed.load (std::memory_order_acquire) > source)
+        {
+            m_tailOutput = m_tailResults + (source % s_tailSlots)*size;
+            if (late) { ++m_lateBlocks; }
+        }
+        else
+        {
+            ++m_dropouts;
+        }
+    }
+}
+
+void PartitionedConvolver::runTask (void* context)
+{
+    PartitionedConvolver* convolver = static_cast<PartitionedConvolver*> (context);
+    convolver->processTailBlocks (convolver->m_submitted.load (std::memory_order_acquire));
+}
+
+void PartitionedConvolver::processTailBlocks (const int64_t end)
+{
+    for (int64_t block = m_completed.load (std::memory_order_acquire); block < end; ++block)
+    {
+        // The claim only succeeds if no block is in progress, so the tail history is never used
+        // by two threads at once.
+        int64_t expected = block;
+        if (! m_claimed.compare_exchange_strong (expected, block + 1, std::memory_order_acq_rel)) { return; }
+
+        convolveTailBlock (block);
+        m_completed.store (block + 1, std::memory_order_release);
+    }
+}
+
+void PartitionedConvolver::convolveTailBlock (const int64_t block)
+{
+    const int size = m_numChannels*s_tailSize;
+    const int spectrumSize = m_tailFFT.getSize() + 2;
+    const int numBins = m_tailFFT.getNumBins();
+
+    if (block == m_clearBlock.load (std::memory_order_acquire))
+    {
+        std::fill (m_tailSpectra, m_tailSpectra + m_numChannels*m_numTailPartitions*spectrumSize, 0.0f);
+        std::fill (m_tailPrevious, m_tailPrevious + size, 0.0f);
+        m_tailSpectrumIndex = 0;
+    }
+
+    const float* input = m_tailSlots + (block % s_tailSlots)*size;
+    float* result = m_tailResults + (block % s_tailSlots)*size;
+    for (int c = 0; c < m_numChannels; ++c)
+    {
+        const int r = c % m_numResponseChannels;
+        float* previous = m_tailPrevious + c*s_tailSize;
+        std::copy (previous, previous + s_tailSize, m_tailBlock);
+        std::copy (input + c*s_tailSize, input + (c + 1)*s_tailSize, m_tailBlock + s_tailSize);
+        std::copy (input + c*s_tailSize, input + (c + 1)*s_tailSize, previous);
+
+        float* spectra = m_tailSpectra + c*m_numTailPartitions*spectrumSize;
+        m_tailFFT.forward (m_tailBlock, spectra + m_tailSpectrumIndex*spectrumSize);
+
+        std::fill (m_tailSum, m_tailSum + spectrumSize, 0.0f);
+        for (int j = 0; j < m_numTailPartitions; ++j)
+        {
+            const int slot = (m_tailSpectrumIndex - j + m_numTailPartitions) % m_numTailPartitions;
+            RealFFT::multiplyAdd (spectra + slot*spectrumSize, m_tailPartitions + (r*m_numTailPartitions + j)*spectrumSize, m_tailSum, numBins);
+        }
+
+        m_tailFFT.inverse (m_tailSum, m_tailBlock);
+        std::copy (m_tailBlock + s_tailSize, m_tailBlock + 2*s_tailSize, result + c*s_tailSize);
+    }
+
+    m_tailSpectrumIndex = (m_tailSpectrumIndex + 1) % m_numTailPartitions;
+}
+
+std::vector<float> PartitionedConvolver::makeEchoResponse (const double fs, const float delay, const float feedback, const float maxLength)
+{
+    const int delaySamples = std::max (1, static_cast<int> (std::round (fs*1e-3*delay)));
+    const size_t maxSamples = static_cast<size_t> (std::max (1.0, fs*1e-3*maxLength));
+    std::vector<float> response;
+    std::vector<float> kernel (1, 1.0f);
+    std::vector<float> wider;
+
+    // Stop once the echoes have decayed by 60 dB, or at the longest response.
+    float gain = 1.0f;
+    for (int echo = 1; gain >= 1e-3f; ++echo)
+    {
+        const size_t start = static_cast<size_t> (echo)*delaySamples - kernel.size()/2;
+        if (start + kernel.size() > maxSamples) { break; }
+
+        if (response.size() < start + kernel.size()) { response.resize (start + kernel.size(), 0.0f); }
+        for (size_t k = 0; k < kernel.size(); ++k) { response[start + k] += gain * kernel[k]; }
+        gain *= feedback;
+
+        // Smooth the next echo once more than this one, which spreads it out and darkens it.
+        wider.assign (kernel.size() + 2, 0.0f);
+        for (size_t k = 0; k < kernel.size(); ++k)
+        {
+            wider[k] += 0.25f * kernel[k];
+            wider[k + 1] += 0.5f * kernel[k];
+            wider[k + 2] += 0.25f * kernel[k];
+        }
+        kernel.swap (wider);
+    }
+
+    if (response.empty()) { response.assign (1, 0.0f); }
+    return response;
+}
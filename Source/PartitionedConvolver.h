@@ -0,0 +1,184 @@
+/**
+ * PartitionedConvolver.h
+ * \brief Zero latency convolution with long impulse responses.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "BackgroundThread.h"
+#include "RealFFT.h"
+
+/**
+ * \brief Zero latency convolution with long impulse responses.
+ *
+ * The impulse response is split into three stages, so that the output has no latency and the cost
+ * per sample grows with the log of the response length instead of with the length:
+ *     - The head (the first s_blockSize samples) is a direct-form FIR filter.
+ *     - The next part is uniformly partitioned into blocks of s_blockSize samples. Each block of
+ *       input is transformed once, and its contribution to the following block of output is
+ *       summed in the frequency domain on the audio thread.
+ *     - The rest is uniformly partitioned into blocks of s_tailSize samples, which a task on the
+ *       shared BackgroundThread convolves. The audio thread signals the task as it hands over each
+ *       tail block, and the block then has one full block of time to finish. A block that isn't
+ *       finished in time is convolved by the audio thread itself and counted as late.
+ *
+ * Each tail block depends on the ones before it, so a block is claimed with a compare-and-swap
+ * before it's convolved, and only once the block before it is complete. If the background thread
+ * is in the middle of a block when it's due, the audio thread can't take it over without waiting,
+ * so that block is left out and counted as a dropout. If the slot for the next tail block is then
+ * still being read, that block is dropped instead of overwriting the slot, and the tail starts
+ * again from the block after it.
+ *
+ * Input and output samples are interleaved frames. Every channel is convolved with its own channel
+ * of the response, and a response with fewer channels is repeated over the channels.
+ */
+class PartitionedConvolver
+{
+public:
+
+    /**
+     * Class constructor. The convolver isn't usable until setResponse() is called.
+     *
+     * \param[in]  int  Number of interleaved channels
+     */
+    explicit PartitionedConvolver (const int numChannels);
+
+    /**
+     * Class destructor.
+     */
+    ~PartitionedConvolver();
+
+    /**
+     * Sets the impulse response, which is partitioned and transformed here. This allocates memory
+     * and registers the background task, so it's never called while the audio thread is processing.
+     *
+     * \param[in]  float**  Impulse response channels
+     * \param[in]  int  Number of impulse response channels
+     * \param[in]  int  Impulse response length (samples)
+     *
+     * \return  bool  True if the convolver is ready to use
+     */
+    bool setResponse (const float* const* response, const int numResponseChannels, const int length);
+
+    void release(); ///< Unregisters the background task and frees the impulse response.
+    void reset(); ///< Clears the convolution history. This never allocates memory.
+
+    bool isReady() const { return m_length > 0; }; ///< Indicates whether an impulse response is set.
+    int getLength() const { return m_length; }; ///< Gets the impulse response length (samples).
+    int getNumDropouts() const { return m_dropouts.load (std::memory_order_relaxed); }; ///< Gets the number of tail blocks that were left out.
+    int getNumLateBlocks() const { return m_lateBlocks.load (std::memory_order_relaxed); }; ///< Gets the number of tail blocks that the audio thread convolved itself.
+
+    /**
+     * Convolves a run of frames.
+     *
+     * \param[in]  float*  Input frames
+     * \param[in]  int  Number of frames (at most s_blockSize)
+     *
+     * \return  const float*  Convolved frames, valid until the next call
+     */
+    const float* process (const float* input, const int numFrames);
+
+    /**
+     * Makes an impulse response of echoes that lose their highs as they repeat, like a tape echo.
+     * Each echo is spread a little more than the one before it.
+     *
+     * \param[in]  double  Sample frequency
+     * \param[in]  float  Time between echoes (msecs)
+     * \param[in]  float  Level of each echo relative to the one before (0-1)
+     * \param[in]  float  Longest response (msecs)
+     *
+     * \return  std::vector<float>  Impulse response
+     */
+    static std::vector<float> makeEchoResponse (const double fs, const float delay, const float feedback, const float maxLength);
+
+    static const int s_blockSize = 128; ///< Head length and partition size on the audio thread (samples).
+    static const int s_tailSize = 2048; ///< Partition size on the background thread (samples).
+    static const int s_tailSlots = 3; ///< Number of tail blocks that can be handed to the background thread at once.
+
+private:
+
+    /**
+     * Convolves frames without crossing a block boundary.
+     *
+     * \param[in]  float*  Input frames
+     * \param[out]  float*  Output frames
+     * \param[in]  int  Number of frames
+     */
+    void processRun (const float* input, float* output, const int numFrames);
+
+    void finishBlock(); ///< Convolves a finished input block with the audio thread partitions.
+    void submitTailBlock(); ///< Hands a finished tail block to the background thread, or drops it if its slot is still in use.
+
+    /**
+     * Background task, which convolves the submitted tail blocks.
+     *
+     * \param[in]  void*  The convolver
+     */
+    static void runTask (void* context);
+
+    /**
+     * Convolves tail blocks in order, claiming each one first, until the given block is complete
+     * or another thread is in the middle of a block.
+     *
+     * \param[in]  int64_t  Index of the block after the last one to convolve
+     */
+    void processTailBlocks (const int64_t end);
+
+    /**
+     * Convolves a claimed tail block with the tail partitions.
+     *
+     * \param[in]  int64_t  Tail block index
+     */
+    void convolveTailBlock (const int64_t block);
+
+    int m_numChannels; ///< Number of interleaved channels.
+    int m_numResponseChannels; ///< Number of impulse response channels.
+    int m_length; ///< Impulse response length (samples).
+
+    RealFFT m_fft; ///< Transform for the audio thread partitions (2 x s_blockSize).
+    RealFFT m_tailFFT; ///< Transform for the background thread partitions (2 x s_tailSize).
+
+    int m_headLength; ///< Number of samples in the head.
+    float* m_head; ///< Reversed head for each response channel.
+    float* m_history; ///< Last two input blocks for each channel.
+    float* m_blockOutput; ///< Audio thread partition output for the current block, for each channel.
+    float* m_output; ///< Output frames returned by process().
+    int m_blockPos; ///< Position in the current block (frames).
+
+    int m_numPartitions; ///< Number of audio thread partitions.
+    float* m_partitions; ///< Spectrum of each audio thread partition, for each response channel.
+    float* m_spectra; ///< Spectrum of each recent input block, for each channel.
+    int m_spectrumIndex; ///< Slot in m_spectra for the next input block.
+    float* m_sum; ///< Sum of the partition products.
+    float* m_block; ///< Inverse transform of the sum.
+
+    int m_numTailPartitions; ///< Number of background thread partitions (0 = no tail).
+    float* m_tailPartitions; ///< Spectrum of each background thread partition, for each response channel.
+    float* m_tailSpectra; ///< Spectrum of each recent tail block, for each channel.
+    int m_tailSpectrumIndex; ///< Slot in m_tailSpectra for the next tail block.
+    float* m_tailPrevious; ///< Previous tail block for each channel (thread holding the claim).
+    float* m_tailSum; ///< Sum of the tail partition products (thread holding the claim).
+    float* m_tailBlock; ///< Tail transform input and output (thread holding the claim).
+    float* m_tailInput; ///< Tail block being recorded by the audio thread.
+    float* m_tailSlots; ///< Tail blocks handed to the background thread (s_tailSlots slots).
+    float* m_tailResults; ///< Tail outputs from the background thread (s_tailSlots slots).
+    int m_tailPos; ///< Position in the current tail block (frames).
+    int64_t m_tailBlockIndex; ///< Index of the tail block being recorded.
+    int64_t m_firstTailBlock; ///< Index of the first tail block since the last reset.
+    const float* m_tailOutput; ///< Tail output for the current tail block (nullptr = silent).
+
+    std::atomic<int64_t> m_submitted; ///< Number of tail blocks handed to the background thread.
+    std::atomic<int64_t> m_claimed; ///< Number of tail blocks claimed for convolving (one more than m_completed while a block is in progress).
+    std::atomic<int64_t> m_completed; ///< Number of tail blocks that have been convolved.
+    std::atomic<int64_t> m_clearBlock; ///< Tail block at which the tail history is cleared.
+    std::atomic<int> m_dropouts; ///< Number of tail blocks that were left out or couldn't be handed over.
+    std::atomic<int> m_lateBlocks; ///< Number of tail blocks that the audio thread convolved itself.
+
+    std::shared_ptr<BackgroundThread> m_thread; ///< Background thread for the tail partitions (null without a tail).
+};
@@ -0,0 +1,265 @@
+/**
+ * PerformanceMonitor.cpp
+ * \brief Realtime-safe timing of the processing callbacks.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "PerformanceMonitor.h"
+
+#if defined (_MSC_VER) && (defined (_M_X64) || defined (_M_IX86))
+ #include <intrin.h>
+ #define PERFORMANCEMONITOR_RDTSC 1
+#elif defined (__x86_64__) || defined (__i386__)
+ #include <x86intrin.h>
+ #define PERFORMANCEMONITOR_RDTSC 1
+#endif
+
+PerformanceMonitor::ScopedTimer::ScopedTimer (PerformanceMonitor& monitor, const int numSamples)
+    : m_monitor (monitor),
+      m_numSamples (numSamples),
+      m_start (getTime()),
+      m_startCycles (getCycles())
+{}
+
+PerformanceMonitor::ScopedTimer::~ScopedTimer()
+{
+    Record record;
+    record.cycles = getCycles() - m_startCycles;
+    record.duration = getTime() - m_start;
+    record.time = m_start - m_monitor.m_startTime;
+    record.numSamples = m_numSamples;
+    m_monitor.push (record);
+}
+
+PerformanceMonitor::PerformanceMonitor()
+    : m_startTime (getTime()),
+      m_callback(),
+      m_writeIndex (0),
+      m_readIndex (0),
+      m_dropped (0),
+      m_mutex(),
+      m_sampleFreq (44100),
+      m_history (s_historySize),
+      m_historyCount(),
+      m_spikes (s_maxSpikes),
+      m_spikeCount(),
+      m_totals(),
+      m_totalTime(), m_totalSamples(), m_totalCycles(),
+      m_thread()
+{}
+
+PerformanceMonitor::~PerformanceMonitor()
+{
+    stop();
+}
+
+void PerformanceMonitor::prepare (const double fs)
+{
+    stop();
+
+    m_startTime = getTime();
+    m_callback = 0;
+    m_writeIndex = 0;
+    m_readIndex = 0;
+    m_dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_sampleFreq = fs;
+        m_historyCount = 0;
+        m_spikeCount = 0;
+        m_totals = Stats();
+        m_totalTime = m_totalSamples = m_totalCycles = 0;
+    }
+
+    // The audio thread never signals the task, so the ring is drained every time the thread
+    // wakes, which is at least every BackgroundThread::s_sleepTime.
+    m_thread = BackgroundThread::getShared();
+    m_thread->add (&PerformanceMonitor::runTask, this);
+}
+
+void PerformanceMonitor::stop()
+{
+    if (m_thread != nullptr)
+    {
+        m_thread->remove (this);
+        m_thread = nullptr;
+    }
+}
+
+void PerformanceMonitor::runTask (void* context)
+{
+    static_cast<PerformanceMonitor*> (context)->drain();
+}
+
+void PerformanceMonitor::push (const Record& record)
+{
+    // The ring is only written here and only read by the background thread, so two counters are
+    // all the synchronization it needs.
+    const uint32_t write = m_writeIndex.load (std::memory_order_relaxed);
+    if (write - m_readIndex.load (std::memory_order_acquire) >= static_cast<uint32_t> (s_ringSize))
+    {
+        m_dropped.fetch_add (1, std::memory_order_relaxed);
+        ++m_callback;
+        return;
+    }
+
+    Record& slot = m_ring[write & (s_ringSize - 1)];
+    slot = record;
+    slot.callback = m_callback++;
+    m_writeIndex.store (write + 1, std::memory_order_release);
+}
+
+void PerformanceMonitor::drain()
+{
+    const uint32_t write = m_writeIndex.load (std::memory_order_acquire);
+    uint32_t read = m_readIndex.load (std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock (m_mutex);
+    for (; read != write; ++read)
+    {
+        const Record& record = m_ring[read & (s_ringSize - 1)];
+        m_history[m_historyCount++ % s_historySize] = record;
+
+        m_totalTime += record.duration;
+        m_totalSamples += record.numSamples;
+        m_totalCycles += record.cycles;
+        ++m_totals.numCallbacks;
+        m_totals.max = std::max (m_totals.max, static_cast<double> (record.duration));
+
+        // The deadline is how long the samples of the callback last at the sample rate.
+        const double deadline = record.numSamples * 1e9 / m_sampleFreq;
+        const double load = (deadline > 0) ? record.duration / deadline : 0;
+        m_totals.maxLoad = std::max (m_totals.maxLoad, load);
+        if (load > s_spikeLoad) { m_spikes[m_spikeCount++ % s_maxSpikes] = record; }
+    }
+    m_readIndex.store (read, std::memory_order_release);
+}
+
+PerformanceMonitor::Stats PerformanceMonitor::getStats() const
+{
+    std::vector<int64_t> durations;
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        stats = m_totals;
+        stats.numSpikes = m_spikeCount;
+        stats.nsPerSample = (m_totalSamples > 0) ? m_totalTime / m_totalSamples : 0;
+        stats.meanCycles = (stats.numCallbacks > 0) ? m_totalCycles / stats.numCallbacks : 0;
+
+        const int64_t count = std::min<int64_t> (m_historyCount, s_historySize);
+        durations.reserve (static_cast<size_t> (count));
+        for (int64_t i = 0; i < count; ++i) { durations.push_back (m_history[static_cast<size_t> (i)].duration); }
+    }
+    stats.numDropped = m_dropped.load (std::memory_order_relaxed);
+    if (durations.empty()) { return stats; }
+
+    // Percentiles of the recent callbacks, by the nearest rank.
+    auto percentile = [&durations] (const double fraction)
+    {
+        const size_t rank = std::min (durations.size() - 1, static_cast<size_t> (fraction * durations.size()));
+        std::nth_element (durations.begin(), durations.begin() + rank, durations.end());
+        return static_cast<double> (durations[rank]);
+    };
+    stats.median = percentile (0.5);
+    stats.p99 = percentile (0.99);
+    stats.p999 = percentile (0.999);
+    return stats;
+}
+
+std::vector<PerformanceMonitor::Record> PerformanceMonitor::getHistory() const
+{
+    std::lock_guard<std::mutex> lock (m_mutex);
+    return copyHistory();
+}
+
+std::vector<PerformanceMonitor::Record> PerformanceMonitor::copyHistory() const
+{
+    const int64_t count = std::min<int64_t> (m_historyCount, s_historySize);
+    std::vector<Record> history;
+    history.reserve (static_cast<size_t> (count));
+    for (int64_t i = m_historyCount - count; i < m_historyCount; ++i) { history.push_back (m_history[static_cast<size_t> (i % s_historySize)]); }
+    return history;
+}
+
+std::string PerformanceMonitor::exportCSV() const
+{
+    // The sample frequency is copied with the history, so the loads are for the same prepare().
+    double fs;
+    std::vector<Record> history;
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        fs = m_sampleFreq;
+        history = copyHistory();
+    }
+
+    std::string csv = "callback,time_s,samples,duration_ns,ns_per_sample,cycles,load\n";
+    char line[256];
+    for (const Record& record : history)
+    {
+        const double deadline = record.numSamples * 1e9 / fs;
+        std::snprintf (line, sizeof (line), "%lld,%.6f,%d,%lld,%.2f,%llu,%.4f\n",
+                       static_cast<long long> (record.callback), record.time * 1e-9, record.numSamples,
+                       static_cast<long long> (record.duration), record.numSamples > 0 ? static_cast<double> (record.duration) / record.numSamples : 0.0,
+                       static_cast<unsigned long long> (record.cycles), deadline > 0 ? record.duration / deadline : 0.0);
+        csv += line;
+    }
+    return csv;
+}
+
+std::string PerformanceMonitor::exportJSON() const
+{
+    const Stats stats = getStats();
+
+    // The spikes that are still kept, oldest first, and the sample frequency they were timed at.
+    double fs;
+    std::vector<Record> spikes;
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        fs = m_sampleFreq;
+        const int64_t count = std::min<int64_t> (m_spikeCount, s_maxSpikes);
+        for (int64_t i = m_spikeCount - count; i < m_spikeCount; ++i) { spikes.push_back (m_spikes[static_cast<size_t> (i % s_maxSpikes)]); }
+    }
+
+    char text[1024];
+    std::snprintf (text, sizeof (text),
+                   "{\n  \"sampleRate\": %.1f,\n  \"callbacks\": %lld,\n  \"dropped\": %lld,\n  \"nsPerSample\": %.2f,\n"
+                   "  \"meanCycles\": %.1f,\n  \"medianNs\": %.0f,\n  \"p99Ns\": %.0f,\n  \"p999Ns\": %.0f,\n  \"maxNs\": %.0f,\n"
+                   "  \"maxLoad\": %.4f,\n  \"spikeLoad\": %.2f,\n  \"spikeCount\": %lld,\n  \"spikes\": [",
+                   fs, static_cast<long long> (stats.numCallbacks), static_cast<long long> (stats.numDropped), stats.nsPerSample,
+                   stats.meanCycles, stats.median, stats.p99, stats.p999, stats.max, stats.maxLoad, s_spikeLoad, static_cast<long long> (stats.numSpikes));
+    std::string json = text;
+
+    for (size_t i = 0; i < spikes.size(); ++i)
+    {
+        const Record& spike = spikes[i];
+        const double deadline = spike.numSamples * 1e9 / fs;
+        std::snprintf (text, sizeof (text), "%s\n    { \"callback\": %lld, \"timeS\": %.6f, \"samples\": %d, \"durationNs\": %lld, \"load\": %.4f }",
+                       (i == 0) ? "" : ",", static_cast<long long> (spike.callback), spike.time * 1e-9, spike.numSamples,
+                       static_cast<long long> (spike.duration), deadline > 0 ? spike.duration / deadline : 0.0);
+        json += text;
+    }
+    json += spikes.empty() ? "]\n}\n" : "\n  ]\n}\n";
+    return json;
+}
+
+int64_t PerformanceMonitor::getTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t PerformanceMonitor::getCycles()
+{
+   #if PERFORMANCEMONITOR_RDTSC
+    return __rdtsc();
+   #elif defined (__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+   #else
+    return 0;
+   #endif
+}
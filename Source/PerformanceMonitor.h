@@ -0,0 +1,170 @@
+/**
+ * PerformanceMonitor.h
+ * \brief Realtime-safe timing of the processing callbacks.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BackgroundThread.h"
+
+/**
+ * \brief Realtime-safe timing of the processing callbacks.
+ *
+ * The audio thread times each callback with a ScopedTimer and pushes the result into a lock-free
+ * single-producer ring, which never blocks and counts a record as dropped if the ring is full. A
+ * task on the shared BackgroundThread drains the ring into a history of the most recent callbacks
+ * and keeps the running totals, so the audio thread never touches the statistics.
+ *
+ * A callback that takes more than s_spikeLoad of its deadline (the time its samples last at the
+ * sample rate) is counted as a spike, since it's close to causing a dropout, and the most recent
+ * spikes are kept. The statistics can be read from any thread other than the audio thread, and
+ * exported as CSV (the recent callbacks) or JSON (the summary and spikes).
+ */
+class PerformanceMonitor
+{
+public:
+
+    /**
+     * Timing of one callback.
+     */
+    struct Record
+    {
+        int64_t callback = 0; ///< Callback number since prepare().
+        int64_t time = 0; ///< Start of the callback since prepare() (nsecs).
+        int64_t duration = 0; ///< Time spent in the callback (nsecs).
+        uint64_t cycles = 0; ///< Timestamp counter ticks spent in the callback (CPU cycles on x86).
+        int numSamples = 0; ///< Number of samples processed.
+    };
+
+    /**
+     * Statistics of the callbacks.
+     */
+    struct Stats
+    {
+        int64_t numCallbacks = 0; ///< Number of callbacks since prepare().
+        int64_t numDropped = 0; ///< Number of records lost because the ring was full.
+        int64_t numSpikes = 0; ///< Number of callbacks that took more than s_spikeLoad of their deadline.
+        double nsPerSample = 0; ///< Mean time per sample over all of the callbacks (nsecs).
+        double meanCycles = 0; ///< Mean timestamp counter ticks per callback.
+        double median = 0; ///< Median callback time of the recent callbacks (nsecs).
+        double p99 = 0; ///< 99th percentile callback time of the recent callbacks (nsecs).
+        double p999 = 0; ///< 99.9th percentile callback time of the recent callbacks (nsecs).
+        double max = 0; ///< Longest callback time since prepare() (nsecs).
+        double maxLoad = 0; ///< Longest callback time relative to its deadline since prepare().
+    };
+
+    /**
+     * Times a callback from construction to destruction, and records it in a monitor.
+     */
+    class ScopedTimer
+    {
+    public:
+
+        /**
+         * Starts timing a callback.
+         *
+         * \param[in]  PerformanceMonitor&  Monitor that records the callback
+         * \param[in]  int  Number of samples in the callback
+         */
+        ScopedTimer (PerformanceMonitor& monitor, const int numSamples);
+
+        ~ScopedTimer(); ///< Records the callback.
+
+    private:
+
+        PerformanceMonitor& m_monitor; ///< Monitor that records the callback.
+        int m_numSamples; ///< Number of samples in the callback.
+        int64_t m_start; ///< Clock time at the start of the callback (nsecs).
+        uint64_t m_startCycles; ///< Timestamp counter at the start of the callback.
+    };
+
+    /**
+     * Class constructor. Nothing is recorded until prepare() is called.
+     */
+    PerformanceMonitor();
+
+    /**
+     * Class destructor, which stops draining the monitor.
+     */
+    ~PerformanceMonitor();
+
+    /**
+     * Clears the statistics and starts draining the monitor for a sample rate. This is called from
+     * AudioProcessor::prepareToPlay(), and never while the audio thread is recording.
+     *
+     * \param[in]  double  Sample frequency
+     */
+    void prepare (const double fs);
+
+    Stats getStats() const; ///< Gets the statistics. This is never called from the audio thread.
+    std::vector<Record> getHistory() const; ///< Gets the recent callbacks, oldest first. This is never called from the audio thread.
+
+    std::string exportCSV() const; ///< Gets the recent callbacks as CSV, one row per callback.
+    std::string exportJSON() const; ///< Gets the summary and the recent spikes as JSON.
+
+    static const int s_ringSize = 4096; ///< Number of records the ring holds (a power of two).
+    static const int s_historySize = 16384; ///< Number of recent callbacks kept for the percentiles and export.
+    static const int s_maxSpikes = 64; ///< Number of recent spikes kept.
+    static constexpr double s_spikeLoad = 0.5; ///< Fraction of its deadline above which a callback is a spike.
+
+private:
+
+    /**
+     * Pushes a record into the ring. This is only called from the audio thread.
+     *
+     * \param[in]  Record&  Callback timing
+     */
+    void push (const Record& record);
+
+    /**
+     * Background task that drains the ring.
+     *
+     * \param[in]  void*  The monitor
+     */
+    static void runTask (void* context);
+
+    void drain(); ///< Moves the records in the ring into the history and statistics.
+    void stop(); ///< Stops draining the monitor, and waits for a drain in progress to finish.
+
+    /**
+     * Copies the recent callbacks, oldest first. This is only called with the mutex held.
+     *
+     * \return  std::vector<Record>  Recent callbacks
+     */
+    std::vector<Record> copyHistory() const;
+
+    static int64_t getTime(); ///< Gets the clock time (nsecs).
+    static uint64_t getCycles(); ///< Gets the CPU timestamp counter, or zero where there isn't one.
+
+    int64_t m_startTime; ///< Clock time of prepare() (nsecs).
+    int64_t m_callback; ///< Number of the next callback (audio thread).
+
+    Record m_ring[s_ringSize]; ///< Records waiting to be drained.
+    std::atomic<uint32_t> m_writeIndex; ///< Number of records pushed.
+    std::atomic<uint32_t> m_readIndex; ///< Number of records drained.
+    std::atomic<int64_t> m_dropped; ///< Number of records lost because the ring was full.
+
+    mutable std::mutex m_mutex; ///< Guards the sample frequency, history and statistics (never taken by the audio thread).
+    double m_sampleFreq; ///< Sample frequency.
+    std::vector<Record> m_history; ///< Recent callbacks (s_historySize slots).
+    int64_t m_historyCount; ///< Number of callbacks written into the history.
+    std::vector<Record> m_spikes; ///< Recent spikes (s_maxSpikes slots).
+    int64_t m_spikeCount; ///< Number of spikes since prepare().
+    Stats m_totals; ///< Running totals (the percentiles are worked out from the history).
+    double m_totalTime; ///< Total callback time (nsecs).
+    double m_totalSamples; ///< Total number of samples.
+    double m_totalCycles; ///< Total timestamp counter ticks.
+
+    std::shared_ptr<BackgroundThread> m_thread; ///< Background thread that drains the ring (null until prepare()).
+
+    PerformanceMonitor (const PerformanceMonitor&) = delete;
+    PerformanceMonitor& operator= (const PerformanceMonitor&) = delete;
+};
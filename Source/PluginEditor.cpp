@@ -8,15 +8,67 @@
 
 StereoDelayEditor::StereoDelayEditor (StereoDelayProcessor* processor)
     : AudioProcessorEditor (processor),
-      SliderListener(), ButtonListener(),
+      SliderListener(), ButtonListener(), ComboBoxListener(), Timer(),
       m_pluginLabel ("plugin name", "Stereo Delay"),
       m_delayLabel ("delay label", "Delay"),
       m_delayKnob ("delay knob"),
+      m_longDelayLabel ("long delay label", "Long Delay"),
+      m_longDelayKnob ("long delay knob"),
       m_feedbackLabel ("feedback", "Feedback"),
       m_feedbackKnob ("feedback knob"), 
       m_mixLabel ("mix label", "Mix"),
       m_mixKnob ("mix knob"),
-      m_bypassButton ("bypass button")
+      m_rateLabel ("rate label", "Rate"),
+      m_rateKnob ("rate knob"),
+      m_depthLabel ("depth label", "Depth"),
+      m_depthKnob ("depth knob"),
+      m_tapsLabel ("taps label", "Taps"),
+      m_tapsKnob ("taps knob"),
+      m_tapSpacingLabel ("tap spacing label", "Spacing"),
+      m_tapSpacingKnob ("tap spacing knob"),
+      m_tapSpreadLabel ("tap spread label", "Spread"),
+      m_tapSpreadKnob ("tap spread knob"),
+      m_tapDecayLabel ("tap decay label", "Decay"),
+      m_tapDecayKnob ("tap decay knob"),
+      m_tapFeedbackButton ("tap feedback button"),
+      m_interpolationLabel ("interpolation label", "Interpolation"),
+      m_interpolationBox ("interpolation box"),
+      m_filterLabel ("filter label", "Feedback Filter"),
+      m_filterBox ("filter box"),
+      m_filterFreqLabel ("filter frequency label", "Frequency"),
+      m_filterFreqKnob ("filter frequency knob"),
+      m_filterTiltLabel ("filter tilt label", "Tilt"),
+      m_filterTiltKnob ("filter tilt knob"),
+      m_saturationLabel ("saturation label", "Drive Curve"),
+      m_saturationBox ("saturation box"),
+      m_driveLabel ("drive label", "Drive"),
+      m_driveKnob ("drive knob"),
+      m_oversamplingLabel ("oversampling label", "Oversampling"),
+      m_oversamplingBox ("oversampling box"),
+      m_delayRightLabel ("right delay label", "Right Delay"),
+      m_delayRightKnob ("right delay knob"),
+      m_linkButton ("link button"),
+      m_pingPongButton ("ping-pong button"),
+      m_crossfeedLabel ("crossfeed label", "Crossfeed"),
+      m_crossfeedKnob ("crossfeed knob"),
+      m_widthLabel ("width label", "Width"),
+      m_widthKnob ("width knob"),
+      m_storageLabel ("storage label", "Storage"),
+      m_storageBox ("storage box"),
+      m_convolutionButton ("convolution button"),
+      m_loadResponseButton ("load response button"),
+      m_echoResponseButton ("echo response button"),
+      m_responseLabel ("response label", String()),
+      m_diffusionLabel ("diffusion label", "Diffusion"),
+      m_diffusionBox ("diffusion box"),
+      m_matrixLabel ("matrix label", "Matrix"),
+      m_matrixBox ("matrix box"),
+      m_syncButton ("sync button"),
+      m_noteBox ("note box"),
+      m_syncTimeLabel ("sync time label", String()),
+      m_bypassButton ("bypass button"),
+      m_performanceLabel ("performance label", String()),
+      m_exportButton ("export button")
 {
     // Set up the window.
     addAndMakeVisible (m_pluginLabel);
@@ -24,7 +76,7 @@ StereoDelayEditor::StereoDelayEditor (StereoDelayProcessor* processor)
     m_pluginLabel.setJustificationType (Justification::centred);
     m_pluginLabel.setEditable (false, false, false);
     setResizable (true, true);
-    setSize (550, 300);
+    setSize (550, 1260);
 
     // Set up the delay time control.
     addAndMakeVisible (m_delayLabel);
@@ -39,6 +91,20 @@ StereoDelayEditor::StereoDelayEditor (StereoDelayProcessor* processor)
     m_delayKnob.setTextValueSuffix (" msecs");
     m_delayKnob.addListener (this);
 
+    // Set up the long delay control.
+    addAndMakeVisible (m_longDelayLabel);
+    m_longDelayLabel.setTooltip ("Long delay time for looping, which replaces the delay time (secs, 0 = off)");
+    m_longDelayLabel.setFont (18.00f);
+    m_longDelayLabel.setJustificationType (Justification::centred);
+    m_longDelayLabel.attachToComponent (&m_longDelayKnob, false);
+    addAndMakeVisible (m_longDelayKnob);
+    m_longDelayKnob.setRange (0, StereoDelayProcessor::s_maxLongDelay, 0.01);
+    m_longDelayKnob.setSkewFactorFromMidPoint (30);
+    m_longDelayKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_longDelayKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_longDelayKnob.setTextValueSuffix (" secs");
+    m_longDelayKnob.addListener (this);
+
     // Set up the feedback control.
     addAndMakeVisible (m_feedbackLabel);
     m_feedbackLabel.setTooltip ("Feedback (%)");
@@ -66,17 +132,355 @@ StereoDelayEditor::StereoDelayEditor (StereoDelayProcessor* processor)
     m_mixKnob.setTextValueSuffix (" %");
     m_mixKnob.addListener (this);
 
+    // Set up the modulation rate control.
+    addAndMakeVisible (m_rateLabel);
+    m_rateLabel.setTooltip ("Modulation rate (Hz)");
+    m_rateLabel.setFont (18.00f);
+    m_rateLabel.setJustificationType (Justification::centred);
+    m_rateLabel.attachToComponent (&m_rateKnob, false);
+    addAndMakeVisible (m_rateKnob);
+    m_rateKnob.setRange (0.05, 10, 0.01);
+    m_rateKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_rateKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_rateKnob.setTextValueSuffix (" Hz");
+    m_rateKnob.addListener (this);
+
+    // Set up the modulation depth control.
+    addAndMakeVisible (m_depthLabel);
+    m_depthLabel.setTooltip ("Modulation depth (msecs)");
+    m_depthLabel.setFont (18.00f);
+    m_depthLabel.setJustificationType (Justification::centred);
+    m_depthLabel.attachToComponent (&m_depthKnob, false);
+    addAndMakeVisible (m_depthKnob);
+    m_depthKnob.setRange (0, 20, 0.01);
+    m_depthKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_depthKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_depthKnob.setTextValueSuffix (" msecs");
+    m_depthKnob.addListener (this);
+
+    // Set up the delay taps control.
+    addAndMakeVisible (m_tapsLabel);
+    m_tapsLabel.setTooltip ("Number of delay taps spread over the delay time");
+    m_tapsLabel.setFont (18.00f);
+    m_tapsLabel.setJustificationType (Justification::centred);
+    m_tapsLabel.attachToComponent (&m_tapsKnob, false);
+    addAndMakeVisible (m_tapsKnob);
+    m_tapsKnob.setRange (1, DelayLine::s_maxTaps, 1);
+    m_tapsKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_tapsKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_tapsKnob.addListener (this);
+
+    // Set up the tap spacing control.
+    addAndMakeVisible (m_tapSpacingLabel);
+    m_tapSpacingLabel.setTooltip ("Tap spacing (positive bunches the taps towards the start, negative towards the end)");
+    m_tapSpacingLabel.setFont (18.00f);
+    m_tapSpacingLabel.setJustificationType (Justification::centred);
+    m_tapSpacingLabel.attachToComponent (&m_tapSpacingKnob, false);
+    addAndMakeVisible (m_tapSpacingKnob);
+    m_tapSpacingKnob.setRange (-100, 100, 1);
+    m_tapSpacingKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_tapSpacingKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_tapSpacingKnob.setTextValueSuffix (" %");
+    m_tapSpacingKnob.addListener (this);
+
+    // Set up the tap stereo spread control.
+    addAndMakeVisible (m_tapSpreadLabel);
+    m_tapSpreadLabel.setTooltip ("Tap stereo spread (%)");
+    m_tapSpreadLabel.setFont (18.00f);
+    m_tapSpreadLabel.setJustificationType (Justification::centred);
+    m_tapSpreadLabel.attachToComponent (&m_tapSpreadKnob, false);
+    addAndMakeVisible (m_tapSpreadKnob);
+    m_tapSpreadKnob.setRange (0, 100, 1);
+    m_tapSpreadKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_tapSpreadKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_tapSpreadKnob.setTextValueSuffix (" %");
+    m_tapSpreadKnob.addListener (this);
+
+    // Set up the tap decay control.
+    addAndMakeVisible (m_tapDecayLabel);
+    m_tapDecayLabel.setTooltip ("How much quieter each tap is than the one before (%)");
+    m_tapDecayLabel.setFont (18.00f);
+    m_tapDecayLabel.setJustificationType (Justification::centred);
+    m_tapDecayLabel.attachToComponent (&m_tapDecayKnob, false);
+    addAndMakeVisible (m_tapDecayKnob);
+    m_tapDecayKnob.setRange (0, 100, 1);
+    m_tapDecayKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_tapDecayKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_tapDecayKnob.setTextValueSuffix (" %");
+    m_tapDecayKnob.addListener (this);
+
+    // Set up a button for feeding back every tap instead of just the last one.
+    addAndMakeVisible (m_tapFeedbackButton);
+    m_tapFeedbackButton.setButtonText ("Feed Back All Taps");
+    m_tapFeedbackButton.setClickingTogglesState (true);
+    m_tapFeedbackButton.addListener (this);
+
+    // Set up the interpolation selector. The item IDs are the interpolation types plus one.
+    addAndMakeVisible (m_interpolationLabel);
+    m_interpolationLabel.setFont (18.00f);
+    m_interpolationLabel.setJustificationType (Justification::centred);
+    m_interpolationLabel.attachToComponent (&m_interpolationBox, false);
+    addAndMakeVisible (m_interpolationBox);
+    m_interpolationBox.setTooltip ("Fractional delay interpolation (higher quality costs more CPU)");
+    for (int type = 0; type < Interpolators::s_numTypes; ++type)
+    {
+        m_interpolationBox.addItem (Interpolators::getName (static_cast<Interpolators::Type> (type)), type + 1);
+    }
+    m_interpolationBox.addListener (this);
+
+    // Set up the feedback filter controls. The item IDs are the filter types plus one.
+    addAndMakeVisible (m_filterLabel);
+    m_filterLabel.setFont (18.00f);
+    m_filterLabel.setJustificationType (Justification::centred);
+    m_filterLabel.attachToComponent (&m_filterBox, false);
+    addAndMakeVisible (m_filterBox);
+    m_filterBox.setTooltip ("Filter applied to every repeat of the delay");
+    for (int type = 0; type < FeedbackFilter::s_numTypes; ++type)
+    {
+        m_filterBox.addItem (FeedbackFilter::getName (static_cast<FeedbackFilter::Type> (type)), type + 1);
+    }
+    m_filterBox.addListener (this);
+
+    addAndMakeVisible (m_filterFreqLabel);
+    m_filterFreqLabel.setTooltip ("Feedback filter cutoff, or pivot frequency for tilt (Hz)");
+    m_filterFreqLabel.setFont (18.00f);
+    m_filterFreqLabel.setJustificationType (Justification::centred);
+    m_filterFreqLabel.attachToComponent (&m_filterFreqKnob, false);
+    addAndMakeVisible (m_filterFreqKnob);
+    m_filterFreqKnob.setRange (20, 20000, 1);
+    m_filterFreqKnob.setSkewFactorFromMidPoint (1000);
+    m_filterFreqKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_filterFreqKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_filterFreqKnob.setTextValueSuffix (" Hz");
+    m_filterFreqKnob.addListener (this);
+
+    addAndMakeVisible (m_filterTiltLabel);
+    m_filterTiltLabel.setTooltip ("Feedback filter tilt: negative darkens, positive thins (dB)");
+    m_filterTiltLabel.setFont (18.00f);
+    m_filterTiltLabel.setJustificationType (Justification::centred);
+    m_filterTiltLabel.attachToComponent (&m_filterTiltKnob, false);
+    addAndMakeVisible (m_filterTiltKnob);
+    m_filterTiltKnob.setRange (-12, 12, 0.1);
+    m_filterTiltKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_filterTiltKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_filterTiltKnob.setTextValueSuffix (" dB");
+    m_filterTiltKnob.addListener (this);
+
+    // Set up the feedback drive controls. The item IDs are the curves (or oversampling settings) plus one.
+    addAndMakeVisible (m_saturationLabel);
+    m_saturationLabel.setFont (18.00f);
+    m_saturationLabel.setJustificationType (Justification::centred);
+    m_saturationLabel.attachToComponent (&m_saturationBox, false);
+    addAndMakeVisible (m_saturationBox);
+    m_saturationBox.setTooltip ("Saturation curve applied to every repeat of the delay");
+    for (int shape = 0; shape < Saturator::s_numShapes; ++shape)
+    {
+        m_saturationBox.addItem (Saturator::getName (static_cast<Saturator::Shape> (shape)), shape + 1);
+    }
+    m_saturationBox.addListener (this);
+
+    addAndMakeVisible (m_driveLabel);
+    m_driveLabel.setTooltip ("Feedback drive (dB)");
+    m_driveLabel.setFont (18.00f);
+    m_driveLabel.setJustificationType (Justification::centred);
+    m_driveLabel.attachToComponent (&m_driveKnob, false);
+    addAndMakeVisible (m_driveKnob);
+    m_driveKnob.setRange (0, 24, 0.1);
+    m_driveKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_driveKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_driveKnob.setTextValueSuffix (" dB");
+    m_driveKnob.addListener (this);
+
+    addAndMakeVisible (m_oversamplingLabel);
+    m_oversamplingLabel.setFont (18.00f);
+    m_oversamplingLabel.setJustificationType (Justification::centred);
+    m_oversamplingLabel.attachToComponent (&m_oversamplingBox, false);
+    addAndMakeVisible (m_oversamplingBox);
+    m_oversamplingBox.setTooltip ("Oversampling for the drive stage (less aliasing, more CPU)");
+    m_oversamplingBox.addItem ("1x", 1);
+    m_oversamplingBox.addItem ("2x", 2);
+    m_oversamplingBox.addItem ("4x", 3);
+    m_oversamplingBox.addListener (this);
+
+    // Set up the stereo routing controls.
+    addAndMakeVisible (m_delayRightLabel);
+    m_delayRightLabel.setTooltip ("Right channel delay time when unlinked (msecs)");
+    m_delayRightLabel.setFont (18.00f);
+    m_delayRightLabel.setJustificationType (Justification::centred);
+    m_delayRightLabel.attachToComponent (&m_delayRightKnob, false);
+    addAndMakeVisible (m_delayRightKnob);
+    m_delayRightKnob.setRange (0, 2000, 0.01);
+    m_delayRightKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_delayRightKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_delayRightKnob.setTextValueSuffix (" msecs");
+    m_delayRightKnob.addListener (this);
+
+    addAndMakeVisible (m_linkButton);
+    m_linkButton.setButtonText ("Link");
+    m_linkButton.setTooltip ("Use the same delay time for both channels");
+    m_linkButton.setClickingTogglesState (true);
+    m_linkButton.addListener (this);
+    addAndMakeVisible (m_pingPongButton);
+    m_pingPongButton.setButtonText ("Ping-Pong");
+    m_pingPongButton.setTooltip ("Bounce the echoes between the left and right channels");
+    m_pingPongButton.setClickingTogglesState (true);
+    m_pingPongButton.addListener (this);
+
+    addAndMakeVisible (m_crossfeedLabel);
+    m_crossfeedLabel.setTooltip ("Feedback sent to the opposite channel (%)");
+    m_crossfeedLabel.setFont (18.00f);
+    m_crossfeedLabel.setJustificationType (Justification::centred);
+    m_crossfeedLabel.attachToComponent (&m_crossfeedKnob, false);
+    addAndMakeVisible (m_crossfeedKnob);
+    m_crossfeedKnob.setRange (0, 100, 1);
+    m_crossfeedKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_crossfeedKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_crossfeedKnob.setTextValueSuffix (" %");
+    m_crossfeedKnob.addListener (this);
+
+    addAndMakeVisible (m_widthLabel);
+    m_widthLabel.setTooltip ("Stereo width of the delayed signal: 0% is mono, 200% is extra wide (%)");
+    m_widthLabel.setFont (18.00f);
+    m_widthLabel.setJustificationType (Justification::centred);
+    m_widthLabel.attachToComponent (&m_widthKnob, false);
+    addAndMakeVisible (m_widthKnob);
+    m_widthKnob.setRange (0, 200, 1);
+    m_widthKnob.setSliderStyle (Slider::RotaryHorizontalVerticalDrag);
+    m_widthKnob.setTextBoxStyle (Slider::TextBoxBelow, false, 80, 20);
+    m_widthKnob.setTextValueSuffix (" %");
+    m_widthKnob.addListener (this);
+
+    // Set up the storage control. The item IDs are the formats plus one.
+    addAndMakeVisible (m_storageLabel);
+    m_storageLabel.setFont (18.00f);
+    m_storageLabel.setJustificationType (Justification::centred);
+    m_storageLabel.attachToComponent (&m_storageBox, false);
+    addAndMakeVisible (m_storageBox);
+    m_storageBox.setTooltip ("Store the delay buffers at half the size, with a little rounding noise on each repeat");
+    m_storageBox.addItem ("Float", TieredDelayBuffer::FLOAT32 + 1);
+    m_storageBox.addItem ("Half", TieredDelayBuffer::FLOAT16 + 1);
+    m_storageBox.addItem ("16-bit", TieredDelayBuffer::INT16 + 1);
+    m_storageBox.addListener (this);
+    // Set up the convolution controls.
+    addAndMakeVisible (m_convolutionButton);
+    m_convolutionButton.setButtonText ("Convolution");
+    m_convolutionButton.setTooltip ("Convolve with the impulse response instead of delaying");
+    m_convolutionButton.setClickingTogglesState (true);
+    m_convolutionButton.addListener (this);
+    addAndMakeVisible (m_loadResponseButton);
+    m_loadResponseButton.setButtonText ("Load IR...");
+    m_loadResponseButton.setTooltip ("Load an impulse response from an audio file");
+    m_loadResponseButton.addListener (this);
+    addAndMakeVisible (m_echoResponseButton);
+    m_echoResponseButton.setButtonText ("Echo IR");
+    m_echoResponseButton.setTooltip ("Make an impulse response of echoes from the delay time and feedback");
+    m_echoResponseButton.addListener (this);
+    addAndMakeVisible (m_responseLabel);
+    m_responseLabel.setFont (14.00f);
+    m_responseLabel.setJustificationType (Justification::centred);
+    m_responseLabel.setEditable (false, false, false);
+
+    // Set up the diffusion controls. The item IDs are Off, then the numbers of lines from the
+    // fewest up in powers of two, and the matrices plus one.
+    addAndMakeVisible (m_diffusionLabel);
+    m_diffusionLabel.setFont (18.00f);
+    m_diffusionLabel.setJustificationType (Justification::centred);
+    m_diffusionLabel.attachToComponent (&m_diffusionBox, false);
+    addAndMakeVisible (m_diffusionBox);
+    m_diffusionBox.setTooltip ("Feed the repeats through a network of delay lines for diffuse, reverb-like echoes");
+    m_diffusionBox.addItem ("Off", 1);
+    for (int lines = FeedbackDelayNetwork::s_minLines, id = 2; lines <= FeedbackDelayNetwork::s_maxLines; lines *= 2, ++id)
+    {
+        m_diffusionBox.addItem (String (lines) + " lines", id);
+    }
+    m_diffusionBox.addListener (this);
+    addAndMakeVisible (m_matrixLabel);
+    m_matrixLabel.setFont (18.00f);
+    m_matrixLabel.setJustificationType (Justification::centred);
+    m_matrixLabel.attachToComponent (&m_matrixBox, false);
+    addAndMakeVisible (m_matrixBox);
+    m_matrixBox.setTooltip ("How the diffusion lines feed back into each other");
+    m_matrixBox.addItem ("Hadamard", FeedbackDelayNetwork::HADAMARD + 1);
+    m_matrixBox.addItem ("Householder", FeedbackDelayNetwork::HOUSEHOLDER + 1);
+    m_matrixBox.addListener (this);
+
+    // Set up the tempo sync controls. The item IDs are the note values plus one.
+    addAndMakeVisible (m_syncButton);
+    m_syncButton.setButtonText ("Sync");
+    m_syncButton.setTooltip ("Sync the delay time to the host tempo");
+    m_syncButton.setClickingTogglesState (true);
+    m_syncButton.addListener (this);
+    addAndMakeVisible (m_noteBox);
+    m_noteBox.setTooltip ("Tempo-synced delay time");
+    for (int note = 0; note < TempoSync::s_numNoteValues; ++note)
+    {
+        m_noteBox.addItem (TempoSync::getName (static_cast<TempoSync::NoteValue> (note)), note + 1);
+    }
+    m_noteBox.addListener (this);
+    addAndMakeVisible (m_syncTimeLabel);
+    m_syncTimeLabel.setFont (14.00f);
+    m_syncTimeLabel.setJustificationType (Justification::centredLeft);
+    m_syncTimeLabel.setEditable (false, false, false);
+    m_syncTimeLabel.setTooltip ("Delay time of the note value at the current tempo");
+
     // Setup a button for bypassing the effect.
     addAndMakeVisible (m_bypassButton);
     m_bypassButton.setButtonText ("Bypass");
     m_bypassButton.setClickingTogglesState (true);
     m_bypassButton.addListener (this);
 
+    // Set up the callback timing readout, which is refreshed from the processor's monitor.
+    addAndMakeVisible (m_performanceLabel);
+    m_performanceLabel.setFont (14.00f);
+    m_performanceLabel.setJustificationType (Justification::centredLeft);
+    m_performanceLabel.setEditable (false, false, false);
+    m_performanceLabel.setTooltip ("Processing time per callback: median, 99th percentile and longest, time per sample, "
+                                   "longest share of the callback deadline, and callbacks over half of their deadline");
+    addAndMakeVisible (m_exportButton);
+    m_exportButton.setButtonText ("Export...");
+    m_exportButton.setTooltip ("Save the recent callback timings as CSV, or the summary and spikes as JSON");
+    m_exportButton.addListener (this);
+
     // Set values for the controls from the saved processor state.
     m_delayKnob.setValue (processor->getParameter (StereoDelayProcessor::DELAY), dontSendNotification);
+    m_longDelayKnob.setValue (processor->getParameter (StereoDelayProcessor::LONG_DELAY), dontSendNotification);
     m_feedbackKnob.setValue (processor->getParameter (StereoDelayProcessor::FEEDBACK), dontSendNotification);
     m_mixKnob.setValue (processor->getParameter (StereoDelayProcessor::MIX), dontSendNotification);
+    m_rateKnob.setValue (processor->getParameter (StereoDelayProcessor::MOD_RATE), dontSendNotification);
+    m_depthKnob.setValue (processor->getParameter (StereoDelayProcessor::MOD_DEPTH), dontSendNotification);
+    m_tapsKnob.setValue (processor->getParameter (StereoDelayProcessor::TAPS), dontSendNotification);
+    m_tapSpacingKnob.setValue (processor->getParameter (StereoDelayProcessor::TAP_SPACING), dontSendNotification);
+    m_tapSpreadKnob.setValue (processor->getParameter (StereoDelayProcessor::TAP_SPREAD), dontSendNotification);
+    m_tapDecayKnob.setValue (processor->getParameter (StereoDelayProcessor::TAP_DECAY), dontSendNotification);
+    m_tapFeedbackButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::TAP_FEEDBACK)), dontSendNotification);
+    m_interpolationBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::INTERPOLATION)) + 1, dontSendNotification);
+    m_syncButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::SYNC)), dontSendNotification);
+    m_noteBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::NOTE)) + 1, dontSendNotification);
+    m_filterBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::FILTER)) + 1, dontSendNotification);
+    m_filterFreqKnob.setValue (processor->getParameter (StereoDelayProcessor::FILTER_FREQ), dontSendNotification);
+    m_filterTiltKnob.setValue (processor->getParameter (StereoDelayProcessor::FILTER_TILT), dontSendNotification);
+    m_saturationBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::SATURATION)) + 1, dontSendNotification);
+    m_driveKnob.setValue (processor->getParameter (StereoDelayProcessor::DRIVE), dontSendNotification);
+    m_oversamplingBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::OVERSAMPLING)) + 1, dontSendNotification);
+    m_delayRightKnob.setValue (processor->getParameter (StereoDelayProcessor::DELAY_RIGHT), dontSendNotification);
+    m_linkButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::LINK)), dontSendNotification);
+    m_pingPongButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::PING_PONG)), dontSendNotification);
+    m_crossfeedKnob.setValue (processor->getParameter (StereoDelayProcessor::CROSSFEED), dontSendNotification);
+    m_widthKnob.setValue (processor->getParameter (StereoDelayProcessor::WIDTH), dontSendNotification);
+    m_storageBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::STORAGE)) + 1, dontSendNotification);
+    m_convolutionButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::CONVOLUTION)), dontSendNotification);
+    m_matrixBox.setSelectedId (static_cast<int> (processor->getParameter (StereoDelayProcessor::DIFFUSION_MATRIX)) + 1, dontSendNotification);
     m_bypassButton.setToggleState (static_cast<bool> (processor->getParameter (StereoDelayProcessor::BYPASS)), dontSendNotification);
+    m_delayKnob.setEnabled (! m_syncButton.getToggleState());
+    m_delayRightKnob.setEnabled (! m_linkButton.getToggleState());
+    m_crossfeedKnob.setEnabled (! m_pingPongButton.getToggleState());
+    updateFilterControls();
+    updateDriveControls();
+    updateResponseLabel();
+    updateDiffusionControls (static_cast<int> (processor->getParameter (StereoDelayProcessor::DIFFUSION)));
+    updatePerformanceLabel();
+    updateSyncTimeLabel();
+    startTimerHz (s_refreshRate);
 }
 
 void StereoDelayEditor::paint (Graphics& graphics)
@@ -87,11 +491,43 @@ void StereoDelayEditor::paint (Graphics& graphics)
 
 void StereoDelayEditor::resized()
 {
-    m_pluginLabel.setBounds (proportionOfWidth(0.25), proportionOfHeight(0.0), proportionOfWidth(0.5), proportionOfHeight(0.2));
-    m_delayKnob.setBounds (proportionOfWidth(0.1), proportionOfHeight(0.3), proportionOfWidth(0.2), proportionOfHeight(0.3));
-    m_feedbackKnob.setBounds (proportionOfWidth(0.4), proportionOfHeight(0.3), proportionOfWidth(0.2), proportionOfHeight(0.3));
-    m_mixKnob.setBounds (proportionOfWidth(0.7), proportionOfHeight(0.3), proportionOfWidth(0.2), proportionOfHeight(0.3));
-    m_bypassButton.setBounds (proportionOfWidth (0.4), proportionOfHeight (0.7), proportionOfWidth (0.2), proportionOfHeight (0.1));
+    m_pluginLabel.setBounds (proportionOfWidth(0.25), proportionOfHeight(0.0), proportionOfWidth(0.5), proportionOfHeight(0.048));
+    m_delayKnob.setBounds (proportionOfWidth(0.05), proportionOfHeight(0.071), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_longDelayKnob.setBounds (proportionOfWidth(0.28), proportionOfHeight(0.071), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_feedbackKnob.setBounds (proportionOfWidth(0.51), proportionOfHeight(0.071), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_mixKnob.setBounds (proportionOfWidth(0.74), proportionOfHeight(0.071), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_rateKnob.setBounds (proportionOfWidth(0.05), proportionOfHeight(0.196), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_depthKnob.setBounds (proportionOfWidth(0.28), proportionOfHeight(0.196), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_tapsKnob.setBounds (proportionOfWidth(0.51), proportionOfHeight(0.196), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_interpolationBox.setBounds (proportionOfWidth(0.74), proportionOfHeight(0.226), proportionOfWidth(0.2), proportionOfHeight(0.024));
+    m_storageBox.setBounds (proportionOfWidth (0.7), proportionOfHeight (0.849), proportionOfWidth (0.2), proportionOfHeight (0.024));
+    m_tapSpacingKnob.setBounds (proportionOfWidth(0.05), proportionOfHeight(0.316), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_tapSpreadKnob.setBounds (proportionOfWidth(0.28), proportionOfHeight(0.316), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_tapDecayKnob.setBounds (proportionOfWidth(0.51), proportionOfHeight(0.316), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_tapFeedbackButton.setBounds (proportionOfWidth (0.74), proportionOfHeight (0.345), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_filterBox.setBounds (proportionOfWidth(0.1), proportionOfHeight(0.471), proportionOfWidth(0.2), proportionOfHeight(0.024));
+    m_filterFreqKnob.setBounds (proportionOfWidth(0.4), proportionOfHeight(0.441), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_filterTiltKnob.setBounds (proportionOfWidth(0.7), proportionOfHeight(0.441), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_saturationBox.setBounds (proportionOfWidth(0.1), proportionOfHeight(0.596), proportionOfWidth(0.2), proportionOfHeight(0.024));
+    m_driveKnob.setBounds (proportionOfWidth(0.4), proportionOfHeight(0.566), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_oversamplingBox.setBounds (proportionOfWidth(0.7), proportionOfHeight(0.596), proportionOfWidth(0.2), proportionOfHeight(0.024));
+    m_delayRightKnob.setBounds (proportionOfWidth(0.05), proportionOfHeight(0.691), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_linkButton.setBounds (proportionOfWidth(0.28), proportionOfHeight(0.698), proportionOfWidth(0.2), proportionOfHeight(0.03));
+    m_pingPongButton.setBounds (proportionOfWidth(0.28), proportionOfHeight(0.741), proportionOfWidth(0.2), proportionOfHeight(0.03));
+    m_crossfeedKnob.setBounds (proportionOfWidth(0.51), proportionOfHeight(0.691), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_widthKnob.setBounds (proportionOfWidth(0.74), proportionOfHeight(0.691), proportionOfWidth(0.2), proportionOfHeight(0.089));
+    m_convolutionButton.setBounds (proportionOfWidth (0.05), proportionOfHeight (0.79), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_loadResponseButton.setBounds (proportionOfWidth (0.28), proportionOfHeight (0.79), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_echoResponseButton.setBounds (proportionOfWidth (0.51), proportionOfHeight (0.79), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_responseLabel.setBounds (proportionOfWidth (0.72), proportionOfHeight (0.79), proportionOfWidth (0.26), proportionOfHeight (0.03));
+    m_diffusionBox.setBounds (proportionOfWidth (0.1), proportionOfHeight (0.849), proportionOfWidth (0.2), proportionOfHeight (0.024));
+    m_matrixBox.setBounds (proportionOfWidth (0.4), proportionOfHeight (0.849), proportionOfWidth (0.2), proportionOfHeight (0.024));
+    m_syncButton.setBounds (proportionOfWidth (0.1), proportionOfHeight (0.917), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_noteBox.setBounds (proportionOfWidth (0.4), proportionOfHeight (0.922), proportionOfWidth (0.2), proportionOfHeight (0.024));
+    m_syncTimeLabel.setBounds (proportionOfWidth (0.4), proportionOfHeight (0.887), proportionOfWidth (0.4), proportionOfHeight (0.03));
+    m_bypassButton.setBounds (proportionOfWidth (0.7), proportionOfHeight (0.917), proportionOfWidth (0.2), proportionOfHeight (0.03));
+    m_performanceLabel.setBounds (proportionOfWidth (0.05), proportionOfHeight (0.963), proportionOfWidth (0.65), proportionOfHeight (0.03));
+    m_exportButton.setBounds (proportionOfWidth (0.74), proportionOfHeight (0.963), proportionOfWidth (0.2), proportionOfHeight (0.03));
 }
 
 void StereoDelayEditor::sliderValueChanged (Slider* slider)
@@ -102,6 +538,10 @@ void StereoDelayEditor::sliderValueChanged (Slider* slider)
     {
         processor->setParameterNotifyingHost (StereoDelayProcessor::DELAY, m_delayKnob.getValue());
     }
+    else if (slider == &m_longDelayKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::LONG_DELAY, m_longDelayKnob.getValue());
+    }
     else if (slider == &m_feedbackKnob)
     {
         processor->setParameterNotifyingHost (StereoDelayProcessor::FEEDBACK, m_feedbackKnob.getValue());
@@ -110,6 +550,54 @@ void StereoDelayEditor::sliderValueChanged (Slider* slider)
     {
         processor->setParameterNotifyingHost (StereoDelayProcessor::MIX, m_mixKnob.getValue());
     }
+    else if (slider == &m_rateKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::MOD_RATE, m_rateKnob.getValue());
+    }
+    else if (slider == &m_depthKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::MOD_DEPTH, m_depthKnob.getValue());
+    }
+    else if (slider == &m_tapsKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::TAPS, m_tapsKnob.getValue());
+    }
+    else if (slider == &m_tapSpacingKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::TAP_SPACING, m_tapSpacingKnob.getValue());
+    }
+    else if (slider == &m_tapSpreadKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::TAP_SPREAD, m_tapSpreadKnob.getValue());
+    }
+    else if (slider == &m_tapDecayKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::TAP_DECAY, m_tapDecayKnob.getValue());
+    }
+    else if (slider == &m_filterFreqKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::FILTER_FREQ, m_filterFreqKnob.getValue());
+    }
+    else if (slider == &m_filterTiltKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::FILTER_TILT, m_filterTiltKnob.getValue());
+    }
+    else if (slider == &m_driveKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::DRIVE, m_driveKnob.getValue());
+    }
+    else if (slider == &m_delayRightKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::DELAY_RIGHT, m_delayRightKnob.getValue());
+    }
+    else if (slider == &m_crossfeedKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::CROSSFEED, m_crossfeedKnob.getValue());
+    }
+    else if (slider == &m_widthKnob)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::WIDTH, m_widthKnob.getValue());
+    }
 }
 
 void StereoDelayEditor::buttonClicked (Button* button)
@@ -120,4 +608,166 @@ void StereoDelayEditor::buttonClicked (Button* button)
     {
         processor->setParameterNotifyingHost (StereoDelayProcessor::BYPASS, static_cast<float>(m_bypassButton.getToggleState()));
     }
+    else if (button == &m_tapFeedbackButton)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::TAP_FEEDBACK, static_cast<float> (m_tapFeedbackButton.getToggleState()));
+    }
+    else if (button == &m_syncButton)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::SYNC, static_cast<float>(m_syncButton.getToggleState()));
+        m_delayKnob.setEnabled (! m_syncButton.getToggleState());
+        updateSyncTimeLabel();
+    }
+    else if (button == &m_linkButton)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::LINK, static_cast<float>(m_linkButton.getToggleState()));
+        m_delayRightKnob.setEnabled (! m_linkButton.getToggleState());
+    }
+    else if (button == &m_pingPongButton)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::PING_PONG, static_cast<float>(m_pingPongButton.getToggleState()));
+        m_crossfeedKnob.setEnabled (! m_pingPongButton.getToggleState());
+    }
+    else if (button == &m_convolutionButton)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::CONVOLUTION, static_cast<float>(m_convolutionButton.getToggleState()));
+    }
+    else if (button == &m_loadResponseButton)
+    {
+        FileChooser chooser ("Load an impulse response", File(), "*.wav;*.aif;*.aiff;*.flac");
+        if (chooser.browseForFileToOpen() && ! processor->loadImpulseResponse (chooser.getResult()))
+        {
+            AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Load IR", "The impulse response couldn't be read from " + chooser.getResult().getFileName());
+        }
+        updateResponseLabel();
+    }
+    else if (button == &m_echoResponseButton)
+    {
+        processor->generateImpulseResponse();
+        updateResponseLabel();
+    }
+    else if (button == &m_exportButton)
+    {
+        FileChooser chooser ("Export callback timings", File(), "*.csv;*.json");
+        if (chooser.browseForFileToSave (true))
+        {
+            const File file = chooser.getResult();
+            const PerformanceMonitor& monitor = processor->getPerformanceMonitor();
+            const std::string text = file.hasFileExtension ("json") ? monitor.exportJSON() : monitor.exportCSV();
+            if (! file.replaceWithText (String (text)))
+            {
+                AlertWindow::showMessageBoxAsync (AlertWindow::WarningIcon, "Export", "The timings couldn't be written to " + file.getFileName());
+            }
+        }
+    }
+}
+
+void StereoDelayEditor::comboBoxChanged (ComboBox* comboBox)
+{
+    auto processor = getProcessor();
+
+    if (comboBox == &m_interpolationBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::INTERPOLATION, static_cast<float> (m_interpolationBox.getSelectedId() - 1));
+    }
+    else if (comboBox == &m_noteBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::NOTE, static_cast<float> (m_noteBox.getSelectedId() - 1));
+        updateSyncTimeLabel();
+    }
+    else if (comboBox == &m_filterBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::FILTER, static_cast<float> (m_filterBox.getSelectedId() - 1));
+        updateFilterControls();
+    }
+    else if (comboBox == &m_saturationBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::SATURATION, static_cast<float> (m_saturationBox.getSelectedId() - 1));
+        updateDriveControls();
+    }
+    else if (comboBox == &m_oversamplingBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::OVERSAMPLING, static_cast<float> (m_oversamplingBox.getSelectedId() - 1));
+    }
+    else if (comboBox == &m_storageBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::STORAGE, static_cast<float> (m_storageBox.getSelectedId() - 1));
+    }
+    else if (comboBox == &m_diffusionBox)
+    {
+        const int id = m_diffusionBox.getSelectedId();
+        const int lines = (id > 1) ? FeedbackDelayNetwork::s_minLines << (id - 2) : 0;
+        processor->setParameterNotifyingHost (StereoDelayProcessor::DIFFUSION, static_cast<float> (lines));
+        updateDiffusionControls (lines);
+    }
+    else if (comboBox == &m_matrixBox)
+    {
+        processor->setParameterNotifyingHost (StereoDelayProcessor::DIFFUSION_MATRIX, static_cast<float> (m_matrixBox.getSelectedId() - 1));
+    }
+}
+
+void StereoDelayEditor::updateFilterControls()
+{
+    const int type = m_filterBox.getSelectedId() - 1;
+    m_filterFreqKnob.setEnabled (type != FeedbackFilter::OFF);
+    m_filterTiltKnob.setEnabled (type == FeedbackFilter::TILT);
+}
+
+void StereoDelayEditor::updateResponseLabel()
+{
+    m_responseLabel.setText (getProcessor()->getImpulseResponseName(), dontSendNotification);
+}
+
+void StereoDelayEditor::timerCallback()
+{
+    updatePerformanceLabel();
+    updateSyncTimeLabel();
+}
+
+void StereoDelayEditor::updatePerformanceLabel()
+{
+    const PerformanceMonitor::Stats stats = getProcessor()->getPerformanceMonitor().getStats();
+    if (stats.numCallbacks == 0)
+    {
+        m_performanceLabel.setText ("No callbacks timed yet", dontSendNotification);
+        return;
+    }
+
+    m_performanceLabel.setText (String (stats.median * 1e-3, 1) + " / " + String (stats.p99 * 1e-3, 1) + " / " + String (stats.max * 1e-3, 1) + " us, "
+                                + String (stats.nsPerSample, 1) + " ns/sample, load " + String (stats.maxLoad * 100.0, 0) + "%, "
+                                + String (static_cast<int64> (stats.numSpikes)) + " spikes", dontSendNotification);
+}
+
+void StereoDelayEditor::updateDiffusionControls (const int numLines)
+{
+    // Any other number of lines is rounded up the same way as the network does.
+    int id = 1;
+    if (numLines > 0)
+    {
+        id = 2;
+        for (int lines = FeedbackDelayNetwork::s_minLines; lines < numLines && lines < FeedbackDelayNetwork::s_maxLines; lines *= 2) { ++id; }
+    }
+    m_diffusionBox.setSelectedId (id, dontSendNotification);
+    m_matrixBox.setEnabled (numLines > 0);
+}
+
+void StereoDelayEditor::updateDriveControls()
+{
+    const bool active = m_saturationBox.getSelectedId() - 1 != Saturator::OFF;
+    m_driveKnob.setEnabled (active);
+    m_oversamplingBox.setEnabled (active);
+}
+
+void StereoDelayEditor::updateSyncTimeLabel()
+{
+    if (! m_syncButton.getToggleState())
+    {
+        m_syncTimeLabel.setText (String(), dontSendNotification);
+        return;
+    }
+
+    const float delay = getProcessor()->getSyncDelayTime();
+    String text = String (delay, 0) + " msecs";
+    if (delay > StereoDelayProcessor::s_maxDelay) { text += ", limited to " + String (StereoDelayProcessor::s_maxDelay); }
+    m_syncTimeLabel.setText (text, dontSendNotification);
 }
@@ -4,10 +4,8 @@
  * \author Chris Harless (chris.harless3@gmail.com)
  *
  * Ideas for new features and improvements:
- *     1. Add separate delay time parameters for each channel.
- *     2. Add optional modulation to the delayed signals (with controls like rate/depth).
- *     3. Add optional fuzz/distortion/noise to the delayed signals (with controls like volume/gain).
- *     4. Add send/receive ports to allow users to process delayed signals with
+ *     1. Add optional noise to the delayed signals (with a level control).
+ *     2. Add send/receive ports to allow users to process delayed signals with
  *        other VST plugins or algorithms.
  */
 
@@ -20,11 +18,21 @@
 /**
  * \brief Editor user interface class for a stereo delay VST plugin.
  *
- * This class builds a user interface with three parameters (delay time, feedback, mix)
- * and a bypass button. The parameters can be changed by turning their respective knobs.
- * Currently, this editor supports delay values up to 2 seconds.
+ * This class builds a user interface with four parameters (delay time, long delay time,
+ * feedback, mix), delay modulation controls (rate, depth), multi-tap controls (the number of
+ * taps, their spacing, stereo spread, decay and feedback), an interpolation selector, feedback
+ * filter controls (type, frequency, tilt), feedback drive controls (curve, drive,
+ * oversampling), stereo routing controls (right delay, link, ping-pong, cross-feedback, width),
+ * convolution controls (on/off, impulse response file, generated echoes), diffusion controls,
+ * tempo sync controls, a bypass button and a readout of the processing callback timings. The
+ * parameters can be changed by turning their respective knobs. With tempo sync on, the delay
+ * time comes from the note value and host tempo, and a linked right channel follows the left.
+ * The delay knob goes up to 2 seconds, and a long delay of up to
+ * StereoDelayProcessor::s_maxLongDelay seconds replaces it when the long delay knob isn't at
+ * zero.
  */
-class StereoDelayEditor : public AudioProcessorEditor, public SliderListener, public ButtonListener
+class StereoDelayEditor : public AudioProcessorEditor, public SliderListener, public ButtonListener, public ComboBoxListener,
+                          private Timer
 {
 public:
 
@@ -73,16 +81,91 @@ public:
      */
     void buttonClicked (Button* button) override;
 
+    /**
+     * Listener method for capturing combo box selections.
+     *
+     * \param[in]  ComboBox*  Combo box that was changed
+     */
+    void comboBoxChanged (ComboBox* comboBox) override;
+
 private:
 
+    void updateFilterControls(); ///< Enables the feedback filter knobs that apply to the selected filter type.
+    void updateDriveControls(); ///< Enables the drive controls when a drive curve is selected.
+    void updateSyncTimeLabel(); ///< Shows the delay time of the synced note value at the current tempo.
+    void updateResponseLabel(); ///< Shows the name of the impulse response for the convolution mode.
+    void updatePerformanceLabel(); ///< Shows the callback timings from the processor's performance monitor.
+    void timerCallback() override; ///< Refreshes the callback timings and the synced delay time.
+
+    static const int s_refreshRate = 2; ///< Number of times a second the callback timings and synced delay time are refreshed (Hz).
+
+    /**
+     * Shows the number of diffusion lines, and enables the matrix selector when diffusion is on.
+     *
+     * \param[in]  int  Number of lines (0 = off)
+     */
+    void updateDiffusionControls (const int numLines);
+
     Label m_pluginLabel; ///< Plugin name label.
     Label m_delayLabel; ///< Delay knob label.
     Slider m_delayKnob; ///< Knob for adjusting the delay time (msecs).
+    Label m_longDelayLabel; ///< Long delay knob label.
+    Slider m_longDelayKnob; ///< Knob for adjusting the long delay time (secs, 0 = off).
     Label m_feedbackLabel; ///< Feedback knob label.
     Slider m_feedbackKnob; ///< Knob for adjusting the feedback (%).
     Label m_mixLabel; ///< Mix knob label.
     Slider m_mixKnob; ///< Knob for adjusting the wet/dry mix (%).
+    Label m_rateLabel; ///< Modulation rate knob label.
+    Slider m_rateKnob; ///< Knob for adjusting the delay modulation rate (Hz).
+    Label m_depthLabel; ///< Modulation depth knob label.
+    Slider m_depthKnob; ///< Knob for adjusting the delay modulation depth (msecs).
+    Label m_tapsLabel; ///< Taps knob label.
+    Slider m_tapsKnob; ///< Knob for adjusting the number of delay taps.
+    Label m_tapSpacingLabel; ///< Tap spacing knob label.
+    Slider m_tapSpacingKnob; ///< Knob for adjusting the tap spacing (%).
+    Label m_tapSpreadLabel; ///< Tap spread knob label.
+    Slider m_tapSpreadKnob; ///< Knob for adjusting the tap stereo spread (%).
+    Label m_tapDecayLabel; ///< Tap decay knob label.
+    Slider m_tapDecayKnob; ///< Knob for adjusting the tap level decay (%).
+    TextButton m_tapFeedbackButton; ///< Button for feeding back every tap instead of just the last one.
+    Label m_interpolationLabel; ///< Interpolation selector label.
+    ComboBox m_interpolationBox; ///< Selector for the fractional delay interpolation type.
+    Label m_filterLabel; ///< Feedback filter selector label.
+    ComboBox m_filterBox; ///< Selector for the feedback filter type.
+    Label m_filterFreqLabel; ///< Feedback filter frequency knob label.
+    Slider m_filterFreqKnob; ///< Knob for adjusting the feedback filter cutoff/pivot frequency (Hz).
+    Label m_filterTiltLabel; ///< Feedback filter tilt knob label.
+    Slider m_filterTiltKnob; ///< Knob for adjusting the feedback filter tilt (dB).
+    Label m_saturationLabel; ///< Feedback drive curve selector label.
+    ComboBox m_saturationBox; ///< Selector for the feedback drive curve.
+    Label m_driveLabel; ///< Drive knob label.
+    Slider m_driveKnob; ///< Knob for adjusting the feedback drive (dB).
+    Label m_oversamplingLabel; ///< Oversampling selector label.
+    ComboBox m_oversamplingBox; ///< Selector for the feedback drive oversampling factor.
+    Label m_delayRightLabel; ///< Right delay knob label.
+    Slider m_delayRightKnob; ///< Knob for adjusting the right channel delay time (msecs).
+    TextButton m_linkButton; ///< Button for linking the right channel delay time to the left.
+    TextButton m_pingPongButton; ///< Button for bouncing the echoes between the channels.
+    Label m_crossfeedLabel; ///< Cross-feedback knob label.
+    Slider m_crossfeedKnob; ///< Knob for adjusting the cross-feedback between the channels (%).
+    Label m_widthLabel; ///< Width knob label.
+    Slider m_widthKnob; ///< Knob for adjusting the stereo width of the delayed signal (%).
+    Label m_storageLabel; ///< Storage selector label.
+    ComboBox m_storageBox; ///< Selector for the delay buffer storage format.
+    TextButton m_convolutionButton; ///< Button for convolving with the impulse response instead of delaying.
+    TextButton m_loadResponseButton; ///< Button for loading an impulse response file.
+    TextButton m_echoResponseButton; ///< Button for generating an echo impulse response from the delay time and feedback.
+    Label m_responseLabel; ///< Name of the impulse response.
+    Label m_diffusionLabel; ///< Diffusion selector label.
+    ComboBox m_diffusionBox; ///< Selector for the number of feedback delay network lines.
+    Label m_matrixLabel; ///< Matrix selector label.
+    ComboBox m_matrixBox; ///< Selector for the feedback delay network mixing matrix.
+    TextButton m_syncButton; ///< Button for syncing the delay time to the host tempo.
+    ComboBox m_noteBox; ///< Selector for the tempo-synced note value.
+    Label m_syncTimeLabel; ///< Delay time of the synced note value, and whether it's limited to the longest delay.
     TextButton m_bypassButton; ///< Button for bypassing the effect processor.
+    Label m_performanceLabel; ///< Callback timings (median / 99th percentile / longest, time per sample, load, spikes).
+    TextButton m_exportButton; ///< Button for exporting the callback timings as CSV or JSON.
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StereoDelayEditor)
 };
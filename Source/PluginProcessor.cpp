@@ -17,52 +17,375 @@ StereoDelayProcessor::StereoDelayProcessor()
                         .withOutput ("Output", AudioChannelSet::stereo(), true)
                     #endif
                     ),
-    m_numParams(4),
+    m_numParams(30),
     m_delay(0.0f),
     m_feedback(0.0f),
     m_mix(50.0f),
     m_bypass(false),
-	m_delayChannel0(),
-	m_delayChannel1()
-	
+    m_modRate(1.0f),
+    m_modDepth(0.0f),
+    m_interpolation(Interpolators::LINEAR),
+    m_taps(1),
+    m_tapSpacing(0.0f),
+    m_tapSpread(50.0f),
+    m_tapDecay(0.0f),
+    m_tapFeedback(false),
+    m_sync(false),
+    m_note(TempoSync::QUARTER),
+    m_filter(FeedbackFilter::OFF),
+    m_filterFreq(4000.0f),
+    m_filterTilt(-6.0f),
+    m_saturation(Saturator::OFF),
+    m_drive(6.0f),
+    m_oversampling(0),
+    m_delayRight(0.0f),
+    m_link(true),
+    m_pingPong(false),
+    m_crossfeed(0.0f),
+    m_width(100.0f),
+    m_longDelay(0.0f),
+    m_storage(TieredDelayBuffer::FLOAT32),
+    m_convolution(false),
+    m_diffusion(0),
+    m_diffusionMatrix(FeedbackDelayNetwork::HADAMARD),
+    m_paramsChanged(true),
+    m_resourcesChanged(false),
+    m_tempo(120.0),
+    m_sampleCount(0),
+    m_lastTap(-1),
+    m_delayLines(),
+    m_numChannels(0),
+    m_monoInput(false),
+    m_groupSize(0),
+    m_workers(),
+    m_groupChannels(),
+    m_groupStart(0),
+    m_groupNumSamples(0),
+    m_response(),
+    m_responseRate(44100.0),
+    m_responseFile(),
+    m_responseLength(0.0f),
+    m_monitor()
 #endif
-{}
+{
+    createDelayLines (2);
+
+    for (auto& param : m_controllerMap) { param = -1; }
+    setControllerMapping (12, DELAY);
+    setControllerMapping (13, FEEDBACK);
+    setControllerMapping (14, MIX);
+    setControllerMapping (15, MOD_RATE);
+    setControllerMapping (16, MOD_DEPTH);
+    startTimer (s_resourceInterval);
+}
 
-void StereoDelayProcessor::prepareToPlay (double /*sampleRate*/, int /*samplesPerBlock*/)
+bool StereoDelayProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    m_delayChannel0.reset();
-    m_delayChannel1.reset();
+    const AudioChannelSet output = layouts.getMainOutputChannelSet();
+    const AudioChannelSet input = layouts.getMainInputChannelSet();
+    if (output.isDisabled() || output.size() > s_maxChannels) { return false; }
+
+    return input == output || input == AudioChannelSet::mono();
 }
 
-void StereoDelayProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& /*midiMessages*/)
+void StereoDelayProcessor::createDelayLines (const int numChannels)
 {
-    auto channel0 = buffer.getWritePointer(0);
-    auto channel1 = buffer.getWritePointer(1);
+    // Use the fewest groups that hold every channel, so the grouping (and with it the diffusion
+    // network and long delay store of each group) only depends on the layout and never on the
+    // machine. Groups are shared out evenly and rounded up to whole frames of four channels.
+    const int maxGroupSize = MultiChannelDelayLine::s_maxChannels;
+    const int numGroups = (numChannels + maxGroupSize - 1) / maxGroupSize;
+    m_groupSize = jmin (maxGroupSize, (((numChannels + numGroups - 1) / numGroups) + 3) & ~3);
+    m_numChannels = numChannels;
 
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    m_delayLines.clear();
+    for (int first = 0; first < numChannels; first += m_groupSize)
     {
-        // Process the first channel.
-        channel0[i] = m_delayChannel0.processSample(channel0[i]);                
-        
-        // Process the second channel. Just copy the first channel for mono output.
-        if (getTotalNumInputChannels() == 1 && getTotalNumOutputChannels() == 2) { channel1[i] = channel0[i]; }
-        else if (getTotalNumInputChannels() == 2 && getTotalNumOutputChannels() == 2) { channel1[i] = m_delayChannel1.processSample(channel1[i]); }             
+        m_delayLines.emplace_back (new MultiChannelDelayLine (jmin (m_groupSize, numChannels - first)));
+
+        // Glide the delay time and ramp the levels so automation doesn't cause zipper noise or clicks.
+        m_delayLines.back()->setSmoothing (ParameterSmoother::ONE_POLE, 100, ParameterSmoother::LINEAR, 20);
     }
 
-    // Clear any additional output channels.
-    for (int i = getTotalNumInputChannels(); i < getTotalNumOutputChannels(); ++i) { buffer.clear (i, 0, buffer.getNumSamples()); }
+    // Only layouts with more than one group need the pool, which every instance shares. Without
+    // realtime priority, a worker preempted in the middle of a group would hold up the audio
+    // thread, so the groups are processed one after the other on the audio thread instead.
+    m_workers = (m_delayLines.size() > 1) ? WorkerPool::getShared() : nullptr;
+    if (m_workers != nullptr && ! m_workers->isRealtime()) { m_workers = nullptr; }
+    m_paramsChanged = true;
 }
 
-void StereoDelayProcessor::processBlockBypassed (AudioSampleBuffer& buffer, MidiBuffer& /*midiMessages*/)
+void StereoDelayProcessor::prepareToPlay (double sampleRate, int /*samplesPerBlock*/)
 {
-    for (int channel = 0; channel < getTotalNumInputChannels(); ++channel)
+    const int numChannels = jlimit (1, s_maxChannels, getMainBusNumOutputChannels());
+    if (numChannels != m_numChannels) { createDelayLines (numChannels); }
+    m_monoInput = (getMainBusNumInputChannels() == 1 && numChannels > 1);
+
+    const auto storage = static_cast<TieredDelayBuffer::Format> (m_storage.load());
+    for (auto& delayLine : m_delayLines) { delayLine->prepare (sampleRate, s_maxDelay, false, storage); }
+    m_resourcesChanged = false;
+    updateResources (true);
+    m_sampleCount = 0;
+    m_lastTap = -1;
+    m_monitor.prepare (sampleRate);
+}
+
+void StereoDelayProcessor::updateResources (const bool reprepare)
+{
+    const bool longDelay = m_longDelay > 0;
+    const bool convolution = m_convolution;
+    const bool diffusion = m_diffusion > 0;
+    const auto storage = static_cast<TieredDelayBuffer::Format> (m_storage.load());
+    bool applyResponse = false;
+    for (auto& delayLine : m_delayLines)
     {
-        auto data = buffer.getWritePointer(channel);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
+        // The buffer is only reallocated in another format, which clears it.
+        if (delayLine->getStorageFormat() != storage) { delayLine->prepare (getSampleRate(), s_maxDelay, false, storage); }
+
+        // Half precision halves the spill file for the longest delays, and its rounding noise stays
+        // about 75 dB below the signal.
+        if (! longDelay) { delayLine->releaseLongDelay(); }
+        else if (reprepare || ! delayLine->isLongDelayReady())
         {
-            data[i] = data[i];            
+            delayLine->prepareLongDelay (s_maxLongDelay * 1000.0f, File::getSpecialLocation (File::tempDirectory).getFullPathName().toStdString(),
+                                         TieredDelayBuffer::FLOAT16);
         }
+
+        if (! convolution) { delayLine->releaseConvolution(); }
+        else if (reprepare || ! delayLine->isConvolutionReady()) { applyResponse = true; }
+
+        if (! diffusion) { delayLine->releaseDiffusion(); }
+        else if (reprepare || ! delayLine->isDiffusionReady()) { delayLine->prepareDiffusion (s_maxDelay); }
+    }
+
+    if (applyResponse)
+    {
+        createImpulseResponse();
+        applyImpulseResponse();
+    }
+}
+
+bool StereoDelayProcessor::isResourceUpdateNeeded() const
+{
+    const bool longDelay = m_longDelay > 0;
+    const bool convolution = m_convolution;
+    const bool diffusion = m_diffusion > 0;
+    const auto storage = static_cast<TieredDelayBuffer::Format> (m_storage.load());
+    for (auto& delayLine : m_delayLines)
+    {
+        if (delayLine->isLongDelayReady() != longDelay || delayLine->isConvolutionReady() != convolution
+            || delayLine->isDiffusionReady() != diffusion || delayLine->getStorageFormat() != storage) { return true; }
     }
+    return false;
+}
+
+void StereoDelayProcessor::timerCallback()
+{
+    // Nothing is prepared before prepareToPlay(), which prepares everything that's switched on.
+    if (! m_resourcesChanged.exchange (false) || getSampleRate() <= 0 || ! isResourceUpdateNeeded()) { return; }
+
+    suspendProcessing (true);
+    updateResources (false);
+    suspendProcessing (false);
+    m_paramsChanged = true;
+}
+
+bool StereoDelayProcessor::loadImpulseResponse (const File& file)
+{
+    if (! readImpulseResponse (file)) { return false; }
+    updateConvolution();
+    return true;
+}
+
+void StereoDelayProcessor::generateImpulseResponse()
+{
+    createEchoResponse();
+    updateConvolution();
+}
+
+void StereoDelayProcessor::updateConvolution()
+{
+    if (! m_convolution || getSampleRate() <= 0) { return; }
+
+    suspendProcessing (true);
+    createImpulseResponse();
+    applyImpulseResponse();
+    suspendProcessing (false);
+}
+
+bool StereoDelayProcessor::readImpulseResponse (const File& file)
+{
+    AudioFormatManager formats;
+    formats.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader (formats.createReaderFor (file));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0) { return false; }
+
+    const int length = static_cast<int> (jmin<int64> (reader->lengthInSamples, static_cast<int64> (reader->sampleRate * s_maxResponseLength)));
+    const int numChannels = jlimit (1, s_maxChannels, static_cast<int> (reader->numChannels));
+    AudioSampleBuffer response (numChannels, length);
+    reader->read (&response, 0, length, 0, true, true);
+
+    m_response = response;
+    m_responseRate = reader->sampleRate;
+    m_responseFile = file.getFullPathName();
+    return true;
+}
+
+void StereoDelayProcessor::createImpulseResponse()
+{
+    if (m_response.getNumSamples() > 0) { return; }
+
+    // A missing file falls back to echoes, like a generated response.
+    if (m_responseFile.isEmpty() || ! readImpulseResponse (File (m_responseFile))) { createEchoResponse(); }
+}
+
+String StereoDelayProcessor::getImpulseResponseName() const
+{
+    return m_responseFile.isEmpty() ? String ("Generated echoes") : File (m_responseFile).getFileName();
+}
+
+void StereoDelayProcessor::createEchoResponse()
+{
+    const double fs = getSampleRate() > 0 ? getSampleRate() : 44100.0;
+    const float delay = m_sync ? getSyncDelayTime() : m_delay.load();
+    const std::vector<float> response = PartitionedConvolver::makeEchoResponse (fs, jmax (delay, 1.0f), m_feedback/100, s_maxResponseLength * 1000.0f);
+
+    m_response.setSize (1, static_cast<int> (response.size()));
+    m_response.copyFrom (0, 0, response.data(), static_cast<int> (response.size()));
+    m_responseRate = fs;
+    m_responseFile = String();
+}
+
+void StereoDelayProcessor::applyImpulseResponse()
+{
+    const int numChannels = m_response.getNumChannels();
+    const int length = m_response.getNumSamples();
+    const double fs = getSampleRate();
+    if (numChannels == 0 || length == 0) { return; }
+
+    if (fs <= 0 || fs == m_responseRate)
+    {
+        setImpulseResponse (m_response.getArrayOfReadPointers(), numChannels, length);
+        m_responseLength = static_cast<float> (length / m_responseRate);
+        return;
+    }
+
+    // Resample with JUCE's interpolator (not the delay line's interpolation policy of the same
+    // name), and scale the response so the level of the convolution stays the same.
+    const double ratio = m_responseRate / fs;
+    const int resampledLength = jmax (1, static_cast<int> (length / ratio));
+    AudioSampleBuffer resampled (numChannels, resampledLength);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        juce::LagrangeInterpolator interpolator;
+        interpolator.process (ratio, m_response.getReadPointer (c), resampled.getWritePointer (c), resampledLength);
+        resampled.applyGain (c, 0, resampledLength, static_cast<float> (ratio));
+    }
+
+    setImpulseResponse (resampled.getArrayOfReadPointers(), numChannels, resampledLength);
+    m_responseLength = static_cast<float> (resampledLength / fs);
+}
+
+void StereoDelayProcessor::setImpulseResponse (const float* const* response, const int numResponseChannels, const int length)
+{
+    const float* channels[MultiChannelDelayLine::s_maxChannels];
+    for (size_t group = 0; group < m_delayLines.size(); ++group)
+    {
+        // A mono response is shared as it is, so each convolver only partitions it once.
+        MultiChannelDelayLine& delayLine = *m_delayLines[group];
+        const int numChannels = (numResponseChannels == 1) ? 1 : delayLine.getNumChannels();
+        for (int c = 0; c < numChannels; ++c) { channels[c] = response[(static_cast<int> (group)*m_groupSize + c) % numResponseChannels]; }
+        delayLine.setImpulseResponse (channels, numChannels, length);
+    }
+}
+
+void StereoDelayProcessor::processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages)
+{
+    PerformanceMonitor::ScopedTimer timer (m_monitor, buffer.getNumSamples());
+    DelayKernels::ScopedNoDenormals noDenormals;
+    updateTempo();
+    updateParameters();
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = m_numChannels;
+    for (int c = 0; c < numChannels; ++c) { m_groupChannels[c] = buffer.getWritePointer (c); }
+    copyMonoInput (buffer);
+
+    // Process all of the channels, up to each MIDI event and then from the event onwards.
+    int done = 0;
+    MidiBuffer::Iterator events (midiMessages);
+    MidiMessage message;
+    int samplePosition = 0;
+    while (events.getNextEvent (message, samplePosition))
+    {
+        samplePosition = jlimit (0, numSamples, samplePosition);
+        if (samplePosition > done)
+        {
+            processGroups (done, samplePosition - done);
+            done = samplePosition;
+        }
+
+        handleMidiEvent (message, samplePosition);
+    }
+
+    if (done < numSamples) { processGroups (done, numSamples - done); }
+    m_sampleCount += numSamples;
+}
+
+void StereoDelayProcessor::copyMonoInput (AudioSampleBuffer& buffer) const
+{
+    if (! m_monoInput) { return; }
+    for (int c = 1; c < m_numChannels; ++c) { buffer.copyFrom (c, 0, buffer, 0, 0, buffer.getNumSamples()); }
+}
+
+void StereoDelayProcessor::processGroups (const int startSample, const int numSamples)
+{
+    // The delay lines share the bypass parameter, so there's no need to wake the workers.
+    if (m_delayLines.front()->isBypassed()) { return; }
+
+    m_groupStart = startSample;
+    m_groupNumSamples = numSamples;
+    const int numGroups = static_cast<int> (m_delayLines.size());
+
+    // A short run isn't worth handing to the workers, since a worker that's slow to finish its
+    // group holds up the whole block.
+    if (m_workers == nullptr || numSamples < s_minParallelSamples)
+    {
+        for (int index = 0; index < numGroups; ++index) { processGroup (this, index); }
+        return;
+    }
+    m_workers->run (numGroups, &StereoDelayProcessor::processGroup, this);
+}
+
+void StereoDelayProcessor::processGroup (void* context, const int index)
+{
+    // The worker threads need denormals flushed as much as the audio thread does.
+    DelayKernels::ScopedNoDenormals noDenormals;
+    auto processor = static_cast<StereoDelayProcessor*> (context);
+    processor->m_delayLines[index]->processBlock (processor->m_groupChannels + index*processor->m_groupSize,
+                                                  processor->m_groupStart, processor->m_groupNumSamples);
+}
+
+void StereoDelayProcessor::processBlockBypassed (AudioSampleBuffer& buffer, MidiBuffer& /*midiMessages*/)
+{
+    copyMonoInput (buffer);
+}
+
+double StereoDelayProcessor::getTailLengthSeconds() const
+{
+    if (m_bypass) { return 0.0; }
+
+    // The longest delay is the full delay time plus the modulation swing, or the last tap in multi-tap mode.
+    // Unlinked channels decay at the pace of the longer one, and a ping-pong echo visits both channels.
+    // The long delay mode replaces the delay time altogether, and the convolution mode lasts as long as its response.
+    // The diffusion mode ignores the long delay, and its longest line decays like a single delay.
+    if (m_convolution) { return m_responseLength; }
+
+    float delay = m_sync ? getSyncDelayTime() : m_delay.load();
+    if (! m_link) { delay = m_pingPong ? (delay + m_delayRight)/2 : jmax (delay, m_delayRight.load()); }
+    if (m_longDelay > 0 && m_diffusion == 0) { delay = m_longDelay * 1000; }
+    const double tail = DelayLine::getTailTime (delay + m_modDepth, m_feedback/100) * 1e-3;
+    return jmin (tail, s_maxTailTime);
 }
 
 float StereoDelayProcessor::getParameter (int param)
@@ -77,6 +400,58 @@ float StereoDelayProcessor::getParameter (int param)
             return m_mix;
         case BYPASS:
             return m_bypass;
+        case MOD_RATE:
+            return m_modRate;
+        case MOD_DEPTH:
+            return m_modDepth;
+        case INTERPOLATION:
+            return static_cast<float> (m_interpolation);
+        case TAPS:
+            return static_cast<float> (m_taps);
+        case TAP_SPACING:
+            return m_tapSpacing;
+        case TAP_SPREAD:
+            return m_tapSpread;
+        case TAP_DECAY:
+            return m_tapDecay;
+        case TAP_FEEDBACK:
+            return m_tapFeedback;
+        case SYNC:
+            return m_sync;
+        case NOTE:
+            return static_cast<float> (m_note);
+        case FILTER:
+            return static_cast<float> (m_filter);
+        case FILTER_FREQ:
+            return m_filterFreq;
+        case FILTER_TILT:
+            return m_filterTilt;
+        case SATURATION:
+            return static_cast<float> (m_saturation);
+        case DRIVE:
+            return m_drive;
+        case OVERSAMPLING:
+            return static_cast<float> (m_oversampling);
+        case DELAY_RIGHT:
+            return m_delayRight;
+        case LINK:
+            return m_link;
+        case PING_PONG:
+            return m_pingPong;
+        case CROSSFEED:
+            return m_crossfeed;
+        case WIDTH:
+            return m_width;
+        case LONG_DELAY:
+            return m_longDelay;
+        case STORAGE:
+            return static_cast<float> (m_storage);
+        case CONVOLUTION:
+            return m_convolution;
+        case DIFFUSION:
+            return static_cast<float> (m_diffusion);
+        case DIFFUSION_MATRIX:
+            return static_cast<float> (m_diffusionMatrix);
         default:
             return 0;
     }
@@ -88,26 +463,285 @@ void StereoDelayProcessor::setParameter (int param, float val)
     {
         case DELAY:
             m_delay = val;
-            m_delayChannel0.setDelay(m_delay);
-            m_delayChannel1.setDelay(m_delay);
             break;
         case FEEDBACK:
             m_feedback = val;
-            m_delayChannel0.setFeedback(m_feedback);
-            m_delayChannel1.setFeedback(m_feedback);
             break;
         case MIX:
             m_mix = val;
-            m_delayChannel0.setMix(m_mix);
-            m_delayChannel1.setMix(m_mix);
             break;
         case BYPASS:
             m_bypass = static_cast<bool>(val);
-            m_delayChannel0.setBypass(m_bypass);
-            m_delayChannel1.setBypass(m_bypass);
             break;
-        default:
+        case MOD_RATE:
+            m_modRate = val;
+            break;
+        case MOD_DEPTH:
+            m_modDepth = val;
+            break;
+        case INTERPOLATION:
+            m_interpolation = jlimit (0, Interpolators::s_numTypes - 1, roundToInt (val));
+            break;
+        case TAPS:
+            m_taps = jlimit (1, DelayLine::s_maxTaps, roundToInt (val));
+            break;
+        case TAP_SPACING:
+            m_tapSpacing = jlimit (-100.0f, 100.0f, val);
+            break;
+        case TAP_SPREAD:
+            m_tapSpread = jlimit (0.0f, 100.0f, val);
+            break;
+        case TAP_DECAY:
+            m_tapDecay = jlimit (0.0f, 100.0f, val);
+            break;
+        case TAP_FEEDBACK:
+            m_tapFeedback = static_cast<bool> (val);
+            break;
+        case SYNC:
+            // Switching sync goes back to the host tempo.
+            if (static_cast<bool> (val) != m_sync) { m_tempo.clearTap(); }
+            m_sync = static_cast<bool>(val);
+            break;
+        case NOTE:
+            m_note = jlimit (0, TempoSync::s_numNoteValues - 1, roundToInt (val));
+            break;
+        case FILTER:
+            m_filter = jlimit (0, FeedbackFilter::s_numTypes - 1, roundToInt (val));
+            break;
+        case FILTER_FREQ:
+            m_filterFreq = val;
+            break;
+        case FILTER_TILT:
+            m_filterTilt = val;
+            break;
+        case SATURATION:
+            m_saturation = jlimit (0, Saturator::s_numShapes - 1, roundToInt (val));
+            break;
+        case DRIVE:
+            m_drive = val;
+            break;
+        case OVERSAMPLING:
+            m_oversampling = jlimit (0, 2, roundToInt (val));
+            break;
+        case DELAY_RIGHT:
+            m_delayRight = val;
             break;
+        case LINK:
+            m_link = static_cast<bool>(val);
+            break;
+        case PING_PONG:
+            m_pingPong = static_cast<bool>(val);
+            break;
+        case CROSSFEED:
+            m_crossfeed = val;
+            break;
+        case WIDTH:
+            m_width = val;
+            break;
+        case LONG_DELAY:
+        {
+            // The long delay buffers are only prepared while the mode is on.
+            const bool wasLong = m_longDelay > 0;
+            m_longDelay = jlimit (0.0f, static_cast<float> (s_maxLongDelay), val);
+            if ((m_longDelay > 0) != wasLong) { m_resourcesChanged = true; }
+            break;
+        }
+        case STORAGE:
+        {
+            // The delay buffer is reallocated in the new format off the audio thread.
+            const int storage = jlimit (0, 2, roundToInt (val));
+            if (m_storage.exchange (storage) != storage) { m_resourcesChanged = true; }
+            break;
+        }
+        case CONVOLUTION:
+            // The convolvers are only built while the mode is on.
+            if (static_cast<bool> (val) != m_convolution) { m_resourcesChanged = true; }
+            m_convolution = static_cast<bool>(val);
+            break;
+        case DIFFUSION:
+        {
+            // The network lines are only allocated while the mode is on.
+            const bool wasDiffuse = m_diffusion > 0;
+            m_diffusion = jlimit (0, FeedbackDelayNetwork::s_maxLines, roundToInt (val));
+            if ((m_diffusion > 0) != wasDiffuse) { m_resourcesChanged = true; }
+            break;
+        }
+        case DIFFUSION_MATRIX:
+            m_diffusionMatrix = jlimit (0, FeedbackDelayNetwork::s_numMatrices - 1, roundToInt (val));
+            break;
+        default:
+            return;
+    }
+
+    m_paramsChanged = true;
+}
+
+void StereoDelayProcessor::updateParameters()
+{
+    if (! m_paramsChanged.load (std::memory_order_relaxed) || ! m_paramsChanged.exchange (false)) { return; }
+
+    // Only a stereo layout is routed, so a pair of channels left over from a bigger layout isn't.
+    const bool stereo = (m_numChannels == 2);
+    for (auto& delayLine : m_delayLines)
+    {
+        delayLine->setFeedback (m_feedback);
+        delayLine->setMix (m_mix);
+        delayLine->setBypass (m_bypass);
+        delayLine->setModulation (m_modRate, m_modDepth);
+        delayLine->setInterpolation (static_cast<Interpolators::Type> (m_interpolation.load()));
+        delayLine->setFeedbackFilter (static_cast<FeedbackFilter::Type> (m_filter.load()), m_filterFreq, m_filterTilt);
+        delayLine->setSaturation (static_cast<Saturator::Shape> (m_saturation.load()), m_drive, 1 << m_oversampling);
+        delayLine->setStereoRouting (stereo && m_pingPong, stereo ? m_crossfeed/100 : 0.0f, stereo ? m_width/100 : 1.0f);
+        delayLine->setLongDelay (m_longDelay * 1000);
+        delayLine->setConvolution (m_convolution);
+        delayLine->setDiffusion (m_diffusion, static_cast<FeedbackDelayNetwork::Matrix> (m_diffusionMatrix.load()));
+    }
+    applyDelayTime();
+}
+
+void StereoDelayProcessor::updateTempo()
+{
+    AudioPlayHead::CurrentPositionInfo position;
+    auto playHead = getPlayHead();
+    if (playHead == nullptr || ! playHead->getCurrentPosition (position)) { return; }
+
+    // A tempo change lands at the start of the block that the host reports it in, and replaces a tapped tempo.
+    if (m_tempo.setHostTempo (position.bpm) && m_sync) { applyDelayTime(); }
+}
+
+void StereoDelayProcessor::applyDelayTime()
+{
+    const float delay = m_sync ? getSyncDelayTime() : m_delay.load();
+
+    // Place the taps from the tap pattern. The last tap always sits in the centre at the full delay
+    // time. The spacing bends the even spacing of the others towards the start (positive) or the
+    // end (negative) of the delay time, the spread pans them alternately left and right, and the
+    // decay makes each tap quieter than the one before. The repeats of the taps are mostly
+    // uncorrelated, so normalising the gains to unit power keeps the wet level about the same as
+    // with a single tap. The feedback comes from the last tap, or is shared between all of the
+    // taps in proportion to their gains, which keeps the same total feedback.
+    const int numTaps = m_taps;
+    const float power = std::exp2 (m_tapSpacing / 50);
+    const float spread = m_tapSpread / 100;
+    const float decay = 1 - m_tapDecay / 100;
+    const bool shareFeedback = m_tapFeedback;
+
+    float gains[DelayLine::s_maxTaps];
+    float sum = 0, sumSquares = 0, gain = 1;
+    for (int k = 0; k < numTaps; ++k, gain *= decay)
+    {
+        gains[k] = gain;
+        sum += gain;
+        sumSquares += gain * gain;
+    }
+    const float scale = 1 / std::sqrt (sumSquares);
+
+    for (auto& delayLine : m_delayLines)
+    {
+        delayLine->setDelay (delay);
+        delayLine->setDelayRight ((m_link || m_numChannels != 2) ? -1.0f : m_delayRight.load());
+
+        if (numTaps > 1)
+        {
+            for (int k = 0; k < numTaps; ++k)
+            {
+                const bool last = (k == numTaps - 1);
+                const float time = std::pow (static_cast<float> (k + 1) / numTaps, power);
+                const float pan = last ? 0.0f : (k % 2 == 0 ? -spread : spread);
+                const float share = shareFeedback ? gains[k] / sum : (last ? 1.0f : 0.0f);
+                delayLine->setTap (k, delay * time, gains[k] * scale, pan, share * m_feedback / 100);
+            }
+        }
+        delayLine->setNumTaps (numTaps > 1 ? numTaps : 0);
+    }
+}
+
+void StereoDelayProcessor::setControllerMapping (int controller, int param)
+{
+    if (controller < 0 || controller >= 128) { return; }
+    m_controllerMap[controller] = (param >= 0 && param < m_numParams) ? param : -1;
+}
+
+void StereoDelayProcessor::handleMidiEvent (const MidiMessage& message, const int samplePosition)
+{
+    if (message.isController())
+    {
+        const int param = m_controllerMap[message.getControllerNumber()];
+        if (param < 0) { return; }
+
+        // Apply the change now rather than at the start of the next block.
+        setParameter (param, scaleControllerValue (param, message.getControllerValue()));
+        updateParameters();
+    }
+    else if (message.isNoteOn() && message.getNoteNumber() == s_tapNote)
+    {
+        // Two taps within the maximum delay time set the delay time, or a quarter note when synced.
+        const int64 now = m_sampleCount + samplePosition;
+        const double interval = (m_lastTap >= 0) ? (now - m_lastTap) * 1000.0 / getSampleRate() : 0;
+        m_lastTap = now;
+        if (interval <= 0 || interval > s_maxDelay) { return; }
+
+        if (m_sync) { m_tempo.tap (60000.0 / interval); }
+        else { m_delay = static_cast<float> (interval); }
+        applyDelayTime();
+    }
+    else if (message.getNoteNumber() == s_freezeNote && (message.isNoteOn() || message.isNoteOff()))
+    {
+        for (auto& delayLine : m_delayLines) { delayLine->setFreeze (message.isNoteOn()); }
+    }
+}
+
+float StereoDelayProcessor::scaleControllerValue (const int param, const int value)
+{
+    const float position = value / 127.0f;
+
+    switch (param)
+    {
+        case DELAY:
+        case DELAY_RIGHT:
+            return 2000 * position;
+        case FEEDBACK:
+        case MIX:
+        case TAP_SPREAD:
+        case TAP_DECAY:
+        case CROSSFEED:
+            return 100 * position;
+        case TAP_SPACING:
+            return -100 + (200 * position);
+        case WIDTH:
+            return 200 * position;
+        case LONG_DELAY:
+            return s_maxLongDelay * position;
+        case MOD_RATE:
+            return 0.05f + (9.95f * position);
+        case MOD_DEPTH:
+            return 20 * position;
+        case INTERPOLATION:
+            return (Interpolators::s_numTypes - 1) * position;
+        case TAPS:
+            return 1 + ((DelayLine::s_maxTaps - 1) * position);
+        case NOTE:
+            return (TempoSync::s_numNoteValues - 1) * position;
+        case FILTER:
+            return (FeedbackFilter::s_numTypes - 1) * position;
+        case FILTER_FREQ:
+            return 20 * std::pow (1000.0f, position);
+        case FILTER_TILT:
+            return -12 + (24 * position);
+        case SATURATION:
+            return (Saturator::s_numShapes - 1) * position;
+        case DRIVE:
+            return 24 * position;
+        case OVERSAMPLING:
+            return 2 * position;
+        case STORAGE:
+            return 2 * position;
+        case DIFFUSION:
+            return FeedbackDelayNetwork::s_maxLines * position;
+        case DIFFUSION_MATRIX:
+            return (FeedbackDelayNetwork::s_numMatrices - 1) * position;
+        default:
+            return value >= 64 ? 1.0f : 0.0f;
     }
 }
 
@@ -115,13 +749,67 @@ void StereoDelayProcessor::getStateInformation (MemoryBlock& destData)
 {
     XmlElement root ("Root");
     auto child = root.createNewChildElement ("Delay");
-    child->addTextElement (String (m_delay));
+    child->addTextElement (String (m_delay.load()));
     child = root.createNewChildElement ("Feedback");
-    child->addTextElement (String (m_feedback));
+    child->addTextElement (String (m_feedback.load()));
     child = root.createNewChildElement ("Mix");
-    child->addTextElement (String (m_mix));
+    child->addTextElement (String (m_mix.load()));
     child = root.createNewChildElement ("Bypass");
     child->addTextElement (String (static_cast<float> (m_bypass)));
+    child = root.createNewChildElement ("ModRate");
+    child->addTextElement (String (m_modRate.load()));
+    child = root.createNewChildElement ("ModDepth");
+    child->addTextElement (String (m_modDepth.load()));
+    child = root.createNewChildElement ("Interpolation");
+    child->addTextElement (String (m_interpolation.load()));
+    child = root.createNewChildElement ("Taps");
+    child->addTextElement (String (m_taps.load()));
+    child = root.createNewChildElement ("TapSpacing");
+    child->addTextElement (String (m_tapSpacing.load()));
+    child = root.createNewChildElement ("TapSpread");
+    child->addTextElement (String (m_tapSpread.load()));
+    child = root.createNewChildElement ("TapDecay");
+    child->addTextElement (String (m_tapDecay.load()));
+    child = root.createNewChildElement ("TapFeedback");
+    child->addTextElement (String (static_cast<float> (m_tapFeedback)));
+    child = root.createNewChildElement ("Sync");
+    child->addTextElement (String (static_cast<float> (m_sync)));
+    child = root.createNewChildElement ("Note");
+    child->addTextElement (String (m_note.load()));
+    child = root.createNewChildElement ("Filter");
+    child->addTextElement (String (m_filter.load()));
+    child = root.createNewChildElement ("FilterFreq");
+    child->addTextElement (String (m_filterFreq.load()));
+    child = root.createNewChildElement ("FilterTilt");
+    child->addTextElement (String (m_filterTilt.load()));
+    child = root.createNewChildElement ("Saturation");
+    child->addTextElement (String (m_saturation.load()));
+    child = root.createNewChildElement ("Drive");
+    child->addTextElement (String (m_drive.load()));
+    child = root.createNewChildElement ("Oversampling");
+    child->addTextElement (String (m_oversampling.load()));
+    child = root.createNewChildElement ("DelayRight");
+    child->addTextElement (String (m_delayRight.load()));
+    child = root.createNewChildElement ("Link");
+    child->addTextElement (String (static_cast<float> (m_link)));
+    child = root.createNewChildElement ("PingPong");
+    child->addTextElement (String (static_cast<float> (m_pingPong)));
+    child = root.createNewChildElement ("Crossfeed");
+    child->addTextElement (String (m_crossfeed.load()));
+    child = root.createNewChildElement ("Width");
+    child->addTextElement (String (m_width.load()));
+    child = root.createNewChildElement ("LongDelay");
+    child->addTextElement (String (m_longDelay.load()));
+    child = root.createNewChildElement ("Storage");
+    child->addTextElement (String (m_storage.load()));
+    child = root.createNewChildElement ("Convolution");
+    child->addTextElement (String (static_cast<float> (m_convolution)));
+    child = root.createNewChildElement ("Diffusion");
+    child->addTextElement (String (m_diffusion.load()));
+    child = root.createNewChildElement ("DiffusionMatrix");
+    child->addTextElement (String (m_diffusionMatrix.load()));
+    child = root.createNewChildElement ("ResponseFile");
+    child->addTextElement (m_responseFile);
     copyXmlToBinary(root, destData);
 }
 
@@ -130,6 +818,7 @@ void StereoDelayProcessor::setStateInformation (const void* data, int sizeInByte
     auto root = getXmlFromBinary (data, sizeInBytes);
     if (root != nullptr)
     {
+        String responseFile;
         forEachXmlChildElement (*root, child)
         {
             auto text = child->getAllSubText();
@@ -138,7 +827,40 @@ void StereoDelayProcessor::setStateInformation (const void* data, int sizeInByte
             else if (child->hasTagName ("Feedback")) { setParameter (FEEDBACK, text.getFloatValue()); }
             else if (child->hasTagName ("Mix")) { setParameter (MIX, text.getFloatValue()); }
             else if (child->hasTagName ("Bypass")) { setParameter (BYPASS, static_cast<bool> (text.getFloatValue())); }
+            else if (child->hasTagName ("ModRate")) { setParameter (MOD_RATE, text.getFloatValue()); }
+            else if (child->hasTagName ("ModDepth")) { setParameter (MOD_DEPTH, text.getFloatValue()); }
+            else if (child->hasTagName ("Interpolation")) { setParameter (INTERPOLATION, text.getFloatValue()); }
+            else if (child->hasTagName ("Taps")) { setParameter (TAPS, text.getFloatValue()); }
+            else if (child->hasTagName ("TapSpacing")) { setParameter (TAP_SPACING, text.getFloatValue()); }
+            else if (child->hasTagName ("TapSpread")) { setParameter (TAP_SPREAD, text.getFloatValue()); }
+            else if (child->hasTagName ("TapDecay")) { setParameter (TAP_DECAY, text.getFloatValue()); }
+            else if (child->hasTagName ("TapFeedback")) { setParameter (TAP_FEEDBACK, text.getFloatValue()); }
+            else if (child->hasTagName ("Sync")) { setParameter (SYNC, static_cast<bool> (text.getFloatValue())); }
+            else if (child->hasTagName ("Note")) { setParameter (NOTE, text.getFloatValue()); }
+            else if (child->hasTagName ("Filter")) { setParameter (FILTER, text.getFloatValue()); }
+            else if (child->hasTagName ("FilterFreq")) { setParameter (FILTER_FREQ, text.getFloatValue()); }
+            else if (child->hasTagName ("FilterTilt")) { setParameter (FILTER_TILT, text.getFloatValue()); }
+            else if (child->hasTagName ("Saturation")) { setParameter (SATURATION, text.getFloatValue()); }
+            else if (child->hasTagName ("Drive")) { setParameter (DRIVE, text.getFloatValue()); }
+            else if (child->hasTagName ("Oversampling")) { setParameter (OVERSAMPLING, text.getFloatValue()); }
+            else if (child->hasTagName ("DelayRight")) { setParameter (DELAY_RIGHT, text.getFloatValue()); }
+            else if (child->hasTagName ("Link")) { setParameter (LINK, static_cast<bool> (text.getFloatValue())); }
+            else if (child->hasTagName ("PingPong")) { setParameter (PING_PONG, static_cast<bool> (text.getFloatValue())); }
+            else if (child->hasTagName ("Crossfeed")) { setParameter (CROSSFEED, text.getFloatValue()); }
+            else if (child->hasTagName ("Width")) { setParameter (WIDTH, text.getFloatValue()); }
+            else if (child->hasTagName ("LongDelay")) { setParameter (LONG_DELAY, text.getFloatValue()); }
+            else if (child->hasTagName ("Storage")) { setParameter (STORAGE, text.getFloatValue()); }
+            else if (child->hasTagName ("Convolution")) { setParameter (CONVOLUTION, static_cast<bool> (text.getFloatValue())); }
+            else if (child->hasTagName ("Diffusion")) { setParameter (DIFFUSION, text.getFloatValue()); }
+            else if (child->hasTagName ("DiffusionMatrix")) { setParameter (DIFFUSION_MATRIX, text.getFloatValue()); }
+            else if (child->hasTagName ("ResponseFile")) { responseFile = text; }
         }
+
+        // A generated echo response is made again from the restored delay time and feedback. The
+        // response is only read or made now if the convolution mode is on.
+        m_response.setSize (0, 0);
+        m_responseFile = responseFile;
+        updateConvolution();
         delete root; /// \todo May not need this.
     }
 }
@@ -148,6 +870,11 @@ AudioProcessorEditor* StereoDelayProcessor::createEditor()
     return new StereoDelayEditor (this);
 }
 
+float StereoDelayProcessor::getSyncDelayTime() const
+{
+    return TempoSync::getDelayTime (m_tempo.getTempo(), static_cast<TempoSync::NoteValue> (m_note.load()));
+}
+
 AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
     return new StereoDelayProcessor();
@@ -6,24 +6,44 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "../JuceLibraryCode/JuceHeader.h"
 
-#include "DelayLine.h"
+#include "MultiChannelDelayLine.h"
+#include "PerformanceMonitor.h"
+#include "TempoSync.h"
+#include "WorkerPool.h"
 
 /**
  * \brief Audio processor class for a stereo delay VST plugin.
  *
  * This class processes blocks of audio samples using the parameters from the StereoDelayEditor
- * class and the algorithm in the DelayLine class.
+ * class and the algorithm in the MultiChannelDelayLine class. Any layout from mono up to
+ * s_maxChannels channels is supported, with a delay for every output channel.
+ *
+ * The output channels are split into groups of up to MultiChannelDelayLine::s_maxChannels, each
+ * with its own MultiChannelDelayLine, and the groups of a block are processed in parallel on a
+ * WorkerPool if its threads have realtime priority (see isParallel()). Layouts of up to 16
+ * channels are a single group on the audio thread.
+ *
+ * The modes that need extra memory, files or threads (the long delay, convolution and diffusion)
+ * are only prepared while they're switched on. A timer on the message thread prepares or releases
+ * them when their parameters switch them on or off, and reallocates the delay buffers when their
+ * storage format changes, with processing suspended while the delay lines change.
  */
-class StereoDelayProcessor : public AudioProcessor
+class StereoDelayProcessor : public AudioProcessor,
+                             private Timer
 {
 public:
 
     /**
      * Enum for getting and setting parameter values.
      */
-    enum Param { DELAY, FEEDBACK, MIX, BYPASS };
+    enum Param { DELAY, FEEDBACK, MIX, BYPASS, MOD_RATE, MOD_DEPTH, INTERPOLATION, TAPS, TAP_SPACING, TAP_SPREAD, TAP_DECAY, TAP_FEEDBACK, SYNC, NOTE, FILTER, FILTER_FREQ, FILTER_TILT, SATURATION, DRIVE, OVERSAMPLING,
+                 DELAY_RIGHT, LINK, PING_PONG, CROSSFEED, WIDTH, LONG_DELAY, STORAGE, CONVOLUTION, DIFFUSION, DIFFUSION_MATRIX };
 
     /**
      * Class constructor.
@@ -36,7 +56,20 @@ public:
     ~StereoDelayProcessor() = default;
 
     /**
-     * Pre-playback initialization of the delay processor.
+     * Checks whether a channel layout is supported. The output can be any layout with up to
+     * s_maxChannels channels, and the input must match it or be mono.
+     *
+     * \param[in]  BusesLayout&  Input and output channel layouts
+     *
+     * \return  bool  True if the layout is supported
+     */
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+
+    /**
+     * Pre-playback initialization of the delay processor. The delay buffers are sized for the
+     * sample rate here, so the audio thread never allocates memory. The delay lines and worker
+     * pool are rebuilt if the number of output channels has changed, and the channel layout is
+     * resolved so the audio thread doesn't check it for every block.
      *
      * \param[in]  double  Audio sample rate
      * \param[in]  double  Number of samples per processing block
@@ -51,8 +84,17 @@ public:
     /**
      * Process the audio buffer using the delay line.
      *
-     * \note For mono inputs, the output is copied to both channels.
-     * \todo The MIDI buffer is currently unused but should be supported in the future.
+     * Denormal numbers are flushed to zero while the block is processed, and once the delay line
+     * has decayed to silence it skips silent blocks entirely.
+     *
+     * The block is split at the timestamp of each MIDI event, so mapped controllers, tap tempo and
+     * freeze notes take effect on the exact sample of the event. The audio between events is
+     * processed in contiguous runs.
+     *
+     * While the bypass parameter is on, the channels are left where they are and none of the
+     * delay lines are run.
+     *
+     * \note For mono inputs, the input is copied to every output channel.
      *
      * \param[in] AudioSampleBuffer&  Audio buffer
      * \param[in] MidiBuffer&  MIDI buffer
@@ -60,7 +102,8 @@ public:
     void processBlock (AudioSampleBuffer& buffer, MidiBuffer& midiMessages) override;
 
     /**
-     * Process block when the effect is bypassed.
+     * Process block when the effect is bypassed by the host. The audio is processed in place, so
+     * this does nothing apart from copying a mono input to the other output channels.
      *
      * \param[in]  AudioSampleBuffer&  Audio buffer
      * \param[in]  MidiBuffer&  MIDI buffer
@@ -69,14 +112,82 @@ public:
 
     int getNumParameters() override { return m_numParams; }; ///< Returns the number of processor parameters.
     float getParameter (int param) override; ///< Gets a specified parameter value.
-    void setParameter (int param, float val) override; ///< Sets a specified parameter value based on the index.
+
+    /**
+     * Sets a specified parameter value based on the index.
+     *
+     * This can be called from any thread. The value is only published here and is applied to the
+     * delay line by the audio thread at the start of the next processing block.
+     *
+     * \param[in]  int  Parameter index
+     * \param[in]  float  Parameter value
+     */
+    void setParameter (int param, float val) override;
+
+    /**
+     * Maps a MIDI controller to a parameter. Controller values (0-127) are scaled to the range of
+     * the parameter, and switch parameters turn on from 64. This can be called from any thread.
+     *
+     * By default, controllers 12-16 are mapped to the delay, feedback, mix, modulation rate and
+     * modulation depth parameters.
+     *
+     * \param[in]  int  MIDI controller number (0-127)
+     * \param[in]  int  Parameter index, or -1 to remove the mapping
+     */
+    void setControllerMapping (int controller, int param);
+
+    /**
+     * Loads an impulse response for the convolution mode from an audio file. Anything longer than
+     * s_maxResponseLength seconds is cut off, and the response is resampled to the sample rate.
+     * This is called from the message thread. If the convolution mode is on, processing is
+     * suspended while the convolver is rebuilt, and otherwise the convolver is built when the mode
+     * is switched on.
+     *
+     * \param[in]  File&  Audio file
+     *
+     * \return  bool  True if the file was loaded
+     */
+    bool loadImpulseResponse (const File& file);
+
+    /**
+     * Makes an echo impulse response for the convolution mode from the current delay time and
+     * feedback (see PartitionedConvolver::makeEchoResponse()). This is called from the message
+     * thread, and the convolver is rebuilt like it is by loadImpulseResponse().
+     */
+    void generateImpulseResponse();
+
+    String getImpulseResponseName() const; ///< Gets the name of the impulse response file, or a description of a generated one.
+
+    const PerformanceMonitor& getPerformanceMonitor() const { return m_monitor; }; ///< Gets the timings of the processing callbacks.
+
+    static const int s_tapNote = 36; ///< MIDI note for tap tempo (C1). The time between two taps sets the delay, or the tempo when synced.
+    static const int s_freezeNote = 37; ///< MIDI note for freezing the delay buffer while it's held (C#1).
 
     bool hasEditor() const override { return true; }; ///< Indicates whether this plugin has an editor.
     const String getName() const override { return JucePlugin_Name; }; ///< Gets the name of the plugin.
 
     bool acceptsMidi() const override { return JucePlugin_WantsMidiInput; }; ///< Indicates whether this plugin accepts MIDI input.
     bool producesMidi() const override { return JucePlugin_ProducesMidiOutput; }; ///< Indicates whether this plugin produces MIDI output.
-    double getTailLengthSeconds() const override { return 0.0; }; ///< Gets the processor tail length (unused).
+
+    /**
+     * Gets how long the output takes to decay to silence after the input stops, from the delay
+     * and feedback parameters. An endless tail at 100% feedback is reported as s_maxTailTime.
+     *
+     * \return  double  Tail length (secs)
+     */
+    double getTailLengthSeconds() const override;
+
+    /**
+     * Indicates whether the channel groups are processed in parallel. This is false for layouts
+     * that are a single group, and when the system didn't grant the worker threads realtime
+     * priority, in which case the groups are processed one after the other on the audio thread.
+     */
+    bool isParallel() const { return m_workers != nullptr; };
+
+    static constexpr double s_maxTailTime = 600; ///< Longest tail length reported to the host (secs).
+    static const int s_maxChannels = 64; ///< Most output channels (seventh-order ambisonics).
+    static const int s_maxLongDelay = 300; ///< Longest delay time in the long delay mode (secs).
+    static const int s_maxResponseLength = 20; ///< Longest impulse response in the convolution mode (secs).
     
     int getNumPrograms() override { return 1; }; ///< Gets the number of programs (unused).
     int getCurrentProgram() override { return 0; }; ///< Gets the current program (unused).
@@ -106,16 +217,205 @@ public:
      */
     AudioProcessorEditor* createEditor() override;
 
+    /**
+     * Gets the delay time of the synced note value at the current tempo. Delay times longer than
+     * s_maxDelay are limited to it by the delay line, so the editor can show when that happens.
+     *
+     * \return  float  Delay time (msecs)
+     */
+    float getSyncDelayTime() const;
+
+    static const int s_maxDelay = 2000; ///< Longest delay time (msecs).
+
 private:
 
+    /**
+     * Creates the delay lines for a number of channels with the parameter smoothing set up, and
+     * the worker pool for processing them. The channels are shared out evenly over as few groups
+     * as the layout needs, in whole SIMD frames of four channels where possible, so the output is
+     * the same on any machine. The parameters are applied at the start of the next block. This
+     * allocates memory and starts threads, so it's never called from the audio thread.
+     *
+     * \param[in]  int  Number of channels
+     */
+    void createDelayLines (const int numChannels);
+
+    /**
+     * Gives the impulse response to every delay line. Each group gets the response channels of
+     * its own channels, and a response with fewer channels is repeated over the layout.
+     *
+     * \param[in]  float**  Impulse response channels
+     * \param[in]  int  Number of impulse response channels
+     * \param[in]  int  Impulse response length (samples)
+     */
+    void setImpulseResponse (const float* const* response, const int numResponseChannels, const int length);
+
+    /**
+     * Copies the first channel to the other output channels if the input is mono, with one
+     * vectorized copy per channel.
+     *
+     * \param[in,out]  AudioSampleBuffer&  Audio buffer
+     */
+    void copyMonoInput (AudioSampleBuffer& buffer) const;
+
+    /**
+     * Processes a run of the block with every delay line, on the worker pool unless the run is
+     * shorter than s_minParallelSamples or isParallel() is false. Nothing is run while the delay
+     * lines are bypassed. This is only called from the audio thread.
+     *
+     * \param[in]  int  Index of the first sample
+     * \param[in]  int  Number of samples
+     */
+    void processGroups (const int startSample, const int numSamples);
+
+    /**
+     * Worker pool job that processes the run set up by processGroups() with one delay line.
+     *
+     * \param[in]  void*  Processor
+     * \param[in]  int  Delay line index
+     */
+    static void processGroup (void* context, const int index);
+
+    /**
+     * Prepares the modes that are switched on and releases the ones that are off, and reallocates
+     * delay buffers that are in the wrong storage format. This allocates and frees memory, so it's
+     * only called from prepareToPlay() or with processing suspended.
+     *
+     * \param[in]  bool  Prepare the modes that are already prepared again (for a new sample rate)
+     */
+    void updateResources (const bool reprepare);
+
+    bool isResourceUpdateNeeded() const; ///< Indicates whether any delay line has a mode prepared that's off, one that's on unprepared, or the wrong storage format.
+    void timerCallback() override; ///< Updates the resources of the modes on the message thread after their parameters change.
+
+    static const int s_resourceInterval = 50; ///< Time between checks for modes to prepare or release (msecs).
+    static const int s_minParallelSamples = 32; ///< Shortest run whose groups are processed on the worker pool.
+
+    /**
+     * Makes an echo impulse response from the current delay time and feedback, without applying it.
+     */
+    void createEchoResponse();
+
+    /**
+     * Reads an impulse response from an audio file, without applying it.
+     *
+     * \param[in]  File&  Audio file
+     *
+     * \return  bool  True if the file was read
+     */
+    bool readImpulseResponse (const File& file);
+
+    /**
+     * Reads the impulse response file, or makes an echo response if there isn't one, unless there's
+     * already a response.
+     */
+    void createImpulseResponse();
+
+    /**
+     * Rebuilds the convolvers with the impulse response if the convolution mode is on, with
+     * processing suspended. Otherwise they're built when the mode is switched on.
+     */
+    void updateConvolution();
+
+    /**
+     * Resamples the impulse response to the sample rate and gives it to the delay line. This
+     * allocates memory, so it's never called from the audio thread, and processing has to be
+     * suspended unless it's called from prepareToPlay().
+     */
+    void applyImpulseResponse();
+
+    /**
+     * Applies any parameter changes published by setParameter() to the delay line. This is only
+     * called from the audio thread.
+     */
+    void updateParameters();
+
+    /**
+     * Reads the tempo from the host playhead and updates a tempo-synced delay time when it
+     * changes. The host reports the tempo once per block, so this is checked once per block
+     * rather than for every sample. This is only called from the audio thread.
+     */
+    void updateTempo();
+
+    /**
+     * Sets the delay time of the delay line and its taps, either from the delay parameter or from
+     * the note value and host tempo. This is only called from the audio thread.
+     */
+    void applyDelayTime();
+
+    /**
+     * Applies a MIDI event to the parameters and delay line. This is only called from the audio thread.
+     *
+     * \param[in]  MidiMessage&  MIDI event
+     * \param[in]  int  Sample position of the event in the block
+     */
+    void handleMidiEvent (const MidiMessage& message, const int samplePosition);
+
+    /**
+     * Scales a MIDI controller value to the range of a parameter.
+     *
+     * \param[in]  int  Parameter index
+     * \param[in]  int  Controller value (0-127)
+     *
+     * \return  float  Parameter value
+     */
+    static float scaleControllerValue (const int param, const int value);
+
     int m_numParams; ///< Number of processor parameters.
-    float m_delay; ///< Delay time parameter (msecs).
-    float m_feedback; ///< Feedback parameter (%).
-    float m_mix; ///< Mix parameter (%).
-    bool m_bypass; ///< Bypass parameter (true = bypass).
+    std::atomic<float> m_delay; ///< Delay time parameter (msecs).
+    std::atomic<float> m_feedback; ///< Feedback parameter (%).
+    std::atomic<float> m_mix; ///< Mix parameter (%).
+    std::atomic<bool> m_bypass; ///< Bypass parameter (true = bypass).
+    std::atomic<float> m_modRate; ///< Delay modulation rate parameter (Hz).
+    std::atomic<float> m_modDepth; ///< Delay modulation depth parameter (msecs).
+    std::atomic<int> m_interpolation; ///< Interpolation type parameter (Interpolators::Type).
+    std::atomic<int> m_taps; ///< Number of delay taps parameter (1 for a single delay).
+    std::atomic<float> m_tapSpacing; ///< Tap spacing parameter (-100 to 100%, 0 for even spacing).
+    std::atomic<float> m_tapSpread; ///< Tap stereo spread parameter (%).
+    std::atomic<float> m_tapDecay; ///< Tap level decay parameter (% quieter than the tap before).
+    std::atomic<bool> m_tapFeedback; ///< Tap feedback parameter (true = every tap feeds back).
+    std::atomic<bool> m_sync; ///< Tempo sync parameter (true = delay time from the note value and host tempo).
+    std::atomic<int> m_note; ///< Note value parameter for tempo sync (TempoSync::NoteValue).
+    std::atomic<int> m_filter; ///< Feedback filter type parameter (FeedbackFilter::Type).
+    std::atomic<float> m_filterFreq; ///< Feedback filter cutoff/pivot frequency parameter (Hz).
+    std::atomic<float> m_filterTilt; ///< Feedback filter tilt parameter (dB).
+    std::atomic<int> m_saturation; ///< Feedback drive curve parameter (Saturator::Shape).
+    std::atomic<float> m_drive; ///< Feedback drive parameter (dB).
+    std::atomic<int> m_oversampling; ///< Feedback drive oversampling parameter (0 = 1x, 1 = 2x, 2 = 4x).
+    std::atomic<float> m_delayRight; ///< Right channel delay time parameter (msecs), used when the channels aren't linked.
+    std::atomic<bool> m_link; ///< Link parameter (true = the right channel uses the delay time of the left).
+    std::atomic<bool> m_pingPong; ///< Ping-pong parameter (true = the echoes bounce between the channels).
+    std::atomic<float> m_crossfeed; ///< Cross-feedback parameter (%).
+    std::atomic<float> m_width; ///< Stereo width parameter of the delayed signal (%).
+    std::atomic<float> m_longDelay; ///< Long delay time parameter (secs, 0 = off).
+    std::atomic<int> m_storage; ///< Delay buffer storage format parameter (TieredDelayBuffer::Format).
+    std::atomic<bool> m_convolution; ///< Convolution parameter (true = convolve with the impulse response instead of delaying).
+    std::atomic<int> m_diffusion; ///< Number of feedback delay network lines parameter (0 = off).
+    std::atomic<int> m_diffusionMatrix; ///< Feedback delay network mixing matrix parameter (FeedbackDelayNetwork::Matrix).
+    std::atomic<bool> m_paramsChanged; ///< Set when a parameter changes and cleared when it's applied.
+    std::atomic<bool> m_resourcesChanged; ///< Set when a mode that needs resources is switched on or off, and cleared by timerCallback().
+
+    TempoTracker m_tempo; ///< Tempo for the synced delay time, from the host or tapped in.
+
+    std::atomic<int> m_controllerMap[128]; ///< Parameter index for each MIDI controller (-1 = unmapped).
+    int64 m_sampleCount; ///< Number of samples processed since prepareToPlay().
+    int64 m_lastTap; ///< Sample count of the last tap tempo note (-1 = none).
+
+    std::vector<std::unique_ptr<MultiChannelDelayLine>> m_delayLines; ///< Delay line for each group of output channels.
+    int m_numChannels; ///< Number of output channels.
+    bool m_monoInput; ///< True if a mono input feeds more than one output channel.
+    int m_groupSize; ///< Number of channels in each group (the last one may have fewer).
+    std::shared_ptr<WorkerPool> m_workers; ///< Shared worker threads for processing the groups in parallel (null with one group or without realtime priority).
+    float* m_groupChannels[s_maxChannels]; ///< Channels of the run being processed by processGroups().
+    int m_groupStart; ///< Index of the first sample of the run being processed.
+    int m_groupNumSamples; ///< Number of samples in the run being processed.
+
+    AudioSampleBuffer m_response; ///< Impulse response for the convolution mode, at its own sample rate (empty until the mode needs it).
+    double m_responseRate; ///< Sample rate of the impulse response.
+    String m_responseFile; ///< Path of the impulse response file (empty for a generated echo response).
+    std::atomic<float> m_responseLength; ///< Length of the impulse response (secs).
 
-    DelayLine m_delayChannel0; ///< 
-    DelayLine m_delayChannel1; ///< 
+    PerformanceMonitor m_monitor; ///< Timings of the processing callbacks.
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StereoDelayProcessor)
 };
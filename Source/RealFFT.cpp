@@ -0,0 +1,150 @@
+/**
+ * RealFFT.cpp
+ * \brief Fast Fourier transform of real signals.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "RealFFT.h"
+
+RealFFT::RealFFT (const int size)
+    : m_size (size),
+      m_half (size/2),
+      m_bitReverse (new int [size/2]),
+      m_twiddles (new float [size/2]),
+      m_splitTwiddles (new float [size + 2]),
+      m_work (new float [size])
+{
+    assert (size >= 4 && (size & (size - 1)) == 0);
+
+    int bits = 0;
+    while ((1 << bits) < m_half) { ++bits; }
+    for (int i = 0; i < m_half; ++i)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) { reversed |= ((i >> b) & 1) << (bits - 1 - b); }
+        m_bitReverse[i] = reversed;
+    }
+
+    const double pi = 3.14159265358979323846;
+    for (int k = 0; k < m_half/2; ++k)
+    {
+        m_twiddles[2*k] = static_cast<float> (std::cos (2*pi*k/m_half));
+        m_twiddles[2*k + 1] = static_cast<float> (-std::sin (2*pi*k/m_half));
+    }
+    for (int k = 0; k <= m_half; ++k)
+    {
+        m_splitTwiddles[2*k] = static_cast<float> (std::cos (2*pi*k/m_size));
+        m_splitTwiddles[2*k + 1] = static_cast<float> (-std::sin (2*pi*k/m_size));
+    }
+}
+
+RealFFT::~RealFFT()
+{
+    delete [] m_bitReverse;
+    delete [] m_twiddles;
+    delete [] m_splitTwiddles;
+    delete [] m_work;
+}
+
+void RealFFT::forward (const float* input, float* spectrum)
+{
+    // Pairs of real samples make up the complex signal.
+    std::copy (input, input + m_size, m_work);
+    transform (false);
+
+    // Split the spectrum of the even and odd samples apart, and combine them into the real spectrum.
+    float* re = spectrum;
+    float* im = spectrum + m_half + 1;
+    for (int k = 0; k <= m_half; ++k)
+    {
+        const int a = (k == m_half) ? 0 : k;
+        const int b = (k == 0) ? 0 : m_half - k;
+        const float evenRe = 0.5f * (m_work[2*a] + m_work[2*b]);
+        const float evenIm = 0.5f * (m_work[2*a + 1] - m_work[2*b + 1]);
+        const float oddRe = 0.5f * (m_work[2*a] - m_work[2*b]);
+        const float oddIm = 0.5f * (m_work[2*a + 1] + m_work[2*b + 1]);
+        const float wr = m_splitTwiddles[2*k];
+        const float wi = m_splitTwiddles[2*k + 1];
+
+        re[k] = evenRe + (wr*oddIm + wi*oddRe);
+        im[k] = evenIm - (wr*oddRe - wi*oddIm);
+    }
+}
+
+void RealFFT::inverse (const float* spectrum, float* output)
+{
+    // Undo the split, which gives the spectrum of the complex signal made from pairs of samples.
+    const float* re = spectrum;
+    const float* im = spectrum + m_half + 1;
+    for (int k = 0; k < m_half; ++k)
+    {
+        const int b = m_half - k;
+        const float evenRe = re[k] + re[b];
+        const float evenIm = im[k] - im[b];
+        const float diffRe = re[k] - re[b];
+        const float diffIm = im[k] + im[b];
+        const float wr = m_splitTwiddles[2*k];
+        const float wi = m_splitTwiddles[2*k + 1];
+        const float oddRe = diffRe*wr + diffIm*wi;
+        const float oddIm = diffIm*wr - diffRe*wi;
+
+        m_work[2*k] = evenRe - oddIm;
+        m_work[2*k + 1] = evenIm + oddRe;
+    }
+
+    transform (true);
+    std::copy (m_work, m_work + m_size, output);
+}
+
+void RealFFT::multiplyAdd (const float* a, const float* b, float* sum, const int numBins)
+{
+    const float* aIm = a + numBins;
+    const float* bIm = b + numBins;
+    float* sumIm = sum + numBins;
+    for (int k = 0; k < numBins; ++k)
+    {
+        sum[k] += (a[k] * b[k]) - (aIm[k] * bIm[k]);
+        sumIm[k] += (a[k] * bIm[k]) + (aIm[k] * b[k]);
+    }
+}
+
+void RealFFT::transform (const bool inverse)
+{
+    for (int i = 0; i < m_half; ++i)
+    {
+        const int j = m_bitReverse[i];
+        if (j > i)
+        {
+            std::swap (m_work[2*i], m_work[2*j]);
+            std::swap (m_work[2*i + 1], m_work[2*j + 1]);
+        }
+    }
+
+    // Radix-2 butterflies, with the conjugate twiddle factors for the inverse.
+    const float sign = inverse ? -1.0f : 1.0f;
+    for (int size = 2; size <= m_half; size *= 2)
+    {
+        const int half = size/2;
+        const int step = m_half/size;
+        for (int start = 0; start < m_half; start += size)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                const float wr = m_twiddles[2*k*step];
+                const float wi = sign * m_twiddles[2*k*step + 1];
+                float* x = m_work + 2*(start + k);
+                float* y = x + 2*half;
+                const float tr = (wr * y[0]) - (wi * y[1]);
+                const float ti = (wr * y[1]) + (wi * y[0]);
+                y[0] = x[0] - tr;
+                y[1] = x[1] - ti;
+                x[0] += tr;
+                x[1] += ti;
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * RealFFT.h
+ * \brief Fast Fourier transform of real signals.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+/**
+ * \brief Fast Fourier transform of real signals.
+ *
+ * A real signal of N samples is transformed as a complex signal of N/2 samples with a radix-2
+ * FFT, and the spectrum is then split into its N/2 + 1 bins. Spectra are stored with the real
+ * parts of all of the bins first and then the imaginary parts (N + 2 floats), so that
+ * multiplying spectra vectorizes.
+ *
+ * Neither transform is scaled, so a forward and inverse transform multiplies the signal by N.
+ */
+class RealFFT
+{
+public:
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  int  Transform size (a power of two, at least 4)
+     */
+    explicit RealFFT (const int size);
+
+    /**
+     * Class destructor.
+     */
+    ~RealFFT();
+
+    int getSize() const { return m_size; }; ///< Gets the transform size.
+    int getNumBins() const { return m_size/2 + 1; }; ///< Gets the number of bins in a spectrum.
+
+    /**
+     * Transforms a signal to its spectrum.
+     *
+     * \param[in]  float*  Signal (size samples)
+     * \param[out]  float*  Spectrum (size + 2 floats)
+     */
+    void forward (const float* input, float* spectrum);
+
+    /**
+     * Transforms a spectrum back to a signal, multiplied by the transform size.
+     *
+     * \param[in]  float*  Spectrum (size + 2 floats)
+     * \param[out]  float*  Signal (size samples)
+     */
+    void inverse (const float* spectrum, float* output);
+
+    /**
+     * Multiplies two spectra and adds the result to a third.
+     *
+     * \param[in]  float*  First spectrum
+     * \param[in]  float*  Second spectrum
+     * \param[in,out]  float*  Sum of products
+     * \param[in]  int  Number of bins
+     */
+    static void multiplyAdd (const float* a, const float* b, float* sum, const int numBins);
+
+private:
+
+    /**
+     * Transforms the complex signal in m_work in place.
+     *
+     * \param[in]  bool  True for the inverse transform
+     */
+    void transform (const bool inverse);
+
+    int m_size; ///< Transform size (real samples).
+    int m_half; ///< Size of the complex transform.
+    int* m_bitReverse; ///< Bit reversed index of each complex sample.
+    float* m_twiddles; ///< Complex transform twiddle factors (m_half/2 interleaved pairs).
+    float* m_splitTwiddles; ///< Twiddle factors for splitting the spectrum (m_half + 1 interleaved pairs).
+    float* m_work; ///< Complex signal being transformed (m_half interleaved pairs).
+
+    RealFFT (const RealFFT&) = delete;
+    RealFFT& operator= (const RealFFT&) = delete;
+};
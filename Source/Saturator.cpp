@@ -0,0 +1,195 @@
+/**
+ * Saturator.cpp
+ * \brief Drive stage for the feedback loop of the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <cmath>
+
+#include "Saturator.h"
+
+static const double s_pi = 3.14159265358979323846;
+
+/**
+ * Waveshaper lookup table, calculated on construction.
+ */
+template <int size>
+struct ShaperTable
+{
+    /**
+     * Fills the table from a waveshaper function over the range of the table.
+     */
+    template <typename Function>
+    ShaperTable (const double range, Function calculate)
+    {
+        for (int i = 0; i <= size; ++i) { data[i] = static_cast<float> (calculate (range * ((2.0 * i / size) - 1))); }
+    }
+
+    float data[size + 1]; ///< Waveshaper output for each step of the input.
+};
+
+/**
+ * Calculates the allpass coefficients of a polyphase IIR half-band filter with an elliptic
+ * response, for a number of coefficients and a transition bandwidth (as a fraction of the sample
+ * rate). This follows the design in Laurent de Soras' HIIR library.
+ */
+static void designHalfBand (double* coefs, const int numCoefs, const double transition)
+{
+    const double k = std::pow (std::tan ((1 - 2*transition) * s_pi / 4), 2);
+    const double kk = std::pow (1 - k*k, 0.25);
+    const double e = 0.5 * (1 - kk) / (1 + kk);
+    const double e4 = std::pow (e, 4);
+    const double q = e * (1 + e4*(2 + e4*(15 + 150*e4)));
+    const int order = 2*numCoefs + 1;
+
+    for (int index = 0; index < numCoefs; ++index)
+    {
+        const int c = index + 1;
+
+        double num = 0;
+        double term = 0;
+        int sign = 1;
+        for (int i = 0; i == 0 || std::abs (term) > 1e-100; ++i, sign = -sign)
+        {
+            term = std::pow (q, i*(i + 1)) * std::sin ((2*i + 1) * c * s_pi / order) * sign;
+            num += term;
+        }
+
+        double den = 0;
+        sign = -1;
+        for (int i = 1; i == 1 || std::abs (term) > 1e-100; ++i, sign = -sign)
+        {
+            term = std::pow (q, i*i) * std::cos (2*i * c * s_pi / order) * sign;
+            den += term;
+        }
+
+        const double ww = (num * std::pow (q, 0.25)) / (den + 0.5);
+        const double wwsq = ww*ww;
+        const double x = std::sqrt ((1 - wwsq*k) * (1 - wwsq/k)) / (1 + wwsq);
+        coefs[index] = (1 - x) / (1 + x);
+    }
+}
+
+Saturator::Saturator (const int numChannels)
+    : m_numChannels (numChannels),
+      m_shape (OFF), m_drive (1.0f), m_makeup (1.0f), m_oversampling (1),
+      m_table (nullptr),
+      m_coefs (getHalfBandCoefficients()),
+      m_filters (new HalfBand [4*numChannels])
+{
+    initialise();
+    reset();
+}
+
+Saturator::~Saturator()
+{
+    delete [] m_filters;
+}
+
+void Saturator::initialise()
+{
+    getTanhTable();
+    getAtanTable();
+    getHalfBandCoefficients();
+}
+
+void Saturator::reset()
+{
+    for (int i = 0; i < 4*m_numChannels; ++i) { m_filters[i].reset(); }
+}
+
+void Saturator::setSaturation (const Shape shape, const float drive, const int oversampling)
+{
+    const int factor = oversampling >= 4 ? 4 : (oversampling >= 2 ? 2 : 1);
+
+    // Start the filters from silence when the oversampling changes or the stage is switched on.
+    if (factor != m_oversampling || m_shape == OFF) { reset(); }
+
+    m_shape = shape;
+    m_drive = std::pow (10.0f, drive / 20);
+    m_makeup = 1.0f / m_drive;
+    m_oversampling = factor;
+    m_table = shape == TANH ? getTanhTable() : (shape == ATAN ? getAtanTable() : nullptr);
+}
+
+void Saturator::process (float* data, const int numFrames)
+{
+    const int channels = m_numChannels;
+
+    if (m_oversampling == 1)
+    {
+        for (int j = 0; j < numFrames*channels; ++j) { data[j] = shape (data[j]); }
+        return;
+    }
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        float* frame = data + i*channels;
+        for (int c = 0; c < channels; ++c)
+        {
+            // Each channel has two upsampling stages followed by two downsampling stages.
+            HalfBand* filters = m_filters + 4*c;
+            float a = 0;
+            float b = 0;
+            filters[0].upsample (frame[c], a, b, m_coefs);
+
+            if (m_oversampling == 2)
+            {
+                frame[c] = filters[3].downsample (shape (a), shape (b), m_coefs);
+                continue;
+            }
+
+            float a0 = 0, a1 = 0, b0 = 0, b1 = 0;
+            filters[1].upsample (a, a0, a1, m_coefs);
+            filters[1].upsample (b, b0, b1, m_coefs);
+            a = filters[2].downsample (shape (a0), shape (a1), m_coefs);
+            b = filters[2].downsample (shape (b0), shape (b1), m_coefs);
+            frame[c] = filters[3].downsample (a, b, m_coefs);
+        }
+    }
+}
+
+const char* Saturator::getName (const Shape shape)
+{
+    switch (shape)
+    {
+        case TANH:
+            return "Tanh";
+        case ATAN:
+            return "Arctan";
+        case CUBIC:
+            return "Cubic";
+        default:
+            return "Off";
+    }
+}
+
+const float* Saturator::getTanhTable()
+{
+    static const ShaperTable<s_tableSize> table (s_tableRange, [] (const double x) { return std::tanh (x); });
+    return table.data;
+}
+
+const float* Saturator::getAtanTable()
+{
+    static const ShaperTable<s_tableSize> table (s_tableRange, [] (const double x) { return (2 / s_pi) * std::atan (0.5 * s_pi * x); });
+    return table.data;
+}
+
+const float* Saturator::getHalfBandCoefficients()
+{
+    // About 100 dB of stopband rejection, with the passband up to 0.46 of the base sample rate.
+    static const struct Coefficients
+    {
+        Coefficients()
+        {
+            double coefs[s_numCoefs];
+            designHalfBand (coefs, s_numCoefs, 0.04);
+            for (int i = 0; i < s_numCoefs; ++i) { data[i] = static_cast<float> (coefs[i]); }
+        }
+
+        float data[s_numCoefs];
+    } coefficients;
+
+    return coefficients.data;
+}
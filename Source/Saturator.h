@@ -0,0 +1,167 @@
+/**
+ * Saturator.h
+ * \brief Drive stage for the feedback loop of the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <algorithm>
+
+/**
+ * \brief Drive stage for the feedback loop of the delay line.
+ *
+ * Saturates the signal written into the delay buffer with a waveshaper, so the repeats compress
+ * and thicken as they recirculate. The smooth curves come from lookup tables that are calculated
+ * once, and the cubic curve is a polynomial, so nothing calls std::tanh on the audio thread. Every
+ * curve has unity gain for small signals, and the drive lowers the level where saturation starts.
+ *
+ * The waveshaper can optionally run at 2x or 4x the sample rate through polyphase IIR half-band
+ * filters to reduce aliasing. Only this stage is oversampled, and without oversampling the
+ * signal goes straight through the waveshaper with no added latency.
+ */
+class Saturator
+{
+public:
+
+    /**
+     * Enum for the waveshaper curves.
+     */
+    enum Shape { OFF, TANH, ATAN, CUBIC };
+
+    static const int s_numShapes = 4; ///< Number of waveshaper curves.
+    static const int s_maxOversampling = 4; ///< Highest oversampling factor.
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  int  Number of interleaved channels
+     */
+    Saturator (const int numChannels = 1);
+
+    /**
+     * Class destructor.
+     */
+    ~Saturator();
+
+    /**
+     * Calculates the lookup tables and half-band coefficients. This is called by the constructor,
+     * so it only needs to be called directly to build them ahead of time.
+     */
+    static void initialise();
+
+    /**
+     * Clears the oversampling filter state.
+     */
+    void reset();
+
+    /**
+     * Sets the waveshaper parameters.
+     *
+     * \param[in]  Shape  Waveshaper curve
+     * \param[in]  float  Drive (dB)
+     * \param[in]  int  Oversampling factor (1, 2 or 4)
+     */
+    void setSaturation (const Shape shape, const float drive, const int oversampling);
+
+    /**
+     * Saturates a block of interleaved frames in place.
+     *
+     * \param[in,out]  float*  Data samples
+     * \param[in]  int  Number of sample frames
+     */
+    void process (float* data, const int numFrames);
+
+    bool isActive() const { return m_shape != OFF; }; ///< Indicates whether the waveshaper does anything.
+    int getOversampling() const { return m_oversampling; }; ///< Gets the oversampling factor.
+
+    static const char* getName (const Shape shape); ///< Gets the name of a waveshaper curve.
+
+private:
+
+    static const int s_tableSize = 4096; ///< Number of steps in the waveshaper tables.
+    static const int s_tableRange = 8; ///< The tables cover inputs from -s_tableRange to s_tableRange.
+    static const int s_numCoefs = 8; ///< Number of allpass coefficients in each half-band filter.
+
+    /**
+     * Polyphase IIR half-band filter state for one channel, made of two chains of first-order
+     * allpass sections that alternate between the coefficients.
+     */
+    struct HalfBand
+    {
+        float x[s_numCoefs]; ///< Previous input of each section.
+        float y[s_numCoefs]; ///< Previous output of each section.
+
+        void reset() { std::fill (x, x + s_numCoefs, 0.0f); std::fill (y, y + s_numCoefs, 0.0f); };
+
+        /**
+         * Runs a sample through both allpass chains, the first one with the even coefficients and
+         * the second with the odd ones.
+         */
+        void processChains (float& even, float& odd, const float* coefs)
+        {
+            for (int i = 0; i < s_numCoefs; i += 2)
+            {
+                const float outEven = ((even - y[i]) * coefs[i]) + x[i];
+                const float outOdd = ((odd - y[i + 1]) * coefs[i + 1]) + x[i + 1];
+                x[i] = even;
+                x[i + 1] = odd;
+                y[i] = even = outEven;
+                y[i + 1] = odd = outOdd;
+            }
+        };
+
+        /** Doubles the sample rate of one input sample. */
+        void upsample (const float input, float& out0, float& out1, const float* coefs)
+        {
+            out0 = out1 = input;
+            processChains (out0, out1, coefs);
+        };
+
+        /** Halves the sample rate of two consecutive input samples. */
+        float downsample (const float in0, const float in1, const float* coefs)
+        {
+            float even = in1;
+            float odd = in0;
+            processChains (even, odd, coefs);
+            return 0.5f * (even + odd);
+        };
+    };
+
+    /**
+     * Applies the drive and waveshaper curve to one sample.
+     *
+     * \param[in]  float  Input sample
+     *
+     * \return  float  Saturated sample
+     */
+    float shape (const float input) const
+    {
+        const float x = input * m_drive;
+
+        if (m_table == nullptr)
+        {
+            // Cubic soft clipper, x - x^3/3 up to its peak at +/-1.
+            const float clipped = std::max (-1.0f, std::min (x, 1.0f));
+            return (clipped - (clipped * clipped * clipped * (1.0f / 3))) * m_makeup;
+        }
+
+        const float position = std::max (0.0f, std::min ((x + s_tableRange) * (s_tableSize / (2.0f * s_tableRange)), s_tableSize - 1.0f));
+        const int index = static_cast<int> (position);
+        const float fraction = position - index;
+        return (m_table[index] + (fraction * (m_table[index + 1] - m_table[index]))) * m_makeup;
+    };
+
+    static const float* getTanhTable(); ///< Gets the tanh waveshaper table.
+    static const float* getAtanTable(); ///< Gets the arctangent waveshaper table.
+    static const float* getHalfBandCoefficients(); ///< Gets the half-band allpass coefficients.
+
+    int m_numChannels; ///< Number of interleaved channels.
+    Shape m_shape; ///< Waveshaper curve.
+    float m_drive; ///< Drive gain (linear).
+    float m_makeup; ///< Output gain that keeps the small signal gain at unity (1/m_drive).
+    int m_oversampling; ///< Oversampling factor (1, 2 or 4).
+    const float* m_table; ///< Table for the waveshaper curve, or nullptr for the polynomial curve.
+    const float* m_coefs; ///< Half-band allpass coefficients.
+    HalfBand* m_filters; ///< Upsampling and downsampling filters for each stage of each channel.
+};
@@ -0,0 +1,82 @@
+/**
+ * TempoSync.cpp
+ * \brief Note values and tempo for tempo-synced delay times.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include "TempoSync.h"
+
+double TempoSync::getBeats (const NoteValue note)
+{
+    switch (note)
+    {
+        case WHOLE:
+            return 4.0;
+        case HALF_DOTTED:
+            return 3.0;
+        case HALF:
+            return 2.0;
+        case HALF_TRIPLET:
+            return 4.0 / 3;
+        case QUARTER_DOTTED:
+            return 1.5;
+        case QUARTER_TRIPLET:
+            return 2.0 / 3;
+        case EIGHTH_DOTTED:
+            return 0.75;
+        case EIGHTH:
+            return 0.5;
+        case EIGHTH_TRIPLET:
+            return 1.0 / 3;
+        case SIXTEENTH_DOTTED:
+            return 0.375;
+        case SIXTEENTH:
+            return 0.25;
+        case SIXTEENTH_TRIPLET:
+            return 1.0 / 6;
+        default:
+            return 1.0;
+    }
+}
+
+const char* TempoSync::getName (const NoteValue note)
+{
+    switch (note)
+    {
+        case WHOLE:
+            return "1/1";
+        case HALF_DOTTED:
+            return "1/2.";
+        case HALF:
+            return "1/2";
+        case HALF_TRIPLET:
+            return "1/2T";
+        case QUARTER_DOTTED:
+            return "1/4.";
+        case QUARTER_TRIPLET:
+            return "1/4T";
+        case EIGHTH_DOTTED:
+            return "1/8.";
+        case EIGHTH:
+            return "1/8";
+        case EIGHTH_TRIPLET:
+            return "1/8T";
+        case SIXTEENTH_DOTTED:
+            return "1/16.";
+        case SIXTEENTH:
+            return "1/16";
+        case SIXTEENTH_TRIPLET:
+            return "1/16T";
+        default:
+            return "1/4";
+    }
+}
+
+bool TempoTracker::setHostTempo (const double bpm)
+{
+    if (bpm <= 0 || bpm == m_hostBpm) { return false; }
+
+    m_hostBpm = bpm;
+    m_tapBpm = 0;
+    return true;
+}
@@ -0,0 +1,92 @@
+/**
+ * TempoSync.h
+ * \brief Note values and tempo for tempo-synced delay times.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+
+/**
+ * \brief Note values for tempo-synced delay times.
+ *
+ * Converts straight, dotted and triplet note values to delay times from the host tempo.
+ */
+class TempoSync
+{
+public:
+
+    /**
+     * Enum for the note values, from longest to shortest.
+     */
+    enum NoteValue { WHOLE, HALF_DOTTED, HALF, HALF_TRIPLET,
+                     QUARTER_DOTTED, QUARTER, QUARTER_TRIPLET,
+                     EIGHTH_DOTTED, EIGHTH, EIGHTH_TRIPLET,
+                     SIXTEENTH_DOTTED, SIXTEENTH, SIXTEENTH_TRIPLET };
+
+    static const int s_numNoteValues = 13; ///< Number of note values.
+
+    /**
+     * Gets the length of a note value in quarter notes (beats).
+     *
+     * \param[in]  NoteValue  Note value
+     *
+     * \return  double  Length in beats
+     */
+    static double getBeats (const NoteValue note);
+
+    /**
+     * Gets the delay time of a note value at a tempo.
+     *
+     * \param[in]  double  Tempo (beats per minute)
+     * \param[in]  NoteValue  Note value
+     *
+     * \return  float  Delay time (msecs)
+     */
+    static float getDelayTime (const double bpm, const NoteValue note) { return static_cast<float> (getBeats (note) * 60000.0 / bpm); };
+
+    static const char* getName (const NoteValue note); ///< Gets the name of a note value (e.g. "1/8." for a dotted eighth).
+};
+
+/**
+ * \brief Tempo for the synced delay times, from the host or tapped in.
+ *
+ * A tapped tempo takes precedence over the host tempo until the host reports a tempo that differs
+ * from the last one it reported, or until the tap is cleared. The host tempo is only ever compared
+ * with the last host tempo, so tapping doesn't look like a tempo change to the next host update.
+ * Every value is atomic, so the tempo can be read from any thread.
+ */
+class TempoTracker
+{
+public:
+
+    /**
+     * Class constructor.
+     *
+     * \param[in]  double  Tempo until the host reports one (beats per minute)
+     */
+    explicit TempoTracker (const double bpm = 120.0) : m_hostBpm (bpm), m_tapBpm (0) {};
+
+    /**
+     * Sets the tempo reported by the host. A tempo that differs from the last one the host reported
+     * clears any tapped tempo.
+     *
+     * \param[in]  double  Tempo (beats per minute)
+     *
+     * \return  bool  True if the host tempo changed
+     */
+    bool setHostTempo (const double bpm);
+
+    void tap (const double bpm) { if (bpm > 0) { m_tapBpm = bpm; } }; ///< Sets a tapped tempo, which takes precedence over the host tempo (beats per minute).
+    void clearTap() { m_tapBpm = 0; }; ///< Goes back to the host tempo.
+    bool isTapped() const { return m_tapBpm > 0; }; ///< Indicates whether a tapped tempo takes precedence over the host tempo.
+
+    double getTempo() const { const double tap = m_tapBpm; return (tap > 0) ? tap : m_hostBpm.load(); }; ///< Gets the tempo in use (beats per minute).
+    double getHostTempo() const { return m_hostBpm; }; ///< Gets the last tempo reported by the host (beats per minute).
+
+private:
+
+    std::atomic<double> m_hostBpm; ///< Last tempo reported by the host (beats per minute).
+    std::atomic<double> m_tapBpm; ///< Tapped tempo (beats per minute, 0 = none).
+};
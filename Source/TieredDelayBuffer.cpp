@@ -0,0 +1,371 @@
+/**
+ * TieredDelayBuffer.cpp
+ * \brief Delay buffer for long delays with recent audio in RAM and older audio spilled to a file.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined (_WIN32)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
+#include "DelayKernels.h"
+#include "TieredDelayBuffer.h"
+
+TieredDelayBuffer::TieredDelayBuffer()
+    : m_numChannels(), m_segmentSize(), m_maxDelayFrames(), m_numSpillSegments(), m_format (FLOAT32), m_segmentBytes(),
+      m_ram (nullptr), m_spill (nullptr), m_spillBytes(), m_mapped(),
+      m_fileHandle (nullptr), m_mappingHandle (nullptr),
+      m_cacheData (nullptr), m_scratch (nullptr),
+      m_writeFrame(), m_startFrame(), m_spilledSegments(), m_readSegment (-1), m_dropouts(),
+      m_thread()
+{
+    for (auto& slot : m_cache)
+    {
+        slot.segment = -1;
+        slot.data = nullptr;
+    }
+}
+
+TieredDelayBuffer::~TieredDelayBuffer()
+{
+    release();
+}
+
+bool TieredDelayBuffer::prepare (const int numChannels, const int64_t maxDelayFrames, const std::string& spillDirectory, const Format format)
+{
+    if (isReady() && numChannels == m_numChannels && maxDelayFrames <= m_maxDelayFrames && format == m_format)
+    {
+        startRecording();
+        return true;
+    }
+
+    release();
+
+    m_numChannels = numChannels;
+    m_segmentSize = s_segmentFrames*numChannels;
+    m_maxDelayFrames = maxDelayFrames;
+    m_format = format;
+
+    // The INT16 format stores the scale for each block in front of the samples.
+    switch (format)
+    {
+        case FLOAT16: m_segmentBytes = m_segmentSize*sizeof(uint16_t); break;
+        case INT16: m_segmentBytes = (m_segmentSize/s_scaleBlock)*sizeof(float) + m_segmentSize*sizeof(int16_t); break;
+        default: m_segmentBytes = m_segmentSize*sizeof(float); break;
+    }
+
+    // Keep every segment that the longest delay can reach, plus the segments being read and written.
+    m_numSpillSegments = ((maxDelayFrames + s_segmentFrames - 1) / s_segmentFrames) + 2;
+    m_spillBytes = static_cast<size_t> (m_numSpillSegments) * m_segmentBytes;
+    if (! mapSpillFile (m_spillBytes, spillDirectory))
+    {
+        // Fall back to keeping the spilled segments in memory. Allocating floats keeps the scales aligned.
+        m_spill = reinterpret_cast<unsigned char*> (new (std::nothrow) float [m_spillBytes / sizeof(float)]);
+        if (m_spill == nullptr) { return false; }
+    }
+
+    m_ram = new float [s_ramSegments*m_segmentSize]();
+    m_cacheData = new float [s_cacheSegments*m_segmentSize];
+    m_scratch = new float [m_segmentSize];
+    for (int i = 0; i < s_cacheSegments; ++i)
+    {
+        m_cache[i].segment = -1;
+        m_cache[i].data = m_cacheData + i*m_segmentSize;
+    }
+
+    m_writeFrame = 0;
+    m_startFrame = 0;
+    m_spilledSegments = 0;
+    m_readSegment = -1;
+    m_dropouts = 0;
+
+    m_thread = BackgroundThread::getShared();
+    m_thread->add (&TieredDelayBuffer::runTask, this);
+    return true;
+}
+
+void TieredDelayBuffer::release()
+{
+    if (m_thread != nullptr)
+    {
+        m_thread->remove (this);
+        m_thread = nullptr;
+    }
+
+    if (m_mapped)
+    {
+#if defined (_WIN32)
+        UnmapViewOfFile (m_spill);
+        CloseHandle (static_cast<HANDLE> (m_mappingHandle));
+        CloseHandle (static_cast<HANDLE> (m_fileHandle));
+        m_fileHandle = m_mappingHandle = nullptr;
+#else
+        munmap (m_spill, m_spillBytes);
+#endif
+    }
+    else
+    {
+        delete [] reinterpret_cast<float*> (m_spill);
+    }
+
+    delete [] m_ram;
+    delete [] m_cacheData;
+    delete [] m_scratch;
+    m_spill = nullptr;
+    m_ram = m_cacheData = m_scratch = nullptr;
+    m_mapped = false;
+    m_maxDelayFrames = 0;
+    for (auto& slot : m_cache)
+    {
+        slot.segment = -1;
+        slot.data = nullptr;
+    }
+}
+
+void TieredDelayBuffer::startRecording()
+{
+    m_startFrame.store (getWriteFrame(), std::memory_order_relaxed);
+}
+
+int TieredDelayBuffer::getRunLength (const int64_t readFrame, const int maxFrames) const
+{
+    const int64_t writeFrame = getWriteFrame();
+    int64_t run = std::min<int64_t> (maxFrames, s_segmentFrames - (writeFrame % s_segmentFrames));
+
+    // The run stops at the start of the recording, which needn't be on a segment boundary.
+    const int64_t startFrame = m_startFrame.load (std::memory_order_relaxed);
+    if (readFrame < startFrame) { run = std::min (run, startFrame - readFrame); }
+    else { run = std::min<int64_t> (run, s_segmentFrames - (readFrame % s_segmentFrames)); }
+
+    return static_cast<int> (run);
+}
+
+void TieredDelayBuffer::advance (const int numFrames)
+{
+    const int64_t writeFrame = getWriteFrame() + numFrames;
+
+    // Starting a segment overwrites the oldest one in the RAM ring, which should have been spilled by now.
+    if (writeFrame % s_segmentFrames == 0)
+    {
+        const int64_t oldest = (writeFrame / s_segmentFrames) - s_ramSegments;
+        if (oldest >= 0 && oldest >= m_spilledSegments.load (std::memory_order_acquire)) { ++m_dropouts; }
+    }
+
+    m_writeFrame.store (writeFrame, std::memory_order_release);
+    if (writeFrame % s_segmentFrames == 0) { m_thread->signal(); }
+}
+
+const float* TieredDelayBuffer::read (const int64_t frame, const int numFrames)
+{
+    const int num = numFrames*m_numChannels;
+    const int64_t startFrame = m_startFrame.load (std::memory_order_relaxed);
+
+    // Tell the background thread where the read position is, so the segments ahead of it are
+    // prefetched before they're needed. Before the start of the recording, that's the first segment.
+    const int64_t segment = std::max (frame, startFrame) / s_segmentFrames;
+    if (m_readSegment.exchange (segment, std::memory_order_relaxed) != segment) { m_thread->signal(); }
+
+    if (frame >= startFrame)
+    {
+        const int offset = static_cast<int> (frame % s_segmentFrames) * m_numChannels;
+
+        // Recent segments are still in the RAM ring.
+        if (segment > (getWriteFrame() / s_segmentFrames) - s_ramSegments)
+        {
+            return m_ram + ((segment % s_ramSegments) * m_segmentSize) + offset;
+        }
+
+        // Older segments come from the cache. The slot is checked again after copying, in case it
+        // was reloaded in the meantime.
+        for (auto& slot : m_cache)
+        {
+            if (slot.segment.load (std::memory_order_acquire) != segment) { continue; }
+
+            std::copy (slot.data + offset, slot.data + offset + num, m_scratch);
+            std::atomic_thread_fence (std::memory_order_acquire);
+            if (slot.segment.load (std::memory_order_relaxed) == segment) { return m_scratch; }
+            break;
+        }
+
+        // The segment wasn't prefetched in time, so it's lost rather than waited for.
+        ++m_dropouts;
+    }
+
+    std::fill (m_scratch, m_scratch + num, 0.0f);
+    return m_scratch;
+}
+
+void TieredDelayBuffer::runTask (void* context)
+{
+    TieredDelayBuffer* buffer = static_cast<TieredDelayBuffer*> (context);
+    buffer->spillSegments();
+    buffer->prefetchSegments();
+}
+
+void TieredDelayBuffer::spillSegments()
+{
+    const int64_t finished = m_writeFrame.load (std::memory_order_acquire) / s_segmentFrames;
+
+    for (int64_t segment = m_spilledSegments.load (std::memory_order_relaxed); segment < finished; ++segment)
+    {
+        // Segments that have already been overwritten in the RAM ring are lost.
+        if (segment > finished - s_ramSegments)
+        {
+            encodeSegment (m_ram + ((segment % s_ramSegments) * m_segmentSize), m_spill + ((segment % m_numSpillSegments) * m_segmentBytes));
+        }
+
+        m_spilledSegments.store (segment + 1, std::memory_order_release);
+    }
+}
+
+void TieredDelayBuffer::prefetchSegments()
+{
+    const int64_t first = m_readSegment.load (std::memory_order_relaxed);
+    if (first < 0) { return; }
+
+    // Only load the segments that will have left the RAM ring by the time they're read.
+    const int64_t finished = m_writeFrame.load (std::memory_order_relaxed) / s_segmentFrames;
+    const int64_t last = std::min (first + s_cacheSegments, m_spilledSegments.load (std::memory_order_acquire));
+    for (int64_t segment = first; segment < last; ++segment)
+    {
+        if (segment > finished - s_ramSegments + s_cacheSegments) { break; }
+
+        // Find the segment in the cache, or a slot holding a segment outside of the prefetch window.
+        CacheSlot* victim = nullptr;
+        bool cached = false;
+        for (auto& slot : m_cache)
+        {
+            const int64_t held = slot.segment.load (std::memory_order_relaxed);
+            if (held == segment) { cached = true; break; }
+            if (victim == nullptr && (held < first || held >= first + s_cacheSegments)) { victim = &slot; }
+        }
+        if (cached) { continue; }
+        if (victim == nullptr) { break; }
+
+        victim->segment.store (-1, std::memory_order_relaxed);
+        std::atomic_thread_fence (std::memory_order_release);
+        decodeSegment (m_spill + ((segment % m_numSpillSegments) * m_segmentBytes), victim->data);
+        victim->segment.store (segment, std::memory_order_release);
+    }
+}
+
+void TieredDelayBuffer::encodeSegment (const float* source, unsigned char* destination) const
+{
+    switch (m_format)
+    {
+        case FLOAT16:
+            DelayKernels::floatToHalf (source, reinterpret_cast<uint16_t*> (destination), m_segmentSize);
+            break;
+
+        case INT16:
+        {
+            // Each block is scaled so that its peak uses the full range.
+            float* scales = reinterpret_cast<float*> (destination);
+            int16_t* samples = reinterpret_cast<int16_t*> (scales + m_segmentSize/s_scaleBlock);
+            for (int i = 0; i < m_segmentSize; i += s_scaleBlock)
+            {
+                const float peak = DelayKernels::getPeak (source + i, s_scaleBlock);
+                const float scale = (peak > 0.0f) ? 32767.0f/peak : 0.0f;
+                DelayKernels::floatToInt16 (source + i, samples + i, s_scaleBlock, scale);
+                scales[i/s_scaleBlock] = (peak > 0.0f) ? peak/32767.0f : 0.0f;
+            }
+            break;
+        }
+
+        default:
+            std::copy (source, source + m_segmentSize, reinterpret_cast<float*> (destination));
+            break;
+    }
+}
+
+void TieredDelayBuffer::decodeSegment (const unsigned char* source, float* destination) const
+{
+    switch (m_format)
+    {
+        case FLOAT16:
+            DelayKernels::halfToFloat (reinterpret_cast<const uint16_t*> (source), destination, m_segmentSize);
+            break;
+
+        case INT16:
+        {
+            const float* scales = reinterpret_cast<const float*> (source);
+            const int16_t* samples = reinterpret_cast<const int16_t*> (scales + m_segmentSize/s_scaleBlock);
+            for (int i = 0; i < m_segmentSize; i += s_scaleBlock)
+            {
+                DelayKernels::int16ToFloat (samples + i, destination + i, s_scaleBlock, scales[i/s_scaleBlock]);
+            }
+            break;
+        }
+
+        default:
+        {
+            const float* samples = reinterpret_cast<const float*> (source);
+            std::copy (samples, samples + m_segmentSize, destination);
+            break;
+        }
+    }
+}
+
+bool TieredDelayBuffer::mapSpillFile (const size_t bytes, const std::string& directory)
+{
+#if defined (_WIN32)
+    char path[MAX_PATH + 1];
+    std::string folder = directory;
+    if (folder.empty())
+    {
+        char temp[MAX_PATH + 1];
+        if (GetTempPathA (MAX_PATH, temp) == 0) { return false; }
+        folder = temp;
+    }
+    if (GetTempFileNameA (folder.c_str(), "SDL", 0, path) == 0) { return false; }
+
+    // The file is deleted when the handles are closed.
+    HANDLE file = CreateFileA (path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+
+    const uint64_t size = bytes;
+    HANDLE mapping = CreateFileMappingA (file, nullptr, PAGE_READWRITE, static_cast<DWORD> (size >> 32), static_cast<DWORD> (size), nullptr);
+    void* data = (mapping != nullptr) ? MapViewOfFile (mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes) : nullptr;
+    if (data == nullptr)
+    {
+        if (mapping != nullptr) { CloseHandle (mapping); }
+        CloseHandle (file);
+        return false;
+    }
+
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+#else
+    std::string folder = directory;
+    if (folder.empty())
+    {
+        const char* temp = std::getenv ("TMPDIR");
+        folder = (temp != nullptr) ? temp : "/tmp";
+    }
+    std::string path = folder + "/StereoDelaySpill-XXXXXX";
+    const int file = mkstemp (&path[0]);
+    if (file < 0) { return false; }
+
+    // The file is deleted straight away, and its space is freed when it's unmapped.
+    unlink (path.c_str());
+    void* data = (ftruncate (file, static_cast<off_t> (bytes)) == 0) ? mmap (nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+    close (file);
+    if (data == MAP_FAILED) { return false; }
+#endif
+
+    m_spill = static_cast<unsigned char*> (data);
+    m_mapped = true;
+    return true;
+}
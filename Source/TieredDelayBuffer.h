@@ -0,0 +1,204 @@
+/**
+ * TieredDelayBuffer.h
+ * \brief Delay buffer for long delays with recent audio in RAM and older audio spilled to a file.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "BackgroundThread.h"
+
+/**
+ * \brief Delay buffer for long delays with tiered memory.
+ *
+ * The buffer is split into segments of s_segmentFrames interleaved frames. The most recent
+ * s_ramSegments segments stay in a RAM ring that the audio thread writes into. A task on the shared
+ * BackgroundThread copies each finished segment to the spill store, which is a memory-mapped
+ * temporary file (or a block of memory if the file can't be mapped). It also loads the segments
+ * just ahead of the read position back into a small prefetch cache. The audio thread signals the
+ * task when it finishes a segment or starts reading a new one, so it doesn't poll.
+ *
+ * The spill store can hold the segments as half precision or as block-scaled 16-bit integers,
+ * which halves the memory or disk space for long delays. The background task does the
+ * conversions as it spills and prefetches, so the RAM ring and cache stay as single precision.
+ *
+ * The audio thread only touches the RAM ring and the cache, so it never waits for the disk. A
+ * segment that isn't prefetched in time reads as silence and is counted as a dropout.
+ *
+ * Positions are absolute frame counts, so nothing has to be cleared when a new recording starts.
+ * Anything from before the start of the recording reads as silence.
+ */
+class TieredDelayBuffer
+{
+public:
+
+    /**
+     * Storage formats for the spill store.
+     */
+    enum Format
+    {
+        FLOAT32, ///< Single precision
+        FLOAT16, ///< Half precision, with 11 significant bits
+        INT16,   ///< 16-bit integers, each block scaled to its own peak
+    };
+
+    /**
+     * Class constructor. The buffer isn't usable until prepare() is called.
+     */
+    TieredDelayBuffer();
+
+    /**
+     * Class destructor.
+     */
+    ~TieredDelayBuffer();
+
+    /**
+     * Allocates the RAM ring, prefetch cache and spill store, and registers the background task.
+     * Nothing is reallocated if the buffer is already big enough for the same number of channels and format.
+     * This allocates memory and creates a file, so it's never called from the audio thread.
+     *
+     * \param[in]  int  Number of interleaved channels
+     * \param[in]  int64_t  Longest delay (frames)
+     * \param[in]  std::string  Directory for the spill file (empty for the system temporary directory)
+     * \param[in]  Format  Storage format for the spill store
+     *
+     * \return  bool  True if the buffer is ready to use
+     */
+    bool prepare (const int numChannels, const int64_t maxDelayFrames, const std::string& spillDirectory, const Format format = FLOAT32);
+
+    void release(); ///< Unregisters the background task, and frees the memory and spill file.
+    bool isReady() const { return m_ram != nullptr; }; ///< Indicates whether prepare() succeeded.
+    bool isMapped() const { return m_mapped; }; ///< Indicates whether the spill store is a memory-mapped file.
+    Format getFormat() const { return m_format; }; ///< Gets the storage format for the spill store.
+    size_t getSpillBytes() const { return m_spillBytes; }; ///< Gets the size of the spill store (bytes).
+    int64_t getMaxDelayFrames() const { return m_maxDelayFrames; }; ///< Gets the longest delay (frames).
+
+    void startRecording(); ///< Starts a new recording at the write position, so that everything before it reads as silence.
+
+    int64_t getWriteFrame() const { return m_writeFrame.load (std::memory_order_relaxed); }; ///< Gets the absolute write position (frames).
+
+    /**
+     * Limits a run so that neither the write position nor a read position crosses a segment
+     * boundary or the start of the recording.
+     *
+     * \param[in]  int64_t  Absolute read position (frames)
+     * \param[in]  int  Maximum run length (frames)
+     *
+     * \return  int  Run length (frames)
+     */
+    int getRunLength (const int64_t readFrame, const int maxFrames) const;
+
+    /**
+     * Gets the RAM at the write position for the next run, which must then be passed to advance().
+     *
+     * \return  float*  Interleaved frames to write
+     */
+    float* getWritePointer() { return m_ram + (getWriteFrame() % (s_ramSegments*s_segmentFrames))*m_numChannels; };
+
+    /**
+     * Moves the write position on after a run has been written. A finished segment is handed to
+     * the background task to be spilled.
+     *
+     * \param[in]  int  Number of frames written
+     */
+    void advance (const int numFrames);
+
+    /**
+     * Reads a run of frames from getRunLength(). Recent frames are read straight from the RAM ring,
+     * and older frames are copied out of the prefetch cache.
+     *
+     * \param[in]  int64_t  Absolute read position (frames)
+     * \param[in]  int  Number of frames
+     *
+     * \return  const float*  Interleaved frames, which are silent if they weren't recorded or prefetched
+     */
+    const float* read (const int64_t frame, const int numFrames);
+
+    int getNumDropouts() const { return m_dropouts.load (std::memory_order_relaxed); }; ///< Gets the number of times audio was lost or read late.
+
+    static const int s_segmentFrames = 4096; ///< Number of frames per segment.
+    static const int s_ramSegments = 32; ///< Number of segments kept in RAM.
+    static const int s_cacheSegments = 8; ///< Number of segments prefetched ahead of the read position.
+    static const int s_scaleBlock = 256; ///< Number of samples sharing a scale in the INT16 format.
+
+private:
+
+    /**
+     * Prefetch cache slot. The segment index is cleared while the slot is being loaded, and the
+     * audio thread checks it before and after copying the data out.
+     */
+    struct CacheSlot
+    {
+        std::atomic<int64_t> segment; ///< Segment held in the slot (-1 = none).
+        float* data; ///< Segment data.
+    };
+
+    /**
+     * Background task, which spills the finished segments and prefetches the ones ahead of the
+     * read position.
+     *
+     * \param[in]  void*  The buffer
+     */
+    static void runTask (void* context);
+
+    void spillSegments(); ///< Copies finished segments from the RAM ring to the spill store.
+    void prefetchSegments(); ///< Loads the segments ahead of the read position into the cache.
+
+    /**
+     * Converts a segment to the storage format.
+     *
+     * \param[in]  float*  Segment from the RAM ring
+     * \param[out]  unsigned char*  Segment in the spill store
+     */
+    void encodeSegment (const float* source, unsigned char* destination) const;
+
+    /**
+     * Converts a segment from the storage format.
+     *
+     * \param[in]  unsigned char*  Segment in the spill store
+     * \param[out]  float*  Segment in the cache
+     */
+    void decodeSegment (const unsigned char* source, float* destination) const;
+
+    /**
+     * Maps a temporary file for the spill store.
+     *
+     * \param[in]  size_t  File size (bytes)
+     * \param[in]  std::string  Directory for the file (empty for the system temporary directory)
+     *
+     * \return  bool  True if the file was mapped
+     */
+    bool mapSpillFile (const size_t bytes, const std::string& directory);
+
+    int m_numChannels; ///< Number of interleaved channels.
+    int m_segmentSize; ///< Number of samples per segment.
+    int64_t m_maxDelayFrames; ///< Longest delay (frames).
+    int64_t m_numSpillSegments; ///< Number of segments in the spill store.
+    Format m_format; ///< Storage format for the spill store.
+    size_t m_segmentBytes; ///< Size of a segment in the spill store (bytes).
+
+    float* m_ram; ///< RAM ring (s_ramSegments segments).
+    unsigned char* m_spill; ///< Spill store (m_numSpillSegments segments).
+    size_t m_spillBytes; ///< Size of the spill store (bytes).
+    bool m_mapped; ///< True if the spill store is a memory-mapped file.
+    void* m_fileHandle; ///< Spill file handle (Windows only).
+    void* m_mappingHandle; ///< Spill file mapping handle (Windows only).
+
+    CacheSlot m_cache[s_cacheSegments]; ///< Prefetch cache.
+    float* m_cacheData; ///< Memory for the cache slots.
+    float* m_scratch; ///< Segment copied out of the cache for the audio thread.
+
+    std::atomic<int64_t> m_writeFrame; ///< Absolute write position (frames).
+    std::atomic<int64_t> m_startFrame; ///< Absolute position where the recording started (frames).
+    std::atomic<int64_t> m_spilledSegments; ///< Number of segments copied to the spill store.
+    std::atomic<int64_t> m_readSegment; ///< Segment that the audio thread last read from the spill store.
+    std::atomic<int> m_dropouts; ///< Number of times audio was lost or read late.
+
+    std::shared_ptr<BackgroundThread> m_thread; ///< Background thread for spilling and prefetching (null until prepared).
+};
@@ -0,0 +1,214 @@
+/**
+ * WorkerPool.cpp
+ * \brief Realtime-safe pool of worker threads for splitting a block across cores.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "WorkerPool.h"
+
+#if defined (_WIN32)
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <pthread.h>
+ #include <sched.h>
+#endif
+
+#if defined (__x86_64__) || defined (__i386__) || defined (_M_X64) || defined (_M_IX86)
+ #include <immintrin.h>
+ #define WORKERPOOL_PAUSE() _mm_pause()
+#elif defined (_M_ARM64)
+ #include <intrin.h>
+ #define WORKERPOOL_PAUSE() __yield()
+#elif defined (__aarch64__) || defined (__arm__)
+ #define WORKERPOOL_PAUSE() __asm__ __volatile__ ("yield")
+#else
+ #define WORKERPOOL_PAUSE()
+#endif
+
+WorkerPool::WorkerPool (const int numThreads)
+    : m_threads(),
+      m_batches(),
+      m_numStarted (0),
+      m_numRealtime (0),
+      m_published (0),
+      m_sleeping (0),
+      m_mutex(),
+      m_wake(),
+      m_running (true)
+{
+    for (int t = 0; t < numThreads; ++t) { m_threads.emplace_back (&WorkerPool::work, this); }
+
+    // isRealtime() is only meaningful once every worker has asked.
+    while (m_numStarted.load() < numThreads) { std::this_thread::yield(); }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_running = false;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) { thread.join(); }
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::getShared()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<WorkerPool> shared;
+
+    std::lock_guard<std::mutex> lock (mutex);
+    std::shared_ptr<WorkerPool> pool = shared.lock();
+    if (pool == nullptr)
+    {
+        const int numCores = static_cast<int> (std::max (1u, std::thread::hardware_concurrency()));
+        pool = std::make_shared<WorkerPool> (std::min (numCores, s_maxSharedThreads + 1) - 1);
+        shared = pool;
+    }
+    return pool;
+}
+
+void WorkerPool::run (const int numJobs, const JobFunction function, void* context)
+{
+    if (numJobs <= 0) { return; }
+
+    // Take a free slot. A single job, a pool without workers or a pool with every slot taken just
+    // runs the jobs on the calling thread.
+    Batch* batch = nullptr;
+    for (int slot = 0; slot < s_maxBatches && batch == nullptr && numJobs > 1 && ! m_threads.empty(); ++slot)
+    {
+        bool busy = false;
+        if (m_batches[slot].busy.compare_exchange_strong (busy, true)) { batch = &m_batches[slot]; }
+    }
+    if (batch == nullptr)
+    {
+        for (int index = 0; index < numJobs; ++index) { function (context, index); }
+        return;
+    }
+
+    // Start the new batch's job count before publishing the rest, so a worker still holding the
+    // last batch number of the slot can't claim one of its jobs.
+    const uint32_t number = batch->number.load() + 1;
+    batch->next = static_cast<uint64_t> (number) << 32;
+    batch->function = function;
+    batch->context = context;
+    batch->numJobs = numJobs;
+    batch->completed = 0;
+    batch->number = number;
+    ++m_published;
+
+    // Notifying doesn't need the mutex. A wake-up that's missed is made up for by the caller.
+    if (m_sleeping.load() > 0) { m_wake.notify_all(); }
+
+    int index = 0;
+    while (claimJob (*batch, number, numJobs, index))
+    {
+        function (context, index);
+        ++batch->completed;
+    }
+
+    // Every job is claimed, so only the ones that workers are still running are left to wait for.
+    // With realtime priority they aren't preempted for ordinary threads, so spin briefly and then
+    // give up the core to them.
+    const auto spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds (s_spinTime);
+    bool spinning = true;
+    for (int spin = 1; batch->completed.load() < numJobs; ++spin)
+    {
+        if (spinning && spin % 64 == 0) { spinning = std::chrono::steady_clock::now() < spinEnd; }
+        if (spinning) { WORKERPOOL_PAUSE(); }
+        else { std::this_thread::yield(); }
+    }
+    batch->busy = false;
+}
+
+bool WorkerPool::claimJob (Batch& batch, const uint32_t number, const int numJobs, int& index)
+{
+    uint64_t next = batch.next.load();
+    while (static_cast<uint32_t> (next >> 32) == number && static_cast<int> (next & 0xffffffffu) < numJobs)
+    {
+        if (batch.next.compare_exchange_weak (next, next + 1))
+        {
+            index = static_cast<int> (next & 0xffffffffu);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkerPool::help()
+{
+    bool worked = false;
+    for (Batch& batch : m_batches)
+    {
+        // The batch number is published last, so the rest belongs to this batch or a later one,
+        // whose jobs can't be claimed with this number.
+        const uint32_t number = batch.number.load();
+        const JobFunction function = batch.function.load();
+        void* const context = batch.context.load();
+        const int numJobs = batch.numJobs.load();
+        int index = 0;
+        while (claimJob (batch, number, numJobs, index))
+        {
+            function (context, index);
+            ++batch.completed;
+            worked = true;
+        }
+    }
+    return worked;
+}
+
+void WorkerPool::work()
+{
+    if (setRealtimePriority()) { ++m_numRealtime; }
+    ++m_numStarted;
+
+    auto spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds (s_spinTime);
+    while (m_running.load())
+    {
+        const uint32_t seen = m_published.load();
+        if (help())
+        {
+            spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds (s_spinTime);
+            continue;
+        }
+
+        // Spin in case another batch follows soon, then sleep until one arrives.
+        bool published = false;
+        for (int spin = 1; ! published; ++spin)
+        {
+            WORKERPOOL_PAUSE();
+            published = m_published.load() != seen;
+            if (spin % 64 == 0 && std::chrono::steady_clock::now() >= spinEnd) { break; }
+        }
+
+        if (! published)
+        {
+            std::unique_lock<std::mutex> lock (m_mutex);
+            ++m_sleeping;
+            published = m_wake.wait_for (lock, std::chrono::milliseconds (s_sleepTime), [this, seen] { return m_published.load() != seen || ! m_running.load(); });
+            --m_sleeping;
+        }
+
+        // Only a new batch starts the spinning again, so an idle pool stays asleep.
+        if (published) { spinEnd = std::chrono::steady_clock::now() + std::chrono::microseconds (s_spinTime); }
+    }
+}
+
+bool WorkerPool::setRealtimePriority()
+{
+   #if defined (_WIN32)
+    return SetThreadPriority (GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+   #else
+    // Midway up the realtime range, which is below the audio threads of most hosts. Without the
+    // permission for it (no RLIMIT_RTPRIO on Linux), this fails and the thread keeps its priority.
+    sched_param param = {};
+    param.sched_priority = (sched_get_priority_min (SCHED_FIFO) + sched_get_priority_max (SCHED_FIFO)) / 2;
+    return pthread_setschedparam (pthread_self(), SCHED_FIFO, &param) == 0;
+   #endif
+}
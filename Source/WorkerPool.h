@@ -0,0 +1,144 @@
+/**
+ * WorkerPool.h
+ * \brief Realtime-safe pool of worker threads for splitting a block across cores.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Realtime-safe pool of worker threads for splitting a block across cores.
+ *
+ * The threads are started up front, so run() never creates a thread, allocates memory or takes a
+ * lock. A call to run() publishes a batch of numbered jobs in one of s_maxBatches slots, and the
+ * workers and the calling thread each claim the next job with a compare-and-swap until there are
+ * none left. The caller then waits for the jobs that workers are still running to finish. Several
+ * threads can run batches at once, so one pool is shared by every plugin instance (see
+ * getShared()). If every slot is taken, the caller runs its jobs itself.
+ *
+ * The workers ask for realtime priority, so the scheduler doesn't preempt them for ordinary
+ * threads while the caller waits. A job that a worker has claimed can't be taken back, so without
+ * the permission for realtime priority, a worker that is preempted in the middle of a job would
+ * hold up the caller until it finishes the job. isRealtime() tells callers whether every worker
+ * got the priority, and an audio thread should run its jobs itself when it didn't. Jobs should be
+ * large enough to be worth handing over at all, which is why callers skip the pool for short
+ * blocks.
+ *
+ * Between batches, a worker spins for up to s_spinTime in case another batch follows straight
+ * away, and then sleeps until it's woken by run(). Because the caller runs any job that no worker
+ * claims, a worker that is slow to wake only costs parallelism.
+ */
+class WorkerPool
+{
+public:
+
+    /**
+     * Pointer to a job function.
+     *
+     * \param[in]  void*  Context passed to run()
+     * \param[in]  int  Job index (0 to the number of jobs - 1)
+     */
+    typedef void (*JobFunction) (void* context, const int index);
+
+    /**
+     * Class constructor, which starts the worker threads and waits for them to ask for realtime
+     * priority.
+     *
+     * \param[in]  int  Number of worker threads, not counting the threads that call run()
+     */
+    explicit WorkerPool (const int numThreads);
+
+    /**
+     * Class destructor, which stops the worker threads.
+     */
+    ~WorkerPool();
+
+    /**
+     * Gets the pool shared by the whole process, with a worker for every core but one, up to
+     * s_maxSharedThreads. The pool is created by the first call and stopped once the last pointer
+     * to it is released, so never call this or release the pool on the audio thread.
+     *
+     * \return  std::shared_ptr<WorkerPool>  Shared pool
+     */
+    static std::shared_ptr<WorkerPool> getShared();
+
+    int getNumThreads() const { return static_cast<int> (m_threads.size()); }; ///< Gets the number of worker threads.
+    bool isRealtime() const { return m_numRealtime.load() == getNumThreads(); }; ///< Indicates whether every worker thread has realtime priority.
+
+    /**
+     * Runs a batch of jobs on the worker threads and the calling thread, and returns once they
+     * have all finished. Any number of threads may call this at once.
+     *
+     * \param[in]  int  Number of jobs
+     * \param[in]  JobFunction  Function called for each job
+     * \param[in]  void*  Context passed to the function
+     */
+    void run (const int numJobs, const JobFunction function, void* context);
+
+    static const int s_maxBatches = 8; ///< Number of batches that can run at once.
+    static const int s_maxSharedThreads = 3; ///< Most worker threads in the shared pool, for the processor's four channel groups at most.
+
+private:
+
+    /**
+     * Slot for a batch of jobs.
+     */
+    struct Batch
+    {
+        std::atomic<bool> busy { false }; ///< True while a caller owns the slot.
+        std::atomic<uint32_t> number { 0 }; ///< Number of the latest batch in the slot.
+        std::atomic<uint64_t> next { 0 }; ///< Batch number (high 32 bits) and index of its next unclaimed job (low 32 bits).
+        std::atomic<JobFunction> function { nullptr }; ///< Job function of the latest batch.
+        std::atomic<void*> context { nullptr }; ///< Job context of the latest batch.
+        std::atomic<int> numJobs { 0 }; ///< Number of jobs in the latest batch.
+        std::atomic<int> completed { 0 }; ///< Number of jobs of the latest batch that have finished.
+    };
+
+    /**
+     * Claims the next job of a batch.
+     *
+     * \param[in]  Batch&  Batch slot
+     * \param[in]  uint32_t  Batch number
+     * \param[in]  int  Number of jobs in the batch
+     * \param[out]  int&  Index of the claimed job
+     *
+     * \return  bool  True if a job was claimed, or false if the batch has none left
+     */
+    static bool claimJob (Batch& batch, const uint32_t number, const int numJobs, int& index);
+
+    /**
+     * Runs jobs from any of the batches until none are left to claim.
+     *
+     * \return  bool  True if any job was run
+     */
+    bool help();
+
+    void work(); ///< Worker thread loop.
+
+    static bool setRealtimePriority(); ///< Asks for realtime scheduling of the calling thread, and returns true if it was granted.
+
+    static const int s_spinTime = 50; ///< Longest time a waiting thread spins before it sleeps or yields (usecs).
+    static const int s_sleepTime = 10; ///< Longest time a worker sleeps without checking for a batch (msecs).
+
+    std::vector<std::thread> m_threads; ///< Worker threads.
+    Batch m_batches[s_maxBatches]; ///< Batch slots.
+    std::atomic<int> m_numStarted; ///< Number of workers that have asked for realtime priority.
+    std::atomic<int> m_numRealtime; ///< Number of workers that were granted realtime priority.
+    std::atomic<uint32_t> m_published; ///< Number of batches published so far, for the workers to notice new ones.
+
+    std::atomic<int> m_sleeping; ///< Number of workers that are sleeping.
+    std::mutex m_mutex; ///< Mutex for the wake condition (workers only).
+    std::condition_variable m_wake; ///< Wakes the sleeping workers for a batch.
+    std::atomic<bool> m_running; ///< Cleared to stop the worker threads.
+
+    WorkerPool (const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+};
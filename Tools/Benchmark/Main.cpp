@@ -0,0 +1,386 @@
+/**
+ * Main.cpp
+ * \brief Headless offline renderer and benchmark for the stereo delay processor.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ *
+ * Runs StereoDelayProcessor::processBlock() offline over a WAV file or synthesized noise, for
+ * every combination of block size, sample rate, parameter sweep and interpolation type, and
+ * reports the processing time per sample, the real-time factor and the number of heap
+ * allocations made while processing. It needs no audio device or display, so it can run on
+ * build servers.
+ *
+ * Usage: stereo-delay-benchmark [options]
+ *     --input file.wav          Audio file to process (default: white noise)
+ *     --output file.wav         Writes the render of the first configuration
+ *     --seconds n               Length of the synthesized noise (default: 10)
+ *     --block-sizes a,b,...     Block sizes (default: 32,64,128,256,512,1024)
+ *     --sample-rates a,b,...    Sample rates (default: 44100,48000,96000, or the input file rate)
+ *     --sweeps a,b,...          Parameter sweeps: static, automation, modulation (default: all)
+ *     --interpolation a,b,...   Interpolation types: linear, cubic, lagrange, allpass, sinc or all (default: linear)
+ *     --repeats n               Timed passes per configuration, the fastest is reported (default: 3)
+ *     --csv                     Prints the results as comma separated values
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../../JuceLibraryCode/JuceHeader.h"
+
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+// Allocation counting. Every heap allocation goes through malloc, calloc or realloc (operator new
+// and JUCE's HeapBlock included), so wrapping them in glibc counts all of them.
+
+static std::atomic<long long> s_numAllocations (0); ///< Number of heap allocations made so far.
+
+extern "C"
+{
+    void* __libc_malloc (size_t size);
+    void* __libc_calloc (size_t count, size_t size);
+    void* __libc_realloc (void* ptr, size_t size);
+
+    void* malloc (size_t size)
+    {
+        s_numAllocations.fetch_add (1, std::memory_order_relaxed);
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size)
+    {
+        s_numAllocations.fetch_add (1, std::memory_order_relaxed);
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* ptr, size_t size)
+    {
+        s_numAllocations.fetch_add (1, std::memory_order_relaxed);
+        return __libc_realloc (ptr, size);
+    }
+}
+
+//==============================================================================
+
+/**
+ * Enum for the parameter sweeps applied while processing.
+ */
+enum Sweep { STATIC, AUTOMATION, MODULATION };
+
+static const char* s_sweepNames[] = { "static", "automation", "modulation" };
+static const char* s_interpolationNames[] = { "linear", "cubic", "lagrange", "allpass", "sinc" };
+
+/**
+ * Benchmark settings from the command line.
+ */
+struct Settings
+{
+    String inputFile; ///< WAV file to process (empty for noise).
+    String outputFile; ///< WAV file for the render of the first configuration (empty for none).
+    double seconds = 10; ///< Length of the synthesized noise (secs).
+    Array<int> blockSizes; ///< Block sizes to run (samples).
+    Array<double> sampleRates; ///< Sample rates to run (Hz).
+    Array<int> sweeps; ///< Parameter sweeps to run (Sweep).
+    Array<int> interpolations; ///< Interpolation types to run (Interpolators::Type).
+    int repeats = 3; ///< Number of timed passes per configuration.
+    bool csv = false; ///< Prints comma separated values instead of a table.
+};
+
+/**
+ * Results of one benchmark configuration.
+ */
+struct Result
+{
+    double nsPerSample; ///< Processing time per sample frame (nsecs).
+    double realTimeFactor; ///< Audio duration divided by the processing time.
+    long long allocations; ///< Heap allocations made while processing, over all passes.
+};
+
+/**
+ * Finds the index of a name in a list of names.
+ *
+ * \return  int  Index of the name, or -1 if it isn't in the list
+ */
+static int findName (const String& name, const char* const* names, const int numNames)
+{
+    for (int i = 0; i < numNames; ++i)
+    {
+        if (name.equalsIgnoreCase (names[i])) { return i; }
+    }
+    return -1;
+}
+
+/**
+ * Parses the command line arguments.
+ *
+ * \return  bool  False if an argument is invalid
+ */
+static bool parseArguments (const StringArray& args, Settings& settings)
+{
+    for (int i = 0; i < args.size(); ++i)
+    {
+        const String arg = args[i];
+        const String value = args[i + 1];
+
+        if (arg == "--csv") { settings.csv = true; continue; }
+        if (value.isEmpty()) { std::fprintf (stderr, "Missing value for %s\n", arg.toRawUTF8()); return false; }
+        ++i;
+
+        StringArray list;
+        list.addTokens (value, ",", "");
+        list.trim();
+        list.removeEmptyStrings();
+
+        if (arg == "--input") { settings.inputFile = value; }
+        else if (arg == "--output") { settings.outputFile = value; }
+        else if (arg == "--seconds") { settings.seconds = value.getDoubleValue(); }
+        else if (arg == "--repeats") { settings.repeats = jmax (1, value.getIntValue()); }
+        else if (arg == "--block-sizes")
+        {
+            for (auto& item : list) { settings.blockSizes.add (jmax (1, item.getIntValue())); }
+        }
+        else if (arg == "--sample-rates")
+        {
+            for (auto& item : list) { settings.sampleRates.add (item.getDoubleValue()); }
+        }
+        else if (arg == "--sweeps")
+        {
+            for (auto& item : list)
+            {
+                const int sweep = findName (item, s_sweepNames, numElementsInArray (s_sweepNames));
+                if (sweep < 0) { std::fprintf (stderr, "Unknown sweep %s\n", item.toRawUTF8()); return false; }
+                settings.sweeps.add (sweep);
+            }
+        }
+        else if (arg == "--interpolation")
+        {
+            for (auto& item : list)
+            {
+                if (item.equalsIgnoreCase ("all"))
+                {
+                    for (int type = 0; type < Interpolators::s_numTypes; ++type) { settings.interpolations.addIfNotAlreadyThere (type); }
+                    continue;
+                }
+
+                const int type = findName (item, s_interpolationNames, numElementsInArray (s_interpolationNames));
+                if (type < 0) { std::fprintf (stderr, "Unknown interpolation %s\n", item.toRawUTF8()); return false; }
+                settings.interpolations.addIfNotAlreadyThere (type);
+            }
+        }
+        else
+        {
+            std::fprintf (stderr, "Unknown argument %s\n", arg.toRawUTF8());
+            return false;
+        }
+    }
+
+    // Fill in the defaults for anything that wasn't given.
+    if (settings.blockSizes.isEmpty()) { settings.blockSizes.addArray ({ 32, 64, 128, 256, 512, 1024 }); }
+    if (settings.sweeps.isEmpty()) { settings.sweeps.addArray ({ STATIC, AUTOMATION, MODULATION }); }
+    if (settings.interpolations.isEmpty()) { settings.interpolations.add (Interpolators::LINEAR); }
+    return true;
+}
+
+/**
+ * Loads the input signal as two channels, or synthesizes white noise without an input file.
+ *
+ * \param[out]  double&  Sample rate of the input file (unchanged for noise)
+ *
+ * \return  bool  False if the input file couldn't be read
+ */
+static bool loadInput (const Settings& settings, AudioSampleBuffer& source, double& fileRate)
+{
+    if (settings.inputFile.isEmpty())
+    {
+        const int numSamples = jmax (1, static_cast<int> (settings.seconds * 48000));
+        source.setSize (2, numSamples);
+
+        Random random (1234);
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            auto data = source.getWritePointer (channel);
+            for (int i = 0; i < numSamples; ++i) { data[i] = (random.nextFloat() - 0.5f); }
+        }
+        return true;
+    }
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    ScopedPointer<AudioFormatReader> reader (formatManager.createReaderFor (File::getCurrentWorkingDirectory().getChildFile (settings.inputFile)));
+    if (reader == nullptr) { return false; }
+
+    const int numSamples = static_cast<int> (reader->lengthInSamples);
+    source.setSize (2, numSamples);
+    reader->read (&source, 0, numSamples, 0, true, true);
+
+    // Play a mono file on both channels.
+    if (reader->numChannels == 1) { source.copyFrom (1, 0, source, 0, 0, numSamples); }
+
+    fileRate = reader->sampleRate;
+    return true;
+}
+
+/**
+ * Writes a rendered signal to a 24-bit WAV file.
+ */
+static bool writeOutput (const String& path, const AudioSampleBuffer& buffer, const double sampleRate)
+{
+    File file (File::getCurrentWorkingDirectory().getChildFile (path));
+    file.deleteFile();
+
+    ScopedPointer<FileOutputStream> stream (file.createOutputStream());
+    if (stream == nullptr) { return false; }
+
+    WavAudioFormat format;
+    ScopedPointer<AudioFormatWriter> writer (format.createWriterFor (stream, sampleRate, 2, 24, StringPairArray(), 0));
+    if (writer == nullptr) { return false; }
+    stream.release(); // The writer owns the stream now.
+
+    return writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+}
+
+/**
+ * Sets the processor parameters for the start of a sweep.
+ */
+static void startSweep (StereoDelayProcessor& processor, const int sweep, const int interpolation)
+{
+    processor.setParameter (StereoDelayProcessor::DELAY, 350);
+    processor.setParameter (StereoDelayProcessor::FEEDBACK, 50);
+    processor.setParameter (StereoDelayProcessor::MIX, 50);
+    processor.setParameter (StereoDelayProcessor::BYPASS, 0);
+    processor.setParameter (StereoDelayProcessor::MOD_RATE, 0.8f);
+    processor.setParameter (StereoDelayProcessor::MOD_DEPTH, sweep == MODULATION ? 4.0f : 0.0f);
+    processor.setParameter (StereoDelayProcessor::INTERPOLATION, static_cast<float> (interpolation));
+}
+
+/**
+ * Updates the processor parameters for a block of a sweep. The automation sweep moves the delay,
+ * feedback and mix on every block, the way a host plays back automation.
+ *
+ * \param[in]  double  Position in the signal (0-1)
+ */
+static void updateSweep (StereoDelayProcessor& processor, const int sweep, const double position)
+{
+    if (sweep != AUTOMATION) { return; }
+
+    const float triangle = static_cast<float> (1 - std::abs (1 - 4 * std::fmod (position, 0.5)));
+    processor.setParameter (StereoDelayProcessor::DELAY, 350 + 250*triangle);
+    processor.setParameter (StereoDelayProcessor::FEEDBACK, 50 + 30*triangle);
+    processor.setParameter (StereoDelayProcessor::MIX, 50 + 20*triangle);
+}
+
+/**
+ * Processes the source signal with one configuration and times it.
+ *
+ * \param[out]  AudioSampleBuffer*  Render of the first pass (may be null)
+ */
+static Result runBenchmark (const Settings& settings, const AudioSampleBuffer& source, const double sampleRate,
+                            const int blockSize, const int sweep, const int interpolation, AudioSampleBuffer* render)
+{
+    const int numSamples = source.getNumSamples();
+
+    StereoDelayProcessor processor;
+    processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    AudioSampleBuffer work (2, numSamples);
+    AudioSampleBuffer block;
+    MidiBuffer midi;
+
+    double bestSeconds = 0;
+    long long allocations = 0;
+
+    for (int pass = 0; pass < settings.repeats; ++pass)
+    {
+        work.makeCopyOf (source);
+        startSweep (processor, sweep, interpolation);
+
+        const long long allocationsBefore = s_numAllocations.load();
+        const auto start = std::chrono::steady_clock::now();
+
+        for (int pos = 0; pos < numSamples; pos += blockSize)
+        {
+            // Refer to the block in place so no samples are copied.
+            float* channels[2] = { work.getWritePointer (0, pos), work.getWritePointer (1, pos) };
+            block.setDataToReferTo (channels, 2, jmin (blockSize, numSamples - pos));
+
+            updateSweep (processor, sweep, static_cast<double> (pos) / numSamples);
+            processor.processBlock (block, midi);
+        }
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        allocations += s_numAllocations.load() - allocationsBefore;
+
+        if (pass == 0 || elapsed.count() < bestSeconds) { bestSeconds = elapsed.count(); }
+        if (pass == 0 && render != nullptr) { render->makeCopyOf (work); }
+    }
+
+    processor.releaseResources();
+
+    Result result;
+    result.nsPerSample = (bestSeconds * 1e9) / numSamples;
+    result.realTimeFactor = (numSamples / sampleRate) / jmax (bestSeconds, 1e-12);
+    result.allocations = allocations;
+    return result;
+}
+
+int main (int argc, char* argv[])
+{
+    StringArray args;
+    for (int i = 1; i < argc; ++i) { args.add (argv[i]); }
+
+    Settings settings;
+    if (! parseArguments (args, settings)) { return 1; }
+
+    AudioSampleBuffer source;
+    double fileRate = 0;
+    if (! loadInput (settings, source, fileRate))
+    {
+        std::fprintf (stderr, "Couldn't read %s\n", settings.inputFile.toRawUTF8());
+        return 1;
+    }
+
+    // A file is processed at its own rate unless other rates are asked for.
+    if (settings.sampleRates.isEmpty())
+    {
+        if (fileRate > 0) { settings.sampleRates.add (fileRate); }
+        else { settings.sampleRates.addArray ({ 44100.0, 48000.0, 96000.0 }); }
+    }
+
+    if (settings.csv) { std::printf ("sweep,interpolation,sample_rate,block_size,ns_per_sample,realtime_factor,allocations\n"); }
+    else { std::printf ("%-12s %-10s %8s %6s %12s %12s %12s\n", "sweep", "interp", "rate", "block", "ns/sample", "x realtime", "allocations"); }
+
+    AudioSampleBuffer render;
+    bool first = true;
+
+    for (auto sweep : settings.sweeps)
+    {
+        for (auto interpolation : settings.interpolations)
+        {
+            for (auto sampleRate : settings.sampleRates)
+            {
+                for (auto blockSize : settings.blockSizes)
+                {
+                    const bool keepRender = first && settings.outputFile.isNotEmpty();
+                    const Result result = runBenchmark (settings, source, sampleRate, blockSize, sweep, interpolation, keepRender ? &render : nullptr);
+
+                    if (keepRender && ! writeOutput (settings.outputFile, render, sampleRate))
+                    {
+                        std::fprintf (stderr, "Couldn't write %s\n", settings.outputFile.toRawUTF8());
+                    }
+                    first = false;
+
+                    const char* format = settings.csv ? "%s,%s,%.0f,%d,%.3f,%.1f,%lld\n"
+                                                      : "%-12s %-10s %8.0f %6d %12.3f %12.1f %12lld\n";
+                    std::printf (format, s_sweepNames[sweep], s_interpolationNames[interpolation], sampleRate, blockSize,
+                                 result.nsPerSample, result.realTimeFactor, result.allocations);
+                    std::fflush (stdout);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/**
+ * BackgroundThreadTests.cpp
+ * \brief Tests for the shared background thread.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "BackgroundThread.h"
+#include "Tests.h"
+
+/**
+ * Task that counts its runs.
+ *
+ * \param[in]  void*  std::atomic<int> counter
+ */
+static void countRuns (void* context)
+{
+    ++*static_cast<std::atomic<int>*> (context);
+}
+
+/**
+ * Waits for a counter to move past a value.
+ *
+ * \param[in]  std::atomic<int>  Counter
+ * \param[in]  int  Value to move past
+ * \param[in]  int  Longest wait (msecs)
+ *
+ * \return  bool  True if the counter moved in time
+ */
+static bool waitForRun (const std::atomic<int>& counter, const int value, const int timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds (timeout);
+    while (counter.load() <= value)
+    {
+        if (std::chrono::steady_clock::now() > end) { return false; }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+TEST_CASE (backgroundThreadIsShared)
+{
+    std::shared_ptr<BackgroundThread> first = BackgroundThread::getShared();
+    std::shared_ptr<BackgroundThread> second = BackgroundThread::getShared();
+    CHECK (first != nullptr && first == second);
+}
+
+TEST_CASE (signalWakesTheTasks)
+{
+    std::shared_ptr<BackgroundThread> thread = BackgroundThread::getShared();
+    std::atomic<int> runs (0);
+    thread->add (&countRuns, &runs);
+    CHECK (waitForRun (runs, 0, 1000));
+
+    // Each signal runs the task again well before the timeout would, so the thread isn't polling.
+    // A missed wake-up only costs one timeout, so most of the signals must land straight away.
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; ++i)
+    {
+        const int seen = runs.load();
+        thread->signal();
+        CHECK (waitForRun (runs, seen, 1000));
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds> (std::chrono::steady_clock::now() - start);
+    CHECK (elapsed.count() < 10*BackgroundThread::s_sleepTime);
+
+    // Once removed, the task never runs again.
+    thread->remove (&runs);
+    const int removed = runs.load();
+    thread->signal();
+    std::this_thread::sleep_for (std::chrono::milliseconds (2*BackgroundThread::s_sleepTime));
+    CHECK (runs.load() == removed);
+}
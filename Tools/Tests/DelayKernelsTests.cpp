@@ -0,0 +1,164 @@
+/**
+ * DelayKernelsTests.cpp
+ * \brief Tests for the vectorized processing kernels.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "DelayKernels.h"
+#include "Tests.h"
+
+static const int s_maxLength = 203; ///< Longest run, which isn't a multiple of any vector width.
+
+/**
+ * Fills a vector with uniform random samples from -1 to 1.
+ */
+static std::vector<float> makeNoise (const size_t size, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+    std::vector<float> noise (size);
+    for (float& sample : noise) { sample = distribution (random); }
+    return noise;
+}
+
+TEST_CASE (kernelsMatchScalar)
+{
+    std::mt19937 random (1);
+    const std::vector<float> input = makeNoise (s_maxLength, random);
+    const std::vector<float> read = makeNoise (s_maxLength + 1, random);
+    const DelayKernels::RunFunction scalar = DelayKernels::getRunFunction (DelayKernels::SCALAR);
+
+    for (int type = DelayKernels::SSE2; type <= DelayKernels::NEON; ++type)
+    {
+        if (! DelayKernels::isSupported (static_cast<DelayKernels::Type> (type))) { continue; }
+        const DelayKernels::RunFunction kernel = DelayKernels::getRunFunction (static_cast<DelayKernels::Type> (type));
+
+        for (int length = 0; length <= s_maxLength; length += 7)
+        {
+            std::vector<float> expected (2*s_maxLength), actual (2*s_maxLength);
+            scalar (input.data(), expected.data(), expected.data() + s_maxLength, read.data() + 1, read.data(), length, 0.3f, 0.7f, 0.6f);
+            kernel (input.data(), actual.data(), actual.data() + s_maxLength, read.data() + 1, read.data(), length, 0.3f, 0.7f, 0.6f);
+            CHECK (std::memcmp (expected.data(), actual.data(), expected.size()*sizeof (float)) == 0);
+        }
+    }
+}
+
+TEST_CASE (stereoKernelsMatchScalar)
+{
+    std::mt19937 random (2);
+    const std::vector<float> input = makeNoise (2*s_maxLength, random);
+    const std::vector<float> read = makeNoise (2*s_maxLength + 8, random);
+    const DelayKernels::StereoMatrix matrix = { { 0.9f, 0.1f, 0.2f, 0.8f }, { 0.5f, 0.25f, 0.3f, 0.45f }, { 0.7f, 0.2f } };
+    const DelayKernels::StereoRunFunction scalar = DelayKernels::getStereoRunFunction (DelayKernels::SCALAR);
+
+    for (int type = DelayKernels::SSE2; type <= DelayKernels::NEON; ++type)
+    {
+        if (! DelayKernels::isSupported (static_cast<DelayKernels::Type> (type))) { continue; }
+        const DelayKernels::StereoRunFunction kernel = DelayKernels::getStereoRunFunction (static_cast<DelayKernels::Type> (type));
+
+        for (int length = 0; length <= s_maxLength; length += 5)
+        {
+            std::vector<float> expected (4*s_maxLength), actual (4*s_maxLength);
+            scalar (input.data(), expected.data(), expected.data() + 2*s_maxLength, read.data() + 2, read.data(), read.data() + 7, read.data() + 5,
+                    length, 0.25f, 0.6f, 0.8f, 0.5f, matrix);
+            kernel (input.data(), actual.data(), actual.data() + 2*s_maxLength, read.data() + 2, read.data(), read.data() + 7, read.data() + 5,
+                    length, 0.25f, 0.6f, 0.8f, 0.5f, matrix);
+            CHECK (std::memcmp (expected.data(), actual.data(), expected.size()*sizeof (float)) == 0);
+        }
+    }
+}
+
+TEST_CASE (kernelsInPlace)
+{
+    // The output may be the same as the input.
+    std::mt19937 random (3);
+    const std::vector<float> input = makeNoise (s_maxLength, random);
+    const std::vector<float> read = makeNoise (s_maxLength + 1, random);
+
+    std::vector<float> expected (s_maxLength), write (s_maxLength);
+    DelayKernels::getRunFunction (DelayKernels::SCALAR) (input.data(), expected.data(), write.data(), read.data() + 1, read.data(),
+                                                         s_maxLength, 0.5f, 0.4f, 0.3f);
+    std::vector<float> inPlace = input;
+    DelayKernels::getRunFunction() (inPlace.data(), inPlace.data(), write.data(), read.data() + 1, read.data(), s_maxLength, 0.5f, 0.4f, 0.3f);
+    CHECK (inPlace == expected);
+}
+
+TEST_CASE (peakMatchesScalar)
+{
+    std::mt19937 random (4);
+    std::vector<float> data = makeNoise (s_maxLength, random);
+
+    for (int length = 0; length <= s_maxLength; length += 3)
+    {
+        float expected = 0;
+        for (int i = 0; i < length; ++i) { expected = std::max (expected, std::abs (data[i])); }
+        CHECK (DelayKernels::getPeak (data.data(), length) == expected);
+    }
+
+    data[s_maxLength - 1] = -2.0f;
+    CHECK (DelayKernels::getPeak (data.data(), s_maxLength) == 2.0f);
+}
+
+TEST_CASE (halfConversionRoundTrips)
+{
+    std::mt19937 random (5);
+    std::vector<float> data = makeNoise (s_maxLength, random);
+    data[0] = 1.0f;
+    data[1] = -2.0f;
+    data[2] = 65504.0f;
+    data[3] = 1.0f + std::ldexp (1.0f, -11); // Ties go to the even value, 1.
+    data[4] = 1.0f + 3*std::ldexp (1.0f, -11); // And up to the next even value.
+
+    // The whole run goes through the vector path, and single samples through the scalar one.
+    std::vector<uint16_t> half (s_maxLength);
+    DelayKernels::floatToHalf (data.data(), half.data(), s_maxLength);
+    for (int i = 0; i < s_maxLength; ++i)
+    {
+        uint16_t expected = 0;
+        DelayKernels::floatToHalf (&data[i], &expected, 1);
+        CHECK (half[i] == expected);
+    }
+    CHECK (half[0] == 0x3c00 && half[1] == 0xc000 && half[2] == 0x7bff && half[3] == 0x3c00 && half[4] == 0x3c02);
+
+    std::vector<float> output (s_maxLength);
+    DelayKernels::halfToFloat (half.data(), output.data(), s_maxLength);
+    for (int i = 0; i < s_maxLength; ++i)
+    {
+        float expected = 0;
+        DelayKernels::halfToFloat (&half[i], &expected, 1);
+        CHECK (output[i] == expected);
+        CHECK (std::abs (output[i] - data[i]) <= std::abs (data[i]) * std::ldexp (1.0f, -11));
+    }
+}
+
+TEST_CASE (int16ConversionRoundTrips)
+{
+    std::mt19937 random (6);
+    std::vector<float> data = makeNoise (s_maxLength, random);
+    data[0] = 2.0f; // Saturates.
+    const float scale = 32767.0f;
+
+    std::vector<int16_t> samples (s_maxLength);
+    DelayKernels::floatToInt16 (data.data(), samples.data(), s_maxLength, scale);
+    for (int i = 0; i < s_maxLength; ++i)
+    {
+        int16_t expected = 0;
+        DelayKernels::floatToInt16 (&data[i], &expected, 1, scale);
+        CHECK (samples[i] == expected);
+    }
+    CHECK (samples[0] == 32767);
+
+    std::vector<float> output (s_maxLength);
+    DelayKernels::int16ToFloat (samples.data(), output.data(), s_maxLength, 1.0f/scale);
+    for (int i = 1; i < s_maxLength; ++i)
+    {
+        float expected = 0;
+        DelayKernels::int16ToFloat (&samples[i], &expected, 1, 1.0f/scale);
+        CHECK (output[i] == expected);
+        CHECK (std::abs (output[i] - data[i]) <= 0.5f/scale + 1e-7f);
+    }
+}
@@ -0,0 +1,626 @@
+/**
+ * DelayLineTests.cpp
+ * \brief Tests for the delay line.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "DelayLine.h"
+#include "MultiChannelDelayLine.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+
+/**
+ * Makes a block of white noise.
+ */
+static std::vector<float> makeNoise (const int numSamples, const unsigned seed = 1)
+{
+    std::mt19937 random (seed);
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+    std::vector<float> noise (numSamples);
+    for (float& sample : noise) { sample = distribution (random); }
+    return noise;
+}
+
+/**
+ * Gets the largest difference between two signals.
+ */
+static float getLargestError (const std::vector<float>& a, const std::vector<float>& b)
+{
+    float largest = 0;
+    for (size_t i = 0; i < a.size(); ++i) { largest = std::max (largest, std::abs (a[i] - b[i])); }
+    return largest;
+}
+
+TEST_CASE (blockMatchesPerSample)
+{
+    // Long enough for the buffer to wrap a few times, in block sizes that don't divide it.
+    const int numSamples = 5 * s_sampleFreq;
+    const std::vector<float> input = makeNoise (numSamples);
+    const int blockSizes[] = { 1, 7, 64, 500, 4096 };
+
+    DelayLine reference (s_sampleFreq, 10.37f);
+    reference.setFeedback (60);
+    reference.setMix (50);
+    std::vector<float> expected (numSamples);
+    for (int i = 0; i < numSamples; ++i) { expected[i] = reference.processSample (input[i]); }
+
+    for (const int blockSize : blockSizes)
+    {
+        DelayLine delayLine (s_sampleFreq, 10.37f);
+        delayLine.setFeedback (60);
+        delayLine.setMix (50);
+
+        // In place, like the processor.
+        std::vector<float> output (input);
+        for (int start = 0; start < numSamples; start += blockSize)
+        {
+            const int length = std::min (blockSize, numSamples - start);
+            delayLine.processBlock (output.data() + start, output.data() + start, length);
+        }
+        CHECK (getLargestError (output, expected) < 1e-5f);
+    }
+}
+
+TEST_CASE (blockHandlesShortDelays)
+{
+    // A delay shorter than the block reads back samples written earlier in the same block.
+    const int numSamples = 4096;
+    const std::vector<float> input = makeNoise (numSamples, 2);
+
+    DelayLine reference (s_sampleFreq, 0.1f);
+    reference.setFeedback (90);
+    reference.setMix (100);
+    std::vector<float> expected (numSamples);
+    for (int i = 0; i < numSamples; ++i) { expected[i] = reference.processSample (input[i]); }
+
+    DelayLine delayLine (s_sampleFreq, 0.1f);
+    delayLine.setFeedback (90);
+    delayLine.setMix (100);
+    std::vector<float> output (numSamples);
+    delayLine.processBlock (input.data(), output.data(), numSamples);
+    CHECK (getLargestError (output, expected) < 1e-5f);
+}
+
+TEST_CASE (multiChannelMatchesMonoLines)
+{
+    const int numSamples = s_sampleFreq;
+
+    for (const int numChannels : { 1, 2, 3, 6, 16 })
+    {
+        std::vector<std::vector<float>> expected, output;
+        for (int c = 0; c < numChannels; ++c)
+        {
+            const std::vector<float> input = makeNoise (numSamples, 3 + c);
+            DelayLine reference (s_sampleFreq, 250.5f);
+            reference.setFeedback (70);
+            reference.setMix (40);
+            expected.push_back (input);
+            reference.processBlock (expected.back().data(), expected.back().data(), numSamples);
+            output.push_back (input);
+        }
+
+        // Block sizes that split the interleaving chunks and the buffer wrap unevenly.
+        MultiChannelDelayLine delayLine (numChannels, s_sampleFreq, 250.5f);
+        delayLine.setFeedback (70);
+        delayLine.setMix (40);
+        std::vector<float*> channels;
+        for (std::vector<float>& channel : output) { channels.push_back (channel.data()); }
+        int blockSize = 1;
+        for (int start = 0; start < numSamples; start += blockSize, blockSize = (blockSize * 7) % 1000 + 1)
+        {
+            delayLine.processBlock (channels.data(), start, std::min (blockSize, numSamples - start));
+        }
+        for (int c = 0; c < numChannels; ++c) { CHECK (getLargestError (output[c], expected[c]) < 1e-5f); }
+    }
+}
+
+TEST_CASE (monoLineMatchesThroughGlides)
+{
+    // A single channel is processed where it sits, which must not change a bit, even while the
+    // delay time glides between blocks of uneven size.
+    const int numSamples = s_sampleFreq;
+    const std::vector<float> input = makeNoise (numSamples, 4);
+
+    DelayLine reference (s_sampleFreq, 20);
+    MultiChannelDelayLine delayLine (1, s_sampleFreq, 20);
+    for (DelayLine* line : { static_cast<DelayLine*> (&reference), static_cast<DelayLine*> (&delayLine) })
+    {
+        line->setSmoothing (ParameterSmoother::ONE_POLE, 100, ParameterSmoother::LINEAR, 20);
+        line->setFeedback (50);
+        line->setMix (60);
+    }
+
+    std::vector<float> expected (input), output (input);
+    float* channels[1] = { output.data() };
+    int blockSize = 1;
+    for (int start = 0, block = 0; start < numSamples; start += blockSize, blockSize = (blockSize * 7) % 1000 + 1, ++block)
+    {
+        if (block % 10 == 0)
+        {
+            reference.setDelay (5.0f + block % 70);
+            delayLine.setDelay (5.0f + block % 70);
+        }
+        const int length = std::min (blockSize, numSamples - start);
+        reference.processBlock (expected.data() + start, expected.data() + start, length);
+        delayLine.processBlock (channels, start, length);
+    }
+    CHECK (output == expected);
+}
+
+TEST_CASE (bypassLeavesChannelsAlone)
+{
+    MultiChannelDelayLine delayLine (3, s_sampleFreq, 10, 50);
+    delayLine.setBypass (true);
+    std::vector<std::vector<float>> output;
+    for (int c = 0; c < 3; ++c) { output.push_back (makeNoise (1000, 5 + c)); }
+    const std::vector<std::vector<float>> input (output);
+    float* channels[3] = { output[0].data(), output[1].data(), output[2].data() };
+    delayLine.processBlock (channels, 0, 1000);
+    CHECK (output == input);
+}
+
+TEST_CASE (convolutionModeReplacesTheDelay)
+{
+    MultiChannelDelayLine delayLine (2, s_sampleFreq, 10);
+    delayLine.setSmoothing (ParameterSmoother::LINEAR, 0, ParameterSmoother::LINEAR, 0);
+    delayLine.setMix (50);
+    std::vector<float> response (20, 0.0f);
+    response[10] = 0.5f;
+    const float* responseChannels[1] = { response.data() };
+    CHECK (delayLine.setImpulseResponse (responseChannels, 1, 20));
+    delayLine.setConvolution (true);
+    CHECK (delayLine.isConvolution());
+
+    // Half of the impulse passes straight through, and half comes back through the response.
+    std::vector<float> left (100, 0.0f), right (100, 0.0f);
+    left[0] = right[0] = 1.0f;
+    float* channels[2] = { left.data(), right.data() };
+    delayLine.processBlock (channels, 0, 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        const float expected = (i == 0) ? 0.5f : (i == 10) ? 0.25f : 0.0f;
+        CHECK (std::abs (left[i] - expected) < 1e-6f && std::abs (right[i] - expected) < 1e-6f);
+    }
+
+    // The input was still written into the buffer, so the delay repeats it once the mode is off.
+    delayLine.setConvolution (false);
+    std::vector<float> more (500, 0.0f), moreRight (500, 0.0f);
+    float* moreChannels[2] = { more.data(), moreRight.data() };
+    delayLine.processBlock (moreChannels, 0, 500);
+    for (int i = 0; i < 500; ++i) { CHECK (i == 380 || (more[i] == 0 && moreRight[i] == 0)); }
+    CHECK (std::abs (more[380] - 0.5f) < 1e-6f && std::abs (moreRight[380] - 0.5f) < 1e-6f);
+}
+
+TEST_CASE (diffusionModeReplacesTheDelay)
+{
+    MultiChannelDelayLine delayLine (2, s_sampleFreq, 10, 50);
+    delayLine.setSmoothing (ParameterSmoother::LINEAR, 0, ParameterSmoother::LINEAR, 0);
+    delayLine.setMix (100);
+    delayLine.prepareDiffusion (100);
+    delayLine.setDiffusion (8, FeedbackDelayNetwork::HOUSEHOLDER);
+    CHECK (delayLine.isDiffusion());
+
+    FeedbackDelayNetwork network (2);
+    network.prepare (s_sampleFreq, 100);
+    network.setNetwork (8, FeedbackDelayNetwork::HOUSEHOLDER);
+    network.setDelay (10);
+    network.setFeedback (0.5f);
+
+    // With the mix all the way up, the output is the network on its own.
+    const int numSamples = 4000;
+    std::vector<float> left = makeNoise (numSamples, 1), right = makeNoise (numSamples, 2);
+    std::fill (left.begin() + 100, left.end(), 0.0f);
+    std::fill (right.begin() + 100, right.end(), 0.0f);
+    std::vector<float> frames (2*numSamples);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        frames[2*i] = left[i];
+        frames[2*i + 1] = right[i];
+    }
+    float* channels[2] = { left.data(), right.data() };
+    delayLine.processBlock (channels, 0, numSamples);
+
+    float largest = 0;
+    for (int start = 0; start < numSamples; start += FeedbackDelayNetwork::s_blockSize)
+    {
+        const int num = std::min (FeedbackDelayNetwork::s_blockSize, numSamples - start);
+        const float* wet = network.process (frames.data() + 2*start, num);
+        for (int i = 0; i < num; ++i)
+        {
+            largest = std::max (largest, std::abs (left[start + i] - wet[2*i]));
+            largest = std::max (largest, std::abs (right[start + i] - wet[2*i + 1]));
+        }
+    }
+    CHECK (largest < 1e-6f);
+
+    // The repeats die away rather than running on.
+    float early = 0, late = 0;
+    for (int i = 0; i < 1000; ++i) { early = std::max (early, std::abs (left[i])); }
+    for (int i = numSamples - 1000; i < numSamples; ++i) { late = std::max (late, std::abs (left[i])); }
+    CHECK (early > 0 && late < 0.5f*early);
+
+    // No lines switches the mode off.
+    delayLine.setDiffusion (0, FeedbackDelayNetwork::HOUSEHOLDER);
+    CHECK (! delayLine.isDiffusion());
+}
+
+/**
+ * Gets the index of the first nonzero output for an impulse through a delay line.
+ */
+static int getFirstEcho (DelayLine& delayLine, const int numSamples)
+{
+    std::vector<float> signal (numSamples, 0.0f);
+    signal[0] = 1.0f;
+    delayLine.processBlock (signal.data(), signal.data(), numSamples);
+    for (int i = 0; i < numSamples; ++i) { if (signal[i] != 0) { return i; } }
+    return -1;
+}
+
+TEST_CASE (delayFollowsSampleRate)
+{
+    DelayLine delayLine (s_sampleFreq, 10);
+    delayLine.setMix (100);
+    CHECK (getFirstEcho (delayLine, 4096) == 480);
+
+    // Preparing again, at a higher and then a lower rate, keeps the delay time in msecs.
+    delayLine.prepare (96000);
+    CHECK (getFirstEcho (delayLine, 4096) == 960);
+    delayLine.prepare (44100);
+    CHECK (getFirstEcho (delayLine, 4096) == 441);
+
+    // The longest delay fits in the buffer at the new rate.
+    delayLine.prepare (96000, 50);
+    delayLine.setDelay (50);
+    CHECK (getFirstEcho (delayLine, 8192) > 4700);
+}
+
+TEST_CASE (powerOfTwoMatchesDefault)
+{
+    // Only the buffer length differs, which doesn't change the output.
+    const int numSamples = 3 * s_sampleFreq;
+    const std::vector<float> input = makeNoise (numSamples, 5);
+    DelayLine delayLine (s_sampleFreq, 123.4f), powerOfTwo (s_sampleFreq, 123.4f);
+    delayLine.prepare (s_sampleFreq, 1000);
+    powerOfTwo.prepare (s_sampleFreq, 1000, true);
+
+    std::vector<float> expected (input), output (input);
+    for (DelayLine* line : { &delayLine, &powerOfTwo })
+    {
+        line->setDelay (123.4f);
+        line->setFeedback (80);
+        line->setMix (60);
+    }
+    for (int start = 0; start < numSamples; start += 333)
+    {
+        const int length = std::min (333, numSamples - start);
+        delayLine.processBlock (expected.data() + start, expected.data() + start, length);
+        powerOfTwo.processBlock (output.data() + start, output.data() + start, length);
+    }
+    CHECK (output == expected);
+}
+
+/**
+ * Runs a constant input through a delay line and gets the largest change between output samples.
+ */
+static float getLargestStep (DelayLine& delayLine, const int numFrames, float& last)
+{
+    const int block = 256;
+    std::vector<float> input (block, 1.0f), output (block);
+    float largest = 0;
+    for (int done = 0; done < numFrames; done += block)
+    {
+        delayLine.processBlock (input.data(), output.data(), block);
+        for (const float sample : output)
+        {
+            largest = std::max (largest, std::abs (sample - last));
+            last = sample;
+        }
+    }
+    return largest;
+}
+
+TEST_CASE (levelChangesAreRamped)
+{
+    DelayLine delayLine (s_sampleFreq, 100);
+    delayLine.setSmoothing (ParameterSmoother::ONE_POLE, 100, ParameterSmoother::LINEAR, 20);
+    delayLine.prepare (s_sampleFreq);
+    delayLine.setMix (0);
+    delayLine.setFeedback (0);
+    float last = 1.0f;
+    getLargestStep (delayLine, s_sampleFreq, last);
+
+    // The wet signal is still the delayed constant, so only the ramps move the output. A 20 msec
+    // ramp over the whole output range steps by 1/960 per sample.
+    delayLine.setMix (100);
+    delayLine.setFeedback (90);
+    CHECK (getLargestStep (delayLine, s_sampleFreq, last) < 2.0f / 960);
+
+    // Without smoothing the same change is a single step.
+    delayLine.setSmoothing (ParameterSmoother::ONE_POLE, 0, ParameterSmoother::LINEAR, 0);
+    delayLine.prepare (s_sampleFreq);
+    delayLine.setMix (0);
+    last = 1.0f;
+    getLargestStep (delayLine, s_sampleFreq, last);
+    delayLine.setMix (100);
+    CHECK (getLargestStep (delayLine, 1024, last) > 0.5f);
+}
+
+TEST_CASE (delayChangesGlide)
+{
+    // A ramp input makes the output step size follow the read speed, so a jump in the read
+    // position shows up as a large step.
+    DelayLine delayLine (s_sampleFreq, 10);
+    delayLine.setSmoothing (ParameterSmoother::ONE_POLE, 100, ParameterSmoother::LINEAR, 20);
+    delayLine.prepare (s_sampleFreq);
+    delayLine.setDelay (10);
+    delayLine.setMix (100);
+
+    const int numSamples = s_sampleFreq;
+    std::vector<float> signal (numSamples);
+    for (int i = 0; i < numSamples; ++i) { signal[i] = i * 1e-4f; }
+    delayLine.processBlock (signal.data(), signal.data(), 2400);
+    delayLine.setDelay (20);
+    delayLine.processBlock (signal.data() + 2400, signal.data() + 2400, numSamples - 2400);
+
+    // The glide slows the read head down instead of jumping back 480 samples.
+    float largest = 0;
+    for (int i = 2400; i < numSamples; ++i) { largest = std::max (largest, std::abs (signal[i] - signal[i - 1])); }
+    CHECK (largest <= 1.01e-4f);
+    CHECK (std::abs (signal[numSamples - 1] - (numSamples - 1 - 960) * 1e-4f) < 1e-3f);
+}
+
+TEST_CASE (modulationSwingsTheDelay)
+{
+    // With a ramp input, the output gives the delay of every sample.
+    DelayLine delayLine (s_sampleFreq, 10);
+    delayLine.setMix (100);
+    delayLine.setModulation (5, 2);
+
+    const int numSamples = s_sampleFreq;
+    std::vector<float> signal (numSamples);
+    for (int i = 0; i < numSamples; ++i) { signal[i] = i * 1e-4f; }
+    delayLine.processBlock (signal.data(), signal.data(), numSamples);
+
+    // 10 msecs plus or minus 2 msecs is 384 to 576 samples, centred on 480.
+    float shortest = 1e9f, longest = 0;
+    double sum = 0;
+    for (int i = s_sampleFreq / 5; i < numSamples; ++i)
+    {
+        const float delay = i - signal[i] * 1e4f;
+        shortest = std::min (shortest, delay);
+        longest = std::max (longest, delay);
+        sum += delay;
+    }
+    CHECK (std::abs (shortest - 384) < 1 && std::abs (longest - 576) < 1);
+    CHECK (std::abs (sum / (numSamples - s_sampleFreq / 5) - 480) < 2);
+
+    // Switching it off returns to the fixed delay.
+    delayLine.setModulation (5, 0);
+    for (int i = 0; i < numSamples; ++i) { signal[i] = i * 1e-4f; }
+    delayLine.processBlock (signal.data(), signal.data(), numSamples);
+    CHECK (std::abs ((numSamples - 1) - signal[numSamples - 1] * 1e4f - 480) < 0.5f);
+}
+
+TEST_CASE (tapFeedbackIsSmoothed)
+{
+    DelayLine delayLine (s_sampleFreq, 10, 0, 1);
+    delayLine.prepare (s_sampleFreq, 100);
+    delayLine.setSmoothing (ParameterSmoother::LINEAR, 100, ParameterSmoother::LINEAR, 20);
+    delayLine.setTap (0, 5, 0.5f, 0, 0);
+    delayLine.setTap (1, 10, 0.5f, 0, 0);
+    delayLine.setNumTaps (2);
+
+    // Settle on the constant input, then turn up the feedback of the last tap.
+    float last = 0;
+    getLargestStep (delayLine, s_sampleFreq / 10, last);
+    CHECK (std::abs (last - 1.0f) < 1e-6f);
+
+    delayLine.setTap (1, 10, 0.5f, 0, 0.5f);
+    const float step = getLargestStep (delayLine, s_sampleFreq / 2, last);
+
+    // Without the ramp the output would step by a quarter as the feedback reaches each tap. It
+    // settles where the buffer holds 1/(1 - 0.5) either way.
+    CHECK (step < 0.01f);
+    CHECK (std::abs (last - 2.0f) < 1e-3f);
+}
+
+TEST_CASE (tapsHaveTheirOwnDelayGainAndPan)
+{
+    DelayLine delayLine (s_sampleFreq, 10, 0, 1, 2);
+    delayLine.prepare (s_sampleFreq, 100);
+    delayLine.setTap (0, 1, 0.5f, -0.5f, 0);
+    delayLine.setTap (1, 2, 0.25f, 1, 0);
+    delayLine.setTap (2, 4, 1, 0, 0);
+    delayLine.setNumTaps (3);
+
+    // The frames are interleaved, with an impulse on both channels.
+    std::vector<float> signal (2*512, 0.0f);
+    signal[0] = signal[1] = 1.0f;
+    delayLine.processBlock (signal.data(), signal.data(), 512);
+
+    // Each tap echoes once at its own delay, with the balance law taking the far side down.
+    for (int i = 0; i < 512; ++i)
+    {
+        if (i != 48 && i != 96 && i != 192) { CHECK (signal[2*i] == 0 && signal[2*i + 1] == 0); }
+    }
+    CHECK (std::abs (signal[2*48] - 0.5f) < 1e-6f && std::abs (signal[2*48 + 1] - 0.25f) < 1e-6f);
+    CHECK (signal[2*96] == 0 && std::abs (signal[2*96 + 1] - 0.25f) < 1e-6f);
+    CHECK (std::abs (signal[2*192] - 1.0f) < 1e-6f && std::abs (signal[2*192 + 1] - 1.0f) < 1e-6f);
+}
+
+TEST_CASE (sleepsOnceTheTailDecays)
+{
+    DelayLine delayLine (s_sampleFreq, 10);
+    delayLine.prepare (s_sampleFreq, 100);
+    delayLine.setFeedback (50);
+    delayLine.setMix (100);
+    const int tail = static_cast<int> (DelayLine::getTailTime (10, 0.5f) * 1e-3 * s_sampleFreq);
+
+    // The echoes of an impulse keep it awake for the tail time, and then the rest of the buffer
+    // has to fill with silence too.
+    std::vector<float> signal (tail + s_sampleFreq / 10, 0.0f);
+    signal[0] = 1.0f;
+    delayLine.processBlock (signal.data(), signal.data(), tail / 2);
+    CHECK (! delayLine.isSilent());
+    delayLine.processBlock (signal.data() + tail / 2, signal.data() + tail / 2, static_cast<int> (signal.size()) - tail / 2);
+    CHECK (delayLine.isSilent());
+    CHECK (std::abs (signal.back()) < DelayLine::s_silenceLevel);
+
+    // New input wakes it up with the same delay. What's left of the old tail is below the silence level.
+    std::vector<float> impulse (1024, 0.0f);
+    impulse[0] = 1.0f;
+    delayLine.processBlock (impulse.data(), impulse.data(), 1024);
+    CHECK (! delayLine.isSilent());
+    for (int i = 0; i < 480; ++i) { CHECK (std::abs (impulse[i]) < DelayLine::s_silenceLevel); }
+    CHECK (std::abs (impulse[480] - 1.0f) < 1e-5f);
+}
+
+/**
+ * Runs an impulse on the left channel through a stereo delay line and returns the interleaved output.
+ */
+static std::vector<float> getStereoImpulseResponse (DelayLine& delayLine, const int numFrames)
+{
+    std::vector<float> signal (2*numFrames, 0.0f);
+    signal[0] = 1.0f;
+    delayLine.processBlock (signal.data(), signal.data(), numFrames);
+    return signal;
+}
+
+TEST_CASE (pingPongAlternatesChannels)
+{
+    DelayLine delayLine (s_sampleFreq, 10, 0, 1, 2);
+    delayLine.setFeedback (50);
+    delayLine.setMix (100);
+    delayLine.setStereoRouting (true, 0, 1);
+    const std::vector<float> signal = getStereoImpulseResponse (delayLine, 2048);
+
+    // Both inputs feed the left channel at half level, and each repeat crosses over.
+    CHECK (std::abs (signal[2*480] - 0.5f) < 1e-6f && signal[2*480 + 1] == 0);
+    CHECK (signal[2*960] == 0 && std::abs (signal[2*960 + 1] - 0.25f) < 1e-6f);
+    CHECK (std::abs (signal[2*1440] - 0.125f) < 1e-6f && signal[2*1440 + 1] == 0);
+}
+
+TEST_CASE (crossfeedSharesTheFeedback)
+{
+    DelayLine delayLine (s_sampleFreq, 10, 0, 1, 2);
+    delayLine.setFeedback (80);
+    delayLine.setMix (100);
+    delayLine.setDelayRight (5);
+    delayLine.setStereoRouting (false, 0.5f, 1);
+    const std::vector<float> signal = getStereoImpulseResponse (delayLine, 2048);
+
+    // The left echo feeds back half into each channel, which the right channel repeats sooner.
+    CHECK (std::abs (signal[2*480] - 1.0f) < 1e-6f);
+    for (int i = 0; i < 720; ++i) { CHECK (signal[2*i + 1] == 0); }
+    CHECK (std::abs (signal[2*720 + 1] - 0.4f) < 1e-6f);
+    CHECK (std::abs (signal[2*960] - 0.4f) < 1e-6f);
+}
+
+TEST_CASE (widthScalesTheSide)
+{
+    // At zero width both channels get the mid signal, and at full width the channels are untouched.
+    DelayLine mono (s_sampleFreq, 10, 0, 1, 2), stereo (s_sampleFreq, 10, 0, 1, 2);
+    mono.setMix (100);
+    stereo.setMix (100);
+    mono.setStereoRouting (false, 0, 0);
+    const std::vector<float> monoSignal = getStereoImpulseResponse (mono, 1024);
+    const std::vector<float> stereoSignal = getStereoImpulseResponse (stereo, 1024);
+    CHECK (std::abs (monoSignal[2*480] - 0.5f) < 1e-6f && std::abs (monoSignal[2*480 + 1] - 0.5f) < 1e-6f);
+    CHECK (std::abs (stereoSignal[2*480] - 1.0f) < 1e-6f && stereoSignal[2*480 + 1] == 0);
+}
+
+/**
+ * Runs the same noise through a delay line stored in single precision and in a compact format,
+ * in blocks of varying length, and gets the largest difference between their outputs. The optional
+ * change is made to both halfway through.
+ */
+static float getCompactError (const TieredDelayBuffer::Format format, const int numChannels, const bool powerOfTwo,
+                              void (*setup) (DelayLine&), void (*change) (DelayLine&) = nullptr)
+{
+    DelayLine reference (s_sampleFreq, 0, 0, 1, numChannels);
+    DelayLine compact (s_sampleFreq, 0, 0, 1, numChannels);
+    reference.prepare (s_sampleFreq, 50, powerOfTwo);
+    compact.prepare (s_sampleFreq, 50, powerOfTwo, format);
+    CHECK (compact.getStorageFormat() == format);
+    setup (reference);
+    setup (compact);
+
+    std::mt19937 random (7);
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+    const int sizes[] = { 1, 17, 256, 63, 500, 64 };
+    float largest = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        const int numFrames = sizes[i % 6];
+        if (i == 100 && change != nullptr)
+        {
+            change (reference);
+            change (compact);
+        }
+        std::vector<float> input (numFrames*numChannels), expected (input.size()), actual (input.size());
+        for (float& sample : input) { sample = distribution (random); }
+
+        reference.processBlock (input.data(), expected.data(), numFrames);
+        compact.processBlock (input.data(), actual.data(), numFrames);
+        for (size_t j = 0; j < input.size(); ++j) { largest = std::max (largest, std::abs (expected[j] - actual[j])); }
+    }
+    return largest;
+}
+
+TEST_CASE (compactStorageMatchesFloat)
+{
+    void (*const setups[]) (DelayLine&) =
+    {
+        [] (DelayLine& d) { d.setDelay (20.01f); d.setFeedback (70); },
+        [] (DelayLine& d) { d.setDelay (0.3f); d.setFeedback (50); }, // Inside the newest block.
+        [] (DelayLine& d) { d.setDelay (49.9f); d.setFeedback (50); }, // The whole buffer.
+        [] (DelayLine& d) { d.setDelay (7.3f); d.setFeedback (60); d.setInterpolation (Interpolators::SINC); },
+        [] (DelayLine& d) { d.setDelay (3.1f); d.setFeedback (60); d.setModulation (2, 1); d.setInterpolation (Interpolators::CUBIC); },
+        [] (DelayLine& d) { d.setTap (0, 1, 0.5f, 0, 0.3f); d.setTap (1, 11.7f, 0.5f, 0, 0.4f); d.setNumTaps (2); },
+    };
+    for (const auto format : { TieredDelayBuffer::FLOAT16, TieredDelayBuffer::INT16 })
+    {
+        // Half precision keeps 11 significant bits and 16-bit keeps 16 below the block peak, and
+        // the feedback adds up the rounding of a few passes.
+        const float tolerance = (format == TieredDelayBuffer::FLOAT16) ? 2e-3f : 2e-4f;
+        for (const auto setup : setups)
+        {
+            CHECK (getCompactError (format, 1, false, setup) < tolerance);
+            CHECK (getCompactError (format, 4, true, setup) < tolerance);
+        }
+
+        const float stereoError = getCompactError (format, 2, true, [] (DelayLine& d)
+        {
+            d.setDelay (10); d.setDelayRight (15.5f); d.setFeedback (50); d.setStereoRouting (true, 0.2f, 80);
+        });
+        CHECK (stereoError < tolerance);
+
+        // Frozen, the loop is converted again on every pass, and its blocks don't line up with the
+        // blocks of the buffer, so the rounding adds up a little more.
+        const float frozenError = getCompactError (format, 2, false, [] (DelayLine& d) { d.setDelay (9); d.setFeedback (60); },
+                                                   [] (DelayLine& d) { d.setFreeze (true); });
+        CHECK (frozenError > 0 && frozenError < 2*tolerance);
+    }
+}
+
+TEST_CASE (compactStorageProcessesSamples)
+{
+    DelayLine reference (s_sampleFreq, 2.5f, 0.5f, 1);
+    DelayLine compact (s_sampleFreq, 2.5f, 0.5f, 1);
+    compact.prepare (s_sampleFreq, 2000, false, TieredDelayBuffer::FLOAT16);
+
+    // An impulse comes back after the delay, and again at half the level.
+    const int delay = s_sampleFreq / 400;
+    for (int i = 0; i < 3*delay; ++i)
+    {
+        const float input = (i == 0) ? 1.0f : 0.0f;
+        const float expected = reference.processSample (input);
+        CHECK (compact.processSample (input) == expected);
+    }
+}
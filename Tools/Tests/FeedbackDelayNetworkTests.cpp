@@ -0,0 +1,115 @@
+/**
+ * FeedbackDelayNetworkTests.cpp
+ * \brief Tests for the feedback delay network.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "FeedbackDelayNetwork.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+
+/**
+ * Runs interleaved frames through a network in runs of up to a block.
+ */
+static std::vector<float> process (FeedbackDelayNetwork& network, const std::vector<float>& input, const int numChannels, const int runLength)
+{
+    std::vector<float> output (input.size());
+    const int numFrames = static_cast<int> (input.size()) / numChannels;
+    for (int done = 0; done < numFrames; done += runLength)
+    {
+        const int num = std::min (runLength, numFrames - done);
+        const float* out = network.process (input.data() + done*numChannels, num);
+        std::copy (out, out + num*numChannels, output.begin() + done*numChannels);
+    }
+    return output;
+}
+
+/**
+ * Gets the energy of the frames from first to last.
+ */
+static double getEnergy (const std::vector<float>& samples, const int numChannels, const int first, const int last)
+{
+    double energy = 0;
+    for (int i = first*numChannels; i < last*numChannels; ++i) { energy += static_cast<double> (samples[i]) * samples[i]; }
+    return energy;
+}
+
+TEST_CASE (networkIsOnlyAllocatedWhenPrepared)
+{
+    FeedbackDelayNetwork network (2);
+    CHECK (! network.isReady());
+    network.prepare (s_sampleFreq, 100);
+    CHECK (network.isReady());
+    network.release();
+    CHECK (! network.isReady());
+    network.reset();
+    network.prepare (s_sampleFreq, 100);
+    CHECK (network.isReady());
+}
+
+TEST_CASE (networkClampsShortDelays)
+{
+    FeedbackDelayNetwork network (2);
+    network.prepare (s_sampleFreq, 100);
+    network.setDelay (0);
+    CHECK (network.getLongestDelay() == FeedbackDelayNetwork::s_minDelay);
+    network.setDelay (50);
+    CHECK (network.getLongestDelay() == 2400);
+
+    // The longest line never outgrows the lines.
+    network.setDelay (1000);
+    CHECK (network.getLongestDelay() < 8192);
+}
+
+TEST_CASE (networkIsIndependentOfRunLength)
+{
+    const int numChannels = 2;
+    std::vector<float> input (numChannels*20000, 0.0f);
+    input[0] = 1.0f;
+    input[numChannels*777 + 1] = -0.5f;
+
+    for (int matrix = 0; matrix < FeedbackDelayNetwork::s_numMatrices; ++matrix)
+    {
+        std::vector<float> outputs[2];
+        const int runLengths[2] = { FeedbackDelayNetwork::s_blockSize, 13 };
+        for (int k = 0; k < 2; ++k)
+        {
+            FeedbackDelayNetwork network (numChannels);
+            network.prepare (s_sampleFreq, 100);
+            network.setNetwork (8, static_cast<FeedbackDelayNetwork::Matrix> (matrix));
+            network.setDelay (30);
+            network.setFeedback (0.7f);
+            outputs[k] = process (network, input, numChannels, runLengths[k]);
+        }
+        CHECK (outputs[0] == outputs[1]);
+    }
+}
+
+TEST_CASE (networkRepeatsAndDecays)
+{
+    const int numChannels = 2;
+    FeedbackDelayNetwork network (numChannels);
+    network.prepare (s_sampleFreq, 100);
+    network.setNetwork (8, FeedbackDelayNetwork::HOUSEHOLDER);
+    network.setDelay (20);
+    network.setFeedback (0.5f);
+
+    std::vector<float> input (numChannels*s_sampleFreq, 0.0f);
+    input[0] = input[1] = 1.0f;
+    const std::vector<float> output = process (network, input, numChannels, FeedbackDelayNetwork::s_blockSize);
+
+    // Nothing comes out before the shortest line, which is at least half of the longest.
+    const int longest = network.getLongestDelay();
+    CHECK (getEnergy (output, numChannels, 0, longest/2) == 0);
+    CHECK (getEnergy (output, numChannels, 0, longest + 1) > 0);
+
+    // Each pass through the longest delay loses half of the level, so a quarter of the energy.
+    const double first = getEnergy (output, numChannels, 4*longest, 8*longest);
+    const double later = getEnergy (output, numChannels, 8*longest, 12*longest);
+    CHECK (later > 0 && later < first);
+    CHECK (std::abs (later/first - 1.0/256) < 0.5/256);
+}
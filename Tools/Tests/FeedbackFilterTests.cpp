@@ -0,0 +1,119 @@
+/**
+ * FeedbackFilterTests.cpp
+ * \brief Tests for the feedback loop filter.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "DelayLine.h"
+#include "FeedbackFilter.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+
+/**
+ * Gets the gain of a filter at a frequency from the peak of a filtered sine, once it has settled.
+ */
+static float getGain (const FeedbackFilter::Type type, const float frequency, const float tilt, const float sineFrequency)
+{
+    FeedbackFilter filter;
+    filter.prepare (s_sampleFreq);
+    filter.setFilter (type, frequency, tilt);
+
+    std::vector<float> sine (s_sampleFreq);
+    for (size_t i = 0; i < sine.size(); ++i) { sine[i] = static_cast<float> (std::sin (2 * 3.14159265358979 * sineFrequency * i / s_sampleFreq)); }
+    filter.process (sine.data(), s_sampleFreq);
+
+    float peak = 0;
+    for (size_t i = sine.size() / 2; i < sine.size(); ++i) { peak = std::max (peak, std::abs (sine[i])); }
+    return peak;
+}
+
+TEST_CASE (filterResponses)
+{
+    // The Butterworth sections are 3 dB down at the cutoff and flat well inside the pass band.
+    CHECK (std::abs (getGain (FeedbackFilter::LOW_PASS, 1000, 0, 50) - 1) < 0.01f);
+    CHECK (std::abs (getGain (FeedbackFilter::LOW_PASS, 1000, 0, 1000) - 0.7071f) < 0.01f);
+    CHECK (getGain (FeedbackFilter::LOW_PASS, 1000, 0, 10000) < 0.015f);
+    CHECK (std::abs (getGain (FeedbackFilter::HIGH_PASS, 1000, 0, 20000) - 1) < 0.01f);
+    CHECK (std::abs (getGain (FeedbackFilter::HIGH_PASS, 1000, 0, 1000) - 0.7071f) < 0.01f);
+    CHECK (getGain (FeedbackFilter::HIGH_PASS, 1000, 0, 100) < 0.015f);
+
+    // A -6 dB tilt halves the top end and leaves the lows alone, and a +6 dB tilt does the opposite.
+    CHECK (std::abs (getGain (FeedbackFilter::TILT, 1000, -6, 20) - 1) < 0.01f);
+    CHECK (std::abs (getGain (FeedbackFilter::TILT, 1000, -6, 20000) - 0.5f) < 0.03f);
+    CHECK (std::abs (getGain (FeedbackFilter::TILT, 1000, 6, 20) - 0.5f) < 0.03f);
+    CHECK (std::abs (getGain (FeedbackFilter::TILT, 1000, 6, 20000) - 1) < 0.01f);
+    CHECK (std::abs (getGain (FeedbackFilter::OFF, 1000, 0, 5000) - 1) < 1e-3f);
+}
+
+TEST_CASE (filtersNeverBoost)
+{
+    // A gain above 0 dB anywhere would let the feedback loop grow.
+    const FeedbackFilter::Type types[] = { FeedbackFilter::LOW_PASS, FeedbackFilter::HIGH_PASS, FeedbackFilter::TILT };
+    for (const FeedbackFilter::Type type : types)
+    {
+        for (float frequency = 20; frequency < 22000; frequency *= 1.5f)
+        {
+            CHECK (getGain (type, 2000, -12, frequency) < 1.002f);
+            CHECK (getGain (type, 2000, 12, frequency) < 1.002f);
+        }
+    }
+}
+
+TEST_CASE (filterChannelsAreIndependent)
+{
+    // Two and three interleaved channels, which take the unrolled and the generic paths.
+    for (const int numChannels : { 2, 3 })
+    {
+        std::vector<float> interleaved (numChannels * 4096);
+        for (size_t i = 0; i < interleaved.size(); ++i) { interleaved[i] = static_cast<float> (std::sin (0.37 * i) + std::cos (0.011 * i * i)); }
+
+        std::vector<float> expected (interleaved);
+        for (int c = 0; c < numChannels; ++c)
+        {
+            FeedbackFilter mono;
+            mono.prepare (s_sampleFreq);
+            mono.setFilter (FeedbackFilter::LOW_PASS, 3000, 0);
+            std::vector<float> channel (4096);
+            for (int i = 0; i < 4096; ++i) { channel[i] = interleaved[i*numChannels + c]; }
+            mono.process (channel.data(), 4096);
+            for (int i = 0; i < 4096; ++i) { expected[i*numChannels + c] = channel[i]; }
+        }
+
+        FeedbackFilter filter (numChannels);
+        filter.prepare (s_sampleFreq);
+        filter.setFilter (FeedbackFilter::LOW_PASS, 3000, 0);
+        for (int start = 0; start < 4096; start += 1000) { filter.process (interleaved.data() + start*numChannels, std::min (1000, 4096 - start)); }
+        CHECK (interleaved == expected);
+    }
+}
+
+TEST_CASE (feedbackFilterDarkensRepeats)
+{
+    DelayLine delayLine (s_sampleFreq, 10);
+    delayLine.setFeedback (90);
+    delayLine.setMix (100);
+    delayLine.setFeedbackFilter (FeedbackFilter::LOW_PASS, 2000, 0);
+
+    std::vector<float> signal (4 * 480, 0.0f);
+    signal[0] = 1.0f;
+    delayLine.processBlock (signal.data(), signal.data(), static_cast<int> (signal.size()));
+
+    // Each repeat goes through the low pass once more, so its peak drops while its DC gain stays
+    // at the feedback level.
+    float peaks[3] = {}, sums[3] = {};
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int i = (k + 1) * 480; i < (k + 2) * 480; ++i)
+        {
+            peaks[k] = std::max (peaks[k], std::abs (signal[i]));
+            sums[k] += signal[i];
+        }
+    }
+    CHECK (peaks[0] < 0.5f && peaks[1] < peaks[0] && peaks[2] < peaks[1]);
+    CHECK (std::abs (sums[0] - 1) < 1e-3f && std::abs (sums[1] - 0.9f) < 1e-3f && std::abs (sums[2] - 0.81f) < 2e-3f);
+}
@@ -0,0 +1,88 @@
+/**
+ * InterpolatorsTests.cpp
+ * \brief Tests for the fractional delay interpolation.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "DelayLine.h"
+#include "Interpolators.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+
+/**
+ * Delays a sine by a fractional number of samples and gets the largest error against the exact
+ * delayed sine, once the delay line has filled.
+ */
+static float getSineError (const Interpolators::Type type, const double frequency, const double delaySamples)
+{
+    DelayLine delayLine (s_sampleFreq);
+    delayLine.setInterpolation (type);
+    delayLine.setDelay (static_cast<float> (delaySamples * 1000.0 / s_sampleFreq));
+    delayLine.setMix (100);
+
+    const int numSamples = 4096;
+    const double w = 2 * M_PI * frequency / s_sampleFreq;
+    std::vector<float> signal (numSamples);
+    for (int i = 0; i < numSamples; ++i) { signal[i] = static_cast<float> (std::sin (w * i)); }
+    delayLine.processBlock (signal.data(), signal.data(), numSamples);
+
+    float largest = 0;
+    for (int i = numSamples / 2; i < numSamples; ++i)
+    {
+        largest = std::max (largest, static_cast<float> (std::abs (signal[i] - std::sin (w * (i - delaySamples)))));
+    }
+    return largest;
+}
+
+TEST_CASE (coefficientsSumToOne)
+{
+    // Every interpolator passes DC unchanged, at any fraction.
+    Interpolators::initialise();
+    for (float fraction = 0; fraction < 1.0f; fraction += 0.0625f)
+    {
+        float coeffs[8];
+        float sum = 0;
+        CubicInterpolator::getCoefficients (fraction, coeffs);
+        for (int k = 0; k < CubicInterpolator::s_numTaps; ++k) { sum += coeffs[k]; }
+        CHECK (std::abs (sum - 1.0f) < 1e-5f);
+
+        sum = 0;
+        LagrangeInterpolator::getCoefficients (fraction, coeffs);
+        for (int k = 0; k < LagrangeInterpolator::s_numTaps; ++k) { sum += coeffs[k]; }
+        CHECK (std::abs (sum - 1.0f) < 1e-5f);
+
+        sum = 0;
+        SincInterpolator::getCoefficients (fraction, coeffs);
+        for (int k = 0; k < SincInterpolator::s_numTaps; ++k) { sum += coeffs[k]; }
+        CHECK (std::abs (sum - 1.0f) < 1e-2f);
+    }
+}
+
+TEST_CASE (interpolatorsDelayASine)
+{
+    // Half a sample is the hardest fraction. Linear interpolation loses a lot at high frequencies,
+    // and the others should do much better.
+    const float linearLow = getSineError (Interpolators::LINEAR, 1000, 10.5);
+    const float linearHigh = getSineError (Interpolators::LINEAR, 8000, 10.5);
+    CHECK (linearLow < 3e-3f && linearHigh < 0.14f);
+
+    for (int type = Interpolators::CUBIC; type < Interpolators::s_numTypes; ++type)
+    {
+        CHECK (getSineError (static_cast<Interpolators::Type> (type), 1000, 10.5) < 2e-4f);
+        CHECK (getSineError (static_cast<Interpolators::Type> (type), 8000, 10.5) < linearHigh / 2);
+    }
+    CHECK (getSineError (Interpolators::SINC, 8000, 10.5) < 2e-3f);
+}
+
+TEST_CASE (interpolatorsKeepWholeDelays)
+{
+    for (int type = 0; type < Interpolators::s_numTypes; ++type)
+    {
+        CHECK (getSineError (static_cast<Interpolators::Type> (type), 8000, 12) < 1e-4f);
+    }
+}
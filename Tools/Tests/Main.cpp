@@ -0,0 +1,50 @@
+/**
+ * Main.cpp
+ * \brief Runs the unit tests.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ *
+ * Usage: stereo-delay-tests [filter]
+ *     Runs every test whose name contains the filter (default: all of them), and exits with a
+ *     non-zero status if any of them fail.
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "Tests.h"
+
+static int s_numFailures = 0; ///< Number of failed checks in the current test.
+
+std::vector<Tests::TestCase>& Tests::getTests()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+void Tests::fail (const char* file, const int line, const char* expression)
+{
+    std::printf ("    %s:%d: CHECK (%s) failed\n", file, line, expression);
+    ++s_numFailures;
+}
+
+int main (int argc, char* argv[])
+{
+    const char* filter = (argc > 1) ? argv[1] : "";
+    int numRun = 0;
+    int numFailed = 0;
+
+    for (const Tests::TestCase& test : Tests::getTests())
+    {
+        if (std::strstr (test.name, filter) == nullptr) { continue; }
+
+        std::printf ("%s\n", test.name);
+        std::fflush (stdout);
+        s_numFailures = 0;
+        test.function();
+        ++numRun;
+        if (s_numFailures > 0) { ++numFailed; }
+    }
+
+    std::printf ("%d tests, %d failed\n", numRun, numFailed);
+    return (numFailed > 0) ? 1 : 0;
+}
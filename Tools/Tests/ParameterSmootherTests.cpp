@@ -0,0 +1,57 @@
+/**
+ * ParameterSmootherTests.cpp
+ * \brief Tests for the parameter ramps.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ParameterSmoother.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+
+TEST_CASE (linearRampIsEven)
+{
+    ParameterSmoother smoother (0.0f);
+    smoother.setRamp (ParameterSmoother::LINEAR, 10);
+    smoother.prepare (s_sampleFreq);
+    smoother.setTarget (1.0f);
+    CHECK (smoother.isSmoothing());
+
+    // The ramp is 480 samples long whatever the block size, and ends exactly on the target.
+    std::vector<float> values (500);
+    for (int start = 0; start < 500; start += 37) { smoother.process (values.data() + start, std::min (37, 500 - start)); }
+    for (int i = 0; i < 480; ++i) { CHECK (std::abs (values[i] - (i + 1) / 480.0f) < 1e-5f); }
+    CHECK (values[479] == 1.0f && values[499] == 1.0f);
+    CHECK (! smoother.isSmoothing());
+}
+
+TEST_CASE (onePoleRampSettles)
+{
+    ParameterSmoother smoother (1.0f);
+    smoother.setRamp (ParameterSmoother::ONE_POLE, 10);
+    smoother.prepare (s_sampleFreq);
+    smoother.setTarget (0.0f);
+
+    // About 0.1% of the change is left after the ramp time (e^-6.9), and then it ends on the target.
+    std::vector<float> values (480);
+    smoother.process (values.data(), 480);
+    CHECK (values[0] < 1.0f && values[479] > 0 && values[479] < 1.01e-3f);
+    for (int i = 1; i < 480; ++i) { CHECK (values[i] < values[i - 1]); }
+
+    values.resize (s_sampleFreq);
+    smoother.process (values.data(), s_sampleFreq);
+    CHECK (! smoother.isSmoothing() && smoother.getValue() == 0.0f);
+}
+
+TEST_CASE (zeroRampIsImmediate)
+{
+    ParameterSmoother smoother (0.0f);
+    smoother.setRamp (ParameterSmoother::LINEAR, 0);
+    smoother.prepare (s_sampleFreq);
+    smoother.setTarget (0.5f);
+    CHECK (! smoother.isSmoothing() && smoother.getValue() == 0.5f);
+}
@@ -0,0 +1,170 @@
+/**
+ * PartitionedConvolverTests.cpp
+ * \brief Tests for the partitioned convolver.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "BackgroundThread.h"
+#include "PartitionedConvolver.h"
+#include "Tests.h"
+
+/**
+ * Convolves interleaved frames with one response channel per channel, directly in double precision.
+ */
+static std::vector<double> convolveDirect (const std::vector<float>& input, const std::vector<std::vector<float>>& response, const int numChannels)
+{
+    const int numFrames = static_cast<int> (input.size()) / numChannels;
+    std::vector<double> output (input.size(), 0.0);
+    for (int c = 0; c < numChannels; ++c)
+    {
+        const std::vector<float>& h = response[c % response.size()];
+        for (int i = 0; i < numFrames; ++i)
+        {
+            double sum = 0;
+            for (int k = 0; k <= i && k < static_cast<int> (h.size()); ++k) { sum += static_cast<double> (h[k]) * input[(i - k)*numChannels + c]; }
+            output[i*numChannels + c] = sum;
+        }
+    }
+    return output;
+}
+
+/**
+ * Runs frames through a convolver in uneven runs, and optionally gives the background thread time
+ * to keep up after every tail block.
+ */
+static std::vector<float> convolve (PartitionedConvolver& convolver, const std::vector<float>& input, const int numChannels, const bool wait = true)
+{
+    const int numFrames = static_cast<int> (input.size()) / numChannels;
+    std::vector<float> output (input.size());
+    int done = 0;
+    for (int run = 1; done < numFrames; run = (run * 7) % PartitionedConvolver::s_blockSize + 1)
+    {
+        const int num = std::min (run, numFrames - done);
+        const float* out = convolver.process (input.data() + done*numChannels, num);
+        std::copy (out, out + num*numChannels, output.begin() + done*numChannels);
+
+        if (wait && (done + num) / PartitionedConvolver::s_tailSize != done / PartitionedConvolver::s_tailSize)
+        {
+            std::this_thread::sleep_for (std::chrono::milliseconds (20));
+        }
+        done += num;
+    }
+    return output;
+}
+
+/**
+ * Makes a random stereo response that reaches the head, the audio thread partitions and three tail
+ * partitions, and random input that runs past its end.
+ */
+static void makeTailTest (std::vector<std::vector<float>>& response, std::vector<float>& input)
+{
+    const int numChannels = 2;
+    const int length = 2*PartitionedConvolver::s_tailSize + 3*PartitionedConvolver::s_tailSize - 100;
+    std::mt19937 random (5);
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+
+    response.assign (numChannels, std::vector<float> (length));
+    for (auto& channel : response)
+    {
+        for (int k = 0; k < length; ++k) { channel[k] = distribution (random) * std::exp (-3.0f*k/length); }
+    }
+    input.resize (numChannels*(length + 3*PartitionedConvolver::s_tailSize));
+    for (float& sample : input) { sample = distribution (random); }
+}
+
+/**
+ * Gets the largest difference between convolved frames and a direct convolution, relative to the
+ * peak of the direct convolution.
+ */
+static double getRelativeError (const std::vector<float>& output, const std::vector<double>& expected)
+{
+    double error = 0;
+    double peak = 0;
+    for (size_t i = 0; i < output.size(); ++i)
+    {
+        error = std::max (error, std::abs (output[i] - expected[i]));
+        peak = std::max (peak, std::abs (expected[i]));
+    }
+    return error / peak;
+}
+
+TEST_CASE (convolverMatchesDirectConvolution)
+{
+    std::vector<std::vector<float>> response;
+    std::vector<float> input;
+    makeTailTest (response, input);
+
+    PartitionedConvolver convolver (2);
+    const float* channels[2] = { response[0].data(), response[1].data() };
+    CHECK (convolver.setResponse (channels, 2, static_cast<int> (response[0].size())));
+
+    const std::vector<float> output = convolve (convolver, input, 2);
+    CHECK (convolver.getNumDropouts() == 0);
+    CHECK (getRelativeError (output, convolveDirect (input, response, 2)) < 1e-5);
+}
+
+/**
+ * Background task that holds up the shared thread until it's released.
+ *
+ * \param[in]  void*  std::atomic<int> state (0 = not started, 1 = holding, 2 = released)
+ */
+static void holdBackgroundThread (void* context)
+{
+    std::atomic<int>& state = *static_cast<std::atomic<int>*> (context);
+    int holding = 0;
+    if (! state.compare_exchange_strong (holding, 1)) { return; }
+    while (state.load() == 1) { std::this_thread::sleep_for (std::chrono::milliseconds (1)); }
+}
+
+TEST_CASE (lateTailBlocksAreConvolved)
+{
+    std::vector<std::vector<float>> response;
+    std::vector<float> input;
+    makeTailTest (response, input);
+
+    PartitionedConvolver convolver (2);
+    const float* channels[2] = { response[0].data(), response[1].data() };
+    CHECK (convolver.setResponse (channels, 2, static_cast<int> (response[0].size())));
+
+    // With the background thread held up, every tail block is late, so the audio thread convolves
+    // each one itself and nothing is left out.
+    std::shared_ptr<BackgroundThread> thread = BackgroundThread::getShared();
+    std::atomic<int> state (0);
+    thread->add (&holdBackgroundThread, &state);
+    while (state.load() == 0) { std::this_thread::yield(); }
+
+    const std::vector<float> output = convolve (convolver, input, 2, false);
+    state = 2;
+    thread->remove (&state);
+
+    CHECK (convolver.getNumDropouts() == 0);
+    CHECK (convolver.getNumLateBlocks() > 0);
+    CHECK (getRelativeError (output, convolveDirect (input, response, 2)) < 1e-5);
+}
+
+TEST_CASE (convolverSharesMonoResponse)
+{
+    const int numChannels = 3;
+    const int length = 300;
+    std::vector<std::vector<float>> response (1, std::vector<float> (length));
+    for (int k = 0; k < length; ++k) { response[0][k] = (k % 37 == 0) ? 1.0f / (1 + k) : 0.0f; }
+    std::vector<float> input (numChannels*1000);
+    for (size_t i = 0; i < input.size(); ++i) { input[i] = std::sin (0.01f * i); }
+
+    PartitionedConvolver convolver (numChannels);
+    const float* channels[1] = { response[0].data() };
+    CHECK (convolver.setResponse (channels, 1, length));
+
+    const std::vector<float> output = convolve (convolver, input, numChannels);
+    const std::vector<double> expected = convolveDirect (input, response, numChannels);
+    double error = 0;
+    for (size_t i = 0; i < output.size(); ++i) { error = std::max (error, std::abs (output[i] - expected[i])); }
+    CHECK (error < 1e-5);
+}
@@ -0,0 +1,53 @@
+/**
+ * PerformanceMonitorTests.cpp
+ * \brief Tests for the performance monitor.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "PerformanceMonitor.h"
+#include "Tests.h"
+
+/**
+ * Records a number of callbacks in a monitor.
+ */
+static void record (PerformanceMonitor& monitor, const int numCallbacks)
+{
+    for (int c = 0; c < numCallbacks; ++c) { PerformanceMonitor::ScopedTimer timer (monitor, 64); }
+}
+
+/**
+ * Waits long enough for the background thread to drain the monitors.
+ */
+static void waitForDrain()
+{
+    std::this_thread::sleep_for (std::chrono::milliseconds (200));
+}
+
+TEST_CASE (drainsSeveralMonitors)
+{
+    PerformanceMonitor first;
+    std::unique_ptr<PerformanceMonitor> second (new PerformanceMonitor());
+    first.prepare (44100);
+    second->prepare (96000);
+    record (first, 10);
+    record (*second, 20);
+    waitForDrain();
+    CHECK (first.getStats().numCallbacks == 10);
+    CHECK (second->getStats().numCallbacks == 20);
+    CHECK (first.exportJSON().find ("\"sampleRate\": 44100.0") != std::string::npos);
+    CHECK (second->exportJSON().find ("\"sampleRate\": 96000.0") != std::string::npos);
+
+    // Preparing again clears a monitor, and destroying one leaves the other drained.
+    first.prepare (48000);
+    second.reset();
+    record (first, 5);
+    waitForDrain();
+    CHECK (first.getStats().numCallbacks == 5);
+    CHECK (first.getHistory().size() == 5);
+    CHECK (first.exportJSON().find ("\"sampleRate\": 48000.0") != std::string::npos);
+}
@@ -0,0 +1,142 @@
+/**
+ * SaturatorTests.cpp
+ * \brief Tests for the feedback loop drive stage.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Saturator.h"
+#include "Tests.h"
+
+static const int s_sampleFreq = 48000; ///< Sample frequency of the tests.
+static const double s_pi = 3.14159265358979323846; ///< Pi.
+
+/**
+ * Gets the amplitude of one frequency in a signal with the Goertzel algorithm.
+ */
+static double getAmplitude (const std::vector<float>& signal, const size_t start, const double frequency)
+{
+    const double coef = 2 * std::cos (2 * s_pi * frequency / s_sampleFreq);
+    double s1 = 0, s2 = 0;
+    for (size_t i = start; i < signal.size(); ++i)
+    {
+        const double s0 = signal[i] + (coef * s1) - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    const double power = (s1 * s1) + (s2 * s2) - (coef * s1 * s2);
+    return 2 * std::sqrt (std::max (power, 0.0)) / (signal.size() - start);
+}
+
+TEST_CASE (curvesMatchTheirFunctions)
+{
+    // With 12 dB of drive, inputs up to +/-2 stay inside the range of the tables.
+    const float drive = std::pow (10.0f, 12.0f / 20);
+    std::vector<float> input (4001);
+    for (size_t i = 0; i < input.size(); ++i) { input[i] = -2.0f + i * 0.001f; }
+
+    const Saturator::Shape shapes[] = { Saturator::TANH, Saturator::ATAN, Saturator::CUBIC };
+    for (const Saturator::Shape shape : shapes)
+    {
+        Saturator saturator;
+        saturator.setSaturation (shape, 12, 1);
+        std::vector<float> output (input);
+        saturator.process (output.data(), static_cast<int> (output.size()));
+
+        for (size_t i = 0; i < input.size(); ++i)
+        {
+            const double x = input[i] * drive;
+            double expected = 0;
+            switch (shape)
+            {
+                case Saturator::TANH:
+                    expected = std::tanh (x);
+                    break;
+                case Saturator::ATAN:
+                    expected = (2 / s_pi) * std::atan (0.5 * s_pi * x);
+                    break;
+                default:
+                    expected = std::max (-1.0, std::min (x, 1.0)) - std::pow (std::max (-1.0, std::min (x, 1.0)), 3) / 3;
+                    break;
+            }
+            CHECK (std::abs (output[i] - expected / drive) < 1e-5);
+        }
+    }
+}
+
+TEST_CASE (saturationNeverAddsGain)
+{
+    // Unity gain for small signals and less for large ones keeps the loop gain at or below the feedback.
+    std::vector<float> input (2001);
+    for (size_t i = 0; i < input.size(); ++i) { input[i] = -10.0f + i * 0.01f; }
+
+    const Saturator::Shape shapes[] = { Saturator::TANH, Saturator::ATAN, Saturator::CUBIC };
+    for (const Saturator::Shape shape : shapes)
+    {
+        for (const float drive : { 0.0f, 6.0f, 24.0f })
+        {
+            Saturator saturator;
+            saturator.setSaturation (shape, drive, 1);
+            std::vector<float> output (input);
+            saturator.process (output.data(), static_cast<int> (output.size()));
+            for (size_t i = 0; i < input.size(); ++i) { CHECK (std::abs (output[i]) <= std::abs (input[i]) + 1e-6f); }
+
+            float small = 1e-3f;
+            saturator.process (&small, 1);
+            CHECK (std::abs (small - 1e-3f) < 1e-6f);
+        }
+    }
+
+    // Switched off, the delay line skips it altogether.
+    Saturator saturator;
+    CHECK (! saturator.isActive());
+    saturator.setSaturation (Saturator::TANH, 6, 1);
+    CHECK (saturator.isActive());
+    saturator.setSaturation (Saturator::OFF, 6, 1);
+    CHECK (! saturator.isActive());
+}
+
+TEST_CASE (oversamplingReducesAliasing)
+{
+    // The fifth harmonic of a 7 kHz sine is at 35 kHz, which folds back to 13 kHz at 1x.
+    std::vector<float> sine (s_sampleFreq / 2);
+    for (size_t i = 0; i < sine.size(); ++i) { sine[i] = static_cast<float> (0.8 * std::sin (2 * s_pi * 7000 * i / s_sampleFreq)); }
+
+    double aliases[3] = {};
+    double fundamentals[3] = {};
+    for (int k = 0; k < 3; ++k)
+    {
+        Saturator saturator;
+        saturator.setSaturation (Saturator::TANH, 18, 1 << k);
+        std::vector<float> output (sine);
+        for (size_t start = 0; start < output.size(); start += 512) { saturator.process (output.data() + start, static_cast<int> (std::min<size_t> (512, output.size() - start))); }
+        aliases[k] = getAmplitude (output, output.size() / 2, 13000);
+        fundamentals[k] = getAmplitude (output, output.size() / 2, 7000);
+    }
+
+    // Each doubling takes the alias down, and the fundamental comes through about the same.
+    CHECK (aliases[1] < aliases[0] / 10);
+    CHECK (aliases[2] < aliases[1]);
+    CHECK (std::abs (fundamentals[1] - fundamentals[0]) < 0.1 * fundamentals[0]);
+    CHECK (std::abs (fundamentals[2] - fundamentals[0]) < 0.1 * fundamentals[0]);
+}
+
+TEST_CASE (oversamplingPassesSmallSignals)
+{
+    // Below the half-band corner, a small sine keeps its level through the up and down filters.
+    for (const int oversampling : { 2, 4 })
+    {
+        Saturator saturator (2);
+        saturator.setSaturation (Saturator::TANH, 0, oversampling);
+        std::vector<float> signal (2 * 8192);
+        for (int i = 0; i < 8192; ++i) { signal[2*i] = signal[2*i + 1] = static_cast<float> (0.01 * std::sin (2 * s_pi * 1000 * i / s_sampleFreq)); }
+        saturator.process (signal.data(), 8192);
+
+        std::vector<float> left (8192);
+        for (int i = 0; i < 8192; ++i) { left[i] = signal[2*i]; CHECK (signal[2*i] == signal[2*i + 1]); }
+        CHECK (std::abs (getAmplitude (left, 4096, 1000) - 0.01) < 1e-4);
+    }
+}
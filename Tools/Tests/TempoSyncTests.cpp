@@ -0,0 +1,63 @@
+/**
+ * TempoSyncTests.cpp
+ * \brief Tests for the tempo-synced delay times and the tap tempo.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <cmath>
+
+#include "TempoSync.h"
+#include "Tests.h"
+
+TEST_CASE (noteDelayTimes)
+{
+    CHECK (TempoSync::getDelayTime (120, TempoSync::QUARTER) == 500.0f);
+    CHECK (TempoSync::getDelayTime (120, TempoSync::WHOLE) == 2000.0f);
+    CHECK (TempoSync::getDelayTime (120, TempoSync::EIGHTH_DOTTED) == 375.0f);
+    CHECK (std::abs (TempoSync::getDelayTime (120, TempoSync::QUARTER_TRIPLET) - 1000.0f / 3) < 1e-3f);
+}
+
+TEST_CASE (tapTempoOutlastsSteadyHostTempo)
+{
+    TempoTracker tempo;
+    CHECK (tempo.setHostTempo (100));
+    CHECK (tempo.getTempo() == 100);
+
+    // The host keeps reporting the same tempo every block, which mustn't undo the tap.
+    tempo.tap (90);
+    CHECK (! tempo.setHostTempo (100));
+    CHECK (! tempo.setHostTempo (100));
+    CHECK (tempo.isTapped());
+    CHECK (tempo.getTempo() == 90);
+    CHECK (tempo.getHostTempo() == 100);
+
+    // Tapping the host's tempo still isn't a host tempo change.
+    tempo.tap (100);
+    CHECK (! tempo.setHostTempo (100));
+    CHECK (tempo.isTapped());
+}
+
+TEST_CASE (hostTempoChangeReplacesTap)
+{
+    TempoTracker tempo (120);
+    tempo.tap (90);
+    CHECK (tempo.setHostTempo (140));
+    CHECK (! tempo.isTapped());
+    CHECK (tempo.getTempo() == 140);
+
+    // Hosts without a tempo report zero, which doesn't count as a change.
+    tempo.tap (80);
+    CHECK (! tempo.setHostTempo (0));
+    CHECK (tempo.getTempo() == 80);
+}
+
+TEST_CASE (clearingTapRestoresHostTempo)
+{
+    TempoTracker tempo (120);
+    tempo.tap (75);
+    CHECK (tempo.getTempo() == 75);
+    tempo.clearTap();
+    CHECK (tempo.getTempo() == 120);
+    tempo.tap (-1);
+    CHECK (! tempo.isTapped());
+}
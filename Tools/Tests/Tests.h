@@ -0,0 +1,56 @@
+/**
+ * Tests.h
+ * \brief Minimal registry and checks for the unit tests.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#pragma once
+
+#include <vector>
+
+/**
+ * \brief Minimal registry and checks for the unit tests.
+ *
+ * Each TEST_CASE registers itself before main() runs, and a failed CHECK prints the file, line and
+ * expression and marks the current test as failed without stopping it.
+ */
+namespace Tests
+{
+    typedef void (*TestFunction)(); ///< Pointer to a test function.
+
+    /**
+     * A registered test.
+     */
+    struct TestCase
+    {
+        const char* name; ///< Name of the test.
+        TestFunction function; ///< Test function.
+    };
+
+    std::vector<TestCase>& getTests(); ///< Gets the registered tests, in the order they were registered.
+
+    /**
+     * Registers a test when it's constructed.
+     */
+    struct Registrar
+    {
+        Registrar (const char* name, const TestFunction function) { getTests().push_back ({ name, function }); };
+    };
+
+    /**
+     * Reports a failed check.
+     *
+     * \param[in]  char*  Source file
+     * \param[in]  int  Line number
+     * \param[in]  char*  Expression that failed
+     */
+    void fail (const char* file, const int line, const char* expression);
+}
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static const Tests::Registrar name##Registrar (#name, &name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (! (condition)) { Tests::fail (__FILE__, __LINE__, #condition); } } while (false)
@@ -0,0 +1,101 @@
+/**
+ * TieredDelayBufferTests.cpp
+ * \brief Tests for the long delay buffer.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "TieredDelayBuffer.h"
+#include "Tests.h"
+
+static const int s_numChannels = 2; ///< Number of interleaved channels in the tests.
+static const int s_blockFrames = 512; ///< Number of frames per block in the tests.
+
+/**
+ * Gets a test sample that's unique to its frame and channel within 2047 frames, which isn't a
+ * whole number of segments, and is exact in half precision.
+ *
+ * \param[in]  int64_t  Absolute frame
+ * \param[in]  int  Channel
+ *
+ * \return  float  Sample value
+ */
+static float getTestSample (const int64_t frame, const int channel)
+{
+    const float value = static_cast<float> ((frame % 2047) - 1023) / 1024;
+    return (channel == 0) ? value : -value;
+}
+
+/**
+ * Writes numbered samples through a delay well past the RAM ring, so that every repeat comes back
+ * through the spill store, and gets the largest difference between what was read and written.
+ *
+ * \param[in]  TieredDelayBuffer::Format  Storage format for the spill store
+ * \param[out]  int&  Number of dropouts
+ *
+ * \return  float  Largest error
+ */
+static float getSpillError (const TieredDelayBuffer::Format format, int& numDropouts)
+{
+    const int64_t delay = 50*TieredDelayBuffer::s_segmentFrames + 123;
+    TieredDelayBuffer buffer;
+    CHECK (buffer.prepare (s_numChannels, 60*TieredDelayBuffer::s_segmentFrames, std::string(), format));
+    CHECK (buffer.isReady() && buffer.getFormat() == format);
+
+    float largest = 0;
+    const int64_t numFrames = delay + 8*TieredDelayBuffer::s_segmentFrames;
+    for (int64_t block = 0; block < numFrames; block += s_blockFrames)
+    {
+        for (int done = 0; done < s_blockFrames; )
+        {
+            const int64_t writeFrame = buffer.getWriteFrame();
+            const int run = buffer.getRunLength (writeFrame - delay, s_blockFrames - done);
+            float* write = buffer.getWritePointer();
+            for (int i = 0; i < run; ++i)
+            {
+                for (int c = 0; c < s_numChannels; ++c) { write[i*s_numChannels + c] = getTestSample (writeFrame + i, c); }
+            }
+            buffer.advance (run);
+
+            // Anything from before the recording started reads as silence.
+            const float* read = buffer.read (writeFrame - delay, run);
+            for (int i = 0; i < run; ++i)
+            {
+                const int64_t frame = writeFrame - delay + i;
+                for (int c = 0; c < s_numChannels; ++c)
+                {
+                    const float expected = (frame < 0) ? 0.0f : getTestSample (frame, c);
+                    largest = std::max (largest, std::abs (read[i*s_numChannels + c] - expected));
+                }
+            }
+            done += run;
+        }
+
+        // Leave the background thread some time, as a real audio callback would.
+        std::this_thread::sleep_for (std::chrono::microseconds (500));
+    }
+
+    numDropouts = buffer.getNumDropouts();
+    buffer.release();
+    CHECK (! buffer.isReady());
+    return largest;
+}
+
+TEST_CASE (spilledAudioReadsBack)
+{
+    // Single and half precision are exact for the test samples, and 16-bit keeps 16 bits below
+    // the peak of each block.
+    int numDropouts = -1;
+    CHECK (getSpillError (TieredDelayBuffer::FLOAT32, numDropouts) == 0);
+    CHECK (numDropouts == 0);
+    CHECK (getSpillError (TieredDelayBuffer::FLOAT16, numDropouts) == 0);
+    CHECK (numDropouts == 0);
+    CHECK (getSpillError (TieredDelayBuffer::INT16, numDropouts) < 1.0f / 32767);
+    CHECK (numDropouts == 0);
+}
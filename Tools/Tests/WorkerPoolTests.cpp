@@ -0,0 +1,175 @@
+/**
+ * WorkerPoolTests.cpp
+ * \brief Tests for the worker pool.
+ * \author Chris Harless (chris.harless3@gmail.com)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "MultiChannelDelayLine.h"
+#include "WorkerPool.h"
+#include "Tests.h"
+
+static const int s_numJobs = 5; ///< Number of jobs per batch.
+
+/**
+ * Counts the times each job of a batch runs.
+ */
+struct JobCounts
+{
+    std::atomic<int> counts[s_numJobs];
+
+    JobCounts() { clear(); };
+    void clear() { for (auto& count : counts) { count = 0; } };
+    static void count (void* context, const int index) { ++static_cast<JobCounts*> (context)->counts[index]; };
+    bool isEachOnce() const
+    {
+        for (auto& count : counts) { if (count.load() != 1) { return false; } }
+        return true;
+    };
+};
+
+TEST_CASE (runsEveryJobOnce)
+{
+    WorkerPool pool (3);
+    JobCounts jobs;
+    for (int batch = 0; batch < 1000; ++batch)
+    {
+        jobs.clear();
+        pool.run (s_numJobs, &JobCounts::count, &jobs);
+        CHECK (jobs.isEachOnce());
+    }
+}
+
+TEST_CASE (runsBatchesFromSeveralThreads)
+{
+    // More callers than slots, so some of them run their jobs themselves.
+    WorkerPool pool (3);
+    const int numCallers = WorkerPool::s_maxBatches + 2;
+    std::vector<std::thread> callers;
+    std::atomic<int> failures (0);
+    for (int c = 0; c < numCallers; ++c)
+    {
+        callers.emplace_back ([&pool, &failures]
+        {
+            JobCounts jobs;
+            for (int batch = 0; batch < 200; ++batch)
+            {
+                jobs.clear();
+                pool.run (s_numJobs, &JobCounts::count, &jobs);
+                if (! jobs.isEachOnce()) { ++failures; }
+            }
+        });
+    }
+    for (auto& caller : callers) { caller.join(); }
+    CHECK (failures == 0);
+}
+
+TEST_CASE (sharesOnePool)
+{
+    std::shared_ptr<WorkerPool> first = WorkerPool::getShared();
+    std::shared_ptr<WorkerPool> second = WorkerPool::getShared();
+    CHECK (first == second);
+    const int numCores = static_cast<int> (std::max (1u, std::thread::hardware_concurrency()));
+    CHECK (first->getNumThreads() == std::min (numCores, WorkerPool::s_maxSharedThreads + 1) - 1);
+}
+
+TEST_CASE (idleWorkersSleep)
+{
+    WorkerPool pool (2);
+    JobCounts jobs;
+    pool.run (s_numJobs, &JobCounts::count, &jobs);
+    std::this_thread::sleep_for (std::chrono::milliseconds (20));
+
+    // Spinning workers would use about the whole wait in processor time.
+    const std::clock_t start = std::clock();
+    std::this_thread::sleep_for (std::chrono::milliseconds (200));
+    const double used = static_cast<double> (std::clock() - start) / CLOCKS_PER_SEC;
+    CHECK (used < 0.05);
+}
+
+TEST_CASE (reportsRealtimePriority)
+{
+    // The workers have realtime priority exactly when any new thread could get it.
+    bool granted = false;
+    std::thread thread ([&granted]
+    {
+        sched_param param = {};
+        param.sched_priority = sched_get_priority_min (SCHED_FIFO);
+        granted = pthread_setschedparam (pthread_self(), SCHED_FIFO, &param) == 0;
+    });
+    thread.join();
+
+    WorkerPool pool (2);
+    CHECK (pool.isRealtime() == granted);
+    CHECK (WorkerPool (0).isRealtime());
+}
+
+/**
+ * Delay lines for the groups of a layout, and the run of channels they process.
+ */
+struct Groups
+{
+    std::vector<std::unique_ptr<MultiChannelDelayLine>> delayLines;
+    float* const* channels;
+    int groupSize;
+    int numSamples;
+
+    static void process (void* context, const int index)
+    {
+        const Groups* groups = static_cast<Groups*> (context);
+        groups->delayLines[index]->processBlock (groups->channels + index*groups->groupSize, 0, groups->numSamples);
+    };
+};
+
+TEST_CASE (parallelGroupsMatchSerial)
+{
+    // 64 channels in four groups, the largest layout the processor splits up.
+    const int numChannels = 64, groupSize = 16, numSamples = 4096, blockSize = 256;
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> distribution (-1.0f, 1.0f);
+    std::vector<std::vector<float>> serial (numChannels, std::vector<float> (numSamples));
+    for (auto& channel : serial) { for (float& sample : channel) { sample = distribution (random); } }
+    std::vector<std::vector<float>> parallel (serial);
+
+    Groups serialGroups, parallelGroups;
+    for (Groups* groups : { &serialGroups, &parallelGroups })
+    {
+        for (int g = 0; g < numChannels / groupSize; ++g)
+        {
+            groups->delayLines.emplace_back (new MultiChannelDelayLine (groupSize, 48000, 3.7f + g, 60, 50));
+            groups->delayLines.back()->setModulation (2, 30);
+        }
+        groups->groupSize = groupSize;
+        groups->numSamples = blockSize;
+    }
+
+    WorkerPool pool (3);
+    float* serialChannels[numChannels];
+    float* parallelChannels[numChannels];
+    for (int start = 0; start < numSamples; start += blockSize)
+    {
+        for (int c = 0; c < numChannels; ++c)
+        {
+            serialChannels[c] = serial[c].data() + start;
+            parallelChannels[c] = parallel[c].data() + start;
+        }
+        serialGroups.channels = serialChannels;
+        parallelGroups.channels = parallelChannels;
+        for (int g = 0; g < numChannels / groupSize; ++g) { Groups::process (&serialGroups, g); }
+        pool.run (numChannels / groupSize, &Groups::process, &parallelGroups);
+    }
+
+    // Each group only depends on its own channels, so the order doesn't change a single bit.
+    CHECK (serial == parallel);
+}